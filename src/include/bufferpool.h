@@ -0,0 +1,127 @@
+#ifndef _bufferpool_h_
+#define _bufferpool_h_
+
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+#include "src/include/pfm.h"
+#include "src/include/pageio.h"
+
+namespace PeterDB {
+
+    typedef unsigned FrameId;
+
+    // Decides which unpinned frame gets evicted when the buffer pool is full.
+    class ReplacementPolicy {
+    public:
+        virtual ~ReplacementPolicy() = default;
+
+        virtual void recordAccess(FrameId frameId) = 0;                     // frame has been referenced
+        virtual void setEvictable(FrameId frameId, bool evictable) = 0;     // pin count dropped to / left zero
+        virtual RC victim(FrameId &frameId) = 0;                            // pick a frame to evict, -1 if none
+        virtual void remove(FrameId frameId) = 0;                           // frame no longer holds a page
+    };
+
+    // Second-chance CLOCK: one reference bit per frame and a rotating hand.
+    class ClockReplacer : public ReplacementPolicy {
+    public:
+        explicit ClockReplacer(unsigned numFrames);
+
+        void recordAccess(FrameId frameId) override;
+        void setEvictable(FrameId frameId, bool evictable) override;
+        RC victim(FrameId &frameId) override;
+        void remove(FrameId frameId) override;
+
+    private:
+        std::vector<bool> referenced;
+        std::vector<bool> evictable;
+        unsigned numEvictable;
+        FrameId hand;
+    };
+
+    // LRU-K: evict the frame whose K-th most recent access is the oldest.
+    // Frames with fewer than K accesses have an infinite backward distance and go first, oldest access first.
+    class LRUKReplacer : public ReplacementPolicy {
+    public:
+        LRUKReplacer(unsigned numFrames, unsigned k);
+
+        void recordAccess(FrameId frameId) override;
+        void setEvictable(FrameId frameId, bool evictable) override;
+        RC victim(FrameId &frameId) override;
+        void remove(FrameId frameId) override;
+
+    private:
+        unsigned k;
+        unsigned long long currentTime;
+        std::vector<std::list<unsigned long long>> history;                 // most recent access at the front
+        std::vector<bool> evictable;
+        unsigned numEvictable;
+    };
+
+    typedef struct Frame {
+        FileId fileId;
+        PageNum pageNum;
+        unsigned pinCount;
+        bool dirty;
+        bool valid;
+    } Frame;
+
+    // Process-wide page cache shared by every FileHandle. Owned by PagedFileManager.
+    // Pages are addressed by (FileId, PageNum); PageNum is the logical page number, i.e. the hidden header page excluded.
+    class BufferPool {
+    public:
+        BufferPool(unsigned numFrames, ReplacementPolicyType policyType);
+        ~BufferPool();
+
+        // A file has to be attached before its pages can be fetched; detaching writes its dirty pages back.
+        RC attachFile(FileId fileId, PageIO *io);
+        RC detachFile(FileId fileId);
+
+        // Pin a page and return a pointer to its frame. When loadPage is false the frame content is left
+        // undefined, which is what a full-page overwrite wants.
+        RC fetchPage(FileId fileId, PageNum pageNum, char *&frame, bool loadPage = true);
+        RC unpinPage(FileId fileId, PageNum pageNum, bool isDirty);
+
+        // Write the page straight to disk and keep a clean copy in the pool
+        RC writeThrough(FileId fileId, PageNum pageNum, const void *data);
+
+        // Ask the OS to start reading a page that is not cached yet; no frame is taken
+        RC prefetchPage(FileId fileId, PageNum pageNum);
+
+        RC flushFile(FileId fileId);                                        // write back dirty pages of a file
+        RC flushAll();
+        RC discardFile(FileId fileId);                                      // drop every cached page of a file, none if one is pinned
+
+        unsigned getNumberOfFrames() const { return numFrames; }
+        RC collectStats(unsigned &hitCount, unsigned &missCount, unsigned &evictCount) const;
+
+    private:
+        unsigned numFrames;
+        char *frameData;
+        std::vector<Frame> frames;
+        std::vector<FrameId> freeFrames;
+        std::unordered_map<unsigned long long, FrameId> pageTable;
+        std::unordered_map<FileId, PageIO *> files;
+        ReplacementPolicy *policy;
+
+        unsigned hitCount;
+        unsigned missCount;
+        unsigned evictCount;
+
+        static unsigned long long pageKey(FileId fileId, PageNum pageNum) {
+            return ((unsigned long long) fileId << 32u) | pageNum;
+        }
+
+        char *frameOf(FrameId frameId) const { return frameData + (size_t) frameId * PAGE_SIZE; }
+
+        RC getFreeFrame(FrameId &frameId);
+        RC readFromDisk(FileId fileId, PageNum pageNum, char *data);
+        RC writeToDisk(FileId fileId, PageNum pageNum, const char *data);
+        RC writeBack(FrameId frameId);
+    };
+
+} // namespace PeterDB
+
+#endif // _bufferpool_h_
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <functional>
 #include <assert.h>
 
 #include "pfm.h"
@@ -10,15 +12,29 @@
 
 # define IX_EOF (-1)  // end of the index scan
 
-# define ROOT_FLAG 2
 # define NONLEAF_FLAG 3
 # define LEAF_FLAG 4
+# define POSTING_FLAG 5
+# define FREE_FLAG 6
+# define BUCKET_FLAG 7
 
-//#define DIR_SIZE 12 // refer to LeafDir: sizeof( char16_t + char16_t + int + int ) = 12
+# define IX_MAX_INLINE_RIDS 64                      // RIDs a leaf entry keeps before they move to posting pages
+# define IX_MIN_FILL 0.5                            // share of a node below which deleteEntry merges or rebalances it
+
+# define IX_DEFAULT_FILL_FACTOR 0.9                 // share of a node bulkLoad fills
+# define IX_SORT_MEMORY (16 * 1024 * 1024)          // bytes IX_KeySorter sorts in memory before spilling a run
+# define IX_MAX_PREFETCH 32                         // leaves a range scan asks to have read ahead of it at most
+
+# define IX_KEY_COMPRESSION 0x1                     // createFile option: prefix-compressed leaves and truncated
+                                                    // separators for VarChar keys
+# define IX_HASH 0x2                                // createFile option: extendible hash instead of a B+ tree,
+                                                    // equality scans read one bucket chain
 
 namespace PeterDB {
     class IX_ScanIterator;
 
+    class IX_BulkSource;
+
     class IXFileHandle;
 
     typedef char16_t PAGE_FLAG;
@@ -28,21 +44,66 @@ namespace PeterDB {
     typedef unsigned NEXT_LEAF_NODE;
     typedef unsigned PAGE_ID;
     typedef int RECORD_ID;
-
-    typedef struct LeafDir {
+    typedef unsigned short KEY_SLOT;
+    typedef unsigned short RID_NUM;
+
+    // Page 0 of an index file
+    typedef struct IndexHeader {
+        PAGE_ID rootPageID;                     // 0 until the first entry
+        unsigned options;                       // IX_* options, fixed by createFile
+        PAGE_ID freePageID;                     // head of the free page list, 0 when empty
+        unsigned version;                       // bumped whenever entries move between existing leaves, B+ tree only
+    } IndexHeader;
+
+    // Header of every tree node. It is followed by the slot array, one offset per entry in key order,
+    // so a node can be binary-searched; the entries are packed from the end of the page downwards.
+    // Leaf entry: key | RID_NUM n | n RIDs in RID order, one entry per key; a list longer than
+    // IX_MAX_INLINE_RIDS has n == 0 and the PAGE_ID of its first posting page instead.
+    // Internal entry: key | PAGE_ID of the child right of the key.
+    // A compressed leaf keeps the prefix all its keys share once, in the last bytes of the page, and each
+    // entry's key holds only the rest (as a VarChar of its own).
+    typedef struct NodeDir {
         PAGE_FLAG flag;
-        FREE_SPACE freeSpace;
         RECORD_NUM recordNum;
-        NEXT_LEAF_NODE nextLeafNode;
-    }LeafDir;
+        FREE_SPACE freeSpace;                   // includes the holes left by deleted entries
+        OFFSET heapOffset;                      // start of the lowest entry
+        NEXT_LEAF_NODE nextLeafNode;            // leaves only, 0 for the last leaf
+        PAGE_ID firstChild;                     // internal nodes only, child left of the first key
+        OFFSET prefixLength;                    // compressed leaves only, bytes of the shared key prefix
+    } NodeDir;
+
+    // Header of a posting page, followed by its RIDs; the chain of a key keeps RID order across pages
+    typedef struct PostingDir {
+        PAGE_FLAG flag;
+        RECORD_NUM ridNum;
+        PAGE_ID nextPostingPage;                // 0 for the last page of a list
+    } PostingDir;
 
-    typedef struct NodePageDir {
+    // Header of a page on the free list, released by merges and emptied posting lists
+    typedef struct FreePageDir {
         PAGE_FLAG flag;
-        FREE_SPACE freeSpace;
+        PAGE_ID nextFreePage;                   // 0 for the last free page
+    } FreePageDir;
+
+    // Follows the IndexHeader in page 0 of a hash index. The directory maps the low globalDepth bits of a key's
+    // hash to the first page of its bucket. Page 0 holds the directory itself while it fits, and the pages it
+    // was moved to (plain PAGE_ID arrays, in slot order) once it has grown past that.
+    typedef struct HashDir {
+        unsigned globalDepth;
+    } HashDir;
+
+    // Header of a bucket page, followed by its entries packed from the start: key | RID. A bucket that cannot
+    // split any further chains overflow pages.
+    typedef struct BucketDir {
+        PAGE_FLAG flag;
+        unsigned localDepth;                    // low bits of the hash every key in the chain shares
         RECORD_NUM recordNum;
-    }NodePageDir;
+        OFFSET freeOffset;                      // end of the last entry
+        PAGE_ID overflowPage;                   // 0 for the last page of the chain
+    } BucketDir;
 
     class IndexManager {
+        friend class IX_ScanIterator;
 
     public:
         static IndexManager &instance();
@@ -50,6 +111,10 @@ namespace PeterDB {
         // Create an index file.
         RC createFile(const std::string &fileName);
 
+        // Create an index file with IX_* options. Page 0 is written right away to keep them; with
+        // IX_KEY_COMPRESSION node fanout follows the key bytes rather than the declared key length.
+        RC createFile(const std::string &fileName, unsigned options);
+
         // Delete an index file.
         RC destroyFile(const std::string &fileName);
 
@@ -59,10 +124,15 @@ namespace PeterDB {
         // Close an ixFileHandle for an index.
         RC closeFile(IXFileHandle &ixFileHandle);
 
+        // Cached handle for a few index operations, see PagedFileManager::acquireFile
+        RC acquireFile(const std::string &fileName, IXFileHandle &ixFileHandle);
+        RC releaseFile(IXFileHandle &ixFileHandle);
+
         // Insert an entry into the given index that is indicated by the given ixFileHandle.
         RC insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
-        // Delete an entry from the given index that is indicated by the given ixFileHandle.
+        // Delete an entry from the given index that is indicated by the given ixFileHandle. A node left less than
+        // IX_MIN_FILL full borrows from a sibling or merges with it, and a root left with one child hands over to it.
         RC deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
         // Initialize and IX_ScanIterator to support a range search
@@ -74,11 +144,26 @@ namespace PeterDB {
                 bool highKeyInclusive,
                 IX_ScanIterator &ix_ScanIterator);
 
-        // Print the B+ tree in pre-order (in a JSON record format)
+        // Build the tree bottom-up into an empty index from entries sorted by key. Nodes are filled to
+        // fillFactor of a page and appended level by level, only the root pointer in page 0 is rewritten.
+        RC bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute, IX_BulkSource &source,
+                    float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Rebuild the tree in place the way bulkLoad builds it, while the file stays open. Pages the new tree
+        // does not need go to the free list; open scans find their place again on the next leaf.
+        RC compact(IXFileHandle &ixFileHandle, const Attribute &attribute, float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Print the B+ tree in pre-order (in a JSON record format); a hash index prints its buckets in slot order
         RC printBTree(IXFileHandle &ixFileHandle, const Attribute &attribute, std::ostream &out) const;
 
-        // New page for overflow leaf
-        RC appendLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        // Compare two keys in the insertEntry format: <0, 0 or >0. VarChar compares bytes, shorter first on a tie.
+        static int compareKey(const Attribute &attribute, const void *key, const void *otherKey);
+
+        // Bytes a key takes in the insertEntry format
+        static unsigned getKeyLength(const Attribute &attribute, const void *key);
+
+        // Hash of a key in the insertEntry format; a hash index directory goes by its low bits
+        static unsigned hashKey(const Attribute &attribute, const void *key);
 
     protected:
         IndexManager() = default;                                                   // Prevent construction
@@ -86,65 +171,192 @@ namespace PeterDB {
         IndexManager(const IndexManager &) = default;                               // Prevent construction by copying
         IndexManager &operator=(const IndexManager &) = default;                    // Prevent assignment
 
-        RC searchStartingLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *lowKey,
-                               bool lowKeyInclusive,
-                               PAGE_ID &curLeafPage, int &curRecordId, int &curOffset, void* ptr_curLeafPage);
+        RC readHeader(IXFileHandle &ixFileHandle, IndexHeader &header);
 
-        RC
-        printCore(IXFileHandle &ixFileHandle, int curNode, const Attribute &attribute, int indentNum, bool isContinue,
-                  std::ostream &out) const;
+        RC writeHeader(IXFileHandle &ixFileHandle, const IndexHeader &header);
 
-        RC
-        printNode(IXFileHandle &ixFileHandle, PAGE_FLAG pageFlag, void *page, RECORD_NUM recordNum,
-                  const Attribute &attribute,
-                  std::ostream &out) const;
+        RC createTree(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+
+        // Write page to the head of the free list, or append it when the list is empty
+        RC allocatePage(IXFileHandle &ixFileHandle, IndexHeader &header, const void *page, PAGE_ID &pageID);
+
+        RC freePage(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID pageID);
+
+        // The insert and delete paths take the header in memory for its options and free list; their callers
+        // write it back once it changed.
+        RC insertion(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header, const void *key,
+                     const RID &rid, PAGE_ID curPageID, void *splitKey, PAGE_ID &splitData, bool &hasChildEntry);
 
-        OFFSET getKeyOccupiedSpace(const Attribute &attribute, const void *key, PAGE_FLAG pageFlag);
+        // Add rid to the entry of an existing key, spilling its list to posting pages when it grows too long
+        RC addPosting(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header, PAGE_ID pageID,
+                      void *page, int slot, const void *key, const RID &rid, void *splitKey, PAGE_ID &splitData,
+                      bool &hasChildEntry);
 
-        RC insertEntry2NodeNoSplit(IXFileHandle &ixFileHandle, PAGE_ID pageID, PAGE_FLAG pageFlag, void *page,
-                                   const Attribute &attribute, const void *key, const void *data);
+        // Write posting pages holding sorted rids through placePage, last page first
+        static RC spillPostings(const RID *rids, int ridNum,
+                                const std::function<RC(const void *, PAGE_ID &)> &placePage, PAGE_ID &firstPage);
 
-        RC insertEntry2NodeCore(void *page, PAGE_FLAG pageFlag, const Attribute &attribute, const void *key,
-                                const void *data);
+        RC insertPosting(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID firstPage, const RID &rid);
 
-        RC splitRootLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        // firstPage moves on when the first page empties, 0 once the list is empty
+        RC deletePosting(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID &firstPage, const RID &rid);
 
-        RC getSplitKey(PAGE_FLAG pageFlag, const Attribute &attribute, void *page, OFFSET &splitOffset, RECORD_NUM &leftRecordNum,
-                       void *splitKey);
+        RC insertEntry2Node(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                            PAGE_ID pageID, void *page, int slot, const void *key, const void *data, void *splitKey,
+                            PAGE_ID &splitData, bool &hasChildEntry);
 
-        RC redistributePage(PAGE_FLAG pageFlag, const Attribute &attribute, RECORD_NUM leftRecordNum, OFFSET splitOffset, void *page,
-                         void *newPage);
+        // Rebuild the node with the new entry; hasChildEntry tells whether it had to split. A compressed leaf
+        // may only need re-encoding under a shorter prefix.
+        RC splitNode(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header, PAGE_ID pageID,
+                     void *page, int slot, const void *key, const void *data, void *splitKey, PAGE_ID &newPageID,
+                     bool &hasChildEntry);
 
-        RC twoWayInsertEntry2Node(PAGE_FLAG pageFlag, const Attribute &attribute, const void *key, const void *data,
-                              void *splitKey,
-                              void *page, void *newPage);
+        RC pushUpRootNode(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                          const void *splitKey, PAGE_ID newPageID);
 
-        RC insertEntry2NodeNSplit(IXFileHandle &ixFileHandle, PAGE_FLAG pageFlag, const Attribute &attribute,
-                                  PAGE_ID pageID,
-                                  const void *key, const void *data, void *splitKey, void *page, void *newPage,
-                                  PAGE_ID &newPageID);
+        // underflow tells the caller the node at curPageID fell below IX_MIN_FILL
+        RC deletion(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header, const void *key,
+                    const RID &rid, PAGE_ID curPageID, bool &underflow);
 
-        RC pushUpRootNode(PAGE_ID pageID, PAGE_ID newPageID, const Attribute &attribute, const void *splitKey,
-                          void *rootPage);
+        // Merge the underfull child of an internal node with a sibling, or even their entries out when both do not
+        // fit in one node; the parent is updated in memory
+        RC fixUnderflow(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header, void *parent,
+                        int child);
 
-        RC insertion(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid,
-                     PAGE_ID curPageID,
-                     void *splitKey, void *splitData, bool &hasChildEntry);
+        // Build the tree bottom-up from sorted entries into pages firstPage, firstPage + 1, ... up to endPage,
+        // overwriting pages the file already has; header.rootPageID is 0 for no entries
+        RC buildTree(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                     IX_BulkSource &source, float fillFactor, PAGE_ID firstPage, PAGE_ID &endPage);
 
-        RC splitRootNode(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const void *data,
-                         PAGE_ID rootPageID);
+        // Descend to the leaf that holds key or would (NULL: the first leaf) and copy it into leafPage, with the
+        // header version the copy belongs to. parentPage gets a copy of its parent and childSlot its place there,
+        // -1 when the leaf is the root. header: page 0 when the caller already read it.
+        RC searchLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                          PAGE_ID &leafPageID, void *leafPage, unsigned &version, void *parentPage = nullptr,
+                          int *childSlot = nullptr, const IndexHeader *header = nullptr);
 
-        RC chooseSubtree(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, PAGE_ID curNodePageID,
-                         PAGE_ID &nextNodePageID);
+        // First slot whose key is >= key (inclusive) or > key, by binary search over the slot array
+        static int searchNode(const Attribute &attribute, const void *page, const void *key, bool inclusive);
+
+        static PAGE_ID getChild(const Attribute &attribute, const void *page, int slot);
+
+        static void insertEntry2NodeCore(const Attribute &attribute, void *page, int slot, const void *key,
+                                         const void *data);
+
+        static void deleteEntryFromNode(const Attribute &attribute, void *page, int slot);
+
+        static void compactNode(const Attribute &attribute, void *page);
+
+        // Fill an empty node with entries [begin, end), full keys in key order; a compressed leaf first takes
+        // the prefix they all share
+        static void fillNode(const Attribute &attribute, void *page, const std::vector<const char *> &entries,
+                             int begin, int end, bool compressKeys);
 
         RC
-        findNextTempPageId(const Attribute &attribute, const void *thisPage, const int tmpPageId,
-                           const RECORD_NUM numRecords,
-                           const void *key, int &nextPageId);
+        printCore(IXFileHandle &ixFileHandle, PAGE_ID curNode, const Attribute &attribute, int indentNum,
+                  bool isContinue, std::ostream &out) const;
+
+        RC printNode(IXFileHandle &ixFileHandle, const void *page, const Attribute &attribute, std::ostream &out) const;
+
+        static void printKey(const Attribute &attribute, const void *key, std::ostream &out);
+
+        // Extendible hash index, see HashDir. The methods taking headPage work on a copy of page 0 and leave
+        // writing it back to their caller.
+        RC hashInsert(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+
+        RC hashDelete(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+
+        RC hashCompact(IXFileHandle &ixFileHandle, const Attribute &attribute);
+
+        RC printHash(IXFileHandle &ixFileHandle, const Attribute &attribute, std::ostream &out) const;
+
+        static RC getBucket(IXFileHandle &ixFileHandle, const void *headPage, unsigned slot, PAGE_ID &bucketPageID);
+
+        // Point every slot whose low depth bits are bits at bucketPageID
+        RC setBuckets(IXFileHandle &ixFileHandle, void *headPage, unsigned bits, unsigned depth, PAGE_ID bucketPageID);
+
+        RC doubleDirectory(IXFileHandle &ixFileHandle, void *headPage);
+
+        // Split the bucket whose keys share the low bits of hash into two of one more bit
+        RC splitBucket(IXFileHandle &ixFileHandle, const Attribute &attribute, void *headPage, unsigned hash);
+
+        // Write packed entries to the chain at firstPage, reusing its pages and freeing the ones left over;
+        // firstPage 0 starts a new chain
+        RC writeBucketChain(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                            PAGE_ID &firstPage, unsigned localDepth, const std::vector<char> &entries);
+    };
+
+    // Entries for IndexManager::bulkLoad, in key order
+    class IX_BulkSource {
+    public:
+        virtual ~IX_BulkSource() = default;
 
-        RC searchKeyInLeafPage(FileHandle &fileHandle, const Attribute &attribute, const void *key,
-                               const bool lowKeyInclusive,
-                               int &leafPageId, int &leafRecordId, int &curOffset, void *ptr_curLeafPage);
+        // Next entry, IX_EOF after the last one
+        virtual RC getNextEntry(void *key, RID &rid) = 0;
+    };
+
+    // External sort of (key, RID) entries. Runs of up to memoryLimit bytes are sorted and spilled to temporary
+    // files, then merged while finish() and getNextEntry read them back in (key, RID) order.
+    class IX_KeySorter : public IX_BulkSource {
+    public:
+        explicit IX_KeySorter(const Attribute &attribute, unsigned memoryLimit = IX_SORT_MEMORY);
+        ~IX_KeySorter() override;
+
+        // key in the insertEntry format
+        RC addEntry(const void *key, const RID &rid);
+
+        // No more entries, start reading them back
+        RC finish();
+
+        RC getNextEntry(void *key, RID &rid) override;
+
+    private:
+        Attribute attribute;
+        unsigned memoryLimit;
+        std::vector<char> arena;                    // key | RID of each entry of the current run
+        std::vector<unsigned> offsets;              // start of each entry in the arena
+        unsigned nextEntry;                         // read position when no run was spilled
+
+        std::vector<FILE *> runs;
+        std::vector<char *> heads;                  // current entry of each run
+        std::vector<int> mergeHeap;                 // runs that still have entries, smallest head on top
+
+        void sortRun();
+        RC spillRun();
+        RC readEntry(FILE *run, char *entry);
+        bool entryLess(const char *entry, const char *otherEntry) const;
+    };
+
+    // Key over an ordered list of attributes, encoded as one VarChar whose bytes sort the way the columns
+    // compare lexicographically, nulls first. The tree stores, compresses and compares it as any VarChar key.
+    // The last includedCount attributes are carried, not keyed on: a row's key puts its RID between the key
+    // columns and them, so every key is unique and the included bytes never decide the order.
+    class IX_CompositeKey {
+    public:
+        explicit IX_CompositeKey(const std::vector<Attribute> &attributes, unsigned includedCount = 0);
+
+        // The VarChar attribute the tree is built over
+        const Attribute &getKeyAttribute() const { return keyAttribute; }
+
+        const std::vector<Attribute> &getAttributes() const { return attributes; }
+
+        // values[i] in the insertEntry format of attributes[i], nullptr for a null. Fewer values than attributes
+        // give the prefix shared by every key with those leading columns. The included columns are only
+        // written after a rid.
+        void encode(const std::vector<const void *> &values, void *key, const RID *rid = nullptr) const;
+
+        // Scan bound on the leading columns. Every key starting with values falls inside the bound when
+        // inclusive is set and outside it otherwise; inclusive is rewritten for the encoded bound. A bound on
+        // every column is the key itself, so equal bounds stay an equality a hash index probes.
+        void encodeBound(const std::vector<const void *> &values, bool isLowKey, bool &inclusive, void *key) const;
+
+        // Back to the record format over the key attributes, null bitmap first; the RID is skipped
+        RC decode(const void *key, void *data) const;
+
+    private:
+        std::vector<Attribute> attributes;
+        unsigned keyCount;                      // leading attributes that are keyed on
+        Attribute keyAttribute;
     };
 
     class IX_ScanIterator {
@@ -159,29 +371,68 @@ namespace PeterDB {
         // Get next matching entry
         RC getNextEntry(RID &rid, void *key);
 
-        RC checkEntryCursor(FileHandle &fileHandle);
-
         // Terminate index scan
         RC close();
 
-        // initialize the ix ScanIterator
-        RC init_IXScanIterator(IXFileHandle &ixFileHandle, const Attribute &attribute,
-                               const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive,
-                               PAGE_ID &curLeafPage, int &curRecordId, int &curOffset, void* ptr_curLeafPage);
+        // initialize the ix ScanIterator, positioned at the first entry in range
+        RC init_IXScanIterator(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *lowKey,
+                               const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
 
     private:
         IXFileHandle *_ixFileHandle;
         Attribute _attribute;
-        const void *_lowKey;
-        const void *_highKey;
+        char *_lowKey;
         bool _lowKeyInclusive;
+        char *_highKey;
         bool _highKeyInclusive;
+        unsigned _version;                      // header version of the leaf copy
 
-        LeafDir _curLeafDir;
         PAGE_ID _curLeafPageId;
-        RECORD_ID _curRecordId;
-        OFFSET _curOffset;
-        char* _curLeafPageBuffer;
+        int _curSlot;
+        char *_curLeafPageBuffer;
+
+        // readahead: the parent copy lists the leaves coming up, children up to _prefetchedSlot were hinted
+        char *_parentPageBuffer;
+        int _parentSlot;                        // child of the parent copy being read, -1 without one
+        int _prefetchedSlot;
+        int _prefetchDepth;                     // leaves to keep hinted ahead, a fixed ramp: doubles per batch
+
+        // the entry being returned: its key, and its RIDs in the leaf copy or the current posting page
+        char *_curKey;
+        unsigned _curKeyLength;                 // 0 before the first entry
+        const char *_curRids;
+        int _curRidNum;                         // -1 before the entry at _curSlot is read
+        int _curRid;
+        char *_postingPageBuffer;
+        bool _inPostings;
+
+        RC enterEntry();
+
+        // Copy the leaf holding the first key after key (inclusive: from key on), NULL: the first leaf
+        RC seek(const void *key, bool inclusive, const IndexHeader *header = nullptr);
+
+        // Find the parent of the current leaf again once the scan walked past the parent copy
+        void locateParent();
+
+        void prefetchLeaves();
+
+        // hash index: an equality scan reads the bucket chain of its key, any other scan every bucket in
+        // directory order, so entries come in no key order. _curLeafPageBuffer holds the bucket page and
+        // _curSlot the offset of the next entry in it. Deletes under an open hash scan are fine, inserts are
+        // not: a split moves entries between buckets, so the scan may miss or repeat them.
+        bool _isHash;
+        bool _hashProbe;
+        unsigned _hashSlot;                     // next directory slot of a scan over every bucket
+
+        // headPage: page 0 of the index
+        RC initHashScan(const void *headPage);
+
+        RC getNextHashEntry(RID &rid, void *key);
+
+        // First page of the next bucket not read yet in slot order
+        RC nextBucket();
+
+        bool inRange(const void *key) const;
     };
 
     class IXFileHandle {
@@ -191,6 +442,7 @@ namespace PeterDB {
         unsigned ixReadPageCounter;
         unsigned ixWritePageCounter;
         unsigned ixAppendPageCounter;
+        unsigned ixPrefetchPageCounter;         // leaves range scans asked to have read ahead
 
         // Constructor
         IXFileHandle();
@@ -0,0 +1,101 @@
+#ifndef _pageio_h_
+#define _pageio_h_
+
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include "src/include/pfm.h"
+
+namespace PeterDB {
+
+    // Byte-level access to a paged file. Offsets are absolute, the hidden header page included.
+    class PageIO {
+    public:
+        static PageIO *create(IOBackend backend);
+
+        virtual ~PageIO() = default;
+
+        virtual RC open(const std::string &fileName) = 0;                   // -1 if the file does not exist
+        virtual RC close() = 0;
+        virtual RC readAt(long long offset, void *data, size_t length) = 0;
+        virtual RC writeAt(long long offset, const void *data, size_t length) = 0;
+        virtual RC flush() = 0;                                             // hand buffered writes to the OS
+        virtual long long size() = 0;
+        virtual RC allocate(long long offset, long long length) = 0;        // reserve zeroed space, growing the file
+
+        // Address of the page starting at offset if the backend maps the file, nullptr otherwise
+        virtual char *mapPage(long long /* offset */) { return nullptr; }
+
+        // Hint that the bytes at offset will be read soon, so the OS can start reading them in; a no-op by default
+        virtual RC prefetch(long long /* offset */, size_t /* length */) { return 0; }
+    };
+
+    // The original std::fstream path: seek, then read or write through the stream buffer
+    class FstreamIO : public PageIO {
+    public:
+        FstreamIO();
+        ~FstreamIO() override;
+
+        RC open(const std::string &fileName) override;
+        RC close() override;
+        RC readAt(long long offset, void *data, size_t length) override;
+        RC writeAt(long long offset, const void *data, size_t length) override;
+        RC flush() override;
+        long long size() override;
+        RC allocate(long long offset, long long length) override;
+
+    private:
+        std::fstream *file;
+    };
+
+    // Raw descriptor with pread/pwrite: one syscall per access and no shared file cursor
+    class PosixIO : public PageIO {
+    public:
+        PosixIO();
+        ~PosixIO() override;
+
+        RC open(const std::string &fileName) override;
+        RC close() override;
+        RC readAt(long long offset, void *data, size_t length) override;
+        RC writeAt(long long offset, const void *data, size_t length) override;
+        RC flush() override;
+        long long size() override;
+        RC allocate(long long offset, long long length) override;
+        RC prefetch(long long offset, size_t length) override;
+
+        int descriptor() const { return fd; }
+
+    private:
+        int fd;
+    };
+
+    // pread/pwrite descriptor plus a shared mapping, built from fixed chunks of MMAP_CHUNK_PAGES pages.
+    // Chunks are never moved or unmapped before close, so page addresses handed out stay valid while
+    // the file grows; pages past the end of file are reached with pwrite only.
+    class MmapIO : public PageIO {
+    public:
+        MmapIO();
+        ~MmapIO() override;
+
+        RC open(const std::string &fileName) override;
+        RC close() override;
+        RC readAt(long long offset, void *data, size_t length) override;
+        RC writeAt(long long offset, const void *data, size_t length) override;
+        RC flush() override;
+        long long size() override;
+        RC allocate(long long offset, long long length) override;
+        char *mapPage(long long offset) override;
+        RC prefetch(long long offset, size_t length) override;
+
+    private:
+        PosixIO file;
+        long long fileSize;
+        std::vector<char *> chunks;
+
+        char *address(long long offset, size_t length);
+    };
+
+} // namespace PeterDB
+
+#endif // _pageio_h_
@@ -1,7 +1,16 @@
 #ifndef _pfm_h_
 #define _pfm_h_
 
+// Build-time page size, e.g. cmake -DPAGE_SIZE=16384. Slot offsets in RBFM are 2 bytes, hence the 64 KB cap.
+#ifndef PAGE_SIZE
 #define PAGE_SIZE 4096
+#endif
+#define DEFAULT_POOL_FRAMES 1024
+#define MMAP_CHUNK_PAGES 1024
+#define DEFAULT_EXTENT_PAGES 1
+#define BULK_EXTENT_PAGES 16
+#define DEFAULT_HANDLE_CACHE 64
+#define FILE_HEADER_MAGIC 0x46424450
 
 #include <string>
 #include <iostream>
@@ -10,14 +19,72 @@
 
 #include <climits>
 #include <cmath>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
 
 
 namespace PeterDB {
 
+    static_assert(PAGE_SIZE >= 4096 && PAGE_SIZE <= 65536 && (PAGE_SIZE & (PAGE_SIZE - 1)) == 0,
+                  "PAGE_SIZE must be a power of two between 4 KB and 64 KB");
+
     typedef unsigned PageNum;
     typedef int RC;
+    typedef unsigned FileId;
 
     class FileHandle;
+    class BufferPool;
+    class PageIO;
+
+    typedef enum {
+        CLOCK_POLICY = 0, LRU_K_POLICY
+    } ReplacementPolicyType;
+
+    // MMAP_IO bypasses the buffer pool: pages are read and written in place through the mapping
+    typedef enum {
+        POSIX_IO = 0, FSTREAM_IO, MMAP_IO
+    } IOBackend;
+
+    // Start of the hidden header page. It sits at offset 0 so it can be read without knowing the page size;
+    // the counters stay in the last 12 bytes of the header page as before.
+    typedef struct FileHeader {
+        unsigned magic;
+        unsigned pageSize;                  // page size the file was created with
+        unsigned npages;                    // logical high-water mark, pages past it are preallocated
+    } FileHeader;
+
+    // One record per open file name, shared by every FileHandle opened on it
+    typedef struct OpenFile {
+        std::string fileName;
+        FileId fileId;
+        IOBackend backend;
+        PageIO *io;
+        unsigned npages;
+        unsigned allocatedPages;                                            // pages the file has room for on disk
+        unsigned extentPages;                                               // pages reserved at a time when it runs out
+        unsigned pageSize;
+        unsigned openCount;
+        // kept in memory, written to the header page only on last close or checkpoint
+        std::atomic<unsigned> readPageCounter;
+        std::atomic<unsigned> writePageCounter;
+        std::atomic<unsigned> appendPageCounter;
+    } OpenFile;
+
+    // What the file looked like when it was last closed, to tell whether cached pages are still valid
+    typedef struct FileStamp {
+        unsigned long long inode;
+        long long size;
+        long long mtime;
+    } FileStamp;
+
+    // A handle kept open by the handle cache, shared by everyone who acquired it
+    typedef struct CachedHandle {
+        FileHandle *fileHandle;
+        unsigned refCount;
+        unsigned long long lastUse;                                         // for closing the least recently used
+    } CachedHandle;
 
     class PagedFileManager {
     public:
@@ -25,20 +92,65 @@ namespace PeterDB {
 
         RC createFile(const std::string &fileName);                         // Create a new file
         RC destroyFile(const std::string &fileName);                        // Destroy a file
+        // The first open of a file picks its backend, POSIX_IO unless given. Later opens share it: a plain
+        // openFile joins whatever backend the file is open with, asking for another one fails with -4.
         RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a file
+        RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                    IOBackend backend);                                     // Open a file with a given I/O backend
         RC closeFile(FileHandle &fileHandle);                               // Close a file
 
+        // Rebuild the buffer pool with a new size or replacement policy; only allowed while no file is open
+        RC configureBufferPool(unsigned numFrames, ReplacementPolicyType policyType);
+        BufferPool &getBufferPool();
+        RC checkpoint();                                                    // Write back dirty pages and counters of open files
+
+        // Grow files opened from now on by this many pages at a time; extra pages are preallocated and
+        // tracked by the high-water mark. FileHandle::setExtentSize changes it for one open file.
+        RC setExtentSize(unsigned numPages);
+
+        // Handle cache for short operations on a file, such as one tuple or one index entry. acquireFile
+        // makes fileHandle a copy of the cached handle of the file, opening it on first use; releaseFile
+        // gives it back. Released handles stay open, the least recently used idle one is closed once more
+        // than the cache size are open. createFile and destroyFile drop the cached handle of their file.
+        RC acquireFile(const std::string &fileName, FileHandle &fileHandle);
+        RC releaseFile(FileHandle &fileHandle);
+        RC setHandleCacheSize(unsigned numHandles);
+        RC closeIdleHandles();                                              // close every cached handle not in use
+
     protected:
         PagedFileManager();                                                 // Prevent construction
         ~PagedFileManager();                                                // Prevent unwanted destruction
         PagedFileManager(const PagedFileManager &);                         // Prevent construction by copying
         PagedFileManager &operator=(const PagedFileManager &);              // Prevent assignment
 
+    private:
+        friend class FileHandle;
+
+        BufferPool *bufferPool;
+        FileId nextFileId;
+        unsigned nextOpenId;
+        unsigned extentPages;
+        std::map<std::string, FileId> fileIds;                              // file name -> id of its cached pages
+        std::map<std::string, OpenFile *> openFiles;                        // file name -> shared open state
+        std::unordered_map<unsigned, OpenFile *> liveHandles;               // open id of a FileHandle -> its file
+        std::map<FileId, FileStamp> closedFiles;
+
+        unsigned handleCacheSize;
+        unsigned long long handleClock;
+        std::map<std::string, CachedHandle> cachedHandles;                 // file name -> its cached handle
+        std::vector<CachedHandle> droppedHandles;                           // dropped while in use, closed on release
+
+        void dropCachedHandle(const std::string &fileName);
+        void trimHandleCache();
+
+        FileId getFileId(const std::string &fileName);
+        RC forgetFile(const std::string &fileName);
+        OpenFile *lookup(unsigned openId);
     };
 
     class FileHandle {
     public:
-        // variables to keep the counter for each operation
+        // counter values as of the last collectCounterValues call
         unsigned readPageCounter;
         unsigned writePageCounter;
         unsigned appendPageCounter;
@@ -51,24 +163,35 @@ namespace PeterDB {
         RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
         RC appendPage(const void *data);                                    // Append a specific page
 
-        RC openFile(std::fstream* file);
+        // Zero-copy read: page points into the mapping (MMAP_IO) or a pinned pool frame, and stays valid
+        // until releasePageRef. Every readPageRef needs a matching releasePageRef.
+        RC readPageRef(PageNum pageNum, const void *&page);
+        RC releasePageRef(PageNum pageNum);
+
+        // Hint that the page will be read soon so the read can start in the background; counts as no read
+        RC prefetchPage(PageNum pageNum);
+
+        // Extent size of the open file, shared by every handle on it. Bulk loads raise it for their
+        // duration and put it back afterwards; getExtentSize is 0 when the handle is not open.
+        RC setExtentSize(unsigned numPages);
+        unsigned getExtentSize();
+
         RC closeFile();
 
         unsigned getNumberOfPages();                                        // Get the number of pages in the file
+        unsigned getPageSize();                                             // Page size recorded in the file header
         RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                                 unsigned &appendPageCount);                 // Put current counter values into variables
-        RC readCounterValues();
-        RC writeCounterValues();
+        RC readCounterValues();                                             // Load counters from the header page
+        RC writeCounterValues();                                            // Persist counters to the header page
         RC initCounterValues();
 
-        std::fstream * get_fstream(){
-            return _file;
-        }
-
     private:
-        std::fstream *_file;
-        bool isOpen;
+        friend class PagedFileManager;
 
+        // page I/O goes through the shared buffer pool or the mapping; openId is 0 when the handle is not open
+        FileId fileId;
+        unsigned openId;
 
     };
 
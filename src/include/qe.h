@@ -2,6 +2,7 @@
 #define _qe_h_
 
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <limits>
 #include <unordered_map>
@@ -54,6 +55,10 @@ namespace PeterDB {
 
         virtual RC getAttributes(std::vector<Attribute> &attrs) const = 0;
 
+        // Columnar form of getNextTuple, columns follow getAttributes. By default the rows are
+        // pulled one at a time, operators with a columnar path override it.
+        virtual RC getNextBatch(RecordBatch &batch);
+
         virtual ~Iterator() = default;
 
         PeterDB::RelationManager &rm = PeterDB::RelationManager::instance();
@@ -99,6 +104,10 @@ namespace PeterDB {
             return iter.getNextTuple(rid, data);
         };
 
+        RC getNextBatch(RecordBatch &batch) override {
+            return iter.getNextBatch(batch);
+        };
+
         RC getAttributes(std::vector<Attribute> &attributes) const override {
             attributes.clear();
             attributes = this->attrs;
@@ -107,6 +116,7 @@ namespace PeterDB {
             for (Attribute &attribute : attributes) {
                 attribute.name = tableName + "." + attribute.name;
             }
+            return 0;
         };
 
         ~TableScan() override {
@@ -120,7 +130,11 @@ namespace PeterDB {
         RelationManager &rm;
         RM_IndexScanIterator iter;
         std::string tableName;
+        std::string relName;                        // the table itself, tableName may be an alias
         std::string attrName;
+        std::vector<std::string> includedAttrNames;
+        bool indexOnly;
+        RC scanRC;                                  // -2 when the scan could not be opened, getNextTuple fails with it
         std::vector<Attribute> attrs;
         char key[PAGE_SIZE];
         RID rid;
@@ -129,13 +143,53 @@ namespace PeterDB {
                   const char *alias = NULL) : rm(rm) {
             // Set members
             this->tableName = tableName;
+            this->relName = tableName;
             this->attrName = attrName;
+            this->indexOnly = false;
 
             // Get Attributes from RM
             rm.getAttributes(tableName, attrs);
 
             // Call rm indexScan to get iterator
-            rm.indexScan(tableName, attrName, NULL, NULL, true, true, iter);
+            scanRC = rm.indexScan(tableName, attrName, NULL, NULL, true, true, iter) == 0 ? 0 : -2; // no such index
+
+            // Set alias
+            if (alias) this->tableName = alias;
+        };
+
+        // Index-only scan of the covering index on attrName including includedAttrNames: tuples hold attrName and
+        // then includedAttrNames, decoded from the index entries with no table read
+        IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName,
+                  const std::vector<std::string> &includedAttrNames, const char *alias = NULL) : rm(rm) {
+            // Set members
+            this->tableName = tableName;
+            this->relName = tableName;
+            this->attrName = attrName;
+            this->includedAttrNames = includedAttrNames;
+            this->indexOnly = true;
+
+            // Only the columns the index holds, in its order, each a column of the table once
+            std::vector<Attribute> tableAttrs;
+            std::vector<std::string> columns(1, attrName);
+            columns.insert(columns.end(), includedAttrNames.begin(), includedAttrNames.end());
+            std::vector<int> fieldIndexes;
+            scanRC = 0;
+            if (rm.getAttributes(tableName, tableAttrs) != 0 ||
+                RecordLayout(tableAttrs).getFieldIndexes(columns, fieldIndexes) != 0) {
+                scanRC = -2; // no such column
+            }
+            for (unsigned i = 0; scanRC == 0 && i < fieldIndexes.size(); i++) {
+                if (std::count(fieldIndexes.begin(), fieldIndexes.begin() + i, fieldIndexes[i]) != 0) {
+                    scanRC = -2; // repeated column
+                    break;
+                }
+                attrs.push_back(tableAttrs[fieldIndexes[i]]);
+            }
+
+            // Call rm indexScan to get iterator
+            if (scanRC == 0) {
+                setIterator(NULL, NULL, true, true);
+            }
 
             // Set alias
             if (alias) this->tableName = alias;
@@ -144,13 +198,34 @@ namespace PeterDB {
         // Start a new iterator given the new key range
         void setIterator(void *lowKey, void *highKey, bool lowKeyInclusive, bool highKeyInclusive) {
             iter.close();
-            rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+            if (!indexOnly) {
+                scanRC = rm.indexScan(relName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter) == 0
+                         ? 0 : -2; // no such index
+                return;
+            }
+            if (attrs.size() != includedAttrNames.size() + 1) {
+                return; // columns refused by the constructor
+            }
+            std::vector<const void *> low, high;
+            if (lowKey) low.push_back(lowKey);
+            if (highKey) high.push_back(highKey);
+            scanRC = rm.indexScan(relName, std::vector<std::string>(1, attrName), includedAttrNames, low, high,
+                                  lowKeyInclusive, highKeyInclusive, iter) == 0 ? 0 : -2; // no such covering index
         };
 
         RC getNextTuple(void *data) override {
+            if (scanRC != 0) {
+                return scanRC;
+            }
+            if (indexOnly) {
+                // a covering index keeps null keys too, first in key order; a plain index has none
+                RC rc;
+                while ((rc = iter.getNextEntry(rid, data)) == 0 && (*(unsigned char *) data & 0x80)) {}
+                return rc;
+            }
             RC rc = iter.getNextEntry(rid, key);
             if (rc == 0) {
-                rc = rm.readTuple(tableName, rid, data);
+                rc = rm.readTuple(relName, rid, data);
             }
             return rc;
         };
@@ -164,6 +239,7 @@ namespace PeterDB {
             for (Attribute &attribute : attributes) {
                 attribute.name = tableName + "." + attribute.name;
             }
+            return 0;
         };
 
         ~IndexScan() override {
@@ -182,12 +258,15 @@ namespace PeterDB {
 
         RC getNextTuple(void *data) override;
 
+        RC getNextBatch(RecordBatch &batch) override;
+
         // For attribute in std::vector<Attribute>, name it as rel.attr
         RC getAttributes(std::vector<Attribute> &attrs) const override;
     private:
         Iterator *input;
         Condition condition;
-        AttrType attrType;
+        RecordLayout layout;
+        int lhsIndex;
 
         bool isSatisfied(void *data);
     };
@@ -201,6 +280,8 @@ namespace PeterDB {
 
         RC getNextTuple(void *data) override;
 
+        RC getNextBatch(RecordBatch &batch) override;
+
         // For attribute in std::vector<Attribute>, name it as rel.attr
         RC getAttributes(std::vector<Attribute> &attrs) const override;
 
@@ -209,6 +290,8 @@ namespace PeterDB {
         std::vector<Attribute> allAttrs;
         std::vector<Attribute> projectAttrs;
         std::vector<std::string> attrNames;
+        RecordLayout layout;
+        std::vector<int> projectIndex;
     };
 
     class BNLJoin : public Iterator {
@@ -236,8 +319,10 @@ namespace PeterDB {
         bool leftTableisOver;
         bool isFirstTime;
         bool restart;
-        int lhsOffset;
-        int rhsOffset;
+        RecordLayout lhsLayout;
+        RecordLayout rhsLayout;
+        int lhsIndex;
+        int rhsIndex;
         void* lhsTupleData;
         void* rhsTupleData;
         std::vector<Attribute> lhsAttributes;
@@ -255,6 +340,8 @@ namespace PeterDB {
 
         RC loadBlockBuffer(bool isFirst);
 
+        RC addToBlockBuffer(void *tuple);
+
         RC cleanBlockBuffer();
 
         bool isBNLJoinSatisfied();
@@ -290,6 +377,9 @@ namespace PeterDB {
         std::vector<std::string> leftAttrName;
         std::vector<std::string> rightAttrName;
 
+        RecordLayout leftLayout;
+        int leftIndex;
+
         void *leftValue;
         void *rightValue;
         void *leftAttrValue;
@@ -350,6 +440,8 @@ namespace PeterDB {
         Attribute aggAttr;
         AggregateOp op;
         bool opDone;
+        RecordLayout layout;
+        int aggIndex;
 
         RC doIntOp(void *data, int nullIndicatorSize, int &aggInt);
 
@@ -30,6 +30,11 @@
 
 #define MIN_TS_LEN 9
 
+# define DEFAULT_BATCH_ROWS 1024        // rows per RecordBatch unless the caller asks otherwise
+
+# define FSM_MAGIC 0x4d534652           // low byte is neither a slot count nor a record flag
+# define FSM_BUCKETS 16                 // free space is kept in 4-bit buckets, one per data page
+
 namespace PeterDB {
     // Record ID
     typedef struct {
@@ -63,6 +68,70 @@ namespace PeterDB {
         char16_t freeSpace;
     }PageDir;
 
+    typedef struct FsmPageHeader {
+        unsigned magic;
+        unsigned reserved;
+    } FsmPageHeader;
+
+    // Free-space map kept in dedicated pages of the record file.
+    // Page 0 is a map page covering the next FSM_ENTRIES data pages, then the pattern repeats,
+    // so map pages sit at multiples of FSM_ENTRIES + 1. Files written before the map existed have
+    // no magic on page 0 and keep the old linear page search.
+    class FreeSpaceMap {
+    public:
+        static const unsigned FSM_ENTRIES = (PAGE_SIZE - sizeof(FsmPageHeader)) * 2;
+
+        static bool isMapPage(PageNum pageNum) { return pageNum % (FSM_ENTRIES + 1) == 0; }
+        static bool hasMap(FileHandle &fileHandle);
+
+        // Latest data page whose bucket guarantees `needed` bytes, -1 if there is none
+        static RC findPage(FileHandle &fileHandle, unsigned needed, PageNum &pageNum);
+
+        // Record the free space of a data page, the map page is only rewritten when the bucket changes
+        static RC update(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace);
+
+        // Append a data page, adding the map page in front of it first when one is due
+        static RC appendDataPage(FileHandle &fileHandle, const void *page, unsigned freeSpace, PageNum &pageNum);
+
+    private:
+        static RC appendMapPage(FileHandle &fileHandle);
+    };
+
+    // Field positions of one record descriptor, computed once and reused for every record.
+    // Both the stored format and the API format give a non-null Int, Real or VarChar slot 4 bytes, so a
+    // field's slot only depends on how many fields before it are null. In the API format VarChar bytes
+    // are inline, so fields after the first VarChar still walk the VarChars in between.
+    class RecordLayout {
+    public:
+        RecordLayout() = default;
+        explicit RecordLayout(const std::vector<Attribute> &recordDescriptor);
+
+        unsigned getNumberOfFields() const { return attributes.size(); }
+        unsigned getNullBitmapSize() const { return nullBitmapSize; }
+        const Attribute &getAttribute(int fieldIndex) const { return attributes[fieldIndex]; }
+
+        int getFieldIndex(const std::string &attributeName) const;                  // -1 if not in the descriptor
+        RC getFieldIndexes(const std::vector<std::string> &attributeNames, std::vector<int> &fieldIndexes) const;
+
+        static bool isNull(const void *nullBitmap, int fieldIndex);
+
+        // Stored format: the value, or the VarChar bytes with their length in varCharLen; nullptr if null
+        const char *getStoredField(const void *record, int fieldIndex, char16_t &varCharLen) const;
+        RC projectStored(const void *record, const std::vector<int> &fieldIndexes, void *data) const;
+
+        // API format: the value, a VarChar starts with its 4-byte length; nullptr if null
+        const char *getField(const void *data, int fieldIndex) const;
+        unsigned getLength(const void *data) const;
+        RC project(const void *data, const std::vector<int> &fieldIndexes, void *selData) const;
+
+    private:
+        std::vector<Attribute> attributes;
+        unsigned nullBitmapSize = 0;
+        int firstVarChar = -1;
+
+        static unsigned nullsBefore(const unsigned char *nullBitmap, int fieldIndex);
+    };
+
     // Comparison Operator (NOT needed for part 1 of the project)
     typedef enum {
         EQ_OP = 0, // no condition// =
@@ -74,6 +143,99 @@ namespace PeterDB {
         NO_OP       // no condition
     } CompOp;
 
+    typedef enum {
+        PRED_COMPARE = 0,   // attribute op value
+        PRED_BETWEEN,       // low <= attribute <= high
+        PRED_IN,            // attribute equals one of the values
+        PRED_AND,
+        PRED_OR
+    } PredicateKind;
+
+    // Predicate tree evaluated by the RBFM scan on the stored record format.
+    // Values follow the insertRecord data format without a null indicator and have to stay valid
+    // while the scan is open. A null attribute satisfies no comparison.
+    typedef struct Predicate {
+        PredicateKind kind;
+        std::string attributeName;
+        CompOp compOp;
+        std::vector<const void *> values;
+        std::vector<Predicate> children;
+
+        static Predicate compare(const std::string &attributeName, CompOp compOp, const void *value);
+        static Predicate between(const std::string &attributeName, const void *low, const void *high);
+        static Predicate in(const std::string &attributeName, const std::vector<const void *> &values);
+        static Predicate conjunction(const std::vector<Predicate> &children);      // true when empty
+        static Predicate disjunction(const std::vector<Predicate> &children);      // false when empty
+    } Predicate;
+
+    // Compare a column of values against a constant. Bit r of the selection mask is set when row r
+    // satisfies the comparison, most significant bit first like the validity bitmaps; the mask holds
+    // (count + 7) / 8 bytes. AVX2 is used when the CPU has it, SSE2 otherwise on x86, plain C++ elsewhere.
+    class CompareKernel {
+    public:
+        static void selectInts(const int *values, unsigned count, CompOp compOp, int value, unsigned char *mask);
+        static void selectReals(const float *values, unsigned count, CompOp compOp, float value, unsigned char *mask);
+    };
+
+
+    // One column of a RecordBatch. Every row has an entry in the array of its type, nulls included,
+    // so row r is always at index r.
+    typedef struct ColumnVector {
+        AttrType type;
+        std::vector<int> ints;
+        std::vector<float> reals;
+        std::vector<unsigned> offsets;          // VarChar row r is heap[offsets[r], offsets[r + 1])
+        std::vector<char> heap;
+        std::vector<unsigned char> validity;    // bit set when the row is not null, most significant bit first
+    } ColumnVector;
+
+    // Up to capacity rows in columnar form, filled by getNextBatch of the scan iterators.
+    class RecordBatch {
+    public:
+        explicit RecordBatch(unsigned capacity = DEFAULT_BATCH_ROWS);
+
+        void reset(const std::vector<Attribute> &attrs);                   // one column per attribute, no rows
+        void clear();                                                       // drop the rows, keep the columns
+
+        unsigned getCapacity() const { return capacity; }
+        unsigned getNumberOfRows() const { return numRows; }
+        bool isFull() const { return numRows >= capacity; }
+        const std::vector<Attribute> &getAttributes() const { return attrs; }
+        const ColumnVector &getColumn(unsigned column) const { return columns[column]; }
+        const RID &getRid(unsigned row) const { return rids[row]; }
+
+        bool isNull(unsigned column, unsigned row) const;
+        int getInt(unsigned column, unsigned row) const { return columns[column].ints[row]; }
+        float getReal(unsigned column, unsigned row) const { return columns[column].reals[row]; }
+        const char *getVarChar(unsigned column, unsigned row, unsigned &length) const;
+
+        // A row is started with beginRow and then gets exactly one value per column, in column order
+        void beginRow(const RID &rid);
+        void appendNull(unsigned column);
+        void appendInt(unsigned column, int value);
+        void appendReal(unsigned column, float value);
+        void appendVarChar(unsigned column, const char *value, unsigned length);
+
+        // Conversion from and to the insertRecord data format
+        RC appendTuple(const RID &rid, const void *data);
+        RC getTuple(unsigned row, void *data) const;
+
+        RC keepRows(const std::vector<bool> &keep);                         // drop the rows that are not kept
+        RC select(unsigned column, CompOp compOp, const void *value);      // keep the Int or Real rows matching the value
+        RC keepColumns(const std::vector<int> &columnIndexes);              // reorder or drop columns
+
+    private:
+        unsigned capacity;
+        unsigned numRows;
+        std::vector<Attribute> attrs;
+        std::vector<ColumnVector> columns;
+        std::vector<RID> rids;
+
+        std::vector<unsigned char> selection;
+
+        void setValid(unsigned column, bool valid);
+        void compact(const unsigned char *mask);          // keep the rows whose bit is set
+    };
 
     /********************************************************************
     * The scan iterator is NOT required to be implemented for Project 1 *
@@ -94,7 +256,7 @@ namespace PeterDB {
     public:
         RBFM_ScanIterator();
 
-        ~RBFM_ScanIterator() = default;
+        ~RBFM_ScanIterator();
 
         RC initScanIterator(FileHandle &fileHandle,
                             const std::vector<Attribute> &recordDescriptor,
@@ -103,38 +265,66 @@ namespace PeterDB {
                             const void *value,                    // used in the comparison
                             const std::vector<std::string> &attributeNames); // a list of projected attributes
 
+        RC initScanIterator(FileHandle &fileHandle,
+                            const std::vector<Attribute> &recordDescriptor,
+                            const Predicate &predicate,
+                            const std::vector<std::string> &attributeNames);
+
         // Never keep the results in the memory. When getNextRecord() is called,
         // a satisfying record needs to be fetched from the file.
         // "data" follows the same format as RecordBasedFileManager::insertRecord().
         RC getNextRecord(RID &rid, void *data) ;
 
+        // Fill the batch with the next qualifying records, RBFM_EOF once there are none left.
+        // The columns are the projected attributes.
+        RC getNextBatch(RecordBatch &batch);
+
         RC close() ;
 
     private:
-        // RecordBasedFileManager rbfm = RecordBasedFileManager::instance();
+        // Predicate with its attribute resolved to a field position
+        typedef struct BoundPredicate {
+            PredicateKind kind;
+            int fieldIndex;
+            CompOp compOp;
+            std::vector<const void *> values;
+            std::vector<BoundPredicate> children;
+        } BoundPredicate;
 
         FileHandle fileHandle;
         std::vector<Attribute> recordDescriptor;
-        std::string conditionAttribute;
-        CompOp compOp;
-        void *value;
         std::vector<std::string> attributeNames;
 
-        AttrType conditionAttributeType;
-        std::vector<Attribute> attributesVector;
+        RecordLayout layout;
+        BoundPredicate predicate;
+        std::vector<int> projectedIndex;        // positions of the projected attributes
+        std::vector<Attribute> projectedAttrs;
 
+        const char *page;                       // the data page being walked, pinned until the scan leaves it
         RID cur_rid;
-        PageDir cur_page_dir;
         unsigned num_of_pages;
         char16_t cur_num_slots_of_curPage;
-        unsigned int maxRecordLen, maxAttrLen;
-
-        // RC findNextRID(RID &rid);
+        bool hasFreeSpaceMap;
+
+        // A single Int or Real comparison is evaluated for a whole page with CompareKernel,
+        // getNextBatch then takes the matching slots from selectedSlots
+        bool pageAtATime;
+        std::vector<char16_t> candidateSlots;   // live records of the page whose field is not null
+        std::vector<int> pageInts;
+        std::vector<float> pageReals;
+        std::vector<unsigned char> pageMask;
+        std::vector<char16_t> selectedSlots;
+        unsigned nextSelected;
 
         RC updateCurRid();
-
-
-        RC helperCompOp(void *attribute_with_null);
+        void releasePage();
+        RC nextQualifyingRecord(const char *&record);
+        RC selectNextPage();
+        void appendRecord(RecordBatch &batch, const char *record) const;
+
+        RC bindPredicate(const Predicate &source, BoundPredicate &bound) const;
+        bool isSatisfied(const BoundPredicate &bound, const char *record) const;
+        int compareField(int fieldIndex, const char *field, char16_t varCharLen, const void *value) const;
     };
 
     class RecordBasedFileManager {
@@ -149,6 +339,10 @@ namespace PeterDB {
 
         RC closeFile(FileHandle &fileHandle);                               // Close a record-based file
 
+        // Cached handle for a few record operations, see PagedFileManager::acquireFile
+        RC acquireFile(const std::string &fileName, FileHandle &fileHandle);
+        RC releaseFile(FileHandle &fileHandle);
+
         //  Format of the data passed into the function is the following:
         //  [n byte-null-indicators for y fields] [actual value for the first field] [actual value for the second field] ...
         //  1) For y fields, there is n-byte-null-indicators in the beginning of each record.
@@ -168,6 +362,12 @@ namespace PeterDB {
         RC insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const void *data,
                         RID &rid);
 
+        // Insert many records at once. They are packed into new pages in memory and every full page
+        // is appended with a single write; free space in the existing pages is not reused.
+        // rids[i] is the RID of data[i]. On failure rids only holds the records that were written.
+        RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                         const std::vector<const void *> &data, std::vector<RID> &rids);
+
 
         // Read a record identified by the given rid.
         RC readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
@@ -211,6 +411,13 @@ namespace PeterDB {
                 const std::vector<std::string> &attributeNames, // a list of projected attributes
                 RBFM_ScanIterator &rbfm_ScanIterator);
 
+        // Scan with a predicate tree, rows are filtered inside the page loop before projection
+        RC scan(FileHandle &fileHandle,
+                const std::vector<Attribute> &recordDescriptor,
+                const Predicate &predicate,
+                const std::vector<std::string> &attributeNames,
+                RBFM_ScanIterator &rbfm_ScanIterator);
+
 
         RC readAttributesGivenByRidAndAttributeNames(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                              const RID &rid, const std::vector<std::string> &attributeNames, void *data);
@@ -234,6 +441,9 @@ namespace PeterDB {
                         const void *data, void *info, void *record,
                         unsigned char *nullFieldsIndicator);                        // raw data to inline format
 
+        RC appendBulkPage(FileHandle &fileHandle, void *page,
+                          std::vector<RID> &rids, unsigned firstRid);               // page filled by insertRecords
+
         RC varCharFormat(int &offsetRecord, int &offsetData,
                          char16_t &varCharLen_16, int &varCharLen,
                          char16_t &offsetVariableData, void *record,
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <cmath>
 #include <iostream>
 #include <stdlib.h>
@@ -19,6 +20,13 @@
 namespace PeterDB {
 #define RM_EOF (-1)  // end of a scan operator
 
+    // BTreeIndex answers ranges in key order, HashIndex only equality probes fast (other scans read every bucket).
+    // CompressedBTreeIndex is a BTreeIndex with IX_KEY_COMPRESSION: VarChar leaves share their common prefix and
+    // separators are truncated, so printBTree shows the truncated separators.
+    typedef enum {
+        BTreeIndex = 0, HashIndex, CompressedBTreeIndex
+    } IndexType;
+
     // RM_ScanIterator is an iterator to go through tuples
     class RM_ScanIterator {
     public:
@@ -29,6 +37,9 @@ namespace PeterDB {
         // "data" follows the same format as RelationManager::insertTuple()
         RC getNextTuple(RID &rid, void *data);
 
+        // Up to batch capacity tuples in columnar form, RM_EOF once there are none left
+        RC getNextBatch(RecordBatch &batch);
+
         RBFM_ScanIterator &getRBFMScanIterator(){
             return _rbfmScanItearator;
         };
@@ -44,7 +55,8 @@ namespace PeterDB {
         RM_IndexScanIterator();    // Constructor
         ~RM_IndexScanIterator();    // Destructor
 
-        // "key" follows the same format as in IndexManager::insertEntry()
+        // "key" follows the same format as in IndexManager::insertEntry(), or the record format over the
+        // index columns for a composite index
         RC getNextEntry(RID &rid, void *key);    // Get next matching entry
         RC close();                              // Terminate index scan
 
@@ -56,11 +68,34 @@ namespace PeterDB {
             return _ix_ScanItearator;
         };
 
+        // Decode keys with compositeKey, owned by the iterator until close
+        void setCompositeKey(IX_CompositeKey *compositeKey);
+
     private:
         IXFileHandle _ixFileHandle;
         IX_ScanIterator _ix_ScanItearator;
+        IX_CompositeKey *_compositeKey;
+        char _encodedKey[PAGE_SIZE];
     };
 
+    // An index of a table, its file stays acquired for as long as the catalog entry is cached
+    typedef struct IndexInfo {
+        std::string attributeName;          // comma separated columns of a composite index, included ones after ';'
+        std::string fileName;
+        std::vector<int> fieldIndexes;      // position of each column in the table
+        Attribute keyAttribute;             // what the tree is keyed on
+        IX_CompositeKey *compositeKey;      // nullptr for a single-attribute index
+        IXFileHandle *ixFileHandle;
+    } IndexInfo;
+
+    // What the catalog says about one table
+    typedef struct TableInfo {
+        int tableId;
+        std::string fileName;
+        std::vector<Attribute> attrs;
+        std::vector<IndexInfo> indexes;
+    } TableInfo;
+
     // Relation Manager
     class RelationManager {
     public:
@@ -78,6 +113,10 @@ namespace PeterDB {
 
         RC insertTuple(const std::string &tableName, const void *data, RID &rid);
 
+        // Insert many tuples with one open of the table and of each of its indexes, see
+        // RecordBasedFileManager::insertRecords. rids[i] is the RID of data[i].
+        RC insertTuples(const std::string &tableName, const std::vector<const void *> &data, std::vector<RID> &rids);
+
         RC deleteTuple(const std::string &tableName, const RID &rid);
 
         RC updateTuple(const std::string &tableName, const void *data, const RID &rid);
@@ -100,6 +139,12 @@ namespace PeterDB {
                 const std::vector<std::string> &attributeNames, // a list of projected attributes
                 RM_ScanIterator &rm_ScanIterator);
 
+        // Scan filtered by a predicate tree, evaluated inside the record file scan
+        RC scan(const std::string &tableName,
+                const Predicate &predicate,
+                const std::vector<std::string> &attributeNames,
+                RM_ScanIterator &rm_ScanIterator);
+
         // Extra credit work (10 points)
         RC addAttribute(const std::string &tableName, const Attribute &attr);
 
@@ -121,6 +166,47 @@ namespace PeterDB {
                      bool highKeyInclusive,
                      RM_IndexScanIterator &rm_IndexScanIterator);
 
+        // Composite index over attributeNames, ordered by the first column, then the second, and so on
+        RC createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames);
+
+        RC createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                       IndexType indexType);
+
+        RC destroyIndex(const std::string &tableName, const std::vector<std::string> &attributeNames);
+
+        // Range on the leading columns of a composite index. lowKey and highKey hold a value per leading column in
+        // the insertEntry format, nullptr for a null; an empty one leaves that end open.
+        RC indexScan(const std::string &tableName,
+                     const std::vector<std::string> &attributeNames,
+                     const std::vector<const void *> &lowKey,
+                     const std::vector<const void *> &highKey,
+                     bool lowKeyInclusive,
+                     bool highKeyInclusive,
+                     RM_IndexScanIterator &rm_IndexScanIterator);
+
+        // Covering B+ tree index: keyed on attributeNames like a composite index, every entry also carries the
+        // includedAttributeNames columns, so a scan needing no other column skips the table. They follow the
+        // key columns and the RID, so rows sharing a key sort by RID and the included values are never compared.
+        RC createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                       const std::vector<std::string> &includedAttributeNames);
+
+        RC createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                       const std::vector<std::string> &includedAttributeNames, IndexType indexType);
+
+        RC destroyIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                        const std::vector<std::string> &includedAttributeNames);
+
+        // Index-only scan of a covering index, bounded on the leading key columns as above. getNextEntry returns
+        // the key columns and then the included ones in the record format, null bitmap first.
+        RC indexScan(const std::string &tableName,
+                     const std::vector<std::string> &attributeNames,
+                     const std::vector<std::string> &includedAttributeNames,
+                     const std::vector<const void *> &lowKey,
+                     const std::vector<const void *> &highKey,
+                     bool lowKeyInclusive,
+                     bool highKeyInclusive,
+                     RM_IndexScanIterator &rm_IndexScanIterator);
+
 
     protected:
         RelationManager();                                                  // Prevent construction
@@ -174,6 +260,36 @@ namespace PeterDB {
 
         RC insertEntriesToExistingIndexesFiles(const std::string &tableName, std::vector<Attribute> &table_attrs, const RID &rid);
 
+        RC insertEntriesInBatch(const std::string &tableName, const std::vector<Attribute> &table_attrs,
+                                const std::vector<const void *> &data, const std::vector<RID> &rids);
+
+        // Index over attributeNames with includedAttributeNames carried along, as every createIndex builds one
+        RC buildIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                      const std::vector<std::string> &includedAttributeNames, IndexType indexType);
+
+        // Column list the Indexes catalog records, and the index file named after it
+        static std::string getIndexColumnList(const std::vector<std::string> &attributeNames,
+                                              const std::vector<std::string> &includedAttributeNames =
+                                                      std::vector<std::string>());
+
+        static std::string getIndexFilename(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                            const std::vector<std::string> &includedAttributeNames =
+                                                    std::vector<std::string>());
+
+        // Key of the record at rid in an index over fieldIndexes of layout, encoded into keyBuffer for a
+        // composite index. nullptr when a single-attribute key is null, it is not indexed.
+        static const void *getIndexKey(const IX_CompositeKey *compositeKey, const std::vector<int> &fieldIndexes,
+                                       const RecordLayout &layout, const void *record, const RID &rid,
+                                       void *keyBuffer);
+
+        // Catalog entry of a table, read from the catalog tables on first use and kept until a schema
+        // change invalidates it, so per-tuple operations do no catalog I/O
+        RC getTableInfo(const std::string &tableName, const TableInfo *&tableInfo);
+
+        void invalidateTableInfo(const std::string &tableName);            // every table when tableName is empty
+
+        void releaseTableInfo(TableInfo &tableInfo);                        // give back the index handles
+
 
     private:
         IndexManager *_indexManager;
@@ -185,6 +301,8 @@ namespace PeterDB {
         static RelationManager *_relation_manager;
         RecordBasedFileManager *_rbfm;
 
+        std::map<std::string, TableInfo> _catalogCache;
+
 
 
     };
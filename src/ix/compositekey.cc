@@ -0,0 +1,188 @@
+#include "src/include/ix.h"
+
+#include <climits>
+#include <stdint.h>
+#include <string.h>
+
+namespace PeterDB {
+
+    // Each column starts with a marker so a null sorts before any value and a prefix never ends in 0xFF
+    static const unsigned char NULL_MARKER = 0x00;
+    static const unsigned char VALUE_MARKER = 0x01;
+
+    // A VarChar escapes its 0x00 bytes as 0x00 0xFF and ends with 0x00 0x00, so a shorter string sorts first
+    static const unsigned char VARCHAR_ESCAPE = 0xFF;
+
+    // Past every key that starts with a given prefix
+    static const unsigned char PREFIX_END = 0xFF;
+
+    static void putBigEndian(uint32_t bits, unsigned char *out) {
+        out[0] = bits >> 24;
+        out[1] = bits >> 16;
+        out[2] = bits >> 8;
+        out[3] = bits;
+    }
+
+    static uint32_t getBigEndian(const unsigned char *in) {
+        return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+    }
+
+    // pageNum and slotNum of a row's RID, big-endian so they compare bytewise
+    static const unsigned RID_LENGTH = 2 * sizeof(uint32_t);
+
+    IX_CompositeKey::IX_CompositeKey(const std::vector<Attribute> &attributes, unsigned includedCount)
+            : attributes(attributes), keyCount(attributes.size() - includedCount) {
+        keyAttribute.type = TypeVarChar;
+        keyAttribute.length = includedCount > 0 ? RID_LENGTH : 0;
+        for (const Attribute &attribute : attributes) {
+            if (!keyAttribute.name.empty()) {
+                keyAttribute.name += ",";
+            }
+            keyAttribute.name += attribute.name;
+            keyAttribute.length += 1 + (attribute.type == TypeVarChar ? 2 * attribute.length + 2 : sizeof(uint32_t));
+        }
+    }
+
+    void IX_CompositeKey::encode(const std::vector<const void *> &values, void *key, const RID *rid) const {
+        unsigned char *out = (unsigned char *) key + sizeof(int);
+        int length = 0;
+        unsigned columns = rid != nullptr ? attributes.size() : keyCount;
+        for (unsigned i = 0; i < values.size() && i < columns; i++) {
+            if (i == keyCount) {
+                putBigEndian(rid->pageNum, out + length);
+                putBigEndian(rid->slotNum, out + length + sizeof(uint32_t));
+                length += RID_LENGTH;
+            }
+            if (values[i] == nullptr) {
+                out[length++] = NULL_MARKER;
+                continue;
+            }
+            out[length++] = VALUE_MARKER;
+            switch (attributes[i].type) {
+                case TypeInt: {
+                    int32_t value;
+                    memcpy(&value, values[i], sizeof(int32_t));
+                    putBigEndian((uint32_t) value ^ 0x80000000u, out + length);
+                    length += sizeof(uint32_t);
+                    break;
+                }
+                case TypeReal: {
+                    float value;
+                    memcpy(&value, values[i], sizeof(float));
+                    if (value == 0) {
+                        value = 0; // -0.0 equals 0.0
+                    }
+                    uint32_t bits;
+                    memcpy(&bits, &value, sizeof(uint32_t));
+                    putBigEndian(bits & 0x80000000u ? ~bits : bits ^ 0x80000000u, out + length);
+                    length += sizeof(uint32_t);
+                    break;
+                }
+                case TypeVarChar: {
+                    int stringLength;
+                    memcpy(&stringLength, values[i], sizeof(int));
+                    const unsigned char *bytes = (const unsigned char *) values[i] + sizeof(int);
+                    for (int j = 0; j < stringLength; j++) {
+                        out[length++] = bytes[j];
+                        if (bytes[j] == 0) {
+                            out[length++] = VARCHAR_ESCAPE;
+                        }
+                    }
+                    out[length++] = 0;
+                    out[length++] = 0;
+                    break;
+                }
+            }
+        }
+        memcpy(key, &length, sizeof(int));
+    }
+
+    void IX_CompositeKey::encodeBound(const std::vector<const void *> &values, bool isLowKey, bool &inclusive,
+                                      void *key) const {
+        encode(values, key);
+        // a low bound that lets the prefix in and a high bound that keeps it out stop right at the prefix;
+        // the other two go past every key under it. A full key prefixes no other, so it stays as is; with
+        // included columns a RID always follows.
+        if (isLowKey == inclusive || (values.size() >= attributes.size() && keyCount == attributes.size())) {
+            return;
+        }
+        int length;
+        memcpy(&length, key, sizeof(int));
+        ((unsigned char *) key)[sizeof(int) + length] = PREFIX_END;
+        length++;
+        memcpy(key, &length, sizeof(int));
+        inclusive = !inclusive;
+    }
+
+    RC IX_CompositeKey::decode(const void *key, void *data) const {
+        int keyLength;
+        memcpy(&keyLength, key, sizeof(int));
+        const unsigned char *in = (const unsigned char *) key + sizeof(int);
+        const unsigned char *end = in + keyLength;
+
+        unsigned nullBitmapSize = (attributes.size() + CHAR_BIT - 1) / CHAR_BIT;
+        unsigned char *nullBitmap = (unsigned char *) data;
+        memset(nullBitmap, 0, nullBitmapSize);
+        char *out = (char *) data + nullBitmapSize;
+
+        for (unsigned i = 0; i < attributes.size(); i++) {
+            if (i == keyCount) {
+                if (end - in < (int) RID_LENGTH) {
+                    return -1; // truncated key
+                }
+                in += RID_LENGTH;
+            }
+            if (in >= end) {
+                return -1; // truncated key
+            }
+            if (*in++ == NULL_MARKER) {
+                nullBitmap[i / CHAR_BIT] |= 1u << (CHAR_BIT - 1 - i % CHAR_BIT);
+                continue;
+            }
+            switch (attributes[i].type) {
+                case TypeInt: {
+                    if (end - in < (int) sizeof(uint32_t)) {
+                        return -1; // truncated key
+                    }
+                    int32_t value = (int32_t) (getBigEndian(in) ^ 0x80000000u);
+                    memcpy(out, &value, sizeof(int32_t));
+                    out += sizeof(int32_t);
+                    in += sizeof(uint32_t);
+                    break;
+                }
+                case TypeReal: {
+                    if (end - in < (int) sizeof(uint32_t)) {
+                        return -1; // truncated key
+                    }
+                    uint32_t bits = getBigEndian(in);
+                    bits = bits & 0x80000000u ? bits ^ 0x80000000u : ~bits;
+                    memcpy(out, &bits, sizeof(float));
+                    out += sizeof(float);
+                    in += sizeof(uint32_t);
+                    break;
+                }
+                case TypeVarChar: {
+                    char *lengthField = out;
+                    out += sizeof(int);
+                    int stringLength = 0;
+                    while (true) {
+                        if (end - in < 2) {
+                            return -1; // unterminated string
+                        }
+                        if (in[0] == 0 && in[1] == 0) {
+                            in += 2;
+                            break;
+                        }
+                        out[stringLength++] = (char) in[0];
+                        in += in[0] == 0 ? 2 : 1;
+                    }
+                    memcpy(lengthField, &stringLength, sizeof(int));
+                    out += stringLength;
+                    break;
+                }
+            }
+        }
+        return 0;
+    }
+
+} // namespace PeterDB
@@ -0,0 +1,627 @@
+#include "src/include/ix.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace PeterDB {
+
+    // Page 0 of a hash index: IndexHeader | HashDir | slots, each the first page of a bucket while the directory
+    // fits in page 0, each a directory page of DIR_SLOTS bucket slots after that
+    static const unsigned HEAD_SLOTS = (PAGE_SIZE - sizeof(IndexHeader) - sizeof(HashDir)) / sizeof(PAGE_ID);
+    static const unsigned DIR_SLOTS = PAGE_SIZE / sizeof(PAGE_ID);
+
+    // Deepest directory page 0 can list the directory pages of: 2^depth slots, DIR_SLOTS to a page, in HEAD_SLOTS
+    static constexpr unsigned maxGlobalDepth(unsigned depth) {
+        return depth < 31 && (2ull << depth) <= (unsigned long long) HEAD_SLOTS * DIR_SLOTS ? maxGlobalDepth(depth + 1)
+                                                                                             : depth;
+    }
+
+    static const unsigned MAX_GLOBAL_DEPTH = maxGlobalDepth(0);
+
+    static const unsigned BUCKET_CAPACITY = PAGE_SIZE - sizeof(BucketDir);
+
+    static HashDir *hashDirOf(void *headPage) {
+        return (HashDir *) ((char *) headPage + sizeof(IndexHeader));
+    }
+
+    static const HashDir *hashDirOf(const void *headPage) {
+        return (const HashDir *) ((const char *) headPage + sizeof(IndexHeader));
+    }
+
+    static PAGE_ID *headSlotsOf(void *headPage) {
+        return (PAGE_ID *) ((char *) headPage + sizeof(IndexHeader) + sizeof(HashDir));
+    }
+
+    static const PAGE_ID *headSlotsOf(const void *headPage) {
+        return (const PAGE_ID *) ((const char *) headPage + sizeof(IndexHeader) + sizeof(HashDir));
+    }
+
+    static bool isDirectoryInHead(unsigned globalDepth) {
+        return (1u << globalDepth) <= HEAD_SLOTS;
+    }
+
+    static unsigned lowBits(unsigned hash, unsigned depth) {
+        return hash & ((1u << depth) - 1);
+    }
+
+    static void initBucket(void *page, unsigned localDepth) {
+        memset(page, 0, PAGE_SIZE);
+        auto *dir = (BucketDir *) page;
+        dir->flag = BUCKET_FLAG;
+        dir->localDepth = localDepth;
+        dir->recordNum = 0;
+        dir->freeOffset = sizeof(BucketDir);
+        dir->overflowPage = 0;
+    }
+
+    static unsigned entryLength(const Attribute &attribute, const char *entry) {
+        return IndexManager::getKeyLength(attribute, entry) + sizeof(RID);
+    }
+
+    unsigned IndexManager::hashKey(const Attribute &attribute, const void *key) {
+        // FNV-1a over the key bytes, then mixed so the low bits the directory goes by depend on all of them
+        const unsigned char *bytes = (const unsigned char *) key;
+        unsigned length = getKeyLength(attribute, key);
+        float zero = 0;
+        if (attribute.type == TypeReal && compareKey(attribute, key, &zero) == 0) {
+            bytes = (const unsigned char *) &zero; // -0.0 is the same key as 0.0
+        }
+        uint32_t hash = 2166136261u;
+        for (unsigned i = 0; i < length; i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    RC IndexManager::getBucket(IXFileHandle &ixFileHandle, const void *headPage, unsigned slot,
+                               PAGE_ID &bucketPageID) {
+        if (isDirectoryInHead(hashDirOf(headPage)->globalDepth)) {
+            bucketPageID = headSlotsOf(headPage)[slot];
+            return 0;
+        }
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        PAGE_ID dirPageID = headSlotsOf(headPage)[slot / DIR_SLOTS];
+        const void *ref;
+        if (fileHandle.readPageRef(dirPageID, ref) != 0) {
+            return -1; // read directory page fail
+        }
+        bucketPageID = ((const PAGE_ID *) ref)[slot % DIR_SLOTS];
+        fileHandle.releasePageRef(dirPageID);
+        return 0;
+    }
+
+    RC IndexManager::setBuckets(IXFileHandle &ixFileHandle, void *headPage, unsigned bits, unsigned depth,
+                                PAGE_ID bucketPageID) {
+        unsigned globalDepth = hashDirOf(headPage)->globalDepth;
+        unsigned slotNum = 1u << globalDepth;
+        if (isDirectoryInHead(globalDepth)) {
+            for (unsigned slot = bits; slot < slotNum; slot += 1u << depth) {
+                headSlotsOf(headPage)[slot] = bucketPageID;
+            }
+            return 0;
+        }
+
+        // the slots are spread over the directory pages, each page is read and written once
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        auto *dirPage = (PAGE_ID *) malloc(PAGE_SIZE);
+        int dirIndex = -1;
+        RC rc = 0;
+        for (unsigned slot = bits; slot < slotNum && rc == 0; slot += 1u << depth) {
+            if ((int) (slot / DIR_SLOTS) != dirIndex) {
+                if (dirIndex >= 0 && fileHandle.writePage(headSlotsOf(headPage)[dirIndex], dirPage) != 0) {
+                    rc = -1; // write directory page fail
+                    break;
+                }
+                dirIndex = slot / DIR_SLOTS;
+                if (fileHandle.readPage(headSlotsOf(headPage)[dirIndex], dirPage) != 0) {
+                    rc = -2; // read directory page fail
+                    break;
+                }
+            }
+            dirPage[slot % DIR_SLOTS] = bucketPageID;
+        }
+        if (rc == 0 && dirIndex >= 0 && fileHandle.writePage(headSlotsOf(headPage)[dirIndex], dirPage) != 0) {
+            rc = -1; // write directory page fail
+        }
+        free(dirPage);
+        return rc;
+    }
+
+    RC IndexManager::doubleDirectory(IXFileHandle &ixFileHandle, void *headPage) {
+        // slot + 2^globalDepth starts out on the bucket of slot
+        unsigned globalDepth = hashDirOf(headPage)->globalDepth;
+        unsigned slotNum = 1u << globalDepth;
+        IndexHeader &header = *(IndexHeader *) headPage;
+        if (globalDepth >= MAX_GLOBAL_DEPTH) {
+            return -1; // directory at its largest
+        }
+
+        if (isDirectoryInHead(globalDepth + 1)) {
+            memcpy(headSlotsOf(headPage) + slotNum, headSlotsOf(headPage), slotNum * sizeof(PAGE_ID));
+        } else if (isDirectoryInHead(globalDepth)) {
+            // moves out of page 0 into whole directory pages
+            std::vector<PAGE_ID> slots(2 * slotNum);
+            memcpy(slots.data(), headSlotsOf(headPage), slotNum * sizeof(PAGE_ID));
+            memcpy(slots.data() + slotNum, headSlotsOf(headPage), slotNum * sizeof(PAGE_ID));
+            for (unsigned dirIndex = 0; dirIndex < 2 * slotNum / DIR_SLOTS; dirIndex++) {
+                PAGE_ID dirPageID;
+                if (allocatePage(ixFileHandle, header, slots.data() + dirIndex * DIR_SLOTS, dirPageID) != 0) {
+                    return -2; // allocate directory page fail
+                }
+                headSlotsOf(headPage)[dirIndex] = dirPageID;
+            }
+        } else {
+            // every directory page gets a copy
+            unsigned dirPageNum = slotNum / DIR_SLOTS;
+            auto *dirPage = (char *) malloc(PAGE_SIZE);
+            for (unsigned dirIndex = 0; dirIndex < dirPageNum; dirIndex++) {
+                PAGE_ID dirPageID;
+                if (ixFileHandle.getFileHandle().readPage(headSlotsOf(headPage)[dirIndex], dirPage) != 0 ||
+                    allocatePage(ixFileHandle, header, dirPage, dirPageID) != 0) {
+                    free(dirPage);
+                    return -2; // allocate directory page fail
+                }
+                headSlotsOf(headPage)[dirPageNum + dirIndex] = dirPageID;
+            }
+            free(dirPage);
+        }
+        hashDirOf(headPage)->globalDepth++;
+        return 0;
+    }
+
+    RC IndexManager::writeBucketChain(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                                      PAGE_ID &firstPage, unsigned localDepth, const std::vector<char> &entries) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        std::vector<PAGE_ID> chain;
+        for (PAGE_ID pageID = firstPage; pageID != 0;) {
+            const void *ref;
+            if (fileHandle.readPageRef(pageID, ref) != 0) {
+                return -1; // read bucket fail
+            }
+            chain.push_back(pageID);
+            PAGE_ID nextPage = ((const BucketDir *) ref)->overflowPage;
+            fileHandle.releasePageRef(pageID);
+            pageID = nextPage;
+        }
+
+        // fill the pages in memory, then place them last page first so each knows the page after it
+        std::vector<char> pages(PAGE_SIZE);
+        initBucket(pages.data(), localDepth);
+        for (unsigned offset = 0; offset < entries.size();) {
+            unsigned length = entryLength(attribute, entries.data() + offset);
+            auto *dir = (BucketDir *) (pages.data() + pages.size() - PAGE_SIZE);
+            if (dir->freeOffset + length > PAGE_SIZE) {
+                pages.resize(pages.size() + PAGE_SIZE);
+                initBucket(pages.data() + pages.size() - PAGE_SIZE, localDepth);
+                continue;
+            }
+            memcpy((char *) dir + dir->freeOffset, entries.data() + offset, length);
+            dir->freeOffset += length;
+            dir->recordNum++;
+            offset += length;
+        }
+
+        unsigned pageNum = pages.size() / PAGE_SIZE;
+        PAGE_ID nextPage = 0;
+        for (unsigned i = pageNum; i-- > 0;) {
+            char *page = pages.data() + i * PAGE_SIZE;
+            ((BucketDir *) page)->overflowPage = nextPage;
+            if (i < chain.size()) {
+                if (fileHandle.writePage(chain[i], page) != 0) {
+                    return -2; // write bucket fail
+                }
+                nextPage = chain[i];
+            } else if (allocatePage(ixFileHandle, header, page, nextPage) != 0) {
+                return -3; // allocate bucket fail
+            }
+        }
+        firstPage = nextPage;
+        for (unsigned i = pageNum; i < chain.size(); i++) {
+            if (freePage(ixFileHandle, header, chain[i]) != 0) {
+                return -4; // free bucket fail
+            }
+        }
+        return 0;
+    }
+
+    RC IndexManager::splitBucket(IXFileHandle &ixFileHandle, const Attribute &attribute, void *headPage,
+                                 unsigned hash) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        IndexHeader &header = *(IndexHeader *) headPage;
+        PAGE_ID bucketPageID;
+        if (getBucket(ixFileHandle, headPage, lowBits(hash, hashDirOf(headPage)->globalDepth), bucketPageID) != 0) {
+            return -1;
+        }
+
+        // the whole chain is dealt out by the next bit of each key's hash
+        std::vector<char> stay, move;
+        unsigned localDepth = 0;
+        for (PAGE_ID pageID = bucketPageID; pageID != 0;) {
+            const void *ref;
+            if (fileHandle.readPageRef(pageID, ref) != 0) {
+                return -2; // read bucket fail
+            }
+            auto *dir = (const BucketDir *) ref;
+            if (pageID == bucketPageID) {
+                localDepth = dir->localDepth;
+            }
+            for (OFFSET offset = sizeof(BucketDir); offset < dir->freeOffset;) {
+                const char *entry = (const char *) ref + offset;
+                unsigned length = entryLength(attribute, entry);
+                std::vector<char> &side = (hashKey(attribute, entry) >> localDepth & 1u) ? move : stay;
+                side.insert(side.end(), entry, entry + length);
+                offset += length;
+            }
+            PAGE_ID nextPage = dir->overflowPage;
+            fileHandle.releasePageRef(pageID);
+            pageID = nextPage;
+        }
+
+        if (localDepth == hashDirOf(headPage)->globalDepth && doubleDirectory(ixFileHandle, headPage) != 0) {
+            return -3; // directory cannot grow
+        }
+        PAGE_ID newPageID = 0;
+        if (writeBucketChain(ixFileHandle, attribute, header, bucketPageID, localDepth + 1, stay) != 0 ||
+            writeBucketChain(ixFileHandle, attribute, header, newPageID, localDepth + 1, move) != 0) {
+            return -4; // write bucket fail
+        }
+        if (setBuckets(ixFileHandle, headPage, lowBits(hash, localDepth) | 1u << localDepth, localDepth + 1,
+                       newPageID) != 0) {
+            return -5; // write directory fail
+        }
+        return 0;
+    }
+
+    RC IndexManager::hashInsert(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                                const RID &rid) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        unsigned keyLength = getKeyLength(attribute, key);
+        if (keyLength + sizeof(RID) > BUCKET_CAPACITY) {
+            return -1; // key too long for a bucket
+        }
+        auto *headPage = (char *) malloc(PAGE_SIZE);
+        auto *oldHeadPage = (char *) malloc(PAGE_SIZE);
+        auto *page = (char *) malloc(PAGE_SIZE);
+        if (fileHandle.readPage(0, headPage) != 0) {
+            free(headPage);
+            free(oldHeadPage);
+            free(page);
+            return -2; // read head page fail
+        }
+        memcpy(oldHeadPage, headPage, PAGE_SIZE);
+
+        unsigned hash = hashKey(attribute, key);
+        RC rc = 0;
+        while (rc == 0) {
+            PAGE_ID bucketPageID;
+            if (getBucket(ixFileHandle, headPage, lowBits(hash, hashDirOf(headPage)->globalDepth), bucketPageID)
+                != 0) {
+                rc = -3; // read directory fail
+                break;
+            }
+
+            // the first page of the chain with room takes the entry
+            PAGE_ID pageID = bucketPageID;
+            unsigned localDepth = 0;
+            bool oneHash = true;                    // every entry of the full chain has chainHash
+            bool hasChainHash = false;
+            unsigned chainHash = 0;
+            unsigned chainPages = 0;
+            bool placed = false;
+            while (true) {
+                if (fileHandle.readPage(pageID, page) != 0) {
+                    rc = -4; // read bucket fail
+                    break;
+                }
+                auto *dir = (BucketDir *) page;
+                if (pageID == bucketPageID) {
+                    localDepth = dir->localDepth;
+                }
+                chainPages++;
+                if (dir->freeOffset + keyLength + sizeof(RID) <= PAGE_SIZE) {
+                    memcpy(page + dir->freeOffset, key, keyLength);
+                    memcpy(page + dir->freeOffset + keyLength, &rid, sizeof(RID));
+                    dir->freeOffset += keyLength + sizeof(RID);
+                    dir->recordNum++;
+                    rc = fileHandle.writePage(pageID, page) == 0 ? 0 : -5; // write bucket fail
+                    placed = true;
+                    break;
+                }
+                for (OFFSET offset = sizeof(BucketDir); offset < dir->freeOffset && oneHash;) {
+                    unsigned entryHash = hashKey(attribute, page + offset);
+                    oneHash = !hasChainHash || entryHash == chainHash;
+                    chainHash = entryHash;
+                    hasChainHash = true;
+                    offset += entryLength(attribute, page + offset);
+                }
+                if (dir->overflowPage == 0) {
+                    break;
+                }
+                pageID = dir->overflowPage;
+            }
+            if (rc != 0 || placed) {
+                break;
+            }
+
+            // Splitting cannot separate the entries of one hash (one key with many RIDs, mostly). A chain already
+            // overflowing with them would only split again and again, so only a single full page grows the
+            // directory; other chains split while the directory need not grow for them, then overflow.
+            unsigned globalDepth = hashDirOf(headPage)->globalDepth;
+            bool canSplit = localDepth < globalDepth ? !oneHash || chainHash != hash
+                                                     : !oneHash && chainPages == 1 && globalDepth < MAX_GLOBAL_DEPTH;
+            if (canSplit) {
+                rc = splitBucket(ixFileHandle, attribute, headPage, hash);
+                continue;
+            }
+            auto *overflowPage = (char *) malloc(PAGE_SIZE);
+            initBucket(overflowPage, localDepth);
+            memcpy(overflowPage + sizeof(BucketDir), key, keyLength);
+            memcpy(overflowPage + sizeof(BucketDir) + keyLength, &rid, sizeof(RID));
+            ((BucketDir *) overflowPage)->freeOffset += keyLength + sizeof(RID);
+            ((BucketDir *) overflowPage)->recordNum = 1;
+            PAGE_ID overflowPageID;
+            rc = allocatePage(ixFileHandle, *(IndexHeader *) headPage, overflowPage, overflowPageID);
+            free(overflowPage);
+            if (rc == 0) {
+                ((BucketDir *) page)->overflowPage = overflowPageID;
+                rc = fileHandle.writePage(pageID, page) == 0 ? 0 : -5; // write bucket fail
+            }
+            break;
+        }
+
+        // a deeper directory, a split or pages taken from the free list
+        if (rc == 0 && memcmp(headPage, oldHeadPage, PAGE_SIZE) != 0 && fileHandle.writePage(0, headPage) != 0) {
+            rc = -6; // write head page fail
+        }
+        free(headPage);
+        free(oldHeadPage);
+        free(page);
+        return rc;
+    }
+
+    RC IndexManager::hashDelete(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                                const RID &rid) {
+        // an emptied overflow page stays in its chain until compact
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        const void *headRef;
+        if (fileHandle.readPageRef(0, headRef) != 0) {
+            return -1; // read head page fail
+        }
+        unsigned hash = hashKey(attribute, key);
+        PAGE_ID pageID;
+        RC rc = getBucket(ixFileHandle, headRef, lowBits(hash, hashDirOf(headRef)->globalDepth), pageID);
+        fileHandle.releasePageRef(0);
+        if (rc != 0) {
+            return -2; // read directory fail
+        }
+
+        auto *page = (char *) malloc(PAGE_SIZE);
+        rc = -3; // no such entry
+        while (pageID != 0 && rc == -3) {
+            if (fileHandle.readPage(pageID, page) != 0) {
+                rc = -4; // read bucket fail
+                break;
+            }
+            auto *dir = (BucketDir *) page;
+            for (OFFSET offset = sizeof(BucketDir); offset < dir->freeOffset;) {
+                char *entry = page + offset;
+                unsigned keyLength = getKeyLength(attribute, entry);
+                RID entryRid;
+                memcpy(&entryRid, entry + keyLength, sizeof(RID));
+                if (entryRid.pageNum == rid.pageNum && entryRid.slotNum == rid.slotNum &&
+                    compareKey(attribute, entry, key) == 0) {
+                    unsigned length = keyLength + sizeof(RID);
+                    memmove(entry, entry + length, dir->freeOffset - offset - length);
+                    dir->freeOffset -= length;
+                    dir->recordNum--;
+                    rc = fileHandle.writePage(pageID, page) == 0 ? 0 : -5; // write bucket fail
+                    break;
+                }
+                offset += keyLength + sizeof(RID);
+            }
+            pageID = dir->overflowPage;
+        }
+        free(page);
+        return rc;
+    }
+
+    RC IndexManager::hashCompact(IXFileHandle &ixFileHandle, const Attribute &attribute) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+
+        // the entries are set aside, every page but page 0 is freed lowest first on top, then they go back in
+        IX_KeySorter sorter(attribute);
+        IX_ScanIterator iterator;
+        auto *key = (char *) malloc(PAGE_SIZE);
+        RID rid;
+        RC rc = scan(ixFileHandle, attribute, NULL, NULL, true, true, iterator);
+        while (rc == 0 && (rc = iterator.getNextEntry(rid, key)) == 0) {
+            rc = sorter.addEntry(key, rid);
+        }
+        iterator.close();
+        if (rc != IX_EOF || sorter.finish() != 0) {
+            free(key);
+            return -3; // read entries fail
+        }
+
+        auto *headPage = (char *) malloc(PAGE_SIZE);
+        rc = fileHandle.readPage(0, headPage) == 0 ? 0 : -4; // read head page fail
+        IndexHeader &header = *(IndexHeader *) headPage;
+        header.freePageID = 0;
+        for (PAGE_ID pageID = fileHandle.getNumberOfPages(); rc == 0 && pageID-- > 1;) {
+            rc = freePage(ixFileHandle, header, pageID);
+        }
+        if (rc == 0) {
+            auto *bucket = (char *) malloc(PAGE_SIZE);
+            initBucket(bucket, 0);
+            hashDirOf(headPage)->globalDepth = 0;
+            rc = allocatePage(ixFileHandle, header, bucket, headSlotsOf(headPage)[0]);
+            free(bucket);
+        }
+        if (rc == 0 && fileHandle.writePage(0, headPage) != 0) {
+            rc = -7; // write head page fail
+        }
+        free(headPage);
+        while (rc == 0 && (rc = sorter.getNextEntry(key, rid)) == 0) {
+            rc = hashInsert(ixFileHandle, attribute, key, rid);
+        }
+        free(key);
+        return rc == IX_EOF ? 0 : rc;
+    }
+
+    RC IndexManager::printHash(IXFileHandle &ixFileHandle, const Attribute &attribute, std::ostream &out) const {
+        // one line per bucket at its lowest slot: {"slot": s, "localDepth": d, "keys": ["key:(p, s)",...]}
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        auto *headPage = (char *) malloc(PAGE_SIZE);
+        auto *page = (char *) malloc(PAGE_SIZE);
+        RC rc = fileHandle.readPage(0, headPage) == 0 ? 0 : -1; // read head page fail
+        unsigned globalDepth = hashDirOf(headPage)->globalDepth;
+        out << "{\"globalDepth\": " << globalDepth << "," << std::endl << "\"buckets\": [";
+        bool firstBucket = true;
+        for (unsigned slot = 0; rc == 0 && slot < 1u << globalDepth; slot++) {
+            PAGE_ID pageID;
+            if (getBucket(ixFileHandle, headPage, slot, pageID) != 0 || fileHandle.readPage(pageID, page) != 0) {
+                rc = -2; // read bucket fail
+                break;
+            }
+            unsigned localDepth = ((BucketDir *) page)->localDepth;
+            if (slot >= 1u << localDepth) {
+                continue;
+            }
+            out << (firstBucket ? "" : ",") << std::endl << "{\"slot\": " << slot << ", \"localDepth\": "
+                << localDepth << ", \"keys\": [";
+            firstBucket = false;
+            bool firstKey = true;
+            while (true) {
+                auto *dir = (BucketDir *) page;
+                for (OFFSET offset = sizeof(BucketDir); offset < dir->freeOffset;) {
+                    const char *entry = page + offset;
+                    unsigned keyLength = getKeyLength(attribute, entry);
+                    RID rid;
+                    memcpy(&rid, entry + keyLength, sizeof(RID));
+                    out << (firstKey ? "\"" : ",\"");
+                    printKey(attribute, entry, out);
+                    out << ":(" << rid.pageNum << ", " << rid.slotNum << ")\"";
+                    firstKey = false;
+                    offset += keyLength + sizeof(RID);
+                }
+                if (dir->overflowPage == 0) {
+                    break;
+                }
+                if (fileHandle.readPage(dir->overflowPage, page) != 0) {
+                    rc = -2; // read bucket fail
+                    break;
+                }
+            }
+            out << "]}";
+        }
+        out << std::endl << "]}" << std::endl;
+        free(headPage);
+        free(page);
+        return rc;
+    }
+
+
+    /*
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    */
+    RC IX_ScanIterator::initHashScan(const void *headPage) {
+        // lowKey == highKey, both inclusive, is one key and so one chain
+        _isHash = true;
+        _hashProbe = _lowKey != nullptr && _highKey != nullptr && _lowKeyInclusive && _highKeyInclusive &&
+                     IndexManager::compareKey(_attribute, _lowKey, _highKey) == 0;
+        _hashSlot = 0;
+        _curLeafPageBuffer = (char *) malloc(PAGE_SIZE);
+        if (!_hashProbe) {
+            _curSlot = 0;
+            ((BucketDir *) _curLeafPageBuffer)->freeOffset = 0;
+            ((BucketDir *) _curLeafPageBuffer)->overflowPage = 0;
+            return 0; // the first bucket is read by getNextEntry
+        }
+
+        unsigned hash = IndexManager::hashKey(_attribute, _lowKey);
+        PAGE_ID pageID;
+        if (IndexManager::getBucket(*_ixFileHandle, headPage, lowBits(hash, hashDirOf(headPage)->globalDepth), pageID)
+            != 0 || _ixFileHandle->getFileHandle().readPage(pageID, _curLeafPageBuffer) != 0) {
+            return -1; // read bucket fail
+        }
+        _curSlot = sizeof(BucketDir);
+        return 0;
+    }
+
+    RC IX_ScanIterator::nextBucket() {
+        // a bucket is read at the lowest slot pointing at it, the slot its localDepth bits name
+        FileHandle &fileHandle = _ixFileHandle->getFileHandle();
+        while (true) {
+            const void *headRef;
+            if (fileHandle.readPageRef(0, headRef) != 0) {
+                return -1; // read head page fail
+            }
+            PAGE_ID pageID = 0;
+            bool hasSlot = _hashSlot < 1u << hashDirOf(headRef)->globalDepth;
+            RC rc = hasSlot ? IndexManager::getBucket(*_ixFileHandle, headRef, _hashSlot, pageID) : 0;
+            fileHandle.releasePageRef(0);
+            if (!hasSlot) {
+                return IX_EOF;
+            }
+            if (rc != 0 || fileHandle.readPage(pageID, _curLeafPageBuffer) != 0) {
+                return -1; // read bucket fail
+            }
+            unsigned slot = _hashSlot++;
+            if (slot < 1u << ((BucketDir *) _curLeafPageBuffer)->localDepth) {
+                _curSlot = sizeof(BucketDir);
+                return 0;
+            }
+        }
+    }
+
+    bool IX_ScanIterator::inRange(const void *key) const {
+        if (_lowKey != nullptr) {
+            int cmp = IndexManager::compareKey(_attribute, key, _lowKey);
+            if (cmp < 0 || (cmp == 0 && !_lowKeyInclusive)) {
+                return false;
+            }
+        }
+        if (_highKey != nullptr) {
+            int cmp = IndexManager::compareKey(_attribute, key, _highKey);
+            if (cmp > 0 || (cmp == 0 && !_highKeyInclusive)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    RC IX_ScanIterator::getNextHashEntry(RID &rid, void *key) {
+        // entries deleted behind the cursor do not move it, the bucket is a private copy
+        while (true) {
+            auto *dir = (BucketDir *) _curLeafPageBuffer;
+            while (_curSlot < dir->freeOffset) {
+                const char *entry = _curLeafPageBuffer + _curSlot;
+                unsigned keyLength = IndexManager::getKeyLength(_attribute, entry);
+                _curSlot += keyLength + sizeof(RID);
+                if (inRange(entry)) {
+                    memcpy(key, entry, keyLength);
+                    memcpy(&rid, entry + keyLength, sizeof(RID));
+                    return 0;
+                }
+            }
+            if (dir->overflowPage != 0) {
+                if (_ixFileHandle->getFileHandle().readPage(dir->overflowPage, _curLeafPageBuffer) != 0 ||
+                    ((BucketDir *) _curLeafPageBuffer)->flag != BUCKET_FLAG) {
+                    return IX_EOF;
+                }
+                _curSlot = sizeof(BucketDir);
+                continue;
+            }
+            if (_hashProbe || nextBucket() != 0) {
+                return IX_EOF;
+            }
+        }
+    }
+
+} // namespace PeterDB
@@ -1,1380 +1,1514 @@
 #include "src/include/ix.h"
 
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
 namespace PeterDB {
-    IndexManager &IndexManager::instance() {
-        static IndexManager _index_manager = IndexManager();
-        return _index_manager;
+    static NodeDir *dirOf(void *page) {
+        return (NodeDir *) page;
     }
 
-    RC IndexManager::createFile(const std::string &fileName) {
-        return PagedFileManager::instance().createFile(fileName);
+    static const NodeDir *dirOf(const void *page) {
+        return (const NodeDir *) page;
     }
 
-    RC IndexManager::destroyFile(const std::string &fileName) {
-        return PagedFileManager::instance().destroyFile(fileName);
+    static KEY_SLOT *slotsOf(void *page) {
+        return (KEY_SLOT *) ((char *) page + sizeof(NodeDir));
     }
 
-    RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
-        return PagedFileManager::instance().openFile(fileName, ixFileHandle.getFileHandle());
+    static const KEY_SLOT *slotsOf(const void *page) {
+        return (const KEY_SLOT *) ((const char *) page + sizeof(NodeDir));
     }
 
-    RC IndexManager::closeFile(IXFileHandle &ixFileHandle) {
-        return PagedFileManager::instance().closeFile(ixFileHandle.getFileHandle());
+    static const char *entryOf(const void *page, int slot) {
+        return (const char *) page + slotsOf(page)[slot];
     }
 
-    RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
-        unsigned pageNum = ixFileHandle.getFileHandle().getNumberOfPages();
-        //std::cout << "line 27 pageNum is: " << pageNum << std::endl;
-        RC rc;
+    // Bytes of entry data after the key: a RID list in leaves, a child page id in internal nodes
+    static unsigned dataLength(PAGE_FLAG pageFlag, const void *data) {
+        if (pageFlag != LEAF_FLAG) {
+            return sizeof(PAGE_ID);
+        }
+        RID_NUM ridNum;
+        memcpy(&ridNum, data, sizeof(RID_NUM));
+        return sizeof(RID_NUM) + (ridNum == 0 ? sizeof(PAGE_ID) : ridNum * sizeof(RID));
+    }
 
-        if (pageNum == 0) {
-            // append dummy head page
-            auto *dmPage = (char *) malloc(PAGE_SIZE);
-            PAGE_ID rootPageNum = 1;
-            memcpy(dmPage, &rootPageNum, sizeof(PAGE_ID));
-            rc = ixFileHandle.getFileHandle().appendPage(dmPage);
-            if (rc != 0) {
-                return -1;
-            }
-            free(dmPage);
+    static bool ridLess(const RID &rid, const RID &otherRid) {
+        return rid.pageNum != otherRid.pageNum ? rid.pageNum < otherRid.pageNum : rid.slotNum < otherRid.slotNum;
+    }
 
-            // append root-leaf page
-            rc = appendLeafPage(ixFileHandle, attribute, key, rid);
-            if (rc != 0) {
-                return rc;
-            }
-        } else if (pageNum == 2) {
-            OFFSET occupiedSpace = getKeyOccupiedSpace(attribute, key, LEAF_FLAG);
-            if (occupiedSpace == -1) {
-                return -2;
-            }
+    static RID *postingRids(void *page) {
+        return (RID *) ((char *) page + sizeof(PostingDir));
+    }
 
-            void *page = malloc(PAGE_SIZE);
-            if(ixFileHandle.getFileHandle().readPage(1, page) != 0) {
-                return -3;
-            }
+    static const RID *postingRids(const void *page) {
+        return (const RID *) ((const char *) page + sizeof(PostingDir));
+    }
 
-            LeafDir leafDir;
-            memcpy(&leafDir, page, sizeof(LeafDir));
+    static const int POSTING_CAPACITY = (PAGE_SIZE - sizeof(PostingDir)) / sizeof(RID);
 
-            if (occupiedSpace <= leafDir.freeSpace) {
-                rc = insertEntry2NodeNoSplit(ixFileHandle, 1, LEAF_FLAG, page, attribute, key, &rid);
-                if (rc != 0) {
-                    return -4;
-                }
-            } else {
-                rc = splitRootLeafPage(ixFileHandle, attribute, key, rid);
-                if (rc != 0) {
-                    return -5;
-                }
-            }
-            free(page);
+    static void initNode(void *page, PAGE_FLAG pageFlag) {
+        memset(page, 0, PAGE_SIZE);
+        NodeDir *dir = dirOf(page);
+        dir->flag = pageFlag;
+        dir->recordNum = 0;
+        dir->freeSpace = PAGE_SIZE - sizeof(NodeDir);
+        dir->heapOffset = PAGE_SIZE;
+        dir->nextLeafNode = 0;
+        dir->firstChild = 0;
+        dir->prefixLength = 0;
+    }
 
-        } else {
-            // std::cout << "page num in index file is big" << std::endl;
-            PAGE_ID rootPageID;
-            void *dmPage = malloc(PAGE_SIZE);
-            if (ixFileHandle.getFileHandle().readPage(0, dmPage) != 0) {
-                return -6;
-            }
-            memcpy(&rootPageID, (char *)dmPage, sizeof(PAGE_ID));
-
-            void *splitKey = malloc(PAGE_SIZE);
-            void *splitData = malloc(PAGE_SIZE);
-            void *_key = malloc(PAGE_SIZE);
-
-            if (attribute.type == TypeVarChar) {
-                int keyLength;
-                memcpy(&keyLength, key, 4);
-                memcpy(_key, key, keyLength+4);
-            } else if (attribute.type == TypeInt || attribute.type == TypeReal) {
-                memcpy(_key, key, 4);
-            } else {
-                return -7; // should not be here
-            }
+    static const char *prefixOf(const void *page) {
+        return (const char *) page + PAGE_SIZE - dirOf(page)->prefixLength;
+    }
 
-            bool hasChildEntry = true;
-            // std::cout << "go into insertion line95" << std::endl;
-            if (insertion(ixFileHandle, attribute, _key, rid, rootPageID, splitKey, splitData, hasChildEntry) != 0) {
-                return -8;
-            }
+    // Prefix every key of an empty leaf starts with, kept once at the end of the page
+    static void setPrefix(void *page, const char *bytes, int length) {
+        NodeDir *dir = dirOf(page);
+        dir->prefixLength = length;
+        dir->heapOffset = PAGE_SIZE - length;
+        dir->freeSpace -= length;
+        memcpy((char *) page + dir->heapOffset, bytes, length);
+    }
 
-            free(dmPage);
-            free(splitData);
-            free(splitKey);
-            free(_key);
+    static int compareBytes(const char *bytes, int length, const char *otherBytes, int otherLength) {
+        int cmp = memcmp(bytes, otherBytes, length < otherLength ? length : otherLength);
+        if (cmp != 0) {
+            return cmp;
         }
-        return 0;
+        return length < otherLength ? -1 : length > otherLength;
     }
 
+    // Bytes two VarChar keys have in common from the start
+    static int commonPrefix(const char *key, const char *otherKey) {
+        int length, otherLength;
+        memcpy(&length, key, sizeof(int));
+        memcpy(&otherLength, otherKey, sizeof(int));
+        int common = 0;
+        while (common < length && common < otherLength && key[sizeof(int) + common] == otherKey[sizeof(int) + common]) {
+            common++;
+        }
+        return common;
+    }
 
-    RC IndexManager::insertion(IXFileHandle &ixFileHandle, const Attribute &attribute, const void * key, const RID &rid,
-                               PAGE_ID curPageID, void *splitKey, void *splitData, bool &hasChildEntry) {
-        void *page = malloc(PAGE_SIZE);
-        if (ixFileHandle.getFileHandle().readPage(curPageID, page) != 0) {
-            free(page);
-            return -1; // no page availabel for current page id
-        } else {
-            // check page flag
-            PAGE_FLAG pageFlag;
-            memcpy(&pageFlag, (char *)page, sizeof(PAGE_FLAG));
-
-            if (pageFlag == LEAF_FLAG) {
-                LeafDir leafDir;
-                memcpy(&leafDir, (char *)page, sizeof(leafDir));
+    // Bytes saved by storing the prefix shared by sorted VarChar entries [begin, end) once
+    static unsigned sharedBytes(const std::vector<const char *> &entries, int begin, int end) {
+        if (end - begin < 2) {
+            return 0;
+        }
+        return (end - begin - 1) * commonPrefix(entries[begin], entries[end - 1]);
+    }
 
-                OFFSET occupiedSpace = getKeyOccupiedSpace(attribute, key, LEAF_FLAG);
+    // Shortest separator above key and at most otherKey, in the insertEntry format; returns its length
+    static unsigned shortestSeparator(const char *key, const char *otherKey, char *separator) {
+        int otherLength;
+        memcpy(&otherLength, otherKey, sizeof(int));
+        int common = commonPrefix(key, otherKey);
+        int length = common < otherLength ? common + 1 : otherLength;
+        memcpy(separator, &length, sizeof(int));
+        memcpy(separator + sizeof(int), otherKey + sizeof(int), length);
+        return sizeof(int) + length;
+    }
 
-                if (leafDir.freeSpace >= occupiedSpace) {
-                    hasChildEntry = false;
+    static bool hasPrefix(const void *page, const void *key) {
+        int keyLength, prefixLength = dirOf(page)->prefixLength;
+        memcpy(&keyLength, key, sizeof(int));
+        return keyLength >= prefixLength && memcmp((const char *) key + sizeof(int), prefixOf(page), prefixLength) == 0;
+    }
 
-                    if (insertEntry2NodeNoSplit(ixFileHandle, curPageID, LEAF_FLAG, page, attribute, key, &rid) != 0) {
-                        return -2; // simplest insertion fail
-                    }
+    // Compare the key of a slot with key; a compressed leaf only stores what follows its prefix
+    static int compareSlot(const Attribute &attribute, const void *page, int slot, const void *key) {
+        const char *entry = entryOf(page, slot);
+        int prefixLength = dirOf(page)->prefixLength;
+        if (prefixLength == 0) {
+            return IndexManager::compareKey(attribute, entry, key);
+        }
+        int keyLength, suffixLength;
+        memcpy(&keyLength, key, sizeof(int));
+        memcpy(&suffixLength, entry, sizeof(int));
+        const char *keyBytes = (const char *) key + sizeof(int);
+        int cmp = compareBytes(prefixOf(page), prefixLength, keyBytes,
+                               keyLength < prefixLength ? keyLength : prefixLength);
+        if (cmp != 0) {
+            return cmp;
+        }
+        return compareBytes(entry + sizeof(int), suffixLength, keyBytes + prefixLength, keyLength - prefixLength);
+    }
 
-                    free(page);
+    // Entry data of a slot: RID in leaves, child page id in internal nodes
+    static const char *dataOf(const Attribute &attribute, const void *page, int slot) {
+        const char *entry = entryOf(page, slot);
+        return entry + IndexManager::getKeyLength(attribute, entry);
+    }
 
-                    return 0;
-                } else {
-                    // for debug: set breakpoint here
-                    hasChildEntry = true;
+    // Copy the full key of a slot into key, in the insertEntry format
+    static void copyKey(const Attribute &attribute, const void *page, int slot, void *key) {
+        const char *entry = entryOf(page, slot);
+        int prefixLength = dirOf(page)->prefixLength;
+        if (prefixLength == 0) {
+            memcpy(key, entry, IndexManager::getKeyLength(attribute, entry));
+            return;
+        }
+        int suffixLength;
+        memcpy(&suffixLength, entry, sizeof(int));
+        int keyLength = prefixLength + suffixLength;
+        memcpy(key, &keyLength, sizeof(int));
+        memcpy((char *) key + sizeof(int), prefixOf(page), prefixLength);
+        memcpy((char *) key + sizeof(int) + prefixLength, entry + sizeof(int), suffixLength);
+    }
 
-                    void *newLeafPage = malloc(PAGE_SIZE);
-                    PAGE_ID newLeafPageID;
+    static bool compressesKeys(const IndexHeader &header, const Attribute &attribute) {
+        return (header.options & IX_KEY_COMPRESSION) && attribute.type == TypeVarChar;
+    }
 
-                    if (insertEntry2NodeNSplit(ixFileHandle, pageFlag, attribute, curPageID, key, &rid, splitKey,
-                                               page, newLeafPage, newLeafPageID) != 0) {
-                        return -3; // split and insertion fail
-                    }
+    static const FREE_SPACE NODE_CAPACITY = PAGE_SIZE - sizeof(NodeDir);
 
-                    memcpy(splitData, &newLeafPageID, sizeof(PAGE_ID));
-                    free(page);
-                    free(newLeafPage);
+    static bool isUnderfull(const void *page) {
+        return NODE_CAPACITY - dirOf(page)->freeSpace < (FREE_SPACE) (NODE_CAPACITY * IX_MIN_FILL);
+    }
 
-                    return 0;
-                }
+    // Entries of nodes being rebuilt, with full keys, in key order
+    struct NodeEntries {
+        const Attribute &attribute;
+        PAGE_FLAG flag;
+        bool compressLeaf;
+        std::vector<char> buffer;
+        std::vector<unsigned> offsets;
+        std::vector<const char *> entries;
+        std::vector<unsigned> sums;                     // bytes of the entries before each one, slots included
+
+        NodeEntries(const Attribute &attribute, PAGE_FLAG flag, bool compressLeaf)
+                : attribute(attribute), flag(flag), compressLeaf(compressLeaf) {}
+
+        void add(const void *key, const void *data) {
+            offsets.push_back(buffer.size());
+            unsigned keyLength = IndexManager::getKeyLength(attribute, key);
+            buffer.insert(buffer.end(), (const char *) key, (const char *) key + keyLength);
+            buffer.insert(buffer.end(), (const char *) data, (const char *) data + dataLength(flag, data));
+        }
+
+        // slots [begin, end) of a node
+        void addSlots(const void *page, int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                offsets.push_back(buffer.size());
+                unsigned keyLength = dirOf(page)->prefixLength + IndexManager::getKeyLength(attribute, entryOf(page, i));
+                unsigned dataSize = dataLength(flag, dataOf(attribute, page, i));
+                buffer.resize(buffer.size() + keyLength + dataSize);
+                copyKey(attribute, page, i, buffer.data() + offsets.back());
+                memcpy(buffer.data() + offsets.back() + keyLength, dataOf(attribute, page, i), dataSize);
             }
-            else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-                PAGE_ID nextPageID;
-
-                if (chooseSubtree(ixFileHandle, attribute, key, curPageID, nextPageID) != 0) {
-                    return -4; // cannot locate the next page id
-                }
-
-                // std::cout << "nextPageID: " << nextPageID << std::endl;
+        }
 
-                insertion(ixFileHandle, attribute, key, rid, nextPageID, splitKey, splitData, hasChildEntry);
+        // done adding, the buffer no longer moves
+        void seal() {
+            sums.assign(1, 0);
+            for (unsigned offset : offsets) {
+                entries.push_back(buffer.data() + offset);
+                unsigned keyLength = IndexManager::getKeyLength(attribute, entries.back());
+                sums.push_back(sums.back() + keyLength + dataLength(flag, entries.back() + keyLength) + sizeof(KEY_SLOT));
+            }
+        }
 
-                if (!hasChildEntry) {
-                    free(page);
-                    return 0; // where ends recursion
-                } else {
-                    NodePageDir nodePageDir;
-                    memcpy(&nodePageDir, page, sizeof(NodePageDir));
+        int size() const {
+            return entries.size();
+        }
 
-                    OFFSET occupiedSpace = getKeyOccupiedSpace(attribute, key, LEAF_FLAG);
+        // bytes entries [begin, end) take in one node
+        unsigned bytes(int begin, int end) const {
+            return sums[end] - sums[begin] - (compressLeaf ? sharedBytes(entries, begin, end) : 0);
+        }
 
-                    if (nodePageDir.freeSpace >= occupiedSpace) {
-                        hasChildEntry = false;
-                        if (insertEntry2NodeNoSplit(ixFileHandle, curPageID, NONLEAF_FLAG, page, attribute, splitKey, splitData) != 0) {
-                            return -5; // insert and split fail
-                        }
-                        free(page);
-                        return 0;
-                    } else {
-                        hasChildEntry = true;
-                        if (pageFlag == NONLEAF_FLAG) {
-                            PAGE_ID  newNodePageID;
-                            void *splitNodeKey = malloc(PAGE_SIZE);
-                            void *newNodePage = malloc(PAGE_SIZE);
-                            //TODO NEVER GET HERE ?????
-                            if (insertEntry2NodeNSplit(ixFileHandle, NONLEAF_FLAG, attribute, curPageID, splitKey, splitData, splitNodeKey,
-                                                       page, newNodePage, newNodePageID) != 0) {
-                                return -5; // insert and split fail
-                            }
-
-                            memcpy(splitKey, splitNodeKey, PAGE_SIZE);
-                            memcpy(splitData, &newNodePageID, sizeof(PAGE_ID));
-
-                            free(page);
-                            free(newNodePage);
-                            free(splitNodeKey);
-                            return 0;
-                        } else {
-                            // split root node
-                            if (splitRootNode(ixFileHandle, attribute, splitKey, splitData, curPageID) != 0) {
-                                return -6; // append new root page fail
-                            }
-
-                            free(page);
-                            return 0;
-                        }
-                    }
+        // Split at the most even byte balance, -1 if there is none; entry `split` starts the right leaf or moves
+        // up from an internal node
+        int balancedSplit() const {
+            int split = -1;
+            unsigned bestGap = 0;
+            for (int i = 1; i < size(); i++) {
+                unsigned left = bytes(0, i);
+                unsigned right = flag == LEAF_FLAG ? bytes(i, size()) : bytes(i + 1, size());
+                if (left > NODE_CAPACITY || right > NODE_CAPACITY) {
+                    continue;
+                }
+                unsigned gap = left > right ? left - right : right - left;
+                if (split == -1 || gap < bestGap) {
+                    split = i;
+                    bestGap = gap;
                 }
             }
-            else {
-                free(page);
-                return -7;
-            }
+            return split;
         }
-    }
-
-    RC IndexManager::insertEntry2NodeCore(void *page, PAGE_FLAG pageFlag, const Attribute &attribute, const void *key,
-                                          const void *data) {
-        // the data is either pageID or RID
-        OFFSET offset;
-        FREE_SPACE freeSpace;
-        RECORD_NUM recordNum;
-
-        LeafDir leafDir;
-        NodePageDir nodePageDir;
+    };
 
-        int dataSize;
+    IndexManager &IndexManager::instance() {
+        static IndexManager _index_manager = IndexManager();
+        return _index_manager;
+    }
 
-        if (pageFlag == LEAF_FLAG) {
-            memcpy(&leafDir, page, sizeof(LeafDir));
+    RC IndexManager::createFile(const std::string &fileName) {
+        return PagedFileManager::instance().createFile(fileName);
+    }
 
-            freeSpace = leafDir.freeSpace;
-            recordNum = leafDir.recordNum;
+    RC IndexManager::createFile(const std::string &fileName, unsigned options) {
+        if (createFile(fileName) != 0) {
+            return -1;
+        }
+        IXFileHandle ixFileHandle;
+        if (openFile(fileName, ixFileHandle) != 0) {
+            return -2; // open fail
+        }
+        // an empty tree, but the options must outlive it
+        auto *page = (char *) calloc(PAGE_SIZE, 1);
+        IndexHeader header = {0, options, 0, 0};
+        memcpy(page, &header, sizeof(IndexHeader));
+        if (options & IX_HASH) {
+            // a directory of one slot and its empty bucket in page 1
+            HashDir hashDir = {0};
+            PAGE_ID bucketPageID = 1;
+            memcpy(page + sizeof(IndexHeader), &hashDir, sizeof(HashDir));
+            memcpy(page + sizeof(IndexHeader) + sizeof(HashDir), &bucketPageID, sizeof(PAGE_ID));
+        }
+        RC rc = ixFileHandle.getFileHandle().appendPage(page);
+        if (rc == 0 && (options & IX_HASH)) {
+            memset(page, 0, PAGE_SIZE);
+            BucketDir bucketDir = {BUCKET_FLAG, 0, 0, sizeof(BucketDir), 0};
+            memcpy(page, &bucketDir, sizeof(BucketDir));
+            rc = ixFileHandle.getFileHandle().appendPage(page);
+        }
+        free(page);
+        closeFile(ixFileHandle);
+        return rc == 0 ? 0 : -3; // append fail
+    }
 
-            offset = sizeof(LeafDir);
+    RC IndexManager::destroyFile(const std::string &fileName) {
+        return PagedFileManager::instance().destroyFile(fileName);
+    }
 
-            dataSize = sizeof(RID);
-        } else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            memcpy(&nodePageDir, page, sizeof(NodePageDir));
+    RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
+        return PagedFileManager::instance().openFile(fileName, ixFileHandle.getFileHandle());
+    }
 
-            freeSpace = nodePageDir.freeSpace;
-            recordNum = nodePageDir.recordNum;
+    RC IndexManager::closeFile(IXFileHandle &ixFileHandle) {
+        return PagedFileManager::instance().closeFile(ixFileHandle.getFileHandle());
+    }
 
-            offset = sizeof(NodePageDir) + sizeof(PAGE_ID); // the first page num is not inserted within this function
+    RC IndexManager::acquireFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
+        return PagedFileManager::instance().acquireFile(fileName, ixFileHandle.getFileHandle());
+    }
 
-            dataSize = sizeof(PAGE_ID);
-        } else {
-            return -1; // undefined flag value
-        }
+    RC IndexManager::releaseFile(IXFileHandle &ixFileHandle) {
+        return PagedFileManager::instance().releaseFile(ixFileHandle.getFileHandle());
+    }
 
+    int IndexManager::compareKey(const Attribute &attribute, const void *key, const void *otherKey) {
         switch (attribute.type) {
             case TypeInt: {
-                if (freeSpace < (4 + dataSize)) {
-                    return -2; // no enough space
-                }
-
-                int keyValue, tempData;
-                memcpy(&keyValue, key, 4);
-                for (int i = 0; i < recordNum; i++) {
-                    memcpy(&tempData, (char *) page + offset, 4);
-                    if (keyValue <= tempData) {
-                        break;
-                    }
-                    offset += (4 + dataSize);
-                }
-                // shift the data
-                memmove((char *) page + offset + 4 + dataSize, (char *) page + offset, PAGE_SIZE - freeSpace - offset);
-                // copy the inserted key and rid pair
-                memcpy((char *) page + offset, key, 4);
-                memcpy((char *) page + offset + 4, (char *) data, dataSize);
-
-                // freespace reduction and num of record increment
-                freeSpace -= (4 + dataSize);
-                recordNum += 1;
-
-                break;
+                int value, otherValue;
+                memcpy(&value, key, sizeof(int));
+                memcpy(&otherValue, otherKey, sizeof(int));
+                return value < otherValue ? -1 : value > otherValue;
             }
             case TypeReal: {
-                if (freeSpace < (4 + dataSize)) {
-                    return -2; // no enough space
-                }
-
-                float keyValue, tempData;
-                memcpy(&keyValue, key, 4);
-
-                for (int i = 0; i < recordNum; i++) {
-                    memcpy(&tempData, (char *) page + offset, 4);
-                    if (keyValue <= tempData) {
-                        break;
-                    }
-                    offset += (4 + dataSize);
-                }
-
-                if (int(keyValue) == 578) {
-                    RID rid;
-                    memcpy(&rid, (char *)data, dataSize);
-                    std::cout << rid.pageNum << ". " << rid.slotNum << std::endl;
-                }
-
-                // shift the data
-                memmove((char *) page + offset + 4 + dataSize, (char *) page + offset, PAGE_SIZE - freeSpace - offset);
-                // copy the inserted key and rid pair
-                memcpy((char *) page + offset, key, 4);
-                memcpy((char *) page + offset + 4, (char *) data, dataSize);
-
-                // freespace reduction and num of record increment
-                freeSpace -= (4 + dataSize);
-                recordNum += 1;
-
-                break;
-
+                float value, otherValue;
+                memcpy(&value, key, sizeof(float));
+                memcpy(&otherValue, otherKey, sizeof(float));
+                return value < otherValue ? -1 : value > otherValue;
             }
             case TypeVarChar: {
-                int varCharLength;
-                memcpy(&varCharLength, (char*)key, 4);
-                if (freeSpace < (varCharLength + sizeof(varCharLength) + dataSize)) {
-                    return -2; // no enough space
-                }
-
-                auto *keyValue = (char *) malloc(varCharLength + 1);
-                memcpy(keyValue, (char *) key + 4, varCharLength);
-                keyValue[varCharLength] = '\0';
-
-                int tempCharLength;
-                for (int i = 0; i < recordNum; i++) {
-                    memcpy(&tempCharLength, (char *) page + offset, sizeof(int));
-                    auto *tempData = (char *) malloc(tempCharLength + 1);
-                    memcpy(tempData, (char *)page + offset + 4, tempCharLength);
-                    tempData[tempCharLength] = '\0';
-
-                    if (strcmp(keyValue, tempData) <= 0) {
-                        free(tempData);
-                        break;
-                    }
-                    offset += (4 + tempCharLength + dataSize); // debug=11/24
-                    free(tempData);
-                }
-                // shift the data
-                memmove((char *) page + offset + 4 + varCharLength + dataSize, (char *) page + offset, PAGE_SIZE - freeSpace - offset);
-                // copy the inserted key and rid pair
-                memcpy((char *) page + offset, (char*)key, 4 + varCharLength);
-                memcpy((char *) page + offset + 4 + varCharLength, (char *) data, dataSize);
-
-                // freespace reduction and num of record increment
-                freeSpace -= (4 + varCharLength + dataSize);
-                recordNum += 1;
-
-                free(keyValue);
-
-                break;
-
+                int length, otherLength;
+                memcpy(&length, key, sizeof(int));
+                memcpy(&otherLength, otherKey, sizeof(int));
+                return compareBytes((const char *) key + sizeof(int), length,
+                                    (const char *) otherKey + sizeof(int), otherLength);
             }
-            default:
-                break;
         }
-
-        if (pageFlag == LEAF_FLAG) {
-            leafDir.recordNum = recordNum;
-            leafDir.freeSpace = freeSpace;
-            memcpy(page, &leafDir, sizeof(LeafDir));
-        } else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            nodePageDir.recordNum = recordNum;
-            nodePageDir.freeSpace = freeSpace;
-            memcpy(page, &nodePageDir, sizeof(NodePageDir));
-        } else {
-            return -3; // flag value has been wrongly changed within this function
-        }
-
         return 0;
     }
 
-    OFFSET IndexManager::getKeyOccupiedSpace(const Attribute &attribute, const void *key, PAGE_FLAG pageFlag) {
-        int dataSize;
-        if (pageFlag == LEAF_FLAG) {
-            dataSize = sizeof(RID);
-        } else if (pageFlag == NONLEAF_FLAG) {
-            dataSize = sizeof(PAGE_ID);
-        } else {
-            return -1;
+    unsigned IndexManager::getKeyLength(const Attribute &attribute, const void *key) {
+        if (attribute.type == TypeVarChar) {
+            int length;
+            memcpy(&length, key, sizeof(int));
+            return sizeof(int) + length;
         }
+        return 4;
+    }
 
-        OFFSET occupiedSpace;
-        switch (attribute.type) {
-            case TypeInt: {
-                occupiedSpace = sizeof(int) + dataSize;
-                break;
-            }
-            case TypeReal: {
-                occupiedSpace = sizeof(float) + dataSize;
-                break;
+    int IndexManager::searchNode(const Attribute &attribute, const void *page, const void *key, bool inclusive) {
+        const KEY_SLOT *slots = slotsOf(page);
+        int low = 0, high = dirOf(page)->recordNum;
+        int prefixLength = dirOf(page)->prefixLength;
+        const char *suffix = nullptr;
+        int suffixLength = 0;
+        if (prefixLength > 0) {
+            // a key outside the leaf prefix is below or above every key in it, otherwise only suffixes differ
+            int keyLength;
+            memcpy(&keyLength, key, sizeof(int));
+            suffix = (const char *) key + sizeof(int);
+            int cmp = compareBytes(prefixOf(page), prefixLength, suffix,
+                                   keyLength < prefixLength ? keyLength : prefixLength);
+            if (cmp != 0) {
+                return cmp > 0 ? 0 : high;
             }
-            case TypeVarChar: {
-                OFFSET varCharLen;
-                memcpy(&varCharLen, key, 4);
-
-                occupiedSpace = 4 + varCharLen + dataSize;
-                break;
+            suffix += prefixLength;
+            suffixLength = keyLength - prefixLength;
+        }
+        while (low < high) {
+            int mid = (low + high) / 2;
+            const char *entry = (const char *) page + slots[mid];
+            int cmp;
+            if (prefixLength > 0) {
+                int entryLength;
+                memcpy(&entryLength, entry, sizeof(int));
+                cmp = compareBytes(entry + sizeof(int), entryLength, suffix, suffixLength);
+            } else {
+                cmp = compareKey(attribute, entry, key);
             }
-            default: {
-                return -1;
+            if (cmp < 0 || (cmp == 0 && !inclusive)) {
+                low = mid + 1;
+            } else {
+                high = mid;
             }
         }
-
-        return occupiedSpace;
+        return low;
     }
 
-
-    RC IndexManager::insertEntry2NodeNoSplit(IXFileHandle &ixFileHandle, PAGE_ID pageID, PAGE_FLAG pageFlag,
-                                             void *page, const Attribute &attribute, const void* key, const void *data) {
-        RC rc;
-
-        rc = insertEntry2NodeCore(page, pageFlag, attribute, key, data);
-        if (rc != 0) {
-            return -1;
-        }
-        rc = ixFileHandle.getFileHandle().writePage(pageID, page);
-        if (rc != 0) {
-            return -2;
+    PAGE_ID IndexManager::getChild(const Attribute &attribute, const void *page, int slot) {
+        // child 0 is left of the first key, child i is stored with key i - 1
+        if (slot == 0) {
+            return dirOf(page)->firstChild;
         }
-        return 0;
+        PAGE_ID child;
+        memcpy(&child, dataOf(attribute, page, slot - 1), sizeof(PAGE_ID));
+        return child;
     }
 
-    RC IndexManager::splitRootLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
-        RC rc;
-        void *page = malloc(PAGE_SIZE);
-        void *newPage = malloc(PAGE_SIZE);
-        void *splitKey = malloc(PAGE_SIZE);
-        void *rootPage = malloc(PAGE_SIZE);
-        memset(page, 0, PAGE_SIZE);
-        memset(newPage, 0, PAGE_SIZE);
-        memset(splitKey, 0, PAGE_SIZE);
-        memset(rootPage, 0, PAGE_SIZE);
-
-        memset(newPage, 0, PAGE_SIZE);
-
-        // read the current page
-        if (ixFileHandle.getFileHandle().readPage(1, page) != 0) {
-            return -1; //read fail
+    void IndexManager::insertEntry2NodeCore(const Attribute &attribute, void *page, int slot, const void *key,
+                                            const void *data) {
+        // the caller checked freeSpace, the gap between the slot array and the entries may still be too small;
+        // in a compressed leaf the key starts with the prefix and only the rest is stored
+        NodeDir *dir = dirOf(page);
+        int prefixLength = dir->prefixLength;
+        unsigned keyLength = getKeyLength(attribute, key) - prefixLength;
+        unsigned dataSize = dataLength(dir->flag, data);
+        unsigned entryLength = keyLength + dataSize;
+        int gap = dir->heapOffset - (int) sizeof(NodeDir) - (dir->recordNum + 1) * (int) sizeof(KEY_SLOT);
+        if (gap < (int) entryLength) {
+            compactNode(attribute, page);
+        }
+
+        dir->heapOffset -= entryLength;
+        char *entry = (char *) page + dir->heapOffset;
+        if (prefixLength > 0) {
+            int suffixLength = keyLength - sizeof(int);
+            memcpy(entry, &suffixLength, sizeof(int));
+            memcpy(entry + sizeof(int), (const char *) key + sizeof(int) + prefixLength, suffixLength);
+        } else {
+            memcpy(entry, key, keyLength);
         }
+        memcpy(entry + keyLength, data, dataSize);
 
-        // std::cout << "428 ixFileHandle.getFileHandle().getNumberOfPages(): " << ixFileHandle.getFileHandle().getNumberOfPages() << std::endl;
+        KEY_SLOT *slots = slotsOf(page);
+        memmove(slots + slot + 1, slots + slot, (dir->recordNum - slot) * sizeof(KEY_SLOT));
+        slots[slot] = dir->heapOffset;
+        dir->recordNum++;
+        dir->freeSpace -= entryLength + sizeof(KEY_SLOT);
+    }
 
-        PAGE_ID newPageID;
+    void IndexManager::deleteEntryFromNode(const Attribute &attribute, void *page, int slot) {
+        NodeDir *dir = dirOf(page);
+        KEY_SLOT *slots = slotsOf(page);
+        const char *entry = (char *) page + slots[slot];
+        unsigned keyLength = getKeyLength(attribute, entry);
+        unsigned entryLength = keyLength + dataLength(dir->flag, entry + keyLength);
+        if (slots[slot] == dir->heapOffset) {
+            dir->heapOffset += entryLength;
+        }
+        memmove(slots + slot, slots + slot + 1, (dir->recordNum - slot - 1) * sizeof(KEY_SLOT));
+        dir->recordNum--;
+        dir->freeSpace += entryLength + sizeof(KEY_SLOT);
+    }
 
-        // split the page (find the middle key value)
-        if (insertEntry2NodeNSplit(ixFileHandle, LEAF_FLAG, attribute, 1, key, &rid, splitKey,
-                                   page, newPage, newPageID) != 0) {
-            return -2; //split fail
-        }
+    void IndexManager::compactNode(const Attribute &attribute, void *page) {
+        // repack the entries against the end of the page, squeezing out holes
+        NodeDir *dir = dirOf(page);
+        KEY_SLOT *slots = slotsOf(page);
+        char *copy = (char *) malloc(PAGE_SIZE);
+        memcpy(copy, page, PAGE_SIZE);
+
+        OFFSET heapOffset = PAGE_SIZE - dir->prefixLength;
+        for (int slot = 0; slot < dir->recordNum; slot++) {
+            const char *entry = copy + slots[slot];
+            unsigned keyLength = getKeyLength(attribute, entry);
+            unsigned entryLength = keyLength + dataLength(dir->flag, entry + keyLength);
+            heapOffset -= entryLength;
+            memcpy((char *) page + heapOffset, entry, entryLength);
+            slots[slot] = heapOffset;
+        }
+        dir->heapOffset = heapOffset;
+        free(copy);
+    }
 
-// lequan 11/24 comment out
-//        if(ixFileHandle.getFileHandle().appendPage(page) != 0) {
-//            return -3; // append fail
-//        }
+    RC IndexManager::readHeader(IXFileHandle &ixFileHandle, IndexHeader &header) {
+        // page 0 holds the root page id and the options the index was created with
+        const void *page;
+        if (ixFileHandle.getFileHandle().readPageRef(0, page) != 0) {
+            return -1; // read fail
+        }
+        memcpy(&header, page, sizeof(IndexHeader));
+        ixFileHandle.getFileHandle().releasePageRef(0);
+        return 0;
+    }
 
-        // std::cout << "441 ixFileHandle.getFileHandle().getNumberOfPages(): " << ixFileHandle.getFileHandle().getNumberOfPages() << std::endl;
+    RC IndexManager::writeHeader(IXFileHandle &ixFileHandle, const IndexHeader &header) {
+        auto *page = (char *) calloc(PAGE_SIZE, 1);
+        memcpy(page, &header, sizeof(IndexHeader));
+        RC rc = ixFileHandle.getFileHandle().writePage(0, page);
+        free(page);
+        return rc;
+    }
 
-        // std::cout << "push up a root line-443" << std::endl;
-        if (pushUpRootNode(1, newPageID, attribute, splitKey, rootPage) != 0) {
-            return -4; // new root page generation fail
+    RC IndexManager::createTree(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                                const RID &rid) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        IndexHeader header = {1, 0, 0, 0};
+        bool hasHeader = fileHandle.getNumberOfPages() > 0;
+        if (hasHeader && readHeader(ixFileHandle, header) != 0) {
+            return -1;
         }
+        auto *page = (char *) malloc(PAGE_SIZE);
 
-        if (ixFileHandle.getFileHandle().appendPage(rootPage) != 0) {
-            return -5; // append root page fail
+        // dummy head page pointing at the root, unless createFile already wrote it
+        if (!hasHeader) {
+            memset(page, 0, PAGE_SIZE);
+            memcpy(page, &header, sizeof(IndexHeader));
+            if (fileHandle.appendPage(page) != 0) {
+                free(page);
+                return -1; // append fail
+            }
         }
 
-        // std::cout << "452 ixFileHandle.getFileHandle().getNumberOfPages(): " << ixFileHandle.getFileHandle().getNumberOfPages() << std::endl;
-
-        PAGE_ID rootPageID = ixFileHandle.getFileHandle().getNumberOfPages() - 1;
-        void *dmPage = malloc(PAGE_SIZE);
-        if (ixFileHandle.getFileHandle().readPage(0, dmPage) != 0) {
-            return -6; // read dm page fail
+        // root-leaf page
+        initNode(page, LEAF_FLAG);
+        if (compressesKeys(header, attribute)) {
+            setPrefix(page, (const char *) key + sizeof(int), getKeyLength(attribute, key) - sizeof(int));
         }
-        memcpy((char *)dmPage, &rootPageID, sizeof(PAGE_ID));
-
-        if (ixFileHandle.getFileHandle().writePage(0, dmPage) != 0) {
-            return -7; // write dm page back fail
+        char data[sizeof(RID_NUM) + sizeof(RID)];
+        RID_NUM ridNum = 1;
+        memcpy(data, &ridNum, sizeof(RID_NUM));
+        memcpy(data + sizeof(RID_NUM), &rid, sizeof(RID));
+        insertEntry2NodeCore(attribute, page, 0, key, data);
+        RC rc;
+        if (hasHeader) {
+            // an emptied index may have pages to reuse
+            rc = allocatePage(ixFileHandle, header, page, header.rootPageID);
+            if (rc == 0) {
+                rc = writeHeader(ixFileHandle, header);
+            }
+        } else {
+            rc = fileHandle.appendPage(page);
         }
-
-        // std::cout << "465 ixFileHandle.getFileHandle().getNumberOfPages(): " << ixFileHandle.getFileHandle().getNumberOfPages() << std::endl;
-
-
         free(page);
-        free(newPage);
-        free(splitKey);
-        free(rootPage);
-        free(dmPage);
+        return rc;
+    }
 
+    RC IndexManager::allocatePage(IXFileHandle &ixFileHandle, IndexHeader &header, const void *page,
+                                  PAGE_ID &pageID) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        if (header.freePageID == 0) {
+            pageID = fileHandle.getNumberOfPages();
+            return fileHandle.appendPage(page) == 0 ? 0 : -1; // append fail
+        }
+        const void *ref;
+        if (fileHandle.readPageRef(header.freePageID, ref) != 0) {
+            return -2; // read free page fail
+        }
+        PAGE_ID nextFreePage = ((const FreePageDir *) ref)->nextFreePage;
+        fileHandle.releasePageRef(header.freePageID);
+        if (fileHandle.writePage(header.freePageID, page) != 0) {
+            return -3; // write fail
+        }
+        pageID = header.freePageID;
+        header.freePageID = nextFreePage;
         return 0;
     }
 
-    RC IndexManager::insertEntry2NodeNSplit(IXFileHandle &ixFileHandle, PAGE_FLAG pageFlag, const Attribute &attribute, PAGE_ID pageID,
-                                            const void* key, const void *data, void *splitKey,
-                                            void *page, void *newPage, PAGE_ID &newPageID) {
-        int splitOffset, leftRecordNum;
-
-        if (getSplitKey(pageFlag, attribute, page, splitOffset, leftRecordNum, splitKey) != 0) {
-            return -1; // split key fail
+    RC IndexManager::freePage(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID pageID) {
+        auto *page = (char *) calloc(PAGE_SIZE, 1);
+        auto *dir = (FreePageDir *) page;
+        dir->flag = FREE_FLAG;
+        dir->nextFreePage = header.freePageID;
+        RC rc = ixFileHandle.getFileHandle().writePage(pageID, page);
+        free(page);
+        if (rc != 0) {
+            return -1; // write fail
         }
+        header.freePageID = pageID;
+        return 0;
+    }
 
-        if (redistributePage(pageFlag, attribute, leftRecordNum, splitOffset, page, newPage) != 0) {
-            return -2; // redistribute fail
+    RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
+        if (ixFileHandle.getFileHandle().getNumberOfPages() == 0) {
+            return createTree(ixFileHandle, attribute, key, rid);
         }
 
-        if (twoWayInsertEntry2Node(pageFlag, attribute, key, data, splitKey, page, newPage) != 0) {
-            return -3; // two way insert entry fail
+        IndexHeader header;
+        if (readHeader(ixFileHandle, header) != 0) {
+            return -1;
         }
-
-        if (ixFileHandle.getFileHandle().appendPage(newPage) == 0) {
-            newPageID = ixFileHandle.getFileHandle().getNumberOfPages() - 1;
-        } else {
-            return -4; // append fail
+        if (header.options & IX_HASH) {
+            return hashInsert(ixFileHandle, attribute, key, rid);
         }
-
-        // if leaf page, link the new page to the previous page
-        if (pageFlag == LEAF_FLAG) {
-            LeafDir leafDir;
-            memcpy(&leafDir, page, sizeof(LeafDir));
-            leafDir.nextLeafNode = newPageID;
-            memcpy(page, &leafDir, sizeof(LeafDir));
+        if (header.rootPageID == 0) {
+            return createTree(ixFileHandle, attribute, key, rid);
         }
 
-        if (ixFileHandle.getFileHandle().writePage(pageID, page) != 0) {
-            return -5; // write page back fail
+        IndexHeader oldHeader = header;
+        void *splitKey = malloc(PAGE_SIZE);
+        PAGE_ID splitData;
+        bool hasChildEntry = false;
+        RC rc = insertion(ixFileHandle, attribute, header, key, rid, header.rootPageID, splitKey, splitData,
+                          hasChildEntry);
+        if (rc == 0 && hasChildEntry) {
+            rc = pushUpRootNode(ixFileHandle, attribute, header, splitKey, splitData);
         }
-
-        return 0;
+        free(splitKey);
+        // a new root or pages taken from the free list
+        if (rc == 0 && memcmp(&header, &oldHeader, sizeof(IndexHeader)) != 0) {
+            rc = writeHeader(ixFileHandle, header) == 0 ? 0 : -3; // write dummy page fail
+        }
+        return rc;
     }
 
-    RC IndexManager::getSplitKey(PAGE_FLAG pageFlag, const Attribute &attribute, void *page, OFFSET &splitOffset, RECORD_NUM &leftRecordNum, void* splitKey) {
-        OFFSET dataOffset;
-        RECORD_NUM recordNum;
-        OFFSET dataSize;
-        FREE_SPACE freeSpace;
-
-        if (pageFlag == LEAF_FLAG) {
-            dataSize = sizeof(RID);
-            dataOffset = sizeof(LeafDir);
-
-            LeafDir leafDir;
-            memcpy(&leafDir, page, sizeof(LeafDir));
-            recordNum = leafDir.recordNum;
-            freeSpace = leafDir.freeSpace;
-        } else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            dataSize = sizeof(PAGE_ID);
-            dataOffset = sizeof(NodePageDir) + sizeof(PAGE_ID);
-
-            NodePageDir nodePageDir;
-            memcpy(&nodePageDir, page, sizeof(NodePageDir));
-            recordNum = nodePageDir.recordNum;
-            freeSpace = nodePageDir.freeSpace;
-        } else {
-            return -1; //undefined page flag
+    RC IndexManager::insertion(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                               const void *key, const RID &rid, PAGE_ID curPageID, void *splitKey,
+                               PAGE_ID &splitData, bool &hasChildEntry) {
+        void *page = malloc(PAGE_SIZE);
+        if (ixFileHandle.getFileHandle().readPage(curPageID, page) != 0) {
+            free(page);
+            return -1; // no page available for current page id
         }
 
-        switch (attribute.type) {
-            case TypeInt: {
-                splitOffset = dataOffset + (4 + dataSize) * (recordNum / 2);
-                leftRecordNum = recordNum / 2;
-                memcpy(splitKey, (char *)page + splitOffset, 4);
-                break;
-            }
-            case TypeReal: {
-                splitOffset = dataOffset + (4 + dataSize) * (recordNum / 2 - 1);
-                leftRecordNum = recordNum / 2 - 1;
-
-                float tempReal, nextReal;
-                while(true){
-                    memcpy(&tempReal, (char *)page + splitOffset, sizeof(float));
-                    memcpy(&nextReal, (char *)page + splitOffset + sizeof(float) + dataSize, sizeof(float));
-                    if(tempReal != nextReal){
-                        splitOffset += (sizeof(float) + dataSize);
-                        leftRecordNum++;
-                        break;
-                    }
-                    splitOffset += (sizeof(float) + dataSize);
-                    leftRecordNum++;
-                }
-
-                memcpy(splitKey, (char *)page + splitOffset, sizeof(float));
-                break;
+        RC rc;
+        if (dirOf(page)->flag == LEAF_FLAG) {
+            int slot = searchNode(attribute, page, key, true);
+            if (slot < dirOf(page)->recordNum && compareSlot(attribute, page, slot, key) == 0) {
+                rc = addPosting(ixFileHandle, attribute, header, curPageID, page, slot, key, rid, splitKey,
+                                splitData, hasChildEntry);
+            } else {
+                char data[sizeof(RID_NUM) + sizeof(RID)];
+                RID_NUM ridNum = 1;
+                memcpy(data, &ridNum, sizeof(RID_NUM));
+                memcpy(data + sizeof(RID_NUM), &rid, sizeof(RID));
+                rc = insertEntry2Node(ixFileHandle, attribute, header, curPageID, page, slot, key, data,
+                                      splitKey, splitData, hasChildEntry);
             }
-            case TypeVarChar: {
-                splitOffset = dataOffset;
-                OFFSET leftSpace;
-                OFFSET spaceThreshold = (PAGE_SIZE - freeSpace - dataOffset) / 2 + dataOffset;
-
-                int tempLength;
-
-                for (leftRecordNum = 0; leftRecordNum < recordNum; leftRecordNum++) {
-                    if (splitOffset >= spaceThreshold) {
-                        break;
-                    }
-
-                    memcpy(&tempLength, (char *)page + splitOffset, 4);
-                    splitOffset += (tempLength + 4 + dataSize);
-                }
-
-                int varCharLen;
-                memcpy(&varCharLen, (char *)page + splitOffset, 4);
-                memcpy(splitKey, (char *)page + splitOffset, 4 + varCharLen);
-
-                break;
+        } else if (dirOf(page)->flag == NONLEAF_FLAG) {
+            int slot = searchNode(attribute, page, key, false);
+            rc = insertion(ixFileHandle, attribute, header, key, rid, getChild(attribute, page, slot),
+                           splitKey, splitData, hasChildEntry);
+            if (rc == 0 && hasChildEntry) {
+                // the child split, its new sibling goes right after it
+                PAGE_ID childData = splitData;
+                rc = insertEntry2Node(ixFileHandle, attribute, header, curPageID, page, slot, splitKey,
+                                      &childData, splitKey, splitData, hasChildEntry);
             }
-            default:
-                break;
+        } else {
+            rc = -2; // undefined flag
         }
-        return 0;
-    }
-
 
-    RC IndexManager::redistributePage(PAGE_FLAG pageFlag, const Attribute &attribute, int leftRecordNum, OFFSET splitOffset, void *page, void *newPage) {
-        if (pageFlag == LEAF_FLAG) {
-            LeafDir leafDir;
-            memcpy(&leafDir, (char *) page, sizeof(LeafDir));
-
-            memcpy((char *)newPage + sizeof(LeafDir), (char *)page + splitOffset, PAGE_SIZE - leafDir.freeSpace - splitOffset);
-            memset((char *)page + splitOffset, 0, PAGE_SIZE - splitOffset);
-
-            LeafDir newLeafDir = {LEAF_FLAG,
-                                  static_cast<FREE_SPACE>(leafDir.freeSpace + splitOffset - sizeof(LeafDir)),
-                                  leafDir.recordNum - leftRecordNum,
-                                  leafDir.nextLeafNode};
-            leafDir.freeSpace = PAGE_SIZE - splitOffset;
-            leafDir.recordNum = leftRecordNum;
-
-            memcpy(page, &leafDir, sizeof(LeafDir));
-            memcpy(newPage, &newLeafDir, sizeof(LeafDir));
-        } else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            NodePageDir nodePageDir;
-            memcpy(&nodePageDir, (char *)page, sizeof(nodePageDir));
+        free(page);
+        return rc;
+    }
 
-            OFFSET splitKeyLen;
-            if (attribute.type == TypeVarChar) {
-                memcpy(&splitKeyLen, (char *)page + splitOffset, 4);
-                splitKeyLen += 4;
-            } else {
-                splitKeyLen = 4;
+    RC IndexManager::addPosting(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                                PAGE_ID pageID, void *page, int slot, const void *key, const RID &rid,
+                                void *splitKey, PAGE_ID &splitData, bool &hasChildEntry) {
+        const char *data = dataOf(attribute, page, slot);
+        RID_NUM ridNum;
+        memcpy(&ridNum, data, sizeof(RID_NUM));
+        hasChildEntry = false;
+        if (ridNum == 0) {
+            // the leaf only points at the list
+            PAGE_ID firstPage;
+            memcpy(&firstPage, data + sizeof(RID_NUM), sizeof(PAGE_ID));
+            return insertPosting(ixFileHandle, header, firstPage, rid);
+        }
+
+        std::vector<RID> rids(ridNum);
+        memcpy(rids.data(), data + sizeof(RID_NUM), ridNum * sizeof(RID));
+        rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+        std::vector<char> newData(sizeof(RID_NUM));
+        if (rids.size() > IX_MAX_INLINE_RIDS) {
+            PAGE_ID firstPage;
+            auto placePage = [&](const void *postingPage, PAGE_ID &pageID) {
+                return allocatePage(ixFileHandle, header, postingPage, pageID);
+            };
+            if (spillPostings(rids.data(), rids.size(), placePage, firstPage) != 0) {
+                return -3; // write posting pages fail
             }
-
-            memcpy((char *)newPage + sizeof(NodePageDir), (char *)page + splitOffset + splitKeyLen, PAGE_SIZE - nodePageDir.freeSpace - splitKeyLen - splitOffset);
-            memset((char *)page + splitOffset, 0, PAGE_SIZE - splitOffset);
-
-            NodePageDir newNodePageDir = {nodePageDir.flag,
-                                          static_cast<FREE_SPACE>(nodePageDir.freeSpace + splitOffset + splitKeyLen - sizeof(NodePageDir)),
-                                          nodePageDir.recordNum - leftRecordNum - 1};
-            nodePageDir.freeSpace = PAGE_SIZE - splitOffset;
-            nodePageDir.recordNum = leftRecordNum;
-
-            memcpy((char *)newPage, &newNodePageDir, sizeof(nodePageDir));
-            memcpy((char *)page, &nodePageDir, sizeof(nodePageDir));
+            ridNum = 0;
+            newData.insert(newData.end(), (const char *) &firstPage, (const char *) &firstPage + sizeof(PAGE_ID));
+        } else {
+            ridNum = rids.size();
+            newData.insert(newData.end(), (const char *) rids.data(), (const char *) (rids.data() + rids.size()));
         }
+        memcpy(newData.data(), &ridNum, sizeof(RID_NUM));
 
-        return 0;
+        // replace the entry, the longer one may not fit
+        deleteEntryFromNode(attribute, page, slot);
+        return insertEntry2Node(ixFileHandle, attribute, header, pageID, page, slot, key, newData.data(),
+                                splitKey, splitData, hasChildEntry);
     }
 
+    RC IndexManager::spillPostings(const RID *rids, int ridNum,
+                                   const std::function<RC(const void *, PAGE_ID &)> &placePage, PAGE_ID &firstPage) {
+        // from the last page back, each page knows where the next one went
+        auto *page = (char *) malloc(PAGE_SIZE);
+        firstPage = 0;
+        RC rc = 0;
+        for (int begin = (ridNum - 1) / POSTING_CAPACITY * POSTING_CAPACITY; begin >= 0 && rc == 0;
+             begin -= POSTING_CAPACITY) {
+            memset(page, 0, PAGE_SIZE);
+            auto *dir = (PostingDir *) page;
+            dir->flag = POSTING_FLAG;
+            dir->ridNum = std::min(POSTING_CAPACITY, ridNum - begin);
+            dir->nextPostingPage = firstPage;
+            memcpy(postingRids(page), rids + begin, dir->ridNum * sizeof(RID));
+            rc = placePage(page, firstPage);
+        }
+        free(page);
+        return rc;
+    }
 
-    RC IndexManager::twoWayInsertEntry2Node(PAGE_FLAG pageFlag, const Attribute &attribute, const void* key, const void* data, void* splitKey, void* page, void* newPage) {
-        switch (attribute.type) {
-            case TypeInt:{
-                int keyValue, splitValue;
-                memcpy(&keyValue, key, 4);
-                memcpy(&splitValue, (char *)splitKey, 4);
-
-                if (splitValue <= keyValue) {
-                    insertEntry2NodeCore(newPage, pageFlag, attribute, key, data);
-                } else {
-                    insertEntry2NodeCore(page, pageFlag, attribute, key, data);
-                }
-                break;
-            }
-            case TypeReal:{
-                float keyValue, splitValue;
-                memcpy(&keyValue, key, 4);
-                memcpy(&splitValue, (char *)splitKey, 4);
-
-                if (splitValue <= keyValue) {
-                    insertEntry2NodeCore(newPage, pageFlag, attribute, key, data);
-                } else {
-                    insertEntry2NodeCore(page, pageFlag, attribute, key, data);
-                }
-                break;
+    RC IndexManager::insertPosting(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID firstPage,
+                                   const RID &rid) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        // the first page whose last RID is not below rid, or the last page
+        PAGE_ID pageID = firstPage;
+        while (true) {
+            const void *ref;
+            if (fileHandle.readPageRef(pageID, ref) != 0) {
+                return -1; // read fail
             }
-            case TypeVarChar:{
-                int keyLength, splitLenght;
-                memcpy(&keyLength, key, 4);
-                memcpy(&splitLenght, (char *)splitKey, 4);
-
-                auto *keyValue = (char *)malloc(keyLength + 1);
-                auto *splitValue = (char *)malloc(splitLenght + 1);
-                memcpy(keyValue, (char *)key + 4, keyLength);
-                memcpy(splitValue, (char *)splitKey + 4, splitLenght);
-                keyValue[keyLength] = '\0';
-                splitValue[splitLenght] = '\0';
-
-                if(std::strcmp(splitValue, keyValue) <= 0) {
-                    insertEntry2NodeCore(newPage, pageFlag, attribute, key, data);
-                } else {
-                    insertEntry2NodeCore(page, pageFlag, attribute, key, data);
-                }
-
-                free(keyValue);
-                free(splitValue);
+            const auto *dir = (const PostingDir *) ref;
+            PAGE_ID nextPage = dir->nextPostingPage;
+            bool below = dir->ridNum > 0 && ridLess(postingRids(ref)[dir->ridNum - 1], rid);
+            fileHandle.releasePageRef(pageID);
+            if (nextPage == 0 || !below) {
                 break;
             }
-            default: {
-                return -1; // unknown attribute type
-            }
-        }
-        return 0;
-    }
-
-
-    RC IndexManager::pushUpRootNode(PAGE_ID pageID, PAGE_ID newPageID, const Attribute &attribute, const void *splitKey, void *rootPage) {
-        // NodePageDir rootPageDir = {ROOT_FLAG, PAGE_SIZE - sizeof(NodePageDir), 0};
-        NodePageDir rootPageDir = {ROOT_FLAG, PAGE_SIZE - sizeof(NodePageDir), 0};
-
-        memcpy((char *)rootPage + sizeof(NodePageDir), &pageID, sizeof(PAGE_ID));
-        rootPageDir.freeSpace -= sizeof(PAGE_ID);
-        memcpy((char *)rootPage, &rootPageDir, sizeof(NodePageDir));
-
-
-        if (insertEntry2NodeCore(rootPage, ROOT_FLAG, attribute, splitKey, &newPageID) != 0) {
-            return -1; // insert entry fail
+            pageID = nextPage;
         }
 
-        return 0;
-    }
-
-
-    RC IndexManager::splitRootNode(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const void* data, PAGE_ID oldRootPageID) {
-        void *oldRootPage = malloc(PAGE_SIZE);
-        void *newRootPage = malloc(PAGE_SIZE);
-        void *newNodePage = malloc(PAGE_SIZE);
-        void *splitRootKey = malloc(PAGE_SIZE);
-        memset(oldRootPage, 0, PAGE_SIZE);
-        memset(newRootPage, 0, PAGE_SIZE);
-        memset(newNodePage, 0, PAGE_SIZE);
-        memset(splitRootKey, 0, PAGE_SIZE);
-
-        if (ixFileHandle.getFileHandle().readPage(oldRootPageID, oldRootPage) != 0) {
-            return -1; // read old root page fail
-        }
-
-        // change the old root page to node page
-        NodePageDir nodePageDir;
-        memcpy(&nodePageDir, (char *)oldRootPage, sizeof(nodePageDir));
-        nodePageDir.flag = NONLEAF_FLAG;
-        memcpy((char *)oldRootPage, &nodePageDir, sizeof(nodePageDir));
-        ixFileHandle.getFileHandle().writePage(oldRootPageID, oldRootPage);
-
-        PAGE_ID newNodePageID;
-        if (insertEntry2NodeNSplit(ixFileHandle, NONLEAF_FLAG, attribute, oldRootPageID, key, data, splitRootKey, oldRootPage, newNodePage, newNodePageID) != 0){
-            // append page called
-            return -2; // split and insertion fail
-        }
-
-        // std::cout << "PAGE_ID newNodePageID" << newNodePageID << std::endl;
-
-        if (pushUpRootNode(oldRootPageID, newNodePageID, attribute, splitRootKey, newRootPage) != 0) {
-            return -3; // generate new root page fail
-        }
-
-        if (ixFileHandle.getFileHandle().appendPage(newRootPage) != 0) {
-            return -4; // append root page fail
-        }
-
-        PAGE_ID newRootPageID = ixFileHandle.getFileHandle().getNumberOfPages() - 1;
-
-        void *dmPage = malloc(PAGE_SIZE);
-        memset(dmPage, 0, PAGE_SIZE);
-        if (ixFileHandle.getFileHandle().readPage(0, dmPage) != 0) {
-            return -5; // read dummy page fail
+        auto *page = (char *) malloc(PAGE_SIZE);
+        if (fileHandle.readPage(pageID, page) != 0) {
+            free(page);
+            return -1;
         }
-        memcpy((char *)dmPage, &newRootPageID, sizeof(PAGE_ID));
-
-        if (ixFileHandle.getFileHandle().writePage(0, dmPage) != 0) {
-            return -7; // write dm page back fail
+        auto *dir = (PostingDir *) page;
+        RC rc = 0;
+        if (dir->ridNum == POSTING_CAPACITY) {
+            // the upper half moves to a new page linked after this one
+            auto *newPage = (char *) calloc(PAGE_SIZE, 1);
+            auto *newDir = (PostingDir *) newPage;
+            newDir->flag = POSTING_FLAG;
+            newDir->ridNum = dir->ridNum / 2;
+            newDir->nextPostingPage = dir->nextPostingPage;
+            dir->ridNum -= newDir->ridNum;
+            memcpy(postingRids(newPage), postingRids(page) + dir->ridNum, newDir->ridNum * sizeof(RID));
+
+            char *target = ridLess(rid, postingRids(newPage)[0]) ? page : newPage;
+            auto *targetDir = (PostingDir *) target;
+            RID *rids = postingRids(target);
+            int pos = std::upper_bound(rids, rids + targetDir->ridNum, rid, ridLess) - rids;
+            memmove(rids + pos + 1, rids + pos, (targetDir->ridNum - pos) * sizeof(RID));
+            rids[pos] = rid;
+            targetDir->ridNum++;
+            if (allocatePage(ixFileHandle, header, newPage, dir->nextPostingPage) != 0) {
+                rc = -2; // append fail
+            }
+            free(newPage);
+        } else {
+            RID *rids = postingRids(page);
+            int pos = std::upper_bound(rids, rids + dir->ridNum, rid, ridLess) - rids;
+            memmove(rids + pos + 1, rids + pos, (dir->ridNum - pos) * sizeof(RID));
+            rids[pos] = rid;
+            dir->ridNum++;
         }
-
-        free(oldRootPage);
-        free(newRootPage);
-        free(newNodePage);
-        free(splitRootKey);
-        free(dmPage);
-
-        return 0;
-    }
-
-
-    RC IndexManager::appendLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
-                                    const RID &rid) {
-        void *page = malloc(PAGE_SIZE);
-
-        LeafDir leafDir = {LEAF_FLAG, PAGE_SIZE - sizeof(LeafDir), 0, 0};
-        memset(page, 0, PAGE_SIZE);
-        memcpy(page, &leafDir, sizeof(LeafDir));
-
-        RC rc = insertEntry2NodeCore(page, LEAF_FLAG, attribute, key, &rid);
-        if (rc != 0) {
-            return rc;
+        if (rc == 0 && fileHandle.writePage(pageID, page) != 0) {
+            rc = -3; // write fail
         }
-
-
-        RC rc1 = ixFileHandle.getFileHandle().appendPage(page);
         free(page);
-
-        if (rc1 != 0) {
-            return rc1;
-        }
-        return 0;
+        return rc;
     }
 
-    RC IndexManager::chooseSubtree(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const PAGE_ID curNodePageID,
-                                   PAGE_ID &nextNodePageID){ //debug=11/24
-
-        auto * page = (char* )malloc(PAGE_SIZE);
-        ixFileHandle.getFileHandle().readPage(curNodePageID, page);
-
-        PAGE_FLAG thisflag;
-        memcpy(&thisflag, page, sizeof(char16_t));
+    RC IndexManager::deletePosting(IXFileHandle &ixFileHandle, IndexHeader &header, PAGE_ID &firstPage,
+                                   const RID &rid) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        PAGE_ID pageID = firstPage, prevPageID = 0;
+        while (true) {
+            const void *ref;
+            if (fileHandle.readPageRef(pageID, ref) != 0) {
+                return -1; // read fail
+            }
+            const auto *dir = (const PostingDir *) ref;
+            PAGE_ID nextPage = dir->nextPostingPage;
+            bool below = dir->ridNum > 0 && ridLess(postingRids(ref)[dir->ridNum - 1], rid);
+            fileHandle.releasePageRef(pageID);
+            if (!below) {
+                break;
+            }
+            if (nextPage == 0) {
+                return -3; // no such entry
+            }
+            prevPageID = pageID;
+            pageID = nextPage;
+        }
 
-        if(thisflag == LEAF_FLAG){
+        auto *page = (char *) malloc(PAGE_SIZE);
+        if (fileHandle.readPage(pageID, page) != 0) {
             free(page);
-            return 1;
+            return -1;
         }
-
-        NodePageDir thisDir;
-        memcpy(&thisDir, page, sizeof(NodePageDir));
-        RECORD_NUM numKeys = thisDir.recordNum;
-        OFFSET offset = sizeof(NodePageDir) + sizeof(PAGE_ID);  //  debug=11/24
-
-        if(key == NULL){
-            // return the first pointer
-            memcpy(&nextNodePageID, (char *)page + sizeof(NodePageDir), sizeof(PAGE_ID));
+        auto *dir = (PostingDir *) page;
+        RID *rids = postingRids(page);
+        int pos = std::lower_bound(rids, rids + dir->ridNum, rid, ridLess) - rids;
+        if (pos == dir->ridNum || rids[pos].pageNum != rid.pageNum || rids[pos].slotNum != rid.slotNum) {
             free(page);
-            return 0;
+            return -3; // no such entry
         }
+        memmove(rids + pos, rids + pos + 1, (dir->ridNum - pos - 1) * sizeof(RID));
+        dir->ridNum--;
 
-        switch (attribute.type) {
-            case TypeInt:{
-                int keyInt, tempInt;
-
-                memcpy(&keyInt, key, sizeof(int));
-
-                for(int idx = 0; idx < numKeys; idx++){
-                    memcpy(&tempInt, (char *)page + offset, sizeof(int));
-                    if(keyInt < tempInt){
-                        // get the left pointer if data if less than the tempData
-                        memcpy(&nextNodePageID, (char *)page + offset - sizeof(PAGE_ID), sizeof(PAGE_ID));
-                        free(page);
-                        return 0;
-                    }
-                    // key: 4B, ptr: 4B
-                    offset += (sizeof(int) + sizeof(PAGE_ID));
-                }
-                memcpy(&nextNodePageID, (char *)page+offset-sizeof(PAGE_ID), sizeof(PAGE_ID));
-                free(page);
-                return 0;
-            }
-            case TypeReal:{
-                float keyvalue;
-                memcpy(&keyvalue, key, sizeof(float));
-
-                float tempInteger;
-
-                for (int idx = 0; idx < numKeys; idx++) {
-                    memcpy(&tempInteger, (char *) page + offset, sizeof(float));
-                    if (keyvalue < tempInteger) { //
-                        memcpy(&nextNodePageID, (char *) page + offset - sizeof(PAGE_ID), sizeof(PAGE_ID));
-                        return 0;
-                    }
-                    offset += sizeof(float) + sizeof(PAGE_ID);  // key + rid pair
-                }
-                memcpy(&nextNodePageID, (char *) page + offset - sizeof(PAGE_ID), sizeof(PAGE_ID));
-                return 0;
+        RC rc;
+        if (dir->ridNum > 0) {
+            rc = fileHandle.writePage(pageID, page);
+        } else if (prevPageID == 0) {
+            // an empty page is dropped from the chain and freed
+            firstPage = dir->nextPostingPage;
+            rc = freePage(ixFileHandle, header, pageID);
+        } else {
+            PAGE_ID nextPage = dir->nextPostingPage;
+            rc = fileHandle.readPage(prevPageID, page);
+            if (rc == 0) {
+                dir->nextPostingPage = nextPage;
+                rc = fileHandle.writePage(prevPageID, page);
             }
-            case TypeVarChar:{
-                int keyVarcharLen;
-                memcpy(&keyVarcharLen, key, sizeof(int));
-                auto *keyVarchar = (char *) malloc(keyVarcharLen);
-                memcpy((char *) keyVarchar, (char *) key + sizeof(int), keyVarcharLen);
-
-                int tempVarcharLen;
-
-                for (int idx = 0; idx < numKeys; idx++) {
-                    memcpy(&tempVarcharLen, (char *) page + offset, sizeof(int));
-                    auto *tempVarchar = (char *) malloc(tempVarcharLen + 1);
-                    memcpy(tempVarchar, (char *) page + offset + sizeof(int), tempVarcharLen);
-                    tempVarchar[tempVarcharLen] = '\0';
-
-                    if (strcmp(tempVarchar, keyVarchar) > 0) {
-                        memcpy(&nextNodePageID, (char *) page + offset - sizeof(PAGE_ID), sizeof(PAGE_ID));
-                        return 0;
-                    }
-                    offset += sizeof(int) + tempVarcharLen + sizeof(PAGE_ID);
-                    free(tempVarchar);
-                }
-
-                free(keyVarchar);
-                memcpy(&nextNodePageID, (char *) page + offset - sizeof(PAGE_ID), sizeof(PAGE_ID));
-                return 0;
+            if (rc == 0) {
+                rc = freePage(ixFileHandle, header, pageID);
             }
         }
         free(page);
-        return 0;
+        return rc == 0 ? 0 : -2; // write fail
     }
 
-    RC IndexManager::deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
-        int recordId, offset;
-        PAGE_ID leafPageNum;
-        RID thisRid;
-        void* ptrLeafPage = malloc(PAGE_SIZE);
-
-        RC rc = searchStartingLeafPage(ixFileHandle, attribute, key, true,
-                                       leafPageNum, recordId, offset, ptrLeafPage);
-        if(rc != 0){
-            //todo error
-            return -1;
-        }
-
-        LeafDir thisLeafDir;
-        memcpy(&thisLeafDir, ptrLeafPage, sizeof(LeafDir));
-        int numRecds = thisLeafDir.recordNum;
+    RC IndexManager::insertEntry2Node(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                                      PAGE_ID pageID, void *page, int slot, const void *key, const void *data,
+                                      void *splitKey, PAGE_ID &splitData, bool &hasChildEntry) {
+        NodeDir *dir = dirOf(page);
+        unsigned entryLength = getKeyLength(attribute, key) - dir->prefixLength + dataLength(dir->flag, data);
+        // a key outside the prefix of a compressed leaf needs the leaf re-encoded
+        bool fitsPrefix = dir->prefixLength == 0 || (dir->recordNum > 0 && hasPrefix(page, key));
+        if (fitsPrefix && dir->freeSpace >= (FREE_SPACE) (entryLength + sizeof(KEY_SLOT))) {
+            hasChildEntry = false;
+            insertEntry2NodeCore(attribute, page, slot, key, data);
+            return ixFileHandle.getFileHandle().writePage(pageID, page);
+        }
+
+        return splitNode(ixFileHandle, attribute, header, pageID, page, slot, key, data, splitKey, splitData,
+                         hasChildEntry);
+    }
 
-        switch (attribute.type) {
+    void IndexManager::fillNode(const Attribute &attribute, void *page, const std::vector<const char *> &entries,
+                                int begin, int end, bool compressKeys) {
+        if (compressKeys && dirOf(page)->flag == LEAF_FLAG && begin < end) {
+            // sorted, so the first and last keys bound what all of them share
+            setPrefix(page, entries[begin] + sizeof(int), commonPrefix(entries[begin], entries[end - 1]));
+        }
+        for (int i = begin; i < end; i++) {
+            insertEntry2NodeCore(attribute, page, i - begin, entries[i], entries[i] + getKeyLength(attribute, entries[i]));
+        }
+    }
 
-            case TypeInt:{
-                int intKey, tempInt;
-                memcpy(&tempInt, (char*)ptrLeafPage + offset, sizeof(int));
-                memcpy(&intKey, (char*)key, sizeof(int));
-                memcpy(&thisRid, (char*)ptrLeafPage + offset + sizeof(int), sizeof(RID));
-
-                if(intKey == tempInt && rid.pageNum == thisRid.pageNum && rid.slotNum == thisRid.slotNum){
-                    memmove((char*)ptrLeafPage+offset, (char*)ptrLeafPage + offset + sizeof(int)+ sizeof(RID), PAGE_SIZE - thisLeafDir.freeSpace - offset - (sizeof(int)+
-                                                                                                                                                             sizeof(RID)));
-                    thisLeafDir.freeSpace += (sizeof(int)+ sizeof(RID));
-                    thisLeafDir.recordNum -= 1;
-                    memcpy((char*)ptrLeafPage, &thisLeafDir, sizeof(LeafDir));
-                    ixFileHandle.getFileHandle().writePage(leafPageNum, ptrLeafPage);
-
-//                    std::cout << "deleteEntry -> Delete " << recordId << "'th entry inside " << pageNum << " RID is : " << rid.pageNum << "; " << rid.slotNum <<  std::endl;
-                    free(ptrLeafPage);
-                    return 0;
-                }
-                free(ptrLeafPage);
-                return -1;
+    RC IndexManager::splitNode(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                               PAGE_ID pageID, void *page, int slot, const void *key, const void *data,
+                               void *splitKey, PAGE_ID &newPageID, bool &hasChildEntry) {
+        NodeDir dir = *dirOf(page);
+        bool compressKeys = compressesKeys(header, attribute);
+        bool compressLeaf = compressKeys && dir.flag == LEAF_FLAG;
+
+        // all entries with their full keys in key order, the new one included
+        NodeEntries entries(attribute, dir.flag, compressLeaf);
+        entries.addSlots(page, 0, slot);
+        entries.add(key, data);
+        entries.addSlots(page, slot, dir.recordNum);
+        entries.seal();
+        int count = entries.size();
+
+        auto *newPage = (char *) malloc(PAGE_SIZE);
+        if (compressLeaf && entries.bytes(0, count) <= NODE_CAPACITY) {
+            // the new key only shortened the prefix
+            hasChildEntry = false;
+            initNode(page, LEAF_FLAG);
+            dirOf(page)->nextLeafNode = dir.nextLeafNode;
+            fillNode(attribute, page, entries.entries, 0, count, true);
+            free(newPage);
+            return ixFileHandle.getFileHandle().writePage(pageID, page);
+        }
+        hasChildEntry = true;
+
+        int split = entries.balancedSplit();
+        if (split == -1) {
+            free(newPage);
+            return -1; // entries too large to split
+        }
+
+        initNode(page, dir.flag);
+        initNode(newPage, dir.flag);
+        int rightBegin = split;
+        if (dir.flag == LEAF_FLAG) {
+            dirOf(newPage)->nextLeafNode = dir.nextLeafNode;
+            if (compressKeys) {
+                // anything above the last left key and up to the first right key separates them
+                shortestSeparator(entries.entries[split - 1], entries.entries[split], (char *) splitKey);
+            } else {
+                memcpy(splitKey, entries.entries[split], getKeyLength(attribute, entries.entries[split]));
             }
-            case TypeReal:{
-
-                float realKey, tempReal;
-                memcpy(&tempReal, (char*)ptrLeafPage + offset, sizeof(int));
-                memcpy(&realKey, (char*)key, sizeof(int));
-                memcpy(&thisRid, (char*)ptrLeafPage + offset + sizeof(int), sizeof(RID));
-
-                if(realKey == tempReal && rid.pageNum == thisRid.pageNum && rid.slotNum == thisRid.slotNum){
-                    memmove((char*)ptrLeafPage + offset, (char*)ptrLeafPage + offset + sizeof(float)+ sizeof(RID), PAGE_SIZE - thisLeafDir.freeSpace - offset - (sizeof(float)+
-                                                                                                                                                                 sizeof(RID)));
-                    thisLeafDir.freeSpace += (sizeof(float)+ sizeof(RID));
-                    thisLeafDir.recordNum -= 1;
-                    memcpy((char*)ptrLeafPage, &thisLeafDir, sizeof(LeafDir));
-                    ixFileHandle.getFileHandle().writePage(leafPageNum, ptrLeafPage);
-
-//                    std::cout << "deleteEntry -> Delete " << recordId << "'th entry inside " << pageNum << " RID is : " << rid.pageNum << "; " << rid.slotNum <<  std::endl;
-                    free(ptrLeafPage);
-                    return 0;
-                }
-                free(ptrLeafPage);
-                return -1;
+        } else {
+            // the middle key moves up, its child becomes the leftmost child on the right
+            unsigned splitKeyLength = getKeyLength(attribute, entries.entries[split]);
+            memcpy(splitKey, entries.entries[split], splitKeyLength);
+            dirOf(page)->firstChild = dir.firstChild;
+            memcpy(&dirOf(newPage)->firstChild, entries.entries[split] + splitKeyLength, sizeof(PAGE_ID));
+            rightBegin = split + 1;
+        }
+        fillNode(attribute, page, entries.entries, 0, split, compressLeaf);
+        fillNode(attribute, newPage, entries.entries, rightBegin, count, compressLeaf);
+
+        RC rc = 0;
+        if (allocatePage(ixFileHandle, header, newPage, newPageID) != 0) {
+            rc = -2; // append fail
+        } else {
+            if (dir.flag == LEAF_FLAG) {
+                dirOf(page)->nextLeafNode = newPageID;
             }
-            case TypeVarChar:{
-                int keyVachaLen;
-                memcpy(&keyVachaLen, (char*)key, sizeof(int));
-                auto* keyVacha = (char*)malloc(keyVachaLen);
-                memcpy(keyVacha, (char*)key + sizeof(int), keyVachaLen+1);
-                keyVacha[keyVachaLen] = '\0';
-
-                int thisVachaLen;
-                memcpy(&thisVachaLen, (char*)ptrLeafPage + offset, sizeof(int));
-                auto* thisVacha = (char*)malloc(thisVachaLen);
-                memcpy(thisVacha, (char*)ptrLeafPage + sizeof(int), thisVachaLen);
-                thisVacha[thisVachaLen] = '\0';
-
-                memcpy(&thisRid, (char*)ptrLeafPage + offset + sizeof(int) + thisVachaLen, sizeof(RID));
-
-                if(strcmp(keyVacha, thisVacha) == 0 && rid.pageNum == thisRid.pageNum && rid.slotNum == thisRid.slotNum) {
-                    memmove((char*)ptrLeafPage + offset, (char*)ptrLeafPage + offset + sizeof(int) + thisVachaLen + sizeof(RID), PAGE_SIZE - thisLeafDir.freeSpace - offset - (sizeof(int) + thisVachaLen +
-                                                                                                                                                                               sizeof(RID)));
-                    thisLeafDir.freeSpace += (sizeof(int) + thisVachaLen + sizeof(RID));
-                    thisLeafDir.recordNum -= 1;
-                    memcpy((char*)ptrLeafPage, &thisLeafDir, sizeof(LeafDir));
-                    ixFileHandle.getFileHandle().writePage(leafPageNum, ptrLeafPage);
-
-                    // std::cout << "deleteEntry -> Delete " << recordId << "'th entry inside " << pageNum << std::endl;
-                    free(keyVacha);
-                    free(thisVacha);
-                    free(ptrLeafPage);
-                    return 0;
-                }
-                free(keyVacha);
-                free(thisVacha);
-                free(ptrLeafPage);
-                return -1;
+            if (ixFileHandle.getFileHandle().writePage(pageID, page) != 0) {
+                rc = -3; // write page back fail
             }
-
         }
 
-
+        free(newPage);
+        return rc;
     }
 
+    RC IndexManager::pushUpRootNode(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                                    const void *splitKey, PAGE_ID newPageID) {
+        void *rootPage = malloc(PAGE_SIZE);
+        initNode(rootPage, NONLEAF_FLAG);
+        dirOf(rootPage)->firstChild = header.rootPageID;
+        insertEntry2NodeCore(attribute, rootPage, 0, splitKey, &newPageID);
 
-    RC IndexManager::scan(IXFileHandle &ixFileHandle,
-                          const Attribute &attribute,
-                          const void *lowKey,
-                          const void *highKey,
-                          bool lowKeyInclusive,
-                          bool highKeyInclusive,
-                          IX_ScanIterator &ix_ScanIterator) {
-
-        int numPages = ixFileHandle.getFileHandle().getNumberOfPages();
-        if(numPages == 0){
-            // this ixFileHandle didi not open any file
-            std::cout << "this ixFileHandle did not open any file [IndexManager::scan]" << std::endl;
-            return -1;
-        }
-
-        // search for the starting entry
-
-        PAGE_ID curLeafPage = 0;
-        int curRecordId = -1;
-        int curOffset = -1;
-
-        void* ptr_curLeafPage = malloc(PAGE_SIZE);
-
-        RC rc = searchStartingLeafPage(ixFileHandle, attribute, lowKey, lowKeyInclusive,
-                                       curLeafPage, curRecordId, curOffset, ptr_curLeafPage);
-//        if(rc != 0)
-//            return -1;  // update 12/8
-
-
-        ix_ScanIterator.init_IXScanIterator(ixFileHandle, attribute,
-                                            lowKey, highKey,  lowKeyInclusive, highKeyInclusive,
-                                            curLeafPage, curRecordId, curOffset, ptr_curLeafPage);
-
-        free(ptr_curLeafPage);
-
-        return 0;
+        RC rc = allocatePage(ixFileHandle, header, rootPage, header.rootPageID);
+        free(rootPage);
+        return rc == 0 ? 0 : -1; // append root page fail
     }
 
-
-    RC IndexManager::searchStartingLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *lowKey,
-                                            bool lowKeyInclusive,
-                                            PAGE_ID &curLeafPage, int &curRecordId, int &curOffset, void* ptr_curLeafPage) {
-        // before getNextEntry, find the first entry satisfying the condition
-
+    RC IndexManager::bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute, IX_BulkSource &source,
+                              float fillFactor) {
         FileHandle &fileHandle = ixFileHandle.getFileHandle();
-        unsigned numPages = fileHandle.getNumberOfPages();
-
-        if (numPages == 0) {
-            std::cout << "no page to read [IndexManager::searchStartingLeafPage]" << std::endl;
+        IndexHeader header = {0, 0, 0, 0};
+        bool hasHeader = fileHandle.getNumberOfPages() > 0;
+        if (hasHeader && readHeader(ixFileHandle, header) != 0) {
             return -1;
         }
-        // if numPages is not 0, so there should be at least 2 pages (dummy head page and root-leaf page)
-
-        //find the page id of root page, page id of root should be stored in the page whose id is 0
-        void *page = malloc(PAGE_SIZE);
-        int rootPageId = -1;
-        fileHandle.readPage(0, page);
-        memcpy(&rootPageId, page, sizeof(int));
-        free(page);
-
-        if (numPages == 2) {
-            // leaf page and root page is same page
-            RC rc = searchKeyInLeafPage(fileHandle, attribute, lowKey, lowKeyInclusive,
-                                        rootPageId, curRecordId, curOffset, ptr_curLeafPage);
-            curLeafPage = rootPageId;
-            if (rc != 0) {
-                return -1;
+        if (header.options & IX_HASH) {
+            // a hash index takes the entries one by one, their order is no help to it
+            auto *key = (char *) malloc(PAGE_SIZE);
+            RID rid;
+            RC rc;
+            while ((rc = source.getNextEntry(key, rid)) == 0) {
+                if (hashInsert(ixFileHandle, attribute, key, rid) != 0) {
+                    break;
+                }
             }
-            return 0;
+            free(key);
+            return rc == IX_EOF ? 0 : -3; // insert fail
+        }
+        if (hasHeader && (fileHandle.getNumberOfPages() > 1 || header.rootPageID != 0)) {
+            return -1; // only into an empty index
+        }
+        if (fillFactor <= 0 || fillFactor > 1) {
+            return -2; // bad fill factor
         }
 
-        // start from root, search and find the leaf node
-        int tmpPageId = rootPageId;
-        auto *tmpPage = (char *) malloc(PAGE_SIZE);
-        int nextPageId;
-
-        while (true) {
-            RC rc = fileHandle.readPage(tmpPageId, tmpPage);
-            if(rc != 0)
-                return -1;
-            PAGE_FLAG tmpFlag;
-            RECORD_NUM numRecords;
-            // here we need to keep same format of dir for three tyoes of nodes
-            NodePageDir tmpDir; int tempsiz = sizeof(NodePageDir);
-
-            memcpy(&tmpDir, tmpPage, sizeof(NodePageDir));
-            tmpFlag = tmpDir.flag;
-            numRecords = tmpDir.recordNum;
-            //memcpy(&tmpFlag, tmpPage, sizeof(PAGE_FLAG));
-
-            // std::cout << "tmpFlag: " << tmpFlag << std::endl;
-
-
-//            if(tmpFlag != LEAF_FLAG){
-//                NodePageDir tmpDir;
-//                memcpy(&tmpDir, tmpPage, sizeof(NodePageDir));
-//                numRecords = tmpDir.recordNum;
-//            }
-
-
-            if (tmpFlag == LEAF_FLAG) {
-                // we find the leaf node, break
-                break;
+        // dummy head page, pointed at the root once it is known
+        if (!hasHeader) {
+            auto *page = (char *) calloc(PAGE_SIZE, 1);
+            RC rc = fileHandle.appendPage(page);
+            free(page);
+            if (rc != 0) {
+                return -4; // append fail
             }
-
-            findNextTempPageId(attribute, tmpPage, tmpPageId, numRecords,
-                               lowKey,
-                               nextPageId);
-
-            tmpPageId = nextPageId;
-
         }
-
-        RC rc = searchKeyInLeafPage(fileHandle, attribute, lowKey, lowKeyInclusive,
-                                    tmpPageId, curRecordId, curOffset, ptr_curLeafPage);
-        curLeafPage = tmpPageId;
-        if (rc != 0) {
-            return -1;
+        // the tree is written page after page, grow the file in large extents meanwhile
+        unsigned extentPages = fileHandle.getExtentSize();
+        if (extentPages < BULK_EXTENT_PAGES) {
+            fileHandle.setExtentSize(BULK_EXTENT_PAGES);
         }
-        return 0;
-
+        PAGE_ID endPage;
+        RC rc = buildTree(ixFileHandle, attribute, header, source, fillFactor, 1, endPage);
+        fileHandle.setExtentSize(extentPages);
+        if (rc == 0 && writeHeader(ixFileHandle, header) != 0) {
+            rc = -7; // write dummy page fail
+        }
+        return rc;
     }
 
-    RC IndexManager::searchKeyInLeafPage(FileHandle &fileHandle, const Attribute &attribute, const void *key, const bool lowKeyInclusive,
-                                         int &leafPageId, int &leafRecordId, int &curOffset, void* ptr_curLeafPage) {
-
-        auto *page = (char*)malloc(PAGE_SIZE);
-        fileHandle.readPage(leafPageId, page);
-
-        memcpy((char*)ptr_curLeafPage, page, PAGE_SIZE);
-
-        LeafDir thisLeafDir;
-        memcpy(&thisLeafDir, page, sizeof(LeafDir));
-        if (thisLeafDir.flag != LEAF_FLAG) {
-            return -1;
+    RC IndexManager::compact(IXFileHandle &ixFileHandle, const Attribute &attribute, float fillFactor) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        IndexHeader header;
+        if (fileHandle.getNumberOfPages() == 0 || readHeader(ixFileHandle, header) != 0) {
+            return -1; // empty index
+        }
+        if (header.options & IX_HASH) {
+            return hashCompact(ixFileHandle, attribute);
+        }
+        if (fillFactor <= 0 || fillFactor > 1) {
+            return -2; // bad fill factor
+        }
+
+        // the entries are set aside first, the new tree overwrites the pages they are read from
+        IX_KeySorter sorter(attribute);
+        RC rc = IX_EOF;
+        if (header.rootPageID != 0) {
+            IX_ScanIterator iterator;
+            auto *key = (char *) malloc(PAGE_SIZE);
+            RID rid;
+            rc = scan(ixFileHandle, attribute, NULL, NULL, true, true, iterator);
+            while (rc == 0 && (rc = iterator.getNextEntry(rid, key)) == 0) {
+                rc = sorter.addEntry(key, rid);
+            }
+            iterator.close();
+            free(key);
         }
-
-        int numRecords = thisLeafDir.recordNum;
-        int offset = sizeof(LeafDir);
-
-        if(key == NULL){
-            leafRecordId = 0;
-            curOffset = offset;
-            free(page);
-            return 0;
+        if (rc != IX_EOF || sorter.finish() != 0) {
+            return -3; // read entries fail
         }
 
-        switch (attribute.type) {
-            case TypeInt: {
-
-                int keyvalue = 0;
-                int tempInteger;
+        // the tree is built from page 1 on; what is left past it is freed lowest first, for reuse in that order
+        PAGE_ID pageNum = fileHandle.getNumberOfPages(), endPage;
+        header.rootPageID = 0;
+        header.freePageID = 0;
+        header.version++;
+        rc = buildTree(ixFileHandle, attribute, header, sorter, fillFactor, 1, endPage);
+        for (PAGE_ID pageID = pageNum; rc == 0 && pageID-- > endPage;) {
+            rc = freePage(ixFileHandle, header, pageID);
+        }
+        if (rc == 0 && writeHeader(ixFileHandle, header) != 0) {
+            rc = -7; // write dummy page fail
+        }
+        return rc;
+    }
 
-                memcpy(&keyvalue, key, sizeof(int));
+    RC IndexManager::buildTree(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                               IX_BulkSource &source, float fillFactor, PAGE_ID firstPage, PAGE_ID &endPage) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        bool compressKeys = compressesKeys(header, attribute);
+        FREE_SPACE capacity = NODE_CAPACITY;
+        auto fillLimit = (FREE_SPACE) (capacity * fillFactor);
+
+        // pages take the ids from firstPage on in the order they are written
+        endPage = firstPage;
+        auto placePage = [&](const void *page, PAGE_ID &pageID) {
+            pageID = endPage++;
+            return pageID < fileHandle.getNumberOfPages() ? fileHandle.writePage(pageID, page)
+                                                           : fileHandle.appendPage(page);
+        };
+
+        auto *key = (char *) malloc(PAGE_SIZE);
+        RID rid;
+        RC rc = source.getNextEntry(key, rid);
+        if (rc != 0) {
+            free(key);
+            header.rootPageID = 0;
+            return rc == IX_EOF ? 0 : -3;
+        }
+        auto *page = (char *) malloc(PAGE_SIZE);
+        auto *lastKey = (char *) malloc(PAGE_SIZE);
+
+        // the level being built: its pages, and the separator left of each page but the first
+        std::vector<PAGE_ID> children;
+        std::vector<char> separators;
+        std::vector<unsigned> separatorOffsets;
+
+        // Leaves are written in key order. The leaf being filled is kept as full entries since its prefix
+        // shrinks as keys are added; the previous leaf is relinked when posting pages were written after it.
+        std::vector<char> leafEntries;
+        std::vector<unsigned> leafOffsets;
+        FREE_SPACE leafBytes = 0;
+        auto *prevLeaf = (char *) malloc(PAGE_SIZE);
+        auto appendLeaf = [&](bool last) {
+            PAGE_ID leafPageID = endPage;
+            if (!children.empty() && dirOf(prevLeaf)->nextLeafNode != leafPageID) {
+                dirOf(prevLeaf)->nextLeafNode = leafPageID;
+                if (fileHandle.writePage(children.back(), prevLeaf) != 0) {
+                    return -4;
+                }
+            }
+            std::vector<const char *> entries;
+            for (unsigned offset : leafOffsets) {
+                entries.push_back(leafEntries.data() + offset);
+            }
+            initNode(page, LEAF_FLAG);
+            dirOf(page)->nextLeafNode = last ? 0 : leafPageID + 1;
+            fillNode(attribute, page, entries, 0, entries.size(), compressKeys);
+            children.push_back(leafPageID);
+            memcpy(prevLeaf, page, PAGE_SIZE);
+            return placePage(page, leafPageID) == 0 ? 0 : -4;
+        };
+
+        // equal keys make one entry holding their RIDs
+        auto *groupKey = (char *) malloc(PAGE_SIZE);
+        std::vector<RID> rids;
+        std::vector<char> data;
+        auto addEntry = [&]() {
+            std::sort(rids.begin(), rids.end(), ridLess);
+            RID_NUM ridNum = 0;
+            data.assign(sizeof(RID_NUM), 0);
+            if (rids.size() > IX_MAX_INLINE_RIDS) {
+                PAGE_ID firstPage;
+                if (spillPostings(rids.data(), rids.size(), placePage, firstPage) != 0) {
+                    return -4;
+                }
+                data.insert(data.end(), (const char *) &firstPage, (const char *) &firstPage + sizeof(PAGE_ID));
+            } else {
+                ridNum = rids.size();
+                data.insert(data.end(), (const char *) rids.data(), (const char *) (rids.data() + rids.size()));
+            }
+            memcpy(data.data(), &ridNum, sizeof(RID_NUM));
 
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempInteger, (char *) page + offset, sizeof(int));
-                    if ((lowKeyInclusive == false && keyvalue < tempInteger) || (lowKeyInclusive == true && keyvalue <= tempInteger)) {
-                        leafRecordId = idx;
-                        curOffset = offset;
-                        free(page);
-                        return 0;
+            unsigned keyLength = getKeyLength(attribute, groupKey);
+            FREE_SPACE entryLength = keyLength + data.size() + sizeof(KEY_SLOT);
+            if (entryLength > capacity) {
+                return -5; // key too large
+            }
+            if (!leafOffsets.empty()) {
+                // sorted, so the leaf would share what its first key and this one share
+                FREE_SPACE shared = compressKeys ? leafOffsets.size() * commonPrefix(leafEntries.data(), groupKey) : 0;
+                if (leafBytes + entryLength - shared > fillLimit) {
+                    if (appendLeaf(false) != 0) {
+                        return -4;
                     }
-                    offset += sizeof(int) + sizeof(RID);  // key + rid pair
+                    separatorOffsets.push_back(separators.size());
+                    separators.resize(separators.size() + keyLength);
+                    if (compressKeys) {
+                        unsigned separatorLength = shortestSeparator(lastKey, groupKey,
+                                                                     separators.data() + separatorOffsets.back());
+                        separators.resize(separatorOffsets.back() + separatorLength);
+                    } else {
+                        memcpy(separators.data() + separatorOffsets.back(), groupKey, keyLength);
+                    }
+                    leafEntries.clear();
+                    leafOffsets.clear();
+                    leafBytes = 0;
                 }
-
-                break;
             }
-            case TypeReal: {
-
-                float keyvalue = 0.0;
-                memcpy(&keyvalue, key, sizeof(float));
-
-                float tempInteger;
-
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempInteger, (char *) page + offset, sizeof(float));
-                    if ((lowKeyInclusive == false && keyvalue < tempInteger) ||
-                        (lowKeyInclusive == true && keyvalue <= tempInteger)) {
-                        curOffset = offset;
+            leafOffsets.push_back(leafEntries.size());
+            leafEntries.insert(leafEntries.end(), groupKey, groupKey + keyLength);
+            leafEntries.insert(leafEntries.end(), data.begin(), data.end());
+            leafBytes += entryLength;
+            memcpy(lastKey, groupKey, keyLength);
+            return 0;
+        };
 
-                        leafRecordId = idx;
-                        free(page);
-                        return 0;
+        while (rc == 0) {
+            if (!rids.empty()) {
+                int cmp = compareKey(attribute, groupKey, key);
+                if (cmp > 0) {
+                    rc = -6; // source not sorted
+                    break;
+                }
+                if (cmp < 0) {
+                    if ((rc = addEntry()) != 0) {
+                        break;
                     }
-                    offset += sizeof(float) + sizeof(RID);  // key + rid pair
+                    rids.clear();
+                }
+            }
+            if (rids.empty()) {
+                memcpy(groupKey, key, getKeyLength(attribute, key));
+            }
+            rids.push_back(rid);
+            rc = source.getNextEntry(key, rid);
+        }
+        if (rc == IX_EOF) {
+            rc = addEntry();
+            if (rc == 0) {
+                rc = appendLeaf(true);
+            }
+        }
+        free(prevLeaf);
+        free(groupKey);
+
+        // internal levels bottom-up, a separator that does not fit moves up and its child starts the next node
+        while (rc == 0 && children.size() > 1) {
+            auto entryLength = [&](unsigned child) {
+                return (FREE_SPACE) (getKeyLength(attribute, separators.data() + separatorOffsets[child - 1]) +
+                                     sizeof(PAGE_ID) + sizeof(KEY_SLOT));
+            };
+            std::vector<unsigned> firstChildren(1, 0);
+            FREE_SPACE used = 0;
+            for (unsigned i = 1; i < children.size(); i++) {
+                if (i - firstChildren.back() > 1 && used + entryLength(i) > fillLimit) {
+                    firstChildren.push_back(i);
+                    used = 0;
+                } else {
+                    used += entryLength(i);
+                }
+            }
+            // a last node of one child would have no separator: it takes the upper half of the node before,
+            // or joins it when that one has a single key
+            if (firstChildren.size() > 1 && firstChildren.back() == children.size() - 1) {
+                unsigned previous = firstChildren[firstChildren.size() - 2];
+                if (children.size() - previous >= 4) {
+                    firstChildren.back() = previous + (children.size() - previous) / 2;
+                } else {
+                    firstChildren.pop_back();
                 }
-
-                break;
             }
-            case TypeVarChar: {
-
-                int keyVarcharLen = 0;
-                memcpy(&keyVarcharLen, key, sizeof(int));
-                auto *keyVarchar = (char *) malloc(keyVarcharLen);
-                memcpy((char *) keyVarchar, (char *) key + sizeof(int), keyVarcharLen);
-
-                int tempVarcharLen;
-
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempVarcharLen, (char *) page + offset, sizeof(int));
-                    auto *tempVarchar = (char *) malloc(tempVarcharLen + 1);
-                    memcpy(tempVarchar, (char *) page + offset + sizeof(int), tempVarcharLen);
-                    tempVarchar[tempVarcharLen] = '\0';
-
-                    if ((lowKeyInclusive == false && strcmp(tempVarchar, keyVarchar) > 0) ||
-                        (lowKeyInclusive == true && strcmp(tempVarchar, keyVarchar) >= 0)) {
-                        curOffset = offset;
-                        leafRecordId = idx;
-                        free(page);
-                        free(keyVarchar);
-                        free(tempVarchar);
-                        return 0;
-                    }
 
-                    offset += sizeof(int) + tempVarcharLen + sizeof(RID);
-                    free(tempVarchar);
+            std::vector<PAGE_ID> parents;
+            std::vector<char> parentSeparators;
+            std::vector<unsigned> parentSeparatorOffsets;
+            for (unsigned node = 0; node < firstChildren.size() && rc == 0; node++) {
+                unsigned end = node + 1 < firstChildren.size() ? firstChildren[node + 1] : children.size();
+                initNode(page, NONLEAF_FLAG);
+                dirOf(page)->firstChild = children[firstChildren[node]];
+                for (unsigned i = firstChildren[node] + 1; i < end; i++) {
+                    insertEntry2NodeCore(attribute, page, dirOf(page)->recordNum,
+                                         separators.data() + separatorOffsets[i - 1], &children[i]);
+                }
+                PAGE_ID pageID;
+                if (placePage(page, pageID) != 0) {
+                    rc = -4;
+                }
+                parents.push_back(pageID);
+                if (end < children.size()) {
+                    const char *separator = separators.data() + separatorOffsets[end - 1];
+                    parentSeparatorOffsets.push_back(parentSeparators.size());
+                    parentSeparators.insert(parentSeparators.end(), separator,
+                                            separator + getKeyLength(attribute, separator));
                 }
-
-                free(keyVarchar);
-                break;
             }
-            default:
-                break;
+            children.swap(parents);
+            separators.swap(parentSeparators);
+            separatorOffsets.swap(parentSeparatorOffsets);
+        }
 
+        if (rc == 0) {
+            header.rootPageID = children[0];
         }
 
         free(page);
-        return -1;
-
+        free(key);
+        free(lastKey);
+        return rc;
     }
 
-
-    RC IndexManager::findNextTempPageId(const Attribute &attribute, const void *thisPage, const int tmpPageId,
-                                        const RECORD_NUM numRecords,
-                                        const void *key,
-                                        int &nextPageId) {
-
-        int offset =
-                sizeof(NodePageDir) + sizeof(PAGE_ID);  // dir(12 Byte) | pointer1(4 Byte) | key1(4 Byte) | pointer2(4 Byte) | .......
-
-        if (key == NULL) {
-            // no key
-            memcpy(&nextPageId, (char *) thisPage + sizeof(NodePageDir), sizeof(PAGE_ID));
-            return 0;
+    RC IndexManager::searchLeafPage(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                                              PAGE_ID &leafPageID, void *leafPage, unsigned &version, void *parentPage,
+                                    int *childSlot, const IndexHeader *knownHeader) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        IndexHeader header;
+        if (knownHeader != nullptr) {
+            header = *knownHeader;
+        } else if (readHeader(ixFileHandle, header) != 0) {
+            return -1;
+        }
+        version = header.version;
+        if (header.rootPageID == 0) {
+            return IX_EOF; // no entry yet
+        }
+        PAGE_ID pageID = header.rootPageID;
+        if (childSlot != nullptr) {
+            *childSlot = -1;
         }
 
-        switch (attribute.type) {
-            case TypeInt: {
-                int keyvalue;
-                memcpy(&keyvalue, key, sizeof(int));
-
-                int tempInteger;
-
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempInteger, (char *) thisPage + offset, sizeof(int));
-                    if (keyvalue < tempInteger) {
-                        // bigger than or equal to
-                        memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned)); // take left pointer
-                        return 0;
-                    }
-                    offset += sizeof(int) + sizeof(unsigned);  // key + rid pair
-                }
-                memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned));
+        while (true) {
+            const void *page;
+            if (fileHandle.readPageRef(pageID, page) != 0) {
+                return -1; // read fail
+            }
+            PAGE_FLAG pageFlag = dirOf(page)->flag;
+            if (pageFlag == LEAF_FLAG) {
+                memcpy(leafPage, page, PAGE_SIZE);
+                fileHandle.releasePageRef(pageID);
+                leafPageID = pageID;
                 return 0;
             }
-            case TypeReal: {
+            if (pageFlag != NONLEAF_FLAG) {
+                fileHandle.releasePageRef(pageID);
+                return -2; // undefined flag
+            }
+            // keys are unique, a key equal to a separator lives right of it
+            int slot = key == NULL ? 0 : searchNode(attribute, page, key, false);
+            PAGE_ID nextPageID = getChild(attribute, page, slot);
+            if (parentPage != nullptr) {
+                memcpy(parentPage, page, PAGE_SIZE);
+                *childSlot = slot;
+            }
+            fileHandle.releasePageRef(pageID);
+            pageID = nextPageID;
+        }
+    }
 
-                float keyvalue;
-                memcpy(&keyvalue, key, sizeof(float));
+    RC IndexManager::deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
+        if (ixFileHandle.getFileHandle().getNumberOfPages() == 0) {
+            return -1; // empty index
+        }
 
-                float tempInteger;
+        IndexHeader header;
+        if (readHeader(ixFileHandle, header) != 0) {
+            return -2; // search fail
+        }
+        if (header.options & IX_HASH) {
+            return hashDelete(ixFileHandle, attribute, key, rid);
+        }
+        if (header.rootPageID == 0) {
+            return -3; // no such entry
+        }
+        IndexHeader oldHeader = header;
+        bool underflow;
+        RC rc = deletion(ixFileHandle, attribute, header, key, rid, header.rootPageID, underflow);
+        // a collapsed root or pages moved to the free list
+        if (rc == 0 && memcmp(&header, &oldHeader, sizeof(IndexHeader)) != 0) {
+            rc = writeHeader(ixFileHandle, header) == 0 ? 0 : -4; // write dummy page fail
+        }
+        return rc;
+    }
 
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempInteger, (char *) thisPage + offset, sizeof(float));
-                    if (keyvalue < tempInteger) {
-                        memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned));
-                        return 0;
-                    }
-                    offset += sizeof(float) + sizeof(unsigned);  // key + rid pair
+    RC IndexManager::deletion(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                              const void *key, const RID &rid, PAGE_ID curPageID, bool &underflow) {
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        underflow = false;
+        void *page = malloc(PAGE_SIZE);
+        if (fileHandle.readPage(curPageID, page) != 0) {
+            free(page);
+            return -2; // search fail
+        }
+
+        RC rc = 0;
+        if (dirOf(page)->flag == NONLEAF_FLAG) {
+            int slot = searchNode(attribute, page, key, false);
+            bool childUnderflow;
+            rc = deletion(ixFileHandle, attribute, header, key, rid, getChild(attribute, page, slot), childUnderflow);
+            if (rc == 0 && childUnderflow) {
+                rc = fixUnderflow(ixFileHandle, attribute, header, page, slot);
+                if (rc == 0 && curPageID == header.rootPageID && dirOf(page)->recordNum == 0) {
+                    // the root merged its last two children, the merged node becomes the root
+                    header.rootPageID = dirOf(page)->firstChild;
+                    rc = freePage(ixFileHandle, header, curPageID);
+                } else if (rc == 0) {
+                    underflow = isUnderfull(page);
+                    rc = fileHandle.writePage(curPageID, page);
                 }
-                memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned));
-                return 0;
             }
-            case TypeVarChar: {
-
-                int keyVarcharLen;
-                memcpy(&keyVarcharLen, key, sizeof(int));
-                auto *keyVarchar = (char *) malloc(keyVarcharLen);
-                memcpy((char *) keyVarchar, (char *) key + sizeof(int), keyVarcharLen);
-
-                int tempVarcharLen;
-
-                for (int idx = 0; idx < numRecords; idx++) {
-                    memcpy(&tempVarcharLen, (char *) thisPage + offset, sizeof(int));
-                    auto *tempVarchar = (char *) malloc(tempVarcharLen + 1);
-                    memcpy(tempVarchar, (char *) thisPage + offset + sizeof(int), tempVarcharLen);
-                    tempVarchar[tempVarcharLen] = '\0';
+            free(page);
+            return rc;
+        }
+        if (dirOf(page)->flag != LEAF_FLAG) {
+            free(page);
+            return -2; // undefined flag
+        }
 
-                    if (strcmp(tempVarchar, keyVarchar) > 0) {
-                        memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned));
-                        return 0;
-                    }
-                    offset += sizeof(int) + tempVarcharLen + sizeof(unsigned);
-                    free(tempVarchar);
+        int slot = searchNode(attribute, page, key, true);
+        if (slot == dirOf(page)->recordNum || compareSlot(attribute, page, slot, key) != 0) {
+            free(page);
+            return -3; // no such entry
+        }
+        auto *data = (char *) dataOf(attribute, page, slot);
+        RID_NUM ridNum;
+        memcpy(&ridNum, data, sizeof(RID_NUM));
+        if (ridNum == 0) {
+            PAGE_ID firstPage, oldFirstPage;
+            memcpy(&firstPage, data + sizeof(RID_NUM), sizeof(PAGE_ID));
+            oldFirstPage = firstPage;
+            rc = deletePosting(ixFileHandle, header, firstPage, rid);
+            if (rc == 0 && firstPage != oldFirstPage) {
+                // the first posting page emptied, or the whole list
+                if (firstPage == 0) {
+                    deleteEntryFromNode(attribute, page, slot);
+                } else {
+                    memcpy(data + sizeof(RID_NUM), &firstPage, sizeof(PAGE_ID));
                 }
+                rc = fileHandle.writePage(curPageID, page);
+            }
+        } else {
+            RID *rids = (RID *) (data + sizeof(RID_NUM));
+            int pos = std::lower_bound(rids, rids + ridNum, rid, ridLess) - rids;
+            if (pos == ridNum || rids[pos].pageNum != rid.pageNum || rids[pos].slotNum != rid.slotNum) {
+                free(page);
+                return -3; // no such entry
+            }
+            if (ridNum == 1) {
+                deleteEntryFromNode(attribute, page, slot);
+            } else {
+                // shrink the list in place, the hole at its end goes with the next compaction
+                memmove(rids + pos, rids + pos + 1, (ridNum - pos - 1) * sizeof(RID));
+                ridNum--;
+                memcpy(data, &ridNum, sizeof(RID_NUM));
+                dirOf(page)->freeSpace += sizeof(RID);
+            }
+            rc = fileHandle.writePage(curPageID, page);
+        }
+        underflow = rc == 0 && isUnderfull(page);
+        free(page);
+        return rc;
+    }
 
-                free(keyVarchar);
-                memcpy(&nextPageId, (char *) thisPage + offset - sizeof(unsigned), sizeof(unsigned));
-                return 0;
-
+    RC IndexManager::fixUnderflow(IXFileHandle &ixFileHandle, const Attribute &attribute, IndexHeader &header,
+                                  void *parent, int child) {
+        if (dirOf(parent)->recordNum == 0) {
+            return 0; // no sibling
+        }
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        // the child and its left sibling, or its right one for the first child; slot `left` of the parent
+        // separates them
+        int left = child > 0 ? child - 1 : 0;
+        PAGE_ID leftPageID = getChild(attribute, parent, left), rightPageID = getChild(attribute, parent, left + 1);
+        auto *leftPage = (char *) malloc(PAGE_SIZE);
+        auto *rightPage = (char *) malloc(PAGE_SIZE);
+        if (fileHandle.readPage(leftPageID, leftPage) != 0 || fileHandle.readPage(rightPageID, rightPage) != 0) {
+            free(leftPage);
+            free(rightPage);
+            return -1; // read fail
+        }
+        NodeDir leftDir = *dirOf(leftPage), rightDir = *dirOf(rightPage);
+        bool compressKeys = compressesKeys(header, attribute);
+        bool compressLeaf = compressKeys && leftDir.flag == LEAF_FLAG;
+
+        // both nodes' entries in key order; between internal nodes the separator comes down with the right
+        // node's first child
+        auto *separator = (char *) malloc(PAGE_SIZE);
+        NodeEntries entries(attribute, leftDir.flag, compressLeaf);
+        entries.addSlots(leftPage, 0, leftDir.recordNum);
+        if (leftDir.flag == NONLEAF_FLAG) {
+            copyKey(attribute, parent, left, separator);
+            entries.add(separator, &rightDir.firstChild);
+        }
+        entries.addSlots(rightPage, 0, rightDir.recordNum);
+        entries.seal();
+        int count = entries.size();
+
+        RC rc = 0;
+        if (entries.bytes(0, count) <= NODE_CAPACITY) {
+            // the right node merges into the left one and is freed
+            initNode(leftPage, leftDir.flag);
+            dirOf(leftPage)->nextLeafNode = rightDir.nextLeafNode;
+            dirOf(leftPage)->firstChild = leftDir.firstChild;
+            fillNode(attribute, leftPage, entries.entries, 0, count, compressLeaf);
+            deleteEntryFromNode(attribute, parent, left);
+            if (fileHandle.writePage(leftPageID, leftPage) != 0 || freePage(ixFileHandle, header, rightPageID) != 0) {
+                rc = -2; // write fail
             }
-            default:
-                break;
+            header.version++;
+        } else {
+            // even the bytes out, the separator in the parent is replaced when the new one fits there
+            int split = entries.balancedSplit();
+            unsigned separatorLength = 0;
+            if (split != -1) {
+                if (compressLeaf) {
+                    separatorLength = shortestSeparator(entries.entries[split - 1], entries.entries[split],
+                                                        separator);
+                } else {
+                    separatorLength = getKeyLength(attribute, entries.entries[split]);
+                    memcpy(separator, entries.entries[split], separatorLength);
+                }
+            }
+            unsigned oldLength = getKeyLength(attribute, entryOf(parent, left));
+            if (split != -1 && dirOf(parent)->freeSpace + oldLength >= separatorLength) {
+                initNode(leftPage, leftDir.flag);
+                initNode(rightPage, rightDir.flag);
+                dirOf(leftPage)->nextLeafNode = leftDir.nextLeafNode;
+                dirOf(rightPage)->nextLeafNode = rightDir.nextLeafNode;
+                dirOf(leftPage)->firstChild = leftDir.firstChild;
+                int rightBegin = split;
+                if (leftDir.flag == NONLEAF_FLAG) {
+                    // the middle key moves up, its child becomes the leftmost child on the right
+                    memcpy(&dirOf(rightPage)->firstChild, entries.entries[split] + separatorLength, sizeof(PAGE_ID));
+                    rightBegin = split + 1;
+                }
+                fillNode(attribute, leftPage, entries.entries, 0, split, compressLeaf);
+                fillNode(attribute, rightPage, entries.entries, rightBegin, count, compressLeaf);
+                deleteEntryFromNode(attribute, parent, left);
+                insertEntry2NodeCore(attribute, parent, left, separator, &rightPageID);
+                if (fileHandle.writePage(leftPageID, leftPage) != 0 || fileHandle.writePage(rightPageID, rightPage) != 0) {
+                    rc = -2; // write fail
+                }
+                header.version++;
+            }
+        }
 
+        free(separator);
+        free(leftPage);
+        free(rightPage);
+        return rc;
+    }
+
+    RC IndexManager::scan(IXFileHandle &ixFileHandle,
+                          const Attribute &attribute,
+                          const void *lowKey,
+                          const void *highKey,
+                          bool lowKeyInclusive,
+                          bool highKeyInclusive,
+                          IX_ScanIterator &ix_ScanIterator) {
+        if (ixFileHandle.getFileHandle().getNumberOfPages() == 0) {
+            // this ixFileHandle did not open any file
+            return -1;
         }
+
+        return ix_ScanIterator.init_IXScanIterator(ixFileHandle, attribute, lowKey, highKey, lowKeyInclusive,
+                                                   highKeyInclusive) == 0 ? 0 : -2; // search fail
     }
 
     RC IndexManager::printBTree(IXFileHandle &ixFileHandle, const Attribute &attribute, std::ostream &out) const {
-        int pageNum = ixFileHandle.getFileHandle().getNumberOfPages();
-
-        if (pageNum <= 1) {
+        if (ixFileHandle.getFileHandle().getNumberOfPages() <= 1) {
             std::cout << "Empty B+ tree" << std::endl;
-//            out << "Empty B+ tree" << std::endl;
             return 0;
-        } else if (pageNum == 2) {
-            printCore(ixFileHandle, 1, attribute, 0, false, out);
-        } else {
-            void *dmpage = malloc(PAGE_SIZE);
-            ixFileHandle.getFileHandle().readPage(0, dmpage);
-
-            PAGE_ID rootPageID;
-            memcpy(&rootPageID, (char *)dmpage, sizeof(PAGE_ID));
+        }
 
-            printCore(ixFileHandle, rootPageID, attribute, 0, false, out);
+        void *dmpage = malloc(PAGE_SIZE);
+        if (ixFileHandle.getFileHandle().readPage(0, dmpage) != 0) {
+            free(dmpage);
+            return -1; // read dummy page fail
         }
-        return 0;
+        IndexHeader header;
+        memcpy(&header, dmpage, sizeof(IndexHeader));
+        free(dmpage);
+        if (header.options & IX_HASH) {
+            return printHash(ixFileHandle, attribute, out);
+        }
+        PAGE_ID rootPageID = header.rootPageID;
+        if (rootPageID == 0) {
+            // compacted after every entry was deleted
+            std::cout << "Empty B+ tree" << std::endl;
+            return 0;
+        }
+
+        return printCore(ixFileHandle, rootPageID, attribute, 0, false, out);
     }
 
-    RC IndexManager::printCore(IXFileHandle &ixFileHandle, int curNode, const Attribute &attribute, int indentNum, bool isContinue, std::ostream &out) const {
+    RC IndexManager::printCore(IXFileHandle &ixFileHandle, PAGE_ID curNode, const Attribute &attribute, int indentNum,
+                               bool isContinue, std::ostream &out) const {
         void *page = malloc(PAGE_SIZE);
         if (ixFileHandle.getFileHandle().readPage(curNode, page) != 0) {
+            free(page);
             return -1; // get node page fail
         }
 
-        PAGE_FLAG pageFlag;
-        memcpy(&pageFlag, page, sizeof(PAGE_FLAG));
-
-        RECORD_NUM recordNum;
-        if (pageFlag == LEAF_FLAG) {
-            LeafDir leafDir;
-            memcpy(&leafDir, page, sizeof(LeafDir));
-            recordNum = leafDir.recordNum;
-        } else if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            NodePageDir nodePageDir;
-            memcpy(&nodePageDir, page, sizeof(nodePageDir));
-            recordNum = nodePageDir.recordNum;
-        } else {
-            return -2; // undefined flag
-        }
-
         std::string indent;
         if (indentNum == 0) {
             out << "{" << std::endl;
@@ -1385,41 +1519,19 @@ namespace PeterDB {
             out << indent << "{";
         }
 
-        printNode(ixFileHandle, pageFlag, page, recordNum, attribute, out);
-
-        if (pageFlag == NONLEAF_FLAG || pageFlag == ROOT_FLAG) {
-            OFFSET offset = sizeof(NodePageDir);
+        RC rc = printNode(ixFileHandle, page, attribute, out);
 
+        const NodeDir *dir = dirOf(page);
+        if (rc == 0 && dir->flag == NONLEAF_FLAG) {
             out << "," << std::endl;
-
             out << indent << "\"children\":[" << std::endl;
-
-            PAGE_ID nextPageID;
-
-            for (int i = 0; i <= recordNum; i++) {
-                if (attribute.type == TypeInt || attribute.type == TypeReal) {
-                    memcpy(&nextPageID, (char *)page + offset, sizeof(PAGE_ID));
-                    offset += (sizeof(PAGE_ID) + 4);
-                } else if (attribute.type == TypeVarChar) {
-                    memcpy(&nextPageID, (char *)page + offset, sizeof(PAGE_ID));
-
-                    int varCharLen;
-                    memcpy(&varCharLen, (char *)page + offset + sizeof(PAGE_ID), 4);
-                    offset += (4 + sizeof(PAGE_ID) + varCharLen);
-                } else {
-                    return -3;
-                }
-
-                printCore(ixFileHandle, nextPageID, attribute, indentNum + 1, i != recordNum, out);
+            for (int i = 0; i <= dir->recordNum && rc == 0; i++) {
+                rc = printCore(ixFileHandle, getChild(attribute, page, i), attribute, indentNum + 1,
+                               i != dir->recordNum, out);
             }
-
             out << indent << "]";
         }
 
-//        if (indentNum == 0) {
-//            out << std::endl;
-//        }
-
         if (isContinue) {
             out << "}," << std::endl;
         } else {
@@ -1427,377 +1539,342 @@ namespace PeterDB {
         }
 
         free(page);
-        return 0;
+        return rc;
     }
 
-
-    RC IndexManager::printNode(IXFileHandle &ixFileHandle, PAGE_FLAG pageFlag, void *page,
-                               RECORD_NUM recordNum, const Attribute &attribute, std::ostream &out) const{
-        OFFSET nodeOffset;
-        int dataSize;
-        if (pageFlag == LEAF_FLAG) {
-            nodeOffset = sizeof(LeafDir);
-            dataSize = sizeof(RID);
-        } else {
-            nodeOffset = sizeof(NodePageDir) + sizeof(PAGE_ID);
-            dataSize = sizeof(PAGE_ID);
-        }
-
-        OFFSET prevNodeOffset = nodeOffset;
-
+    RC IndexManager::printNode(IXFileHandle &ixFileHandle, const void *page, const Attribute &attribute,
+                               std::ostream &out) const {
+        // leaves print each key followed by its RIDs: "key:[(p, s),(p, s)]"
+        FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        const NodeDir *dir = dirOf(page);
+        auto *key = (char *) malloc(PAGE_SIZE);
+        RC rc = 0;
         out << "\"keys\": [";
-        for (int i = 0; i < recordNum; i++) {
-            switch (attribute.type) {
-                case TypeInt: {
-                    int data;
-                    memcpy(&data, (char *)page + nodeOffset, 4);
-                    nodeOffset += (4 + dataSize);
-
-                    if (i != 0 && pageFlag == LEAF_FLAG) {
-                        int prevData;
-                        memcpy(&prevData, (char *)page + prevNodeOffset, 4);
-
-                        if (prevData == data) {
-                            out << ",";
-                        } else {
-                            out << "]\",\"" << data << ":[";
-                        }
-                        prevNodeOffset += (4 + dataSize);
-                    } else if (i == 0 ) {
-                        out << "\"";
-                        out << data;
-                        if (pageFlag == LEAF_FLAG) {
-                            out << ":[";
-                        }
-                    } else if (pageFlag == LEAF_FLAG){
-                        out << "]\",\"";
-                        out << data;
-                        out << ":[";
-                        prevNodeOffset += (4 + dataSize);
-                    } else {
-                        out << "\",\"" << data;
-                        prevNodeOffset += (4 + dataSize);
-                    }
+        for (int i = 0; i < dir->recordNum && rc == 0; i++) {
+            out << (i == 0 ? "\"" : "\",\"");
+            copyKey(attribute, page, i, key);
+            printKey(attribute, key, out);
+            if (dir->flag != LEAF_FLAG) {
+                continue;
+            }
 
-                    break;
-                }
-                case TypeReal: {
-                    float data;
-                    memcpy(&data, (char *)page + nodeOffset, 4);
-                    nodeOffset += (4 + dataSize);
-
-                    if (i != 0 && pageFlag == LEAF_FLAG) {
-                        float prevData;
-                        memcpy(&prevData, (char *)page + prevNodeOffset, 4);
-
-                        if (prevData == data) {
-                            out << ",";
-                        } else {
-                            out << "]\",\"";
-                            out << data;
-                            out << ":[";
-                        }
-                        prevNodeOffset += (4 + dataSize);
-                    } else if (i == 0 ) {
-                        out << "\"";
-                        out << data;
-                        if (pageFlag == LEAF_FLAG) {
-                            out << ":[";
-                        }
-                    } else if (pageFlag == LEAF_FLAG){
-                        out << "]\",\"";
-                        out << data;
-                        out << ":[";
-                        prevNodeOffset += (4 + dataSize);
-                    } else {
-                        out << "\",\"" << data;
-                        prevNodeOffset += (4 + dataSize);
-                    }
-                    break;
+            out << ":[";
+            const char *data = dataOf(attribute, page, i);
+            RID_NUM ridNum;
+            memcpy(&ridNum, data, sizeof(RID_NUM));
+            bool first = true;
+            auto printRids = [&](const RID *rids, int count) {
+                for (int j = 0; j < count; j++) {
+                    out << (first ? "" : ",") << "(" << rids[j].pageNum << ", " << rids[j].slotNum << ")";
+                    first = false;
                 }
-                case TypeVarChar: {
-                    int varCharLength;
-
-                    memcpy(&varCharLength, (char *)page+nodeOffset, 4);
-
-                    auto *data = (char *)malloc(varCharLength + 1);
-                    memcpy(data, (char *)page + nodeOffset + 4, varCharLength);
-                    data[varCharLength] = '\0';
-                    nodeOffset += (4 + varCharLength + dataSize);
-
-                    if (i != 0 && pageFlag == LEAF_FLAG) {
-                        int prevVarCharLength;
-                        memcpy(&prevVarCharLength, (char *)page+prevNodeOffset, 4);
-
-                        auto *prevData = (char *)malloc(prevVarCharLength + 1);
-                        memcpy(prevData, (char *)page + prevNodeOffset + 4, prevVarCharLength);
-                        prevData[varCharLength] = '\0';
-
-                        if (std::strcmp(prevData, data) == 0) {
-                            out << ",";
-                        } else {
-                            out << "]\",\"";
-                            out << data;
-                            out << ":[";
-                        }
-                        prevNodeOffset += (4 + prevVarCharLength + dataSize);
-                    } else if (i == 0 ) {
-                        out << "\"";
-                        out << data;
-                        if (pageFlag == LEAF_FLAG) {
-                            out << ":[";
-                        }
-                    } else if (pageFlag == LEAF_FLAG){
-                        out << "]\",\"";
-                        out << data;
-                        out << ":[";
-                        prevNodeOffset += (4 + dataSize);
-                    } else {
-                        out << "\",\"" << data;
-                        prevNodeOffset += (4 + dataSize);
+            };
+            if (ridNum > 0) {
+                std::vector<RID> rids(ridNum);
+                memcpy(rids.data(), data + sizeof(RID_NUM), ridNum * sizeof(RID));
+                printRids(rids.data(), ridNum);
+            } else {
+                PAGE_ID postingPage;
+                memcpy(&postingPage, data + sizeof(RID_NUM), sizeof(PAGE_ID));
+                while (postingPage != 0) {
+                    const void *ref;
+                    if (fileHandle.readPageRef(postingPage, ref) != 0) {
+                        rc = -1; // read posting page fail
+                        break;
                     }
-                    break;
-                }
-                default: {
-                    break;
+                    printRids(postingRids(ref), ((const PostingDir *) ref)->ridNum);
+                    PAGE_ID nextPage = ((const PostingDir *) ref)->nextPostingPage;
+                    fileHandle.releasePageRef(postingPage);
+                    postingPage = nextPage;
                 }
             }
+            out << "]";
+        }
+        if (dir->recordNum > 0) {
+            out << "\"";
+        }
+        out << "]";
+        free(key);
+        return rc;
+    }
 
-            if (pageFlag == LEAF_FLAG) {
-                RID rid;
-                memcpy(&rid, (char *) page + nodeOffset - dataSize, sizeof(RID));
-                out << "(" << rid.pageNum << ", " << rid.slotNum << ")";
-            }
-
-//            nodeOffset += dataSize;
 
-            if (i == recordNum - 1) {
-                if (pageFlag == LEAF_FLAG) {
-                    out << "]\"";
-                } else {
-                    out << "\"";
-                }
+    void IndexManager::printKey(const Attribute &attribute, const void *key, std::ostream &out) {
+        switch (attribute.type) {
+            case TypeInt: {
+                int value;
+                memcpy(&value, key, sizeof(int));
+                out << value;
+                break;
+            }
+            case TypeReal: {
+                float value;
+                memcpy(&value, key, sizeof(float));
+                out << value;
+                break;
+            }
+            case TypeVarChar: {
+                int length;
+                memcpy(&length, key, sizeof(int));
+                out.write((const char *) key + sizeof(int), length);
+                break;
             }
         }
-        out << "]";
-        return 0;
     }
 
 
     /*
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     */
-    IX_ScanIterator::IX_ScanIterator() {}
-
-    IX_ScanIterator::~IX_ScanIterator() {}
+    IX_ScanIterator::IX_ScanIterator() : _ixFileHandle(nullptr), _lowKey(nullptr), _lowKeyInclusive(false),
+                                         _highKey(nullptr), _highKeyInclusive(false), _version(0), _curLeafPageId(0),
+                                         _curSlot(0), _curLeafPageBuffer(nullptr), _parentPageBuffer(nullptr),
+                                         _parentSlot(-1), _prefetchedSlot(-1), _prefetchDepth(1),
+                                         _curKey(nullptr), _curKeyLength(0), _curRids(nullptr), _curRidNum(-1),
+                                         _curRid(0), _postingPageBuffer(nullptr), _inPostings(false), _isHash(false),
+                                         _hashProbe(false), _hashSlot(0) {}
+
+    IX_ScanIterator::~IX_ScanIterator() {
+        close();
+    }
 
+    RC IX_ScanIterator::enterEntry() {
+        // the key is compared and copied once, its RIDs are returned without looking at it again
+        if (_highKey != nullptr) {
+            int cmp = compareSlot(_attribute, _curLeafPageBuffer, _curSlot, _highKey);
+            if (cmp > 0 || (cmp == 0 && !_highKeyInclusive)) {
+                return IX_EOF;
+            }
+        }
+        copyKey(_attribute, _curLeafPageBuffer, _curSlot, _curKey);
+        _curKeyLength = IndexManager::getKeyLength(_attribute, _curKey);
+
+        const char *data = dataOf(_attribute, _curLeafPageBuffer, _curSlot);
+        RID_NUM ridNum;
+        memcpy(&ridNum, data, sizeof(RID_NUM));
+        _curRid = 0;
+        if (ridNum > 0) {
+            _inPostings = false;
+            _curRids = data + sizeof(RID_NUM);
+            _curRidNum = ridNum;
+            return 0;
+        }
 
-    RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
-        if(_curLeafPageId == -1){
+        PAGE_ID postingPage;
+        memcpy(&postingPage, data + sizeof(RID_NUM), sizeof(PAGE_ID));
+        if (_postingPageBuffer == nullptr) {
+            _postingPageBuffer = (char *) malloc(PAGE_SIZE);
+        }
+        if (_ixFileHandle->getFileHandle().readPage(postingPage, _postingPageBuffer) != 0 ||
+            ((PostingDir *) _postingPageBuffer)->flag != POSTING_FLAG) {
             return IX_EOF;
         }
-        FileHandle &fileHandle = _ixFileHandle->getFileHandle();
-
-        // move entry cursor to next, this method return either 0 or IX_EOF
-        RC rc = checkEntryCursor(fileHandle);
+        _inPostings = true;
+        _curRids = (const char *) postingRids(_postingPageBuffer);
+        _curRidNum = ((PostingDir *) _postingPageBuffer)->ridNum;
+        return 0;
+    }
 
-        if(rc == IX_EOF){
+    RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
+        if (_curLeafPageBuffer == nullptr) {
             return IX_EOF;
         }
+        if (_isHash) {
+            return getNextHashEntry(rid, key);
+        }
 
-        // memcpy(&leafDir, page, DIR_SIZE);
-        int numRecds = _curLeafDir.recordNum;
-
-        switch (_attribute.type) {
-            case TypeInt:{
-                int thisInt;
-                memcpy(&thisInt, _curLeafPageBuffer + _curOffset, sizeof(int));
-
-                int intHighKey;
-                if(_highKey != NULL) {
-                    memcpy(&intHighKey, (char*)_highKey, sizeof(int));
-                }
-
-                if((_highKey == NULL) || (thisInt <= intHighKey && _highKeyInclusive) || (thisInt < intHighKey)){
-                    memcpy(key, _curLeafPageBuffer + _curOffset, sizeof(int));
-                    memcpy(&rid, _curLeafPageBuffer + _curOffset + sizeof(int), sizeof(RID));
-
-                    _curRecordId ++;
-                    if(_curRecordId == _curLeafDir.recordNum ){
-                        _curLeafPageId = _curLeafDir.nextLeafNode;
-
-                        _ixFileHandle->getFileHandle().readPage(_curLeafPageId, _curLeafPageBuffer);
-                        memcpy(&_curLeafDir, _curLeafPageBuffer, sizeof(LeafDir));
-                        _curOffset = sizeof(LeafDir);
-                        _curRecordId = 0;
+        while (true) {
+            if (_curRidNum < 0) {
+                // entries deleted behind the cursor do not move it, the leaf is a private copy
+                while (_curSlot >= dirOf(_curLeafPageBuffer)->recordNum) {
+                    PAGE_ID nextLeafPageId = dirOf(_curLeafPageBuffer)->nextLeafNode;
+                    IndexHeader header;
+                    if (nextLeafPageId == 0 || IndexManager::instance().readHeader(*_ixFileHandle, header) != 0) {
+                        return IX_EOF;
                     }
-                    else{
-                        _curOffset += sizeof(int) + sizeof(RID);
+                    if (header.version != _version) {
+                        // entries moved between leaves since the copy, the next key is found from the root
+                        RC rc = _curKeyLength > 0 ? seek(_curKey, false) : seek(_lowKey, _lowKeyInclusive);
+                        if (rc != 0 || _curLeafPageBuffer == nullptr) {
+                            return IX_EOF;
+                        }
+                        continue;
                     }
-                    return 0;
-
-                }
-                else{
-                    return -1;
-                }
-
-            }
-            case TypeReal:{
-                float thisReal;
-                memcpy(&thisReal, _curLeafPageBuffer + _curOffset, sizeof(float));
-
-                float realHighKey;
-                if(_highKey != NULL) {
-                    memcpy(&realHighKey, (char*)_highKey, sizeof(float));
-                }
-
-                if((_highKey == NULL) || (thisReal <= realHighKey && _highKeyInclusive) || (thisReal < realHighKey)){
-                    memcpy(key, _curLeafPageBuffer + _curOffset, sizeof(float));
-                    memcpy(&rid, _curLeafPageBuffer + _curOffset + sizeof(float), sizeof(RID));
-
-                    _curRecordId ++;
-                    if(_curRecordId == _curLeafDir.recordNum ){
-                        _curLeafPageId = _curLeafDir.nextLeafNode;
-                        std::cout << "#################get to next page in getnextentry" << std::endl;
-
-                        _ixFileHandle->getFileHandle().readPage(_curLeafPageId, _curLeafPageBuffer);
-                        memcpy(&_curLeafDir, _curLeafPageBuffer, sizeof(LeafDir));
-                        _curOffset = sizeof(LeafDir);
-                        _curRecordId = 0;
+                    _curLeafPageId = nextLeafPageId;
+                    if (_ixFileHandle->getFileHandle().readPage(_curLeafPageId, _curLeafPageBuffer) != 0) {
+                        return IX_EOF;
                     }
-                    else{
-                        _curOffset += sizeof(float) + sizeof(RID);
+                    _curSlot = 0;
+                    if (_parentSlot >= 0) {
+                        _parentSlot++;
+                        if (_parentSlot > dirOf(_parentPageBuffer)->recordNum ||
+                            IndexManager::getChild(_attribute, _parentPageBuffer, _parentSlot) != _curLeafPageId) {
+                            locateParent();
+                        }
+                        prefetchLeaves();
                     }
-                    return 0;
-
                 }
-                else{
-                    return -1;
+                RC rc = enterEntry();
+                if (rc != 0) {
+                    return rc;
                 }
-
             }
-            case TypeVarChar:{
-
-                int thisVarcharLen;
-                memcpy(&thisVarcharLen, _curLeafPageBuffer + _curOffset, sizeof(int));
-                auto * thisVarchar = (char* )malloc(thisVarcharLen + 1);
-                memcpy(thisVarchar, _curLeafPageBuffer + _curOffset + sizeof(int), thisVarcharLen);
-                thisVarchar[thisVarcharLen] = '\0';
-
-
-                char *varcharHikey;
-                if(_highKey != NULL) {
-                    int highkeyLen;
-                    memcpy(&highkeyLen, (char*)_highKey, sizeof(int));
-                    varcharHikey = (char*)malloc(highkeyLen);
-                    memcpy(varcharHikey, (char*)_highKey + sizeof(int), highkeyLen);
-                }
-
-                if( (_highKey == NULL) || (strcmp(thisVarchar, varcharHikey) < 0) || (_highKeyInclusive && strcmp(thisVarchar, varcharHikey) <= 0) ){
-                    memcpy(key, _curLeafPageBuffer + _curOffset, sizeof(int) + thisVarcharLen);
-                    memcpy(&rid, _curLeafPageBuffer + _curOffset + sizeof(int) + thisVarcharLen, sizeof(RID));
-
-                    _curRecordId ++;
-                    if(_curRecordId == _curLeafDir.recordNum ){
-                        _curLeafPageId = _curLeafDir.nextLeafNode;
-
-                        _ixFileHandle->getFileHandle().readPage(_curLeafPageId, _curLeafPageBuffer);
-                        memcpy(&_curLeafDir, _curLeafPageBuffer, sizeof(LeafDir));
-                        _curOffset = sizeof(LeafDir);
-                        _curRecordId = 0;
-                    }
-                    else{
-                        _curOffset += sizeof(float) + thisVarcharLen + sizeof(RID);
-                    }
-
-
-                    free(thisVarchar);
-                    if(_highKey != NULL) {
-                        free(varcharHikey);
-                    }
-                    return 0;
 
-                }
-                else{
-                    return -1;
-                }
+            if (_curRid < _curRidNum) {
+                memcpy(&rid, _curRids + _curRid * sizeof(RID), sizeof(RID));
+                memcpy(key, _curKey, _curKeyLength);
+                _curRid++;
+                return 0;
             }
 
-            default:
-                std::cout << "type not known " << std::endl;
-                return -1;
-
-        }
-
-        return -1;
-
-
-    }
-
-
-    RC IX_ScanIterator::checkEntryCursor(FileHandle &fileHandle) {
-
-        if(_curRecordId >= _curLeafDir.recordNum && _curLeafDir.recordNum != 0 && _curLeafDir.nextLeafNode == 0){
-            return  IX_EOF;
-        }
-
-        if(_curLeafPageId == 0){
-            return IX_EOF;
-        }
-
-        while(_curLeafDir.recordNum == 0){
-            // std::cout << "while loop in checkEntryCursor" << std::endl;
-            if(_curLeafDir.nextLeafNode != 0){
-                _curLeafPageId = _curLeafDir.nextLeafNode;
-                fileHandle.readPage(_curLeafPageId, _curLeafPageBuffer);
-                memcpy(&_curLeafDir, _curLeafPageBuffer, sizeof(LeafDir));
-                _curOffset = sizeof(LeafDir);
-                _curRecordId = 0;
-            }
-            else{
-                return IX_EOF;
+            PAGE_ID nextPage = _inPostings ? ((PostingDir *) _postingPageBuffer)->nextPostingPage : 0;
+            if (nextPage != 0) {
+                if (_ixFileHandle->getFileHandle().readPage(nextPage, _postingPageBuffer) != 0 ||
+                    ((PostingDir *) _postingPageBuffer)->flag != POSTING_FLAG) {
+                    return IX_EOF;
+                }
+                _curRidNum = ((PostingDir *) _postingPageBuffer)->ridNum;
+                _curRid = 0;
+                continue;
             }
-
+            _curSlot++;
+            _curRidNum = -1;
         }
-
-        return 0;
     }
 
-
     RC IX_ScanIterator::close() {
-        IndexManager::instance().closeFile(*_ixFileHandle); // todo
+        // the file handle belongs to the caller
         this->_ixFileHandle = nullptr;
+        free(this->_lowKey);
         this->_lowKey = nullptr;
+        free(this->_highKey);
         this->_highKey = nullptr;
         free(this->_curLeafPageBuffer);
         this->_curLeafPageBuffer = nullptr;
+        free(this->_parentPageBuffer);
+        this->_parentPageBuffer = nullptr;
+        this->_parentSlot = -1;
+        this->_prefetchedSlot = -1;
+        this->_prefetchDepth = 1;
+        free(this->_curKey);
+        this->_curKey = nullptr;
+        this->_curKeyLength = 0;
+        free(this->_postingPageBuffer);
+        this->_postingPageBuffer = nullptr;
+        this->_curRidNum = -1;
+        this->_inPostings = false;
+        this->_isHash = false;
+        this->_hashProbe = false;
+        this->_hashSlot = 0;
         return 0;
     }
 
-
-
     RC IX_ScanIterator::init_IXScanIterator(IXFileHandle &ixFileHandle, const Attribute &attribute,
-                                            const void *lowKey, const void *highKey,
-                                            bool lowKeyInclusive, bool highKeyInclusive,
-                                            PAGE_ID &curLeafPage, int &curRecordId, int &curOffset, void* ptr_curLeafPage) {
-        // initilaize
+                                            const void *lowKey, const void *highKey, bool lowKeyInclusive,
+                                            bool highKeyInclusive) {
+        close();
         this->_ixFileHandle = &ixFileHandle;
         this->_attribute = attribute;
-        this->_lowKey = lowKey;
-        this->_highKey = highKey;
         this->_lowKeyInclusive = lowKeyInclusive;
         this->_highKeyInclusive = highKeyInclusive;
+        // the caller may reuse its key buffers for getNextEntry
+        if (lowKey != NULL) {
+            unsigned keyLength = IndexManager::getKeyLength(attribute, lowKey);
+            this->_lowKey = (char *) malloc(keyLength);
+            memcpy(this->_lowKey, lowKey, keyLength);
+        }
+        if (highKey != NULL) {
+            unsigned keyLength = IndexManager::getKeyLength(attribute, highKey);
+            this->_highKey = (char *) malloc(keyLength);
+            memcpy(this->_highKey, highKey, keyLength);
+        }
+        this->_curKey = (char *) malloc(PAGE_SIZE);
+        // page 0 is read once, for the index kind and then the root or the hash directory
+        const void *headPage;
+        if (ixFileHandle.getFileHandle().readPageRef(0, headPage) != 0) {
+            return -1; // read dummy page fail
+        }
+        IndexHeader header;
+        memcpy(&header, headPage, sizeof(IndexHeader));
+        RC rc = header.options & IX_HASH ? initHashScan(headPage) : 0;
+        ixFileHandle.getFileHandle().releasePageRef(0);
+        if (header.options & IX_HASH) {
+            return rc;
+        }
+        return seek(_lowKey, _lowKeyInclusive, &header);
+    }
 
-        this->_curLeafPageId = curLeafPage;
-        this->_curRecordId = curRecordId;
-        this->_curOffset = curOffset;
-        this->_curLeafPageBuffer = (char*)malloc(PAGE_SIZE);
+    RC IX_ScanIterator::seek(const void *key, bool inclusive, const IndexHeader *header) {
+        if (_curLeafPageBuffer == nullptr) {
+            _curLeafPageBuffer = (char *) malloc(PAGE_SIZE);
+        }
+        if (_parentPageBuffer == nullptr) {
+            _parentPageBuffer = (char *) malloc(PAGE_SIZE);
+        }
+        RC rc = IndexManager::instance().searchLeafPage(*_ixFileHandle, _attribute, key, _curLeafPageId,
+                                                        _curLeafPageBuffer, _version, _parentPageBuffer,
+                                                        &_parentSlot, header);
+        if (rc == IX_EOF) {
+            // no entries at all
+            free(_curLeafPageBuffer);
+            _curLeafPageBuffer = nullptr;
+            return 0;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+        _curSlot = key == NULL ? 0 : IndexManager::searchNode(_attribute, _curLeafPageBuffer, key, inclusive);
+        _curRidNum = -1;
+        _prefetchedSlot = _parentSlot;
+        prefetchLeaves();
+        return 0;
+    }
 
-        //ixFileHandle.getFileHandle().readPage(curLeafPage, _curPage);
-        memcpy(_curLeafPageBuffer, (char*)ptr_curLeafPage, PAGE_SIZE);
-        memcpy(&_curLeafDir, _curLeafPageBuffer, sizeof(LeafDir));
+    void IX_ScanIterator::locateParent() {
+        // the leaf is found again by its first key; without one there is nothing to read ahead from for now
+        _parentSlot = -1;
+        if (dirOf(_curLeafPageBuffer)->recordNum == 0) {
+            return;
+        }
+        auto *key = (char *) malloc(PAGE_SIZE);
+        auto *leafPage = (char *) malloc(PAGE_SIZE);
+        copyKey(_attribute, _curLeafPageBuffer, 0, key);
+        PAGE_ID leafPageID;
+        unsigned version;
+        int childSlot;
+        if (IndexManager::instance().searchLeafPage(*_ixFileHandle, _attribute, key, leafPageID, leafPage, version,
+                                                    _parentPageBuffer, &childSlot) == 0
+            && leafPageID == _curLeafPageId) {
+            _parentSlot = childSlot;
+            _prefetchedSlot = childSlot;
+        }
+        free(key);
+        free(leafPage);
+    }
 
-        return 0;
+    void IX_ScanIterator::prefetchLeaves() {
+        // Hints go out in batches once the reader is through half the window, which doubles each time up to
+        // IX_MAX_PREFETCH; leaves past the high key are left alone. The ramp is fixed, it does not measure how
+        // far ahead of the reader the pages really arrive: a hint on a cached page costs a lookup and nothing
+        // more, so overshooting is cheap, and the high key bounds how far past the range it can go.
+        if (_parentSlot < 0 || _prefetchedSlot - _parentSlot > _prefetchDepth / 2) {
+            return;
+        }
+        _prefetchDepth = std::min(_prefetchDepth * 2, IX_MAX_PREFETCH);
+        const NodeDir *parent = dirOf(_parentPageBuffer);
+        int lastSlot = std::min(parent->recordNum, _parentSlot + _prefetchDepth);
+        for (int slot = _prefetchedSlot + 1; slot <= lastSlot; slot++) {
+            if (_highKey != nullptr) {
+                // child `slot` starts at key slot - 1
+                int cmp = IndexManager::compareKey(_attribute, entryOf(_parentPageBuffer, slot - 1), _highKey);
+                if (cmp > 0 || (cmp == 0 && !_highKeyInclusive)) {
+                    break;
+                }
+            }
+            _ixFileHandle->getFileHandle().prefetchPage(IndexManager::getChild(_attribute, _parentPageBuffer, slot));
+            _ixFileHandle->ixPrefetchPageCounter++;
+            _prefetchedSlot = slot;
+        }
     }
     /*
     //////////////////////////////////////////////////////
@@ -1806,6 +1883,7 @@ namespace PeterDB {
         ixReadPageCounter = 0;
         ixWritePageCounter = 0;
         ixAppendPageCounter = 0;
+        ixPrefetchPageCounter = 0;
     }
 
     IXFileHandle::~IXFileHandle() {
@@ -1825,4 +1903,4 @@ namespace PeterDB {
         return fileHandle;
     }
 
-} // namespace PeterDB
\ No newline at end of file
+} // namespace PeterDB
@@ -0,0 +1,154 @@
+#include "src/include/ix.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace PeterDB {
+
+    IX_KeySorter::IX_KeySorter(const Attribute &attribute, unsigned memoryLimit)
+            : attribute(attribute), memoryLimit(memoryLimit), nextEntry(0) {
+    }
+
+    IX_KeySorter::~IX_KeySorter() {
+        for (FILE *run : runs) {
+            fclose(run);
+        }
+        for (char *head : heads) {
+            free(head);
+        }
+    }
+
+    bool IX_KeySorter::entryLess(const char *entry, const char *otherEntry) const {
+        // by key, then by RID so equal keys come out in heap order
+        int cmp = IndexManager::compareKey(attribute, entry, otherEntry);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+        RID rid, otherRid;
+        memcpy(&rid, entry + IndexManager::getKeyLength(attribute, entry), sizeof(RID));
+        memcpy(&otherRid, otherEntry + IndexManager::getKeyLength(attribute, otherEntry), sizeof(RID));
+        return rid.pageNum != otherRid.pageNum ? rid.pageNum < otherRid.pageNum : rid.slotNum < otherRid.slotNum;
+    }
+
+    RC IX_KeySorter::addEntry(const void *key, const RID &rid) {
+        unsigned keyLength = IndexManager::getKeyLength(attribute, key);
+        if (!offsets.empty() && arena.size() + offsets.size() * sizeof(unsigned) + keyLength + sizeof(RID)
+                                > memoryLimit) {
+            if (spillRun() != 0) {
+                return -1; // spill fail
+            }
+        }
+        offsets.push_back(arena.size());
+        arena.insert(arena.end(), (const char *) key, (const char *) key + keyLength);
+        arena.insert(arena.end(), (const char *) &rid, (const char *) &rid + sizeof(RID));
+        return 0;
+    }
+
+    void IX_KeySorter::sortRun() {
+        const char *base = arena.data();
+        std::sort(offsets.begin(), offsets.end(), [&](unsigned offset, unsigned otherOffset) {
+            return entryLess(base + offset, base + otherOffset);
+        });
+    }
+
+    RC IX_KeySorter::spillRun() {
+        sortRun();
+        FILE *run = tmpfile();
+        if (run == NULL) {
+            return -1; // no temporary file
+        }
+        runs.push_back(run);
+        for (unsigned offset : offsets) {
+            const char *entry = arena.data() + offset;
+            size_t entryLength = IndexManager::getKeyLength(attribute, entry) + sizeof(RID);
+            if (fwrite(entry, 1, entryLength, run) != entryLength) {
+                return -2; // write fail
+            }
+        }
+        arena.clear();
+        offsets.clear();
+        return 0;
+    }
+
+    RC IX_KeySorter::readEntry(FILE *run, char *entry) {
+        // key length first for VarChar, the rest follows
+        if (fread(entry, 1, sizeof(int), run) != sizeof(int)) {
+            return IX_EOF;
+        }
+        size_t rest = IndexManager::getKeyLength(attribute, entry) - sizeof(int) + sizeof(RID);
+        if (fread(entry + sizeof(int), 1, rest, run) != rest) {
+            return -1; // truncated run
+        }
+        return 0;
+    }
+
+    RC IX_KeySorter::finish() {
+        if (runs.empty()) {
+            // everything fit in memory
+            sortRun();
+            nextEntry = 0;
+            return 0;
+        }
+        if (!offsets.empty() && spillRun() != 0) {
+            return -1; // spill fail
+        }
+        std::vector<char>().swap(arena);
+        std::vector<unsigned>().swap(offsets);
+
+        auto greater = [&](int run, int otherRun) {
+            return entryLess(heads[otherRun], heads[run]);
+        };
+        for (unsigned run = 0; run < runs.size(); run++) {
+            rewind(runs[run]);
+            heads.push_back((char *) malloc(PAGE_SIZE + sizeof(RID)));
+            RC rc = readEntry(runs[run], heads[run]);
+            if (rc == 0) {
+                mergeHeap.push_back(run);
+            } else if (rc != IX_EOF) {
+                return -2; // read fail
+            }
+        }
+        std::make_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+        return 0;
+    }
+
+    RC IX_KeySorter::getNextEntry(void *key, RID &rid) {
+        const char *entry;
+        if (runs.empty()) {
+            if (nextEntry >= offsets.size()) {
+                return IX_EOF;
+            }
+            entry = arena.data() + offsets[nextEntry++];
+            unsigned keyLength = IndexManager::getKeyLength(attribute, entry);
+            memcpy(key, entry, keyLength);
+            memcpy(&rid, entry + keyLength, sizeof(RID));
+            return 0;
+        }
+
+        if (mergeHeap.empty()) {
+            return IX_EOF;
+        }
+        auto greater = [&](int run, int otherRun) {
+            return entryLess(heads[otherRun], heads[run]);
+        };
+        std::pop_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+        int run = mergeHeap.back();
+        entry = heads[run];
+        unsigned keyLength = IndexManager::getKeyLength(attribute, entry);
+        memcpy(key, entry, keyLength);
+        memcpy(&rid, entry + keyLength, sizeof(RID));
+
+        RC rc = readEntry(runs[run], heads[run]);
+        if (rc == 0) {
+            std::push_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+        } else {
+            mergeHeap.pop_back();
+            if (rc != IX_EOF) {
+                return -1; // read fail
+            }
+        }
+        return 0;
+    }
+
+} // namespace PeterDB
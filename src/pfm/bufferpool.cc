@@ -0,0 +1,348 @@
+#include "src/include/bufferpool.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace PeterDB {
+
+    ClockReplacer::ClockReplacer(unsigned numFrames) {
+        referenced.assign(numFrames, false);
+        evictable.assign(numFrames, false);
+        numEvictable = 0;
+        hand = 0;
+    }
+
+    void ClockReplacer::recordAccess(FrameId frameId) {
+        referenced[frameId] = true;
+    }
+
+    void ClockReplacer::setEvictable(FrameId frameId, bool isEvictable) {
+        if (evictable[frameId] == isEvictable) {
+            return;
+        }
+        evictable[frameId] = isEvictable;
+        if (isEvictable) {
+            numEvictable++;
+        } else {
+            numEvictable--;
+        }
+    }
+
+    RC ClockReplacer::victim(FrameId &frameId) {
+        if (numEvictable == 0) {
+            // every frame is pinned
+            return -1;
+        }
+        // at most two sweeps: the first one clears reference bits
+        while (true) {
+            FrameId cur = hand;
+            hand = (hand + 1) % (unsigned) evictable.size();
+            if (!evictable[cur]) {
+                continue;
+            }
+            if (referenced[cur]) {
+                referenced[cur] = false;
+                continue;
+            }
+            frameId = cur;
+            remove(cur);
+            return 0;
+        }
+    }
+
+    void ClockReplacer::remove(FrameId frameId) {
+        setEvictable(frameId, false);
+        referenced[frameId] = false;
+    }
+
+    LRUKReplacer::LRUKReplacer(unsigned numFrames, unsigned k) : k(k) {
+        currentTime = 0;
+        history.resize(numFrames);
+        evictable.assign(numFrames, false);
+        numEvictable = 0;
+    }
+
+    void LRUKReplacer::recordAccess(FrameId frameId) {
+        std::list<unsigned long long> &accesses = history[frameId];
+        accesses.push_front(currentTime++);
+        if (accesses.size() > k) {
+            accesses.pop_back();
+        }
+    }
+
+    void LRUKReplacer::setEvictable(FrameId frameId, bool isEvictable) {
+        if (evictable[frameId] == isEvictable) {
+            return;
+        }
+        evictable[frameId] = isEvictable;
+        if (isEvictable) {
+            numEvictable++;
+        } else {
+            numEvictable--;
+        }
+    }
+
+    RC LRUKReplacer::victim(FrameId &frameId) {
+        if (numEvictable == 0) {
+            return -1;
+        }
+        bool found = false;
+        bool foundInfinite = false;
+        unsigned long long oldest = numeric_limits<unsigned long long>::max();
+        for (FrameId cur = 0; cur < history.size(); cur++) {
+            if (!evictable[cur]) {
+                continue;
+            }
+            const std::list<unsigned long long> &accesses = history[cur];
+            bool infinite = accesses.size() < k;
+            // the back of the list is the K-th most recent access, or the earliest one if there are fewer than K
+            unsigned long long stamp = accesses.empty() ? 0 : accesses.back();
+            if (!found || (infinite && !foundInfinite) || (infinite == foundInfinite && stamp < oldest)) {
+                found = true;
+                foundInfinite = infinite;
+                oldest = stamp;
+                frameId = cur;
+            }
+        }
+        remove(frameId);
+        return 0;
+    }
+
+    void LRUKReplacer::remove(FrameId frameId) {
+        setEvictable(frameId, false);
+        history[frameId].clear();
+    }
+
+    BufferPool::BufferPool(unsigned numFrames, ReplacementPolicyType policyType) : numFrames(numFrames) {
+        frameData = (char *) malloc((size_t) numFrames * PAGE_SIZE);
+        frames.resize(numFrames);
+        for (FrameId frameId = numFrames; frameId > 0; frameId--) {
+            frames[frameId - 1].valid = false;
+            frames[frameId - 1].dirty = false;
+            frames[frameId - 1].pinCount = 0;
+            freeFrames.push_back(frameId - 1);
+        }
+        if (policyType == LRU_K_POLICY) {
+            policy = new LRUKReplacer(numFrames, 2);
+        } else {
+            policy = new ClockReplacer(numFrames);
+        }
+        hitCount = 0;
+        missCount = 0;
+        evictCount = 0;
+    }
+
+    BufferPool::~BufferPool() {
+        flushAll();
+        delete policy;
+        free(frameData);
+    }
+
+    RC BufferPool::attachFile(FileId fileId, PageIO *io) {
+        if (files.find(fileId) != files.end()) {
+            // already attached
+            return -1;
+        }
+        files[fileId] = io;
+        return 0;
+    }
+
+    RC BufferPool::detachFile(FileId fileId) {
+        RC rc = flushFile(fileId);
+        files.erase(fileId);
+        return rc;
+    }
+
+    RC BufferPool::readFromDisk(FileId fileId, PageNum pageNum, char *data) {
+        auto it = files.find(fileId);
+        if (it == files.end()) {
+            // file not attached
+            return -1;
+        }
+        return it->second->readAt((long long) (pageNum + 1) * PAGE_SIZE, data, PAGE_SIZE);
+    }
+
+    RC BufferPool::writeToDisk(FileId fileId, PageNum pageNum, const char *data) {
+        auto it = files.find(fileId);
+        if (it == files.end()) {
+            return -1;
+        }
+        return it->second->writeAt((long long) (pageNum + 1) * PAGE_SIZE, data, PAGE_SIZE);
+    }
+
+    RC BufferPool::writeBack(FrameId frameId) {
+        Frame &frame = frames[frameId];
+        if (!frame.valid || !frame.dirty) {
+            return 0;
+        }
+        if (writeToDisk(frame.fileId, frame.pageNum, frameOf(frameId)) != 0) {
+            return -1;
+        }
+        frame.dirty = false;
+        return 0;
+    }
+
+    RC BufferPool::getFreeFrame(FrameId &frameId) {
+        if (!freeFrames.empty()) {
+            frameId = freeFrames.back();
+            freeFrames.pop_back();
+            return 0;
+        }
+        if (policy->victim(frameId) != 0) {
+            // every frame is pinned
+            return -1;
+        }
+        if (writeBack(frameId) != 0) {
+            policy->setEvictable(frameId, true);
+            return -1;
+        }
+        pageTable.erase(pageKey(frames[frameId].fileId, frames[frameId].pageNum));
+        frames[frameId].valid = false;
+        evictCount++;
+        return 0;
+    }
+
+    RC BufferPool::fetchPage(FileId fileId, PageNum pageNum, char *&frame, bool loadPage) {
+        unsigned long long key = pageKey(fileId, pageNum);
+        auto it = pageTable.find(key);
+        if (it != pageTable.end()) {
+            FrameId frameId = it->second;
+            frames[frameId].pinCount++;
+            policy->recordAccess(frameId);
+            policy->setEvictable(frameId, false);
+            frame = frameOf(frameId);
+            hitCount++;
+            return 0;
+        }
+
+        FrameId frameId;
+        if (getFreeFrame(frameId) != 0) {
+            return -1;
+        }
+        if (loadPage && readFromDisk(fileId, pageNum, frameOf(frameId)) != 0) {
+            freeFrames.push_back(frameId);
+            return -1;
+        }
+        Frame &f = frames[frameId];
+        f.fileId = fileId;
+        f.pageNum = pageNum;
+        f.pinCount = 1;
+        f.dirty = false;
+        f.valid = true;
+        pageTable[key] = frameId;
+        policy->recordAccess(frameId);
+        policy->setEvictable(frameId, false);
+        frame = frameOf(frameId);
+        if (loadPage) {
+            missCount++;
+        }
+        return 0;
+    }
+
+    RC BufferPool::unpinPage(FileId fileId, PageNum pageNum, bool isDirty) {
+        auto it = pageTable.find(pageKey(fileId, pageNum));
+        if (it == pageTable.end()) {
+            // page not cached
+            return -1;
+        }
+        Frame &frame = frames[it->second];
+        if (frame.pinCount == 0) {
+            // unbalanced unpin
+            return -1;
+        }
+        frame.dirty = frame.dirty || isDirty;
+        if (--frame.pinCount == 0) {
+            policy->setEvictable(it->second, true);
+        }
+        return 0;
+    }
+
+    RC BufferPool::writeThrough(FileId fileId, PageNum pageNum, const void *data) {
+        if (writeToDisk(fileId, pageNum, (const char *) data) != 0) {
+            return -1;
+        }
+        char *frame;
+        if (fetchPage(fileId, pageNum, frame, false) != 0) {
+            // page is on disk, caching it is best effort
+            return 0;
+        }
+        memcpy(frame, data, PAGE_SIZE);
+        auto it = pageTable.find(pageKey(fileId, pageNum));
+        frames[it->second].dirty = false;
+        return unpinPage(fileId, pageNum, false);
+    }
+
+    RC BufferPool::prefetchPage(FileId fileId, PageNum pageNum) {
+        if (pageTable.count(pageKey(fileId, pageNum))) {
+            return 0; // already cached
+        }
+        auto it = files.find(fileId);
+        if (it == files.end()) {
+            return -1;
+        }
+        return it->second->prefetch((long long) (pageNum + 1) * PAGE_SIZE, PAGE_SIZE);
+    }
+
+    RC BufferPool::flushFile(FileId fileId) {
+        // write back in page order so the disk sees a sequential pass
+        std::vector<std::pair<PageNum, FrameId>> dirtyPages;
+        for (FrameId frameId = 0; frameId < numFrames; frameId++) {
+            if (frames[frameId].valid && frames[frameId].dirty && frames[frameId].fileId == fileId) {
+                dirtyPages.emplace_back(frames[frameId].pageNum, frameId);
+            }
+        }
+        std::sort(dirtyPages.begin(), dirtyPages.end());
+        RC rc = 0;
+        for (auto &page : dirtyPages) {
+            if (writeBack(page.second) != 0) {
+                rc = -1;
+            }
+        }
+        auto it = files.find(fileId);
+        if (it != files.end() && it->second->flush() != 0) {
+            rc = -1;
+        }
+        return rc;
+    }
+
+    RC BufferPool::flushAll() {
+        RC rc = 0;
+        for (auto &file : files) {
+            if (flushFile(file.first) != 0) {
+                rc = -1;
+            }
+        }
+        return rc;
+    }
+
+    RC BufferPool::discardFile(FileId fileId) {
+        for (FrameId frameId = 0; frameId < numFrames; frameId++) {
+            if (frames[frameId].valid && frames[frameId].fileId == fileId && frames[frameId].pinCount > 0) {
+                // still in use, drop nothing
+                return -1;
+            }
+        }
+        for (FrameId frameId = 0; frameId < numFrames; frameId++) {
+            Frame &frame = frames[frameId];
+            if (!frame.valid || frame.fileId != fileId) {
+                continue;
+            }
+            pageTable.erase(pageKey(frame.fileId, frame.pageNum));
+            policy->remove(frameId);
+            frame.valid = false;
+            frame.dirty = false;
+            freeFrames.push_back(frameId);
+        }
+        return 0;
+    }
+
+    RC BufferPool::collectStats(unsigned &hits, unsigned &misses, unsigned &evictions) const {
+        hits = hitCount;
+        misses = missCount;
+        evictions = evictCount;
+        return 0;
+    }
+
+} // namespace PeterDB
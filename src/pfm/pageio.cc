@@ -0,0 +1,294 @@
+#include "src/include/pageio.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace PeterDB {
+
+    PageIO *PageIO::create(IOBackend backend) {
+        if (backend == FSTREAM_IO) {
+            return new FstreamIO();
+        }
+        if (backend == MMAP_IO) {
+            return new MmapIO();
+        }
+        return new PosixIO();
+    }
+
+    FstreamIO::FstreamIO() {
+        file = nullptr;
+    }
+
+    FstreamIO::~FstreamIO() {
+        close();
+    }
+
+    RC FstreamIO::open(const std::string &fileName) {
+        if (file) {
+            // already open
+            return -1;
+        }
+        file = new fstream();
+        file->open(fileName.c_str(), fstream::in | fstream::out | fstream::binary);
+        if (!(*file)) {
+            //file not exist
+            delete file;
+            file = nullptr;
+            return -1;
+        }
+        return 0;
+    }
+
+    RC FstreamIO::close() {
+        if (!file) {
+            return -1;
+        }
+        file->flush();
+        file->close();
+        delete file;
+        file = nullptr;
+        return 0;
+    }
+
+    RC FstreamIO::readAt(long long offset, void *data, size_t length) {
+        file->clear();
+        file->seekg(offset, ios::beg);
+        if (!file->read(static_cast<char *>(data), length)) {
+            // read fail
+            file->clear();
+            return -1;
+        }
+        return 0;
+    }
+
+    RC FstreamIO::writeAt(long long offset, const void *data, size_t length) {
+        file->clear();
+        file->seekp(offset, ios::beg);
+        if (!file->write(static_cast<const char *>(data), length)) {
+            // write fail
+            file->clear();
+            return -1;
+        }
+        return 0;
+    }
+
+    RC FstreamIO::flush() {
+        if (!file->flush()) {
+            file->clear();
+            return -1;
+        }
+        return 0;
+    }
+
+    long long FstreamIO::size() {
+        file->clear();
+        file->seekg(0, ios::end);
+        return file->tellg();
+    }
+
+    RC FstreamIO::allocate(long long offset, long long length) {
+        // no descriptor to fallocate on, write the zeros out
+        std::vector<char> zeros(PAGE_SIZE, 0);
+        for (long long done = 0; done < length; done += PAGE_SIZE) {
+            size_t chunk = (size_t) std::min<long long>(PAGE_SIZE, length - done);
+            if (writeAt(offset + done, zeros.data(), chunk) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    PosixIO::PosixIO() {
+        fd = -1;
+    }
+
+    PosixIO::~PosixIO() {
+        close();
+    }
+
+    RC PosixIO::open(const std::string &fileName) {
+        if (fd >= 0) {
+            // already open
+            return -1;
+        }
+        fd = ::open(fileName.c_str(), O_RDWR);
+        if (fd < 0) {
+            //file not exist
+            return -1;
+        }
+        return 0;
+    }
+
+    RC PosixIO::close() {
+        if (fd < 0) {
+            return -1;
+        }
+        RC rc = ::close(fd) == 0 ? 0 : -1;
+        fd = -1;
+        return rc;
+    }
+
+    RC PosixIO::readAt(long long offset, void *data, size_t length) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pread(fd, (char *) data + done, length - done, offset + done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                // read fail, or short read at end of file
+                return -1;
+            }
+            done += n;
+        }
+        return 0;
+    }
+
+    RC PosixIO::writeAt(long long offset, const void *data, size_t length) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pwrite(fd, (const char *) data + done, length - done, offset + done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                // write fail
+                return -1;
+            }
+            done += n;
+        }
+        return 0;
+    }
+
+    RC PosixIO::flush() {
+        // pwrite is unbuffered, the data is already with the kernel
+        return fd < 0 ? -1 : 0;
+    }
+
+    long long PosixIO::size() {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            return -1;
+        }
+        return st.st_size;
+    }
+
+    RC PosixIO::allocate(long long offset, long long length) {
+        // one contiguous extent instead of a page at a time
+        return posix_fallocate(fd, offset, length) == 0 ? 0 : -1;
+    }
+
+    static const long long chunkBytes = (long long) MMAP_CHUNK_PAGES * PAGE_SIZE;
+
+    RC PosixIO::prefetch(long long offset, size_t length) {
+        return posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED) == 0 ? 0 : -1;
+    }
+
+    MmapIO::MmapIO() {
+        fileSize = 0;
+    }
+
+    MmapIO::~MmapIO() {
+        close();
+    }
+
+    RC MmapIO::open(const std::string &fileName) {
+        if (file.open(fileName) != 0) {
+            return -1;
+        }
+        fileSize = file.size();
+        return 0;
+    }
+
+    RC MmapIO::close() {
+        for (char *chunk : chunks) {
+            if (chunk) {
+                munmap(chunk, chunkBytes);
+            }
+        }
+        chunks.clear();
+        return file.close();
+    }
+
+    char *MmapIO::address(long long offset, size_t length) {
+        if (offset < 0 || offset + (long long) length > fileSize) {
+            // touching a mapped page past end of file raises SIGBUS
+            return nullptr;
+        }
+        size_t chunkInd = offset / chunkBytes;
+        if ((offset + (long long) length - 1) / chunkBytes != (long long) chunkInd) {
+            // spans two chunks, never the case for a page
+            return nullptr;
+        }
+        if (chunkInd >= chunks.size()) {
+            chunks.resize(chunkInd + 1, nullptr);
+        }
+        if (!chunks[chunkInd]) {
+            // the chunk may reach past end of file; those pages become usable as the file grows
+            void *chunk = mmap(nullptr, chunkBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.descriptor(),
+                               (off_t) chunkInd * chunkBytes);
+            if (chunk == MAP_FAILED) {
+                return nullptr;
+            }
+            chunks[chunkInd] = (char *) chunk;
+        }
+        return chunks[chunkInd] + offset % chunkBytes;
+    }
+
+    RC MmapIO::readAt(long long offset, void *data, size_t length) {
+        char *src = address(offset, length);
+        if (!src) {
+            return file.readAt(offset, data, length);
+        }
+        memcpy(data, src, length);
+        return 0;
+    }
+
+    RC MmapIO::writeAt(long long offset, const void *data, size_t length) {
+        char *dst = address(offset, length);
+        if (!dst) {
+            // extending the file
+            if (file.writeAt(offset, data, length) != 0) {
+                return -1;
+            }
+            fileSize = std::max(fileSize, offset + (long long) length);
+            return 0;
+        }
+        memcpy(dst, data, length);
+        return 0;
+    }
+
+    RC MmapIO::flush() {
+        // the mapping is shared, stores are already in the page cache
+        return 0;
+    }
+
+    long long MmapIO::size() {
+        return fileSize;
+    }
+
+    RC MmapIO::allocate(long long offset, long long length) {
+        if (file.allocate(offset, length) != 0) {
+            return -1;
+        }
+        fileSize = std::max(fileSize, offset + length);
+        return 0;
+    }
+
+    char *MmapIO::mapPage(long long offset) {
+        return address(offset, PAGE_SIZE);
+    }
+
+    RC MmapIO::prefetch(long long offset, size_t length) {
+        // the mapping is backed by the same page cache
+        return file.prefetch(offset, length);
+    }
+
+} // namespace PeterDB
@@ -1,4 +1,9 @@
 #include "src/include/pfm.h"
+#include "src/include/bufferpool.h"
+#include "src/include/pageio.h"
+
+#include <algorithm>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -8,15 +13,83 @@ namespace PeterDB {
         return _pf_manager;
     }
 
-    PagedFileManager::PagedFileManager() = default;
+    static bool statFile(const std::string &fileName, FileStamp &stamp) {
+        struct stat st;
+        if (stat(fileName.c_str(), &st) != 0) {
+            return false;
+        }
+        stamp.inode = st.st_ino;
+        stamp.size = st.st_size;
+        stamp.mtime = (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        return true;
+    }
 
-    PagedFileManager::~PagedFileManager() = default;
+    // page 0 holds the FileHeader at its start and the counters at its end
+    static RC loadHeader(OpenFile *openFile, FileHeader &header) {
+        if (openFile->io->readAt(0, &header, sizeof(FileHeader)) != 0) {
+            // fail to read the header page
+            return -1;
+        }
+        return 0;
+    }
+
+    static RC loadCounters(OpenFile *openFile) {
+        unsigned counters[3];
+        if (openFile->io->readAt(PAGE_SIZE - sizeof(counters), counters, sizeof(counters)) != 0) {
+            // file to read read/write/append counter
+            return -1;
+        }
+        openFile->readPageCounter = counters[0];
+        openFile->writePageCounter = counters[1];
+        openFile->appendPageCounter = counters[2];
+        return 0;
+    }
+
+    // the high-water mark changes with the counters, so both are written together
+    static RC storeCounters(OpenFile *openFile) {
+        FileHeader header = {FILE_HEADER_MAGIC, PAGE_SIZE, openFile->npages};
+        unsigned counters[3] = {openFile->readPageCounter, openFile->writePageCounter, openFile->appendPageCounter};
+        if (openFile->io->writeAt(0, &header, sizeof(FileHeader)) != 0 ||
+            openFile->io->writeAt(PAGE_SIZE - sizeof(counters), counters, sizeof(counters)) != 0) {
+            // fail to write read/write/append counter
+            return -1;
+        }
+        return 0;
+    }
+
+    PagedFileManager::PagedFileManager() {
+        bufferPool = new BufferPool(DEFAULT_POOL_FRAMES, CLOCK_POLICY);
+        nextFileId = 1;
+        nextOpenId = 1;
+        extentPages = DEFAULT_EXTENT_PAGES;
+        handleCacheSize = DEFAULT_HANDLE_CACHE;
+        handleClock = 0;
+    }
+
+    PagedFileManager::~PagedFileManager() {
+        // write back whatever is still open at exit
+        for (auto &it : cachedHandles) {
+            delete it.second.fileHandle;
+        }
+        for (auto &dropped : droppedHandles) {
+            delete dropped.fileHandle;
+        }
+        for (auto &it : openFiles) {
+            storeCounters(it.second);
+            bufferPool->detachFile(it.second->fileId);
+            delete it.second->io;
+        }
+        delete bufferPool;
+    }
 
     PagedFileManager::PagedFileManager(const PagedFileManager &) = default;
 
     PagedFileManager &PagedFileManager::operator=(const PagedFileManager &) = default;
 
     RC PagedFileManager::createFile(const std::string &fileName) {
+        // a cached handle could still be on a file of this name removed behind our back
+        dropCachedHandle(fileName);
+
         // file handler
         fstream fs;
         fs.open(fileName, ios::in | ios::binary);
@@ -29,6 +102,10 @@ namespace PeterDB {
             return -1;
         }
         else {
+            if (forgetFile(fileName) != 0) {
+                // pages of an earlier file by this name are still pinned
+                return -1;
+            }
             // create empty-page file, out mode
             fs.open(fileName, ios::out | ios::binary);
             if (fs.is_open()){
@@ -43,6 +120,8 @@ namespace PeterDB {
     }
 
     RC PagedFileManager::destroyFile(const std::string &fileName) {
+        dropCachedHandle(fileName);
+
         // file handler
         fstream fs;
         fs.open(fileName, ios::in | ios::binary);
@@ -52,6 +131,10 @@ namespace PeterDB {
             if (fs.is_open()) {
                 fs.close();
             }
+            if (forgetFile(fileName) != 0) {
+                // its pages are still pinned
+                return -1;
+            }
             // filename converts to a pointer
             if (remove(fileName.c_str()) != 0) {
                 return -1;
@@ -67,221 +150,534 @@ namespace PeterDB {
     }
 
     RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
+        auto it = openFiles.find(fileName);
+        return openFile(fileName, fileHandle, it != openFiles.end() ? it->second->backend : POSIX_IO);
+    }
+
+    RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, IOBackend backend) {
+        if (fileHandle.openId != 0 && lookup(fileHandle.openId) != nullptr) {
+            return -2; // duplicate open
+        }
+
+        OpenFile *openFile;
+        auto it = openFiles.find(fileName);
+        if (it != openFiles.end()) {
+            // share the backend and page count with the handles already open on this file
+            openFile = it->second;
+            if (openFile->backend != backend) {
+                return -4; // open with another backend
+            }
+        } else {
+            PageIO *io = PageIO::create(backend);
+            if (io->open(fileName) != 0) {
+                //file not exist
+                delete io;
+                return -1;
+            }
+
+            openFile = new OpenFile;
+            openFile->fileName = fileName;
+            openFile->fileId = getFileId(fileName);
+            openFile->backend = backend;
+            openFile->io = io;
+            openFile->openCount = 0;
+            openFile->pageSize = PAGE_SIZE;
+            openFile->extentPages = extentPages;
+            openFile->readPageCounter = 0;
+            openFile->writePageCounter = 0;
+            openFile->appendPageCounter = 0;
+
+            // pages cached from an earlier open are only reused if nobody touched the file since;
+            // under MMAP_IO the mapping is the cache, frames left from a pooled open would go stale
+            FileStamp stamp;
+            auto closed = closedFiles.find(openFile->fileId);
+            bool stale = closed != closedFiles.end() &&
+                         (!statFile(fileName, stamp) || stamp.inode != closed->second.inode ||
+                          stamp.size != closed->second.size || stamp.mtime != closed->second.mtime);
+            if ((stale || backend == MMAP_IO) && bufferPool->discardFile(openFile->fileId) != 0) {
+                // those pages are still pinned
+                io->close();
+                delete io;
+                delete openFile;
+                return -5;
+            }
+            if (closed != closedFiles.end()) {
+                closedFiles.erase(closed);
+            }
 
-        auto *fs = new fstream();
-        fs->open(fileName.c_str(),fstream::in | fstream::out | fstream::binary);
-        if(!(*fs)){
-            //file not exist
+            long long size = io->size();
+            openFile->allocatedPages = size < 2 * PAGE_SIZE ? 0 : (unsigned) (size / PAGE_SIZE - 1);
+            openFile->npages = openFile->allocatedPages;
+            if (size == 0) {
+                // brand new file, lay down the header page
+                storeCounters(openFile);
+            } else {
+                FileHeader header;
+                if (loadHeader(openFile, header) == 0 && header.magic == FILE_HEADER_MAGIC) {
+                    if (header.pageSize != PAGE_SIZE) {
+                        // written by a build with another page size, the page layouts would not line up
+                        io->close();
+                        delete io;
+                        delete openFile;
+                        return -3;
+                    }
+                    if (header.npages < openFile->npages) {
+                        // the rest is preallocated space
+                        openFile->npages = header.npages;
+                    }
+                }
+                if (loadCounters(openFile) == 0) {
+                    // reading the hidden page counts as a page read
+                    openFile->readPageCounter++;
+                }
+            }
+            bufferPool->attachFile(openFile->fileId, io);
+            openFiles[fileName] = openFile;
+        }
+
+        openFile->openCount++;
+        fileHandle.fileId = openFile->fileId;
+        fileHandle.openId = nextOpenId++;
+        liveHandles[fileHandle.openId] = openFile;
+
+        fileHandle.npages = openFile->npages;
+        return 0;
+    }
+
+    RC PagedFileManager::closeFile(FileHandle &fileHandle) {
+        auto it = liveHandles.find(fileHandle.openId);
+        if (fileHandle.openId == 0 || it == liveHandles.end()) {
+            // file not open, or already closed through a copy of this handle
             return -1;
         }
-        return fileHandle.openFile(fs);
+        OpenFile *openFile = it->second;
+        liveHandles.erase(it);
+        fileHandle.openId = 0;
+
+        if (--openFile->openCount > 0) {
+            return 0;
+        }
+
+        // last handle on this file: persist counters and write back dirty pages, clean ones stay cached
+        RC rc = storeCounters(openFile);
+        if (bufferPool->detachFile(openFile->fileId) != 0) {
+            rc = -1;
+        }
+        openFile->io->close();
+        delete openFile->io;
+
+        FileStamp stamp;
+        auto current = openFiles.find(openFile->fileName);
+        if (current != openFiles.end() && current->second == openFile && statFile(openFile->fileName, stamp)) {
+            closedFiles[openFile->fileId] = stamp;
+            openFiles.erase(current);
+        } else {
+            // the file was destroyed or replaced while open, its pages are of no use anymore
+            if (bufferPool->discardFile(openFile->fileId) != 0) {
+                // a page of it is still referenced
+                rc = -1;
+            }
+        }
+        delete openFile;
+        return rc;
     }
 
-/*    RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
+    RC PagedFileManager::configureBufferPool(unsigned numFrames, ReplacementPolicyType policyType) {
+        closeIdleHandles();
+        if (numFrames == 0 || !openFiles.empty()) {
+            return -1;
+        }
+        delete bufferPool;
+        bufferPool = new BufferPool(numFrames, policyType);
+        closedFiles.clear();
+        return 0;
+    }
+
+    BufferPool &PagedFileManager::getBufferPool() {
+        return *bufferPool;
+    }
 
-        fstream *fs = new fstream();
-        fs->open(fileName.c_str(),fstream::in | fstream::out | fstream::binary);
-        if(!(*fs)){
-            //file not exist
-            delete fs;
+    RC PagedFileManager::setExtentSize(unsigned numPages) {
+        if (numPages == 0) {
             return -1;
         }
-        RC rc = fileHandle.openFile(fs);
-        delete fs;
+        extentPages = numPages;
+        return 0;
+    }
+
+    RC PagedFileManager::checkpoint() {
+        RC rc = 0;
+        for (auto &it : openFiles) {
+            if (storeCounters(it.second) != 0 || bufferPool->flushFile(it.second->fileId) != 0) {
+                rc = -1;
+            }
+        }
         return rc;
-    }*/
+    }
 
-    RC PagedFileManager::closeFile(FileHandle &fileHandle) {
-        return fileHandle.closeFile();
+    RC PagedFileManager::acquireFile(const std::string &fileName, FileHandle &fileHandle) {
+        auto it = cachedHandles.find(fileName);
+        if (it == cachedHandles.end()) {
+            auto *cached = new FileHandle;
+            if (openFile(fileName, *cached) != 0) {
+                delete cached;
+                return -1;
+            }
+            it = cachedHandles.insert(std::make_pair(fileName, CachedHandle{cached, 0, 0})).first;
+        }
+        it->second.refCount++;
+        it->second.lastUse = ++handleClock;
+        fileHandle = *it->second.fileHandle;
+        trimHandleCache();
+        return 0;
+    }
+
+    RC PagedFileManager::releaseFile(FileHandle &fileHandle) {
+        unsigned openId = fileHandle.openId;
+        if (openId == 0) {
+            return -1; // not acquired
+        }
+        for (auto &it : cachedHandles) {
+            if (it.second.fileHandle->openId == openId && it.second.refCount > 0) {
+                it.second.refCount--;
+                fileHandle.openId = 0;
+                trimHandleCache();
+                return 0;
+            }
+        }
+        for (auto dropped = droppedHandles.begin(); dropped != droppedHandles.end(); dropped++) {
+            if (dropped->fileHandle->openId == openId) {
+                fileHandle.openId = 0;
+                if (--dropped->refCount > 0) {
+                    return 0;
+                }
+                RC rc = closeFile(*dropped->fileHandle);
+                delete dropped->fileHandle;
+                droppedHandles.erase(dropped);
+                return rc;
+            }
+        }
+        return -1; // not from the cache
+    }
+
+    RC PagedFileManager::setHandleCacheSize(unsigned numHandles) {
+        if (numHandles == 0) {
+            return -1;
+        }
+        handleCacheSize = numHandles;
+        trimHandleCache();
+        return 0;
+    }
+
+    RC PagedFileManager::closeIdleHandles() {
+        RC rc = 0;
+        for (auto it = cachedHandles.begin(); it != cachedHandles.end();) {
+            if (it->second.refCount > 0) {
+                it++;
+                continue;
+            }
+            if (closeFile(*it->second.fileHandle) != 0) {
+                rc = -1;
+            }
+            delete it->second.fileHandle;
+            it = cachedHandles.erase(it);
+        }
+        return rc;
+    }
+
+    void PagedFileManager::dropCachedHandle(const std::string &fileName) {
+        auto it = cachedHandles.find(fileName);
+        if (it == cachedHandles.end()) {
+            return;
+        }
+        if (it->second.refCount > 0) {
+            droppedHandles.push_back(it->second);
+        } else {
+            closeFile(*it->second.fileHandle);
+            delete it->second.fileHandle;
+        }
+        cachedHandles.erase(it);
+    }
+
+    void PagedFileManager::trimHandleCache() {
+        while (cachedHandles.size() > handleCacheSize) {
+            auto victim = cachedHandles.end();
+            for (auto it = cachedHandles.begin(); it != cachedHandles.end(); it++) {
+                if (it->second.refCount == 0 && (victim == cachedHandles.end() || it->second.lastUse < victim->second.lastUse)) {
+                    victim = it;
+                }
+            }
+            if (victim == cachedHandles.end()) {
+                return; // all in use
+            }
+            closeFile(*victim->second.fileHandle);
+            delete victim->second.fileHandle;
+            cachedHandles.erase(victim);
+        }
+    }
+
+    FileId PagedFileManager::getFileId(const std::string &fileName) {
+        auto it = fileIds.find(fileName);
+        if (it != fileIds.end()) {
+            return it->second;
+        }
+        FileId fileId = nextFileId++;
+        fileIds[fileName] = fileId;
+        return fileId;
+    }
+
+    RC PagedFileManager::forgetFile(const std::string &fileName) {
+        auto it = fileIds.find(fileName);
+        if (it == fileIds.end()) {
+            return 0;
+        }
+        if (openFiles.find(fileName) != openFiles.end()) {
+            // handles still open on the old file keep working on it, but a new open of this name starts afresh
+            openFiles.erase(fileName);
+        } else {
+            if (bufferPool->discardFile(it->second) != 0) {
+                // pinned pages, keep the id so they are not mistaken for another file's
+                return -1;
+            }
+            closedFiles.erase(it->second);
+        }
+        fileIds.erase(it);
+        return 0;
+    }
+
+    OpenFile *PagedFileManager::lookup(unsigned openId) {
+        auto it = liveHandles.find(openId);
+        if (it == liveHandles.end()) {
+            return nullptr;
+        }
+        return it->second;
     }
 
     FileHandle::FileHandle() {
         readPageCounter = 0;
         writePageCounter = 0;
         appendPageCounter = 0;
-        isOpen = false;
+        npages = 0;
+        fileId = 0;
+        openId = 0;
     }
 
     FileHandle::~FileHandle() = default;
 
+    static long long pageOffset(PageNum pageNum) {
+        // skip the hidden header page
+        return (long long) (pageNum + 1) * PAGE_SIZE;
+    }
+
     RC FileHandle::readPage(PageNum pageNum, void *data) {
-        if (_file->is_open()) {
-            unsigned pages_total_num = getNumberOfPages();
-            if (pageNum > pages_total_num) {
-                // overflow
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
+            // file not open, read fail
+            return -1;
+        }
+        if (pageNum >= openFile->npages) {
+            // overflow
+            return -1;
+        }
+        if (openFile->backend == MMAP_IO) {
+            if (openFile->io->readAt(pageOffset(pageNum), data, PAGE_SIZE) != 0) {
                 return -1;
-            } else {
-                //locate the to-read page head
-                _file->seekg((pageNum+1) * PAGE_SIZE, ios::beg);
-
-                if (!_file->read(static_cast<char*>(data), PAGE_SIZE)) {
-                    // read fail
-                    return -1;
-                } else {
-                    readPageCounter++;
-                    writeCounterValues();
-                    return 0;
-                }
             }
-        } else {
-            // file not open, read fail
+            openFile->readPageCounter++;
+            return 0;
+        }
+        BufferPool &bufferPool = PagedFileManager::instance().getBufferPool();
+        char *frame;
+        if (bufferPool.fetchPage(fileId, pageNum, frame) != 0) {
+            // read fail
             return -1;
         }
+        memcpy(data, frame, PAGE_SIZE);
+        bufferPool.unpinPage(fileId, pageNum, false);
+        openFile->readPageCounter++;
+        return 0;
     }
 
     RC FileHandle::writePage(PageNum pageNum, const void *data) {
-        if (_file->is_open()) {
-            unsigned pages_total_num = getNumberOfPages();
-            if (pageNum>pages_total_num) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
+            // file not open, write fail
+            return -1;
+        }
+        if (pageNum >= openFile->npages) {
+            return -1;
+        }
+        if (openFile->backend == MMAP_IO) {
+            if (openFile->io->writeAt(pageOffset(pageNum), data, PAGE_SIZE) != 0) {
                 return -1;
-            } else {
-                //locate the to-write page head
-                _file->seekg((pageNum+1) * PAGE_SIZE, ios::beg);
-                if (!_file->write((char*)(data), PAGE_SIZE)) {
-                    // write fail
-                    return -1;
-                } else {
-                    _file->flush();
-                    writePageCounter++;
-                    writeCounterValues();
-                    return 0;
-                }
             }
-        } else {
-            // file not open, write fail
+            openFile->writePageCounter++;
+            return 0;
+        }
+        // the whole page is overwritten, no need to read it in first
+        BufferPool &bufferPool = PagedFileManager::instance().getBufferPool();
+        char *frame;
+        if (bufferPool.fetchPage(fileId, pageNum, frame, false) != 0) {
+            // write fail
             return -1;
         }
+        memcpy(frame, data, PAGE_SIZE);
+        bufferPool.unpinPage(fileId, pageNum, true);
+        openFile->writePageCounter++;
+        return 0;
     }
 
     RC FileHandle::appendPage(const void *data) {
-        if (!_file->good()) {
-            // write new page fail
-            return -5;
-        }
-        if (_file->is_open()) {
-            unsigned pageNum = getNumberOfPages() + 1;
-
-            //locate the to-write page head
-            _file->seekg(pageNum*PAGE_SIZE, ios::beg);
-            _file->write(static_cast<const char *>(data), PAGE_SIZE);
-            _file->seekg(0, ios::beg);
-            _file->flush();
-            appendPageCounter++;
-            npages++;
-            writeCounterValues();
-            return 0;
-//            if (!_file->good()){
-//                // write new page fail
-//                return -3;
-//            } else {
-//                _file->seekg(0, ios::beg);
-//                if (!_file->flush()) {
-//                    return -4;
-//                } else {
-//                    appendPageCounter++;
-//                    npages++;
-//                    writeCounterValues();
-//                    return 0;
-//                }
-//            }
-        } else {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
             // file not open, write fail
             return -1;
         }
-    }
-
-    unsigned FileHandle::getNumberOfPages() {
-        // This method returns the total number of pages currently in the file.
-
-        return npages;
-
-    }
+        if (openFile->npages >= openFile->allocatedPages && openFile->extentPages > 1) {
+            // out of preallocated pages, reserve the next extent in one go
+            if (openFile->io->allocate(pageOffset(openFile->allocatedPages),
+                                       (long long) openFile->extentPages * PAGE_SIZE) != 0) {
+                return -1;
+            }
+            openFile->allocatedPages += openFile->extentPages;
+        }
 
-    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount) {
-        readCounterValues();
-        readPageCount = this->readPageCounter;
-        writePageCount = this->writePageCounter;
-        appendPageCount = this->appendPageCounter;
+        // appends go to disk right away so the file grows with the page count
+        if (openFile->backend == MMAP_IO) {
+            if (openFile->io->writeAt(pageOffset(openFile->npages), data, PAGE_SIZE) != 0) {
+                return -1;
+            }
+        } else {
+            BufferPool &bufferPool = PagedFileManager::instance().getBufferPool();
+            if (bufferPool.writeThrough(fileId, openFile->npages, data) != 0) {
+                return -1;
+            }
+            openFile->io->flush();
+        }
+        openFile->appendPageCounter++;
+        openFile->npages++;
+        openFile->allocatedPages = std::max(openFile->allocatedPages, openFile->npages);
+        npages = openFile->npages;
         return 0;
     }
 
-    RC FileHandle::readCounterValues() {
-        // read file first 4Byte data, which is the counter data, to the FileHandle instance
-        _file->seekg(PAGE_SIZE - 3 * sizeof(unsigned), ios::beg);
-        _file->read((char*)&readPageCounter, sizeof(unsigned));
-        _file->read((char*)&writePageCounter, sizeof(unsigned));
-        _file->read((char*)&appendPageCounter, sizeof(unsigned));
-        if (_file->good()) {
-            return 0;
+    RC FileHandle::readPageRef(PageNum pageNum, const void *&page) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
+            // file not open, read fail
+            return -1;
         }
-        else {
-            // file to read read/write/append counter
+        if (pageNum >= openFile->npages) {
             return -1;
         }
+        if (openFile->backend == MMAP_IO) {
+            page = openFile->io->mapPage(pageOffset(pageNum));
+            if (!page) {
+                // mapping fail
+                return -1;
+            }
+        } else {
+            char *frame;
+            if (PagedFileManager::instance().getBufferPool().fetchPage(fileId, pageNum, frame) != 0) {
+                return -1;
+            }
+            page = frame;
+        }
+        openFile->readPageCounter++;
+        return 0;
     }
 
-    RC FileHandle::writeCounterValues() {
-        // read file first 4Byte data, which is the counter data, to the FileHandle instance
-        _file->seekg(PAGE_SIZE - 3 * sizeof(unsigned), ios::beg);
-        _file->write((char*)&readPageCounter, sizeof(unsigned));
-        _file->write((char*)&writePageCounter, sizeof(unsigned));
-        _file->write((char*)&appendPageCounter, sizeof(unsigned));
-        if (_file->good()) {
-            return 0;
+    RC FileHandle::releasePageRef(PageNum pageNum) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
+            // closed through a copy of this handle while the page was held, the frame is still pinned
+            return PagedFileManager::instance().getBufferPool().unpinPage(fileId, pageNum, false);
         }
-        else {
-            // fail to write read/write/append counter
-            return -1;
+        if (openFile->backend == MMAP_IO) {
+            // mapped pages stay until close
+            return 0;
         }
+        return PagedFileManager::instance().getBufferPool().unpinPage(fileId, pageNum, false);
     }
 
-    RC FileHandle::initCounterValues() {
-        writeCounterValues();
-        if (_file->good()) {
-            return 0;
-        } else {
+    RC FileHandle::setExtentSize(unsigned numPages) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile || numPages == 0) {
             return -1;
         }
+        openFile->extentPages = numPages;
+        return 0;
     }
 
-    RC FileHandle::openFile(fstream* file) {
-        if (!file) {
+    unsigned FileHandle::getExtentSize() {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        return openFile ? openFile->extentPages : 0;
+    }
+
+    RC FileHandle::prefetchPage(PageNum pageNum) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile || pageNum >= openFile->npages) {
             return -1;
         }
-
-        if (isOpen) {
-            return -2; // duplicate open
+        if (openFile->backend == MMAP_IO) {
+            return openFile->io->prefetch(pageOffset(pageNum), PAGE_SIZE);
         }
+        return PagedFileManager::instance().getBufferPool().prefetchPage(fileId, pageNum);
+    }
 
-        _file = file;
+    unsigned FileHandle::getNumberOfPages() {
+        // This method returns the total number of pages currently in the file.
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (openFile) {
+            npages = openFile->npages;
+        }
+        return npages;
 
-        //_file->copyfmt(*file); // not sure
+    }
 
-        _file->seekg(0, ios::end);
+    unsigned FileHandle::getPageSize() {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        return openFile ? openFile->pageSize : PAGE_SIZE;
+    }
 
-        if (_file->tellg() == 0) {
-            initCounterValues();
+    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount) {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (openFile) {
+            readPageCounter = openFile->readPageCounter;
+            writePageCounter = openFile->writePageCounter;
+            appendPageCounter = openFile->appendPageCounter;
         }
-        npages = _file->tellg() / PAGE_SIZE - 1;
-//        _file->seekg(PAGE_SIZE, ios::beg);
-        readCounterValues();
-        isOpen = true;
+        readPageCount = this->readPageCounter;
+        writePageCount = this->writePageCounter;
+        appendPageCount = this->appendPageCounter;
         return 0;
     }
 
-    RC FileHandle::closeFile() {
-        if (!(_file->is_open())) {
-            // file not open
+    RC FileHandle::readCounterValues() {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile || loadCounters(openFile) != 0) {
             return -1;
         }
-        if(!isOpen)
+        readPageCounter = openFile->readPageCounter;
+        writePageCounter = openFile->writePageCounter;
+        appendPageCounter = openFile->appendPageCounter;
+        return 0;
+    }
+
+    RC FileHandle::writeCounterValues() {
+        OpenFile *openFile = PagedFileManager::instance().lookup(openId);
+        if (!openFile) {
             return -1;
+        }
+        return storeCounters(openFile);
+    }
 
-        _file->flush();
-        _file->close();
-        delete(_file);
-        isOpen = false;
-        return 0;
+    RC FileHandle::initCounterValues() {
+        return writeCounterValues();
+    }
+
+    RC FileHandle::closeFile() {
+        return PagedFileManager::instance().closeFile(*this);
     }
 
 } // namespace PeterDB
\ No newline at end of file
@@ -3,11 +3,31 @@
 
 namespace PeterDB {
 
+    //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< Iterator >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>//
+
+    RC Iterator::getNextBatch(RecordBatch &batch) {
+        std::vector<Attribute> attrs;
+        getAttributes(attrs);
+        batch.reset(attrs);
+
+        std::vector<char> tuple(PAGE_SIZE);
+        RID rid = {0, 0};   // rows built by an operator have no rid
+        while (!batch.isFull() && getNextTuple(tuple.data()) == 0) {
+            batch.appendTuple(rid, tuple.data());
+        }
+        return batch.getNumberOfRows() > 0 ? 0 : QE_EOF;
+    }
+
     //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< Filter >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>//
 
     Filter::Filter(Iterator *input, const Condition &condition) {
         this->input = input;
         this->condition = condition;
+
+        std::vector<Attribute> lhsAttrs;
+        input->getAttributes(lhsAttrs);
+        this->layout = RecordLayout(lhsAttrs);
+        this->lhsIndex = layout.getFieldIndex(condition.lhsAttr);
     }
 
     RC Filter::getNextTuple(void *data) {
@@ -21,35 +41,70 @@ namespace PeterDB {
         return 0;
     }
 
+    RC Filter::getNextBatch(RecordBatch &batch) {
+        if (condition.bRhsIsAttr || lhsIndex == -1) {
+            // not a column against a value, the row path decides the same way getNextTuple does
+            return Iterator::getNextBatch(batch);
+        }
+
+        std::vector<char> varCharValue;
+        while (input->getNextBatch(batch) == 0) {
+            const ColumnVector &column = batch.getColumn(lhsIndex);
+            if (column.type != TypeVarChar && column.type == condition.rhsValue.type) {
+                // Int and Real go through the compare kernels
+                batch.select(lhsIndex, condition.op, condition.rhsValue.data);
+                if (batch.getNumberOfRows() > 0) {
+                    return 0;
+                }
+                continue;
+            }
+            std::vector<bool> keep(batch.getNumberOfRows(), false);
+            for (unsigned row = 0; row < batch.getNumberOfRows(); row++) {
+                if (batch.isNull(lhsIndex, row)) {
+                    continue;
+                }
+                const void *lhsValue;
+                if (column.type == TypeInt) {
+                    lhsValue = &column.ints[row];
+                } else if (column.type == TypeReal) {
+                    lhsValue = &column.reals[row];
+                } else {
+                    // compLeftRightVal wants the length in front
+                    unsigned length;
+                    const char *value = batch.getVarChar(lhsIndex, row, length);
+                    varCharValue.resize(sizeof(int) + length);
+                    int len = length;
+                    memcpy(varCharValue.data(), &len, sizeof(int));
+                    memcpy(varCharValue.data() + sizeof(int), value, length);
+                    lhsValue = varCharValue.data();
+                }
+                keep[row] = compLeftRightVal(condition.rhsValue.type, this->condition, lhsValue, condition.rhsValue.data, 0, 0);
+            }
+            batch.keepRows(keep);
+            if (batch.getNumberOfRows() > 0) {
+                return 0;
+            }
+        }
+        return QE_EOF;
+    }
+
     RC Filter::getAttributes(std::vector<Attribute> &attrs) const {
         input->getAttributes(attrs);
         return 0;
     }
 
     bool Filter::isSatisfied(void *data) {
-        if (condition.bRhsIsAttr) {
-            // should be value, instead of a attribute
-            return -1;
+        if (condition.bRhsIsAttr || lhsIndex == -1) {
+            // should be value of a known attribute
+            return false;
         }
 
-        std::vector<Attribute> lhsAttrs;
-        input->getAttributes(lhsAttrs);
-
-        // get the attrType
-        attrType = condition.rhsValue.type;
-
-        void *selData = malloc(PAGE_SIZE);
-        std::vector<std::string> selAttrs;
-        selAttrs.push_back(condition.lhsAttr);
-
-        extractFromReturnedData(lhsAttrs, selAttrs, data, selData);
-
-        int leftDataOffset = ceil(double(selAttrs.size())/CHAR_BIT);
-        RC rc = compLeftRightVal(this->attrType, this->condition, selData, condition.rhsValue.data, leftDataOffset, 0);
-
-        free(selData);
-
-        return rc;
+        const char *lhsValue = layout.getField(data, lhsIndex);
+        if (lhsValue == nullptr) {
+            // null never satisfies a condition
+            return false;
+        }
+        return compLeftRightVal(condition.rhsValue.type, this->condition, lhsValue, condition.rhsValue.data, 0, 0);
     }
 
     //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< Project >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>//
@@ -62,13 +117,12 @@ namespace PeterDB {
         input->getAttributes(allAttrs);
 
         // find the matching attributes
+        layout = RecordLayout(allAttrs);
         for(const auto & attrName : attrNames){
-            for(auto & allAttr : allAttrs){
-                if(allAttr.name == attrName){
-                    projectAttrs.emplace_back(allAttr);
-                    // to the next attr name
-                    break;
-                }
+            int fieldIndex = layout.getFieldIndex(attrName);
+            if(fieldIndex != -1){
+                projectAttrs.emplace_back(allAttrs[fieldIndex]);
+                projectIndex.push_back(fieldIndex);
             }
         }
     }
@@ -85,12 +139,19 @@ namespace PeterDB {
         }
 
         // the filter by the names
-        extractFromReturnedData(this->allAttrs, this->attrNames, tuple, data);
+        layout.project(tuple, projectIndex, data);
         free(tuple);
 
         return 0;
     }
 
+    RC Project::getNextBatch(RecordBatch &batch) {
+        if (input->getNextBatch(batch) != 0) {
+            return QE_EOF;
+        }
+        return batch.keepColumns(projectIndex);
+    }
+
     RC Project::getAttributes(std::vector<Attribute> &attrs) const {
         attrs.clear();
         attrs = projectAttrs;
@@ -113,13 +174,18 @@ namespace PeterDB {
         this->leftTableisOver = false;
         this->isFirstTime = true;
         this->restart = false;
-        this->lhsOffset = 0;
-        this->rhsOffset = 0;
+
+        this->lhsLayout = RecordLayout(lhsAttributes);
+        this->rhsLayout = RecordLayout(rhsAttributes);
+        this->lhsIndex = lhsLayout.getFieldIndex(condition.lhsAttr);
+        this->rhsIndex = rhsLayout.getFieldIndex(condition.rhsAttr);
+        this->joinTargetType = rhsIndex == -1 ? TypeInt : rhsAttributes[rhsIndex].type;
     }
 
     RC BNLJoin::getNextTuple(void *data) {
-        if (!condition.bRhsIsAttr) {
-            // should be attribute, instead of value
+        if (!condition.bRhsIsAttr || lhsIndex == -1 || rhsIndex == -1
+            || lhsAttributes[lhsIndex].type != joinTargetType) {
+            // should be attributes of the same type, instead of value
             return -1;
         }
 
@@ -135,26 +201,6 @@ namespace PeterDB {
 
             rm.printTuple(rhsAttributes, rhsTupleData, std::cout);
 
-            rhsOffset = ceil((double(rhsAttributes.size()) / CHAR_BIT));
-            for (auto &attr : rhsAttributes) {
-                int stepLen = 0;
-                if (attr.type == TypeVarChar) {
-                    // we need to add the varchar length to the offset
-                    int varCharLen = 0;
-                    memcpy(&varCharLen, (char *) rhsTupleData + rhsOffset, 4);
-                    stepLen += varCharLen;
-                }
-
-                stepLen += 4;
-
-                if (attr.name == condition.rhsAttr) {
-                    joinTargetType = attr.type;
-                    break;
-                }
-
-                rhsOffset += stepLen;
-            }
-
             loadBlockBuffer(true);
         }
 
@@ -280,50 +326,8 @@ namespace PeterDB {
             // copy the tuple to our vector for later use.
             leftTable.emplace_back(lhsTupleData);
 
-            // Find the attribute's offset of this tuple
-            lhsOffset = ceil((double(lhsAttributes.size())/CHAR_BIT));
-            for(auto &attr : lhsAttributes){
-                int stepLen = 0;
-                if(attr.type == TypeVarChar){
-                    // we need to add the varchar length to the offset
-                    int varCharLen = 0;
-                    memcpy(&varCharLen, (char*)lhsTupleData + lhsOffset, 4);
-                    stepLen += varCharLen;
-                }
-
-                stepLen += 4;
-
-                if(attr.name == condition.lhsAttr){
-                    // matched
-                    if(attr.type != joinTargetType){
-                        return -1;
-                    }
-                    break;
-                }
-
-                lhsOffset += stepLen;
-            }
-
             // get the joinValue and load this tuple.
-            if(joinTargetType == TypeInt){
-                int joinVal = 0;
-                memcpy(&joinVal, (char*)lhsTupleData + lhsOffset, sizeof(int));
-                intBlockBuffer.insert(std::pair<int, void*>(joinVal, lhsTupleData));
-            }
-            else if(joinTargetType == TypeReal){
-                float joinVal;
-                memcpy(&joinVal, (char*)lhsTupleData + lhsOffset, sizeof(float));
-                floatBlockBuffer.insert(std::pair<float, void*>(joinVal, lhsTupleData));
-            }
-            else{
-                // varchar
-                int varcharLen = 0;
-                char* temp;
-                memcpy(&varcharLen, (char*)lhsTupleData + lhsOffset, 4);
-                memcpy(&temp, (char*)lhsTupleData + lhsOffset + 4, varcharLen);
-                std::string joinVal(temp);
-                varcharBlockBuffer.insert(std::pair<std::string, void*>(joinVal, lhsTupleData));
-            }
+            addToBlockBuffer(lhsTupleData);
 
             totalTupleLen += getDataLength(lhsAttributes, lhsTupleData);
         }
@@ -361,25 +365,7 @@ namespace PeterDB {
             rm.printTuple(lhsAttributes, lhsTupleData, std::cout);
 
             // load this tuple.
-            if(joinTargetType == TypeInt){
-                int joinVal = 0;
-                memcpy(&joinVal, (char*)lhsTupleData + lhsOffset, sizeof(int));
-                intBlockBuffer.insert(std::pair<int, void*>(joinVal, lhsTupleData));
-            }
-            else if(joinTargetType == TypeReal){
-                float joinVal;
-                memcpy(&joinVal, (char*)lhsTupleData + lhsOffset, sizeof(float));
-                floatBlockBuffer.insert(std::pair<float, void*>(joinVal, lhsTupleData));
-            }
-            else{
-                // varchar
-                int varcharLen = 0;
-                char* temp;
-                memcpy(&varcharLen, (char*)lhsTupleData + lhsOffset, 4);
-                memcpy(&temp, (char*)lhsTupleData + lhsOffset + 4, varcharLen);
-                std::string joinVal(temp);
-                varcharBlockBuffer.insert(std::pair<std::string, void*>(joinVal, lhsTupleData));
-            }
+            addToBlockBuffer(lhsTupleData);
 
             totalTupleLen += getDataLength(lhsAttributes, lhsTupleData);
         }
@@ -401,6 +387,33 @@ namespace PeterDB {
         return 0;
     }
 
+    RC BNLJoin::addToBlockBuffer(void *tuple) {
+        const char *joinField = lhsLayout.getField(tuple, lhsIndex);
+        if(joinField == nullptr){
+            // null never joins
+            return 0;
+        }
+
+        if(joinTargetType == TypeInt){
+            int joinVal;
+            memcpy(&joinVal, joinField, sizeof(int));
+            intBlockBuffer.insert(std::pair<int, void*>(joinVal, tuple));
+        }
+        else if(joinTargetType == TypeReal){
+            float joinVal;
+            memcpy(&joinVal, joinField, sizeof(float));
+            floatBlockBuffer.insert(std::pair<float, void*>(joinVal, tuple));
+        }
+        else{
+            // varchar
+            int varcharLen;
+            memcpy(&varcharLen, joinField, sizeof(int));
+            std::string joinVal(joinField + sizeof(int), varcharLen);
+            varcharBlockBuffer.insert(std::pair<std::string, void*>(joinVal, tuple));
+        }
+        return 0;
+    }
+
     RC BNLJoin::cleanBlockBuffer() {
 
         if(joinTargetType == TypeInt){
@@ -441,6 +454,11 @@ namespace PeterDB {
     }
 
     bool BNLJoin::isBNLJoinSatisfied() {
+        const char *rhsJoinField = rhsLayout.getField(rhsTupleData, rhsIndex);
+        if(rhsJoinField == nullptr){
+            return false;
+        }
+
         // check status
         if(joinTargetType == TypeInt){
             // first, we need to check whether the hashmap is empty or full
@@ -448,7 +466,7 @@ namespace PeterDB {
                 return false;
 
             int rhsJoinVal = 0;
-            memcpy(&rhsJoinVal, (char*)rhsTupleData + rhsOffset, sizeof(int));
+            memcpy(&rhsJoinVal, rhsJoinField, sizeof(int));
             return intCurrentPos->first == rhsJoinVal;
         }
         else if(joinTargetType == TypeReal){
@@ -457,7 +475,7 @@ namespace PeterDB {
                 return false;
 
             float rhsJoinVal;
-            memcpy(&rhsJoinVal, (char*)rhsTupleData + rhsOffset, sizeof(float));
+            memcpy(&rhsJoinVal, rhsJoinField, sizeof(float));
             return floatCurrentPos->first == rhsJoinVal;
         }
         else{
@@ -465,11 +483,9 @@ namespace PeterDB {
             if(varcharCurrentPos == varcharBlockBuffer.end())
                 return false;
 
-            char* temp;
             int varCharLen = 0;
-            memcpy(&varCharLen, (char*)rhsTupleData + rhsOffset, 4);
-            memcpy(&temp, (char*)rhsTupleData + rhsOffset + 4, varCharLen);
-            std::string rhsJoinVal(temp);
+            memcpy(&varCharLen, rhsJoinField, sizeof(int));
+            std::string rhsJoinVal(rhsJoinField + sizeof(int), varCharLen);
 
             return varcharCurrentPos->first == rhsJoinVal;
         }
@@ -488,6 +504,9 @@ namespace PeterDB {
         this->leftIn->getAttributes(this->leftInAttrs);
         this->rightIn->getAttributes(this->rightInAttrs);
 
+        this->leftLayout = RecordLayout(this->leftInAttrs);
+        this->leftIndex = leftLayout.getFieldIndex(this->condition.lhsAttr);
+
         this->leftAttrName.push_back(this->condition.lhsAttr);
         this->rightAttrName.push_back(this->condition.rhsAttr);
 
@@ -518,15 +537,20 @@ namespace PeterDB {
 
             if(isNewLeftNeeded){
                 while(leftIn->getNextTuple(leftValue) != QE_EOF){
-                    extractFromReturnedData(leftInAttrs, leftAttrName, leftValue, leftAttrValue);
-                    if (((char *) leftAttrValue)[0] & (unsigned) 1 << (unsigned) 7){
+                    const char *leftKey = leftIndex == -1 ? nullptr : leftLayout.getField(leftValue, leftIndex);
+                    if (leftKey == nullptr){
                         // null
                         continue;
                     }
                     // left value
-                    int nullIndicatorSize = ceil(double(leftAttrName.size())/CHAR_BIT);
+                    int keyLength = INT_FIELD_LEN;
+                    if (leftInAttrs[leftIndex].type == TypeVarChar) {
+                        int varCharLen;
+                        memcpy(&varCharLen, leftKey, sizeof(int));
+                        keyLength += varCharLen;
+                    }
                     isNewLeftNeeded = false;
-                    memcpy(keyValue, (char *)leftAttrValue + nullIndicatorSize, PAGE_SIZE - nullIndicatorSize);
+                    memcpy(keyValue, leftKey, keyLength);
 
 //                    float keyv;
 //                    memcpy(&keyv, keyValue, sizeof(float));
@@ -551,6 +575,9 @@ namespace PeterDB {
                     break;
                     // leftIn should get a new value
                 }
+                else if(rc != 0){
+                    return rc; // the index scan could not be opened
+                }
                 else{
                     isNewRight = false;
                     concatenateData(allAttrs, leftInAttrs, rightInAttrs, leftValue, rightValue, data);
@@ -597,10 +624,16 @@ namespace PeterDB {
         this->aggAttr = aggAttr;
         this->op = op;
         this->opDone = false;
+
+        this->layout = RecordLayout(this->allAttrs);
+        this->aggIndex = layout.getFieldIndex(aggAttr.name);
     }
 
     Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, const Attribute &groupAttr, AggregateOp op) {
         // extra credits
+        this->input = input;
+        this->opDone = false;
+        this->aggIndex = -1;
     }
 
     RC Aggregate::getNextTuple(void *data) {
@@ -608,11 +641,12 @@ namespace PeterDB {
             return QE_EOF;
         }
 
-        void *selData = malloc(PAGE_SIZE);
+        if (this->aggIndex == -1) {
+            return QE_EOF;
+        }
+
         void *tuple = malloc(PAGE_SIZE);
-        std::vector<std::string> selAttrNames;
-        selAttrNames.emplace_back(this->aggAttr.name);
-        int nullIndicatorSize = ceil(double(selAttrNames.size())/CHAR_BIT);
+        int nullIndicatorSize = 1;
         int count = 0;
 
         int aggInt;
@@ -626,12 +660,16 @@ namespace PeterDB {
         }
 
         while (input->getNextTuple(tuple) == 0) {
-            extractFromReturnedData(this->allAttrs, selAttrNames, tuple, selData);
+            const char *aggValue = layout.getField(tuple, aggIndex);
+            if (aggValue == nullptr) {
+                // nulls do not take part in an aggregate
+                continue;
+            }
 
             if (this->aggAttr.type == TypeInt) {
-                doIntOp(selData, nullIndicatorSize, aggInt);
+                doIntOp((void *) aggValue, 0, aggInt);
             } else {
-                doFloatOp(selData, nullIndicatorSize, aggFloat);
+                doFloatOp((void *) aggValue, 0, aggFloat);
             }
             count++;
         }
@@ -654,8 +692,7 @@ namespace PeterDB {
             aggResult = float(count);
         }
 
-        memcpy(data, selData, nullIndicatorSize);
-        free(selData);
+        memset(data, 0, nullIndicatorSize);
         free(tuple);
 
         memcpy((char *)data+nullIndicatorSize, &aggResult, sizeof(float));
@@ -769,97 +806,12 @@ namespace PeterDB {
     //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< Helper Function >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>//
 
     RC extractFromReturnedData(const std::vector<Attribute> &attrs, const std::vector<std::string> &selAttrNames, const void *data, void *selData) {
-
-        int offsetData = 0;
-        int offsetSelData = 0;
-
-        int fieldLength = attrs.size();
-        int selAttrsLength = selAttrNames.size();
-
-        int nullIndicatorForSelAttrsSize = ceil((double(selAttrsLength) / CHAR_BIT));
-        auto *nullIndicatorForSelAttrs = (unsigned char *) malloc(nullIndicatorForSelAttrsSize);
-        // must set the memory to 0
-        memset(nullIndicatorForSelAttrs, 0, nullIndicatorForSelAttrsSize);
-        offsetSelData += nullIndicatorForSelAttrsSize;
-
-        // 3. NullIndicator
-        int nullIndicatorSize = ceil((double(fieldLength) / CHAR_BIT));
-        auto *nullsIndicator = (unsigned char *) malloc(nullIndicatorSize);
-        memcpy((char *) nullsIndicator, (char *) data, nullIndicatorSize);
-
-        // 4. iterate over attributes
-        int nullByteIndex, bitIndex, fieldIndex;
-        int varCharLen = 0;
-
-        // 5, iterate over selected attributes
-        int selAttrsIndex;
-
-        for (selAttrsIndex = 0; selAttrsIndex < selAttrsLength; selAttrsIndex++) {
-            offsetData = nullIndicatorSize;
-            for (nullByteIndex = 0; nullByteIndex < nullIndicatorSize; nullByteIndex++) {
-                for (bitIndex = 0; bitIndex < 8; bitIndex++) {
-                    fieldIndex = nullByteIndex * 8 + bitIndex;
-
-                    if (fieldIndex == fieldLength)
-                        break;
-
-                    // deal with null field
-                    if (nullsIndicator[nullByteIndex] & (unsigned) 1 << (unsigned) (7 - bitIndex)) {
-                        if (attrs[fieldIndex].name == selAttrNames[selAttrsIndex]) {
-                            nullIndicatorForSelAttrs[selAttrsIndex / CHAR_BIT] |= ((unsigned char) 1
-                                    << (unsigned) (7 - selAttrsIndex % CHAR_BIT));
-                            selAttrsIndex++;
-                        }
-                        continue;
-                    }
-
-                    switch (attrs[fieldIndex].type) {
-                        case TypeVarChar:
-                            if (attrs[fieldIndex].name == selAttrNames[selAttrsIndex]) {
-                                memcpy(&varCharLen, (char *) data + offsetData, 4);
-                                memcpy((char *) selData + offsetSelData, (char *) data + offsetData, 4 + varCharLen);
-                                offsetSelData += (4 + varCharLen);
-                            }
-                            offsetData += (4 + varCharLen);
-                            break;
-                        case TypeInt:
-                            if (attrs[fieldIndex].name == selAttrNames[selAttrsIndex]) {
-                                /* for debug
-                                int intData;
-                                memcpy(&intData, (char *)data + offsetData, sizeof(intData));
-                                std::cout << "right.D:  " << intData << std::endl;
-                                 */
-
-                                memcpy((char *) selData + offsetSelData, (char *) data + offsetData, 4);
-                                offsetSelData += 4;
-                            }
-                            offsetData += 4;
-                            break;
-                        case TypeReal:
-                            if (attrs[fieldIndex].name == selAttrNames[selAttrsIndex]) {
-                                /* for debug
-                                float floatData;
-                                memcpy(&floatData, (char *)data + offsetData, sizeof(floatData));
-                                std::cout << "right.C:  " << floatData << std::endl;
-                                 */
-
-                                memcpy((char *) selData + offsetSelData, (char *) data + offsetData, 4);
-                                offsetSelData += 4;
-                            }
-                            offsetData += 4;
-                            break;
-                        default:
-                            break;
-                    }
-
-                }
-            }
+        RecordLayout layout(attrs);
+        std::vector<int> selIndexes;
+        if (layout.getFieldIndexes(selAttrNames, selIndexes) != 0) {
+            return -1;
         }
-        // write the nullsIndicatorForAttributes back to data
-        memcpy(selData, nullIndicatorForSelAttrs, nullIndicatorForSelAttrsSize);
-        free(nullsIndicator);
-        free(nullIndicatorForSelAttrs);
-        return 0;
+        return layout.project(data, selIndexes, selData);
     }
 
     bool compLeftRightVal(AttrType attrType, Condition condition, const void *leftData, const void *rightData, int leftOffset, int rightOffset) {
@@ -995,48 +947,7 @@ namespace PeterDB {
     }
 
     int getDataLength(const std::vector<Attribute> &attrs, const void *data){
-        // fieldNumber, offset, length, fieldlength, fieldoffset -> 2 Byte -> char16_t
-
-        int offset = 0;
-        int numAttrs = attrs.size();
-        int nullIndicatorSize = ceil(double(attrs.size())/CHAR_BIT);
-        char *nullIndicator = (char *)malloc(nullIndicatorSize);
-        memcpy(nullIndicator, data, nullIndicatorSize);
-
-        offset += nullIndicatorSize;
-        int fieldIndex;
-        for(int nullByteIndex = 0; nullByteIndex < nullIndicatorSize; nullByteIndex++){
-            for(int bitIndex = 0; bitIndex < 8; bitIndex++){
-                fieldIndex = nullByteIndex * 8 + bitIndex;
-
-                // eof
-                if(fieldIndex == numAttrs)
-                    break;
-
-                // if the corresponding field is null
-                if(nullIndicator[nullByteIndex] & (unsigned) 1 << (unsigned) (7-bitIndex)){
-                    continue;
-                }
-                switch(attrs[fieldIndex].type){
-                    case TypeInt:
-                        offset += 4;
-                        break;
-                    case TypeReal:
-                        offset += 4;
-                        break;
-                    case TypeVarChar:
-                        int varCharLen;
-                        memcpy(&varCharLen, (char *)data+offset, sizeof(varCharLen));
-                        offset += 4;    // use two byte to store length, use two byte to store offset
-                        offset += varCharLen;
-                        break;
-                    default:
-                        break;
-                }
-            }
-        }
-        free(nullIndicator);
-        return offset;
+        return RecordLayout(attrs).getLength(data);
     }
 
     RC concatenateData(std::vector<Attribute> allAttributes, std::vector<Attribute> lhsAttributes,
@@ -0,0 +1,180 @@
+#include "src/include/rbfm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
+
+namespace PeterDB {
+
+    // movemask gives row 0 in the lowest bit, the selection mask wants it in the highest
+    static const unsigned char *reversedBits() {
+        static const struct ReversedBits {
+            unsigned char table[256];
+
+            ReversedBits() : table() {
+                for (unsigned byte = 0; byte < 256; byte++) {
+                    for (unsigned bit = 0; bit < CHAR_BIT; bit++) {
+                        if (byte & (1u << bit)) {
+                            table[byte] |= (unsigned char) (1u << (CHAR_BIT - 1 - bit));
+                        }
+                    }
+                }
+            }
+        } reversed;
+        return reversed.table;
+    }
+
+    template<typename T>
+    static bool compareScalar(T attr, CompOp compOp, T value) {
+        switch (compOp) {
+            case EQ_OP: return attr == value;
+            case LT_OP: return attr < value;
+            case LE_OP: return attr <= value;
+            case GT_OP: return attr > value;
+            case GE_OP: return attr >= value;
+            case NE_OP: return attr != value;
+            default: return true;
+        }
+    }
+
+    // rows [begin, count), begin is a multiple of CHAR_BIT
+    template<typename T>
+    static void selectScalar(const T *values, unsigned begin, unsigned count, CompOp compOp, T value, unsigned char *mask) {
+        for (unsigned row = begin; row < count; row++) {
+            if (row % CHAR_BIT == 0) {
+                mask[row / CHAR_BIT] = 0;
+            }
+            if (compareScalar(values[row], compOp, value)) {
+                mask[row / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT));
+            }
+        }
+    }
+
+#ifdef HAS_X86_KERNELS
+
+    // Integer compares only come as == and >, the others are their complements or swap the operands
+    __attribute__((target("avx2")))
+    static unsigned selectIntsAvx2(const int *values, unsigned count, CompOp compOp, int value, unsigned char *mask) {
+        const unsigned char *reversed = reversedBits();
+        __m256i constant = _mm256_set1_epi32(value);
+        unsigned row = 0;
+        for (; row + 8 <= count; row += 8) {
+            __m256i attrs = _mm256_loadu_si256((const __m256i *) (values + row));
+            __m256i cmp;
+            bool negate = false;
+            switch (compOp) {
+                case EQ_OP: cmp = _mm256_cmpeq_epi32(attrs, constant); break;
+                case NE_OP: cmp = _mm256_cmpeq_epi32(attrs, constant); negate = true; break;
+                case GT_OP: cmp = _mm256_cmpgt_epi32(attrs, constant); break;
+                case LE_OP: cmp = _mm256_cmpgt_epi32(attrs, constant); negate = true; break;
+                case LT_OP: cmp = _mm256_cmpgt_epi32(constant, attrs); break;
+                case GE_OP: cmp = _mm256_cmpgt_epi32(constant, attrs); negate = true; break;
+                default: cmp = _mm256_set1_epi32(-1); break;
+            }
+            unsigned bits = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+            mask[row / CHAR_BIT] = reversed[negate ? ~bits & 0xffu : bits];
+        }
+        return row;
+    }
+
+    __attribute__((target("avx2")))
+    static unsigned selectRealsAvx2(const float *values, unsigned count, CompOp compOp, float value, unsigned char *mask) {
+        const unsigned char *reversed = reversedBits();
+        __m256 constant = _mm256_set1_ps(value);
+        unsigned row = 0;
+        for (; row + 8 <= count; row += 8) {
+            __m256 attrs = _mm256_loadu_ps(values + row);
+            __m256 cmp;
+            switch (compOp) {
+                case EQ_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_EQ_OQ); break;
+                case LT_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_LT_OQ); break;
+                case LE_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_LE_OQ); break;
+                case GT_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_GT_OQ); break;
+                case GE_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_GE_OQ); break;
+                case NE_OP: cmp = _mm256_cmp_ps(attrs, constant, _CMP_NEQ_UQ); break;
+                default: cmp = _mm256_castsi256_ps(_mm256_set1_epi32(-1)); break;
+            }
+            mask[row / CHAR_BIT] = reversed[(unsigned) _mm256_movemask_ps(cmp)];
+        }
+        return row;
+    }
+
+    // SSE2 is part of x86-64, two 4-row halves make one mask byte
+    static unsigned selectIntsSse2(const int *values, unsigned count, CompOp compOp, int value, unsigned char *mask) {
+        const unsigned char *reversed = reversedBits();
+        __m128i constant = _mm_set1_epi32(value);
+        unsigned row = 0;
+        for (; row + 8 <= count; row += 8) {
+            unsigned bits = 0;
+            bool negate = false;
+            for (unsigned half = 0; half < 2; half++) {
+                __m128i attrs = _mm_loadu_si128((const __m128i *) (values + row + half * 4));
+                __m128i cmp;
+                switch (compOp) {
+                    case EQ_OP: cmp = _mm_cmpeq_epi32(attrs, constant); break;
+                    case NE_OP: cmp = _mm_cmpeq_epi32(attrs, constant); negate = true; break;
+                    case GT_OP: cmp = _mm_cmpgt_epi32(attrs, constant); break;
+                    case LE_OP: cmp = _mm_cmpgt_epi32(attrs, constant); negate = true; break;
+                    case LT_OP: cmp = _mm_cmplt_epi32(attrs, constant); break;
+                    case GE_OP: cmp = _mm_cmplt_epi32(attrs, constant); negate = true; break;
+                    default: cmp = _mm_set1_epi32(-1); break;
+                }
+                bits |= (unsigned) _mm_movemask_ps(_mm_castsi128_ps(cmp)) << (half * 4);
+            }
+            mask[row / CHAR_BIT] = reversed[negate ? ~bits & 0xffu : bits];
+        }
+        return row;
+    }
+
+    static unsigned selectRealsSse2(const float *values, unsigned count, CompOp compOp, float value, unsigned char *mask) {
+        const unsigned char *reversed = reversedBits();
+        __m128 constant = _mm_set1_ps(value);
+        unsigned row = 0;
+        for (; row + 8 <= count; row += 8) {
+            unsigned bits = 0;
+            for (unsigned half = 0; half < 2; half++) {
+                __m128 attrs = _mm_loadu_ps(values + row + half * 4);
+                __m128 cmp;
+                switch (compOp) {
+                    case EQ_OP: cmp = _mm_cmpeq_ps(attrs, constant); break;
+                    case LT_OP: cmp = _mm_cmplt_ps(attrs, constant); break;
+                    case LE_OP: cmp = _mm_cmple_ps(attrs, constant); break;
+                    case GT_OP: cmp = _mm_cmpgt_ps(attrs, constant); break;
+                    case GE_OP: cmp = _mm_cmpge_ps(attrs, constant); break;
+                    case NE_OP: cmp = _mm_cmpneq_ps(attrs, constant); break;
+                    default: cmp = _mm_castsi128_ps(_mm_set1_epi32(-1)); break;
+                }
+                bits |= (unsigned) _mm_movemask_ps(cmp) << (half * 4);
+            }
+            mask[row / CHAR_BIT] = reversed[bits];
+        }
+        return row;
+    }
+
+    static bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+#endif
+
+    void CompareKernel::selectInts(const int *values, unsigned count, CompOp compOp, int value, unsigned char *mask) {
+        unsigned done = 0;
+#ifdef HAS_X86_KERNELS
+        done = hasAvx2() ? selectIntsAvx2(values, count, compOp, value, mask)
+                         : selectIntsSse2(values, count, compOp, value, mask);
+#endif
+        selectScalar(values, done, count, compOp, value, mask);
+    }
+
+    void CompareKernel::selectReals(const float *values, unsigned count, CompOp compOp, float value, unsigned char *mask) {
+        unsigned done = 0;
+#ifdef HAS_X86_KERNELS
+        done = hasAvx2() ? selectRealsAvx2(values, count, compOp, value, mask)
+                         : selectRealsSse2(values, count, compOp, value, mask);
+#endif
+        selectScalar(values, done, count, compOp, value, mask);
+    }
+
+} // namespace PeterDB
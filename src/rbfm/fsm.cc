@@ -0,0 +1,135 @@
+#include "src/include/rbfm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace PeterDB {
+
+    static PageNum mapPageOf(PageNum pageNum) {
+        return pageNum - pageNum % (FreeSpaceMap::FSM_ENTRIES + 1);
+    }
+
+    static unsigned getBucket(const char *mapPage, unsigned entry) {
+        unsigned char byte = (unsigned char) mapPage[sizeof(FsmPageHeader) + entry / 2];
+        return entry % 2 == 0 ? byte & 0x0fu : byte >> 4u;
+    }
+
+    static void setBucket(char *mapPage, unsigned entry, unsigned bucket) {
+        auto *byte = (unsigned char *) mapPage + sizeof(FsmPageHeader) + entry / 2;
+        if (entry % 2 == 0) {
+            *byte = (*byte & 0xf0u) | bucket;
+        } else {
+            *byte = (*byte & 0x0fu) | (bucket << 4u);
+        }
+    }
+
+    // rounds down, a bucket never promises more than the page has
+    static unsigned bucketOf(unsigned freeSpace) {
+        unsigned bucket = freeSpace / (PAGE_SIZE / FSM_BUCKETS);
+        return bucket < FSM_BUCKETS ? bucket : FSM_BUCKETS - 1;
+    }
+
+    bool FreeSpaceMap::hasMap(FileHandle &fileHandle) {
+        if (fileHandle.getNumberOfPages() == 0) {
+            return false;
+        }
+        const void *mapPage;
+        if (fileHandle.readPageRef(0, mapPage) != 0) {
+            return false;
+        }
+        bool found = ((const FsmPageHeader *) mapPage)->magic == FSM_MAGIC;
+        fileHandle.releasePageRef(0);
+        return found;
+    }
+
+    RC FreeSpaceMap::findPage(FileHandle &fileHandle, unsigned needed, PageNum &pageNum) {
+        unsigned width = PAGE_SIZE / FSM_BUCKETS;
+        unsigned wanted = (needed + width - 1) / width;
+        if (wanted >= FSM_BUCKETS) {
+            // only an empty page could take it
+            return -1;
+        }
+        unsigned numPages = fileHandle.getNumberOfPages();
+        if (numPages == 0) {
+            return -1;
+        }
+        // latest pages first, like the linear search did
+        PageNum mapPageNum = mapPageOf(numPages - 1);
+        while (true) {
+            const void *mapPage;
+            if (fileHandle.readPageRef(mapPageNum, mapPage) != 0) {
+                // read fail
+                return -1;
+            }
+            unsigned entries = numPages - mapPageNum - 1;
+            if (entries > FSM_ENTRIES) {
+                entries = FSM_ENTRIES;
+            }
+            for (unsigned entry = entries; entry > 0; entry--) {
+                if (getBucket((const char *) mapPage, entry - 1) >= wanted) {
+                    fileHandle.releasePageRef(mapPageNum);
+                    pageNum = mapPageNum + entry;
+                    return 0;
+                }
+            }
+            fileHandle.releasePageRef(mapPageNum);
+            if (mapPageNum == 0) {
+                return -1;
+            }
+            mapPageNum -= FSM_ENTRIES + 1;
+        }
+    }
+
+    RC FreeSpaceMap::update(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace) {
+        if (isMapPage(pageNum) || !hasMap(fileHandle)) {
+            return 0;
+        }
+        PageNum mapPageNum = mapPageOf(pageNum);
+        unsigned entry = pageNum - mapPageNum - 1;
+        unsigned bucket = bucketOf(freeSpace);
+
+        const void *mapPage;
+        if (fileHandle.readPageRef(mapPageNum, mapPage) != 0) {
+            // read fail
+            return -1;
+        }
+        if (getBucket((const char *) mapPage, entry) == bucket) {
+            fileHandle.releasePageRef(mapPageNum);
+            return 0;
+        }
+        char *copy = (char *) malloc(PAGE_SIZE);
+        memcpy(copy, mapPage, PAGE_SIZE);
+        fileHandle.releasePageRef(mapPageNum);
+
+        setBucket(copy, entry, bucket);
+        RC rc = fileHandle.writePage(mapPageNum, copy);
+        free(copy);
+        return rc;
+    }
+
+    RC FreeSpaceMap::appendMapPage(FileHandle &fileHandle) {
+        char *mapPage = (char *) calloc(PAGE_SIZE, 1);
+        ((FsmPageHeader *) mapPage)->magic = FSM_MAGIC;
+        RC rc = fileHandle.appendPage(mapPage);
+        free(mapPage);
+        return rc;
+    }
+
+    RC FreeSpaceMap::appendDataPage(FileHandle &fileHandle, const void *page, unsigned freeSpace, PageNum &pageNum) {
+        unsigned numPages = fileHandle.getNumberOfPages();
+        bool mapped = numPages == 0 || hasMap(fileHandle);
+        if (mapped && isMapPage(numPages)) {
+            if (appendMapPage(fileHandle) != 0) {
+                // append fail
+                return -1;
+            }
+            numPages++;
+        }
+        if (fileHandle.appendPage(page) != 0) {
+            return -1;
+        }
+        pageNum = numPages;
+        return mapped ? update(fileHandle, pageNum, freeSpace) : 0;
+    }
+
+} // namespace PeterDB
@@ -51,6 +51,14 @@ namespace PeterDB {
         return pfm_ins.closeFile(fileHandle);
     }
 
+    RC RecordBasedFileManager::acquireFile(const std::string &fileName, FileHandle &fileHandle) {
+        return PagedFileManager::instance().acquireFile(fileName, fileHandle);
+    }
+
+    RC RecordBasedFileManager::releaseFile(FileHandle &fileHandle) {
+        return PagedFileManager::instance().releaseFile(fileHandle);
+    }
+
     RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                             const void *data, RID &rid) {
         // get nullsindicator size
@@ -101,10 +109,15 @@ namespace PeterDB {
             // append record
             memcpy((char*) page + record_offset, record, recordLength);
 
-            thisPage->numOfSlots++;
-            thisPage->freeSpace -= (recordLength + sizeof(SlotDir));
+            // a reused slot is already counted, a new one takes its directory entry out of the free space
+            if (rid.slotNum == thisPage->numOfSlots) {
+                thisPage->numOfSlots++;
+                thisPage->freeSpace -= sizeof(SlotDir);
+            }
+            thisPage->freeSpace -= recordLength;
 
-            if (fileHandle.writePage(rid.pageNum, page) == 0) {
+            if (fileHandle.writePage(rid.pageNum, page) == 0
+                && FreeSpaceMap::update(fileHandle, rid.pageNum, thisPage->freeSpace) == 0) {
                 free(record);
                 free(page);
                 free(offsetAndVarLen);
@@ -137,8 +150,8 @@ namespace PeterDB {
             // append record
             memcpy((char*) page, record, recordLength);
 
-            // append page
-            RC m = fileHandle.appendPage(page);
+            // append page, rid.pageNum moves past a map page if one had to be added first
+            RC m = FreeSpaceMap::appendDataPage(fileHandle, page, thisPage->freeSpace, rid.pageNum);
             if (m == 0) {
                 free(page);
                 free(record);
@@ -161,6 +174,98 @@ namespace PeterDB {
             return -1;
         }
     }
+
+
+    RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                             const std::vector<const void *> &data, std::vector<RID> &rids) {
+        rids.clear();
+        rids.reserve(data.size());
+
+        // buffers are shared by all the records
+        int nullFieldsIndicatorSize = ceil((double(recordDescriptor.size())/CHAR_BIT));
+        auto *nullFieldsIndicator = (unsigned char*) malloc(nullFieldsIndicatorSize);
+        void *offsetAndVarLen = malloc(8);
+        void *record = malloc(PAGE_SIZE);
+        void *page = malloc(PAGE_SIZE);
+        auto *thisPage = (PageDir*) ((char*) page + PAGE_SIZE - sizeof(PageDir));
+        thisPage->numOfSlots = 0;
+        thisPage->freeSpace = PAGE_SIZE - sizeof(PageDir);
+        unsigned firstRid = 0;      // first record of the page being filled
+        unsigned extentPages = fileHandle.getExtentSize();
+
+        RC rc = 0;
+        for (const void *tuple : data) {
+            memcpy(nullFieldsIndicator, tuple, nullFieldsIndicatorSize);
+            getLengthBeforeVarChar(recordDescriptor, tuple, offsetAndVarLen, nullFieldsIndicator);
+            int recordLength = ((int *)offsetAndVarLen)[0];
+            if (recordLength < MIN_TS_LEN) {
+                recordLength = MIN_TS_LEN;
+            }
+            if (recordLength + sizeof(SlotDir) > PAGE_SIZE - sizeof(PageDir)) {
+                rc = -1; // record does not fit in a page
+                break;
+            }
+
+            if (recordLength + sizeof(SlotDir) > thisPage->freeSpace) {
+                if (firstRid == 0 && extentPages < BULK_EXTENT_PAGES) {
+                    // the batch takes more than one page, grow the file in large extents until it is in
+                    fileHandle.setExtentSize(BULK_EXTENT_PAGES);
+                }
+                if (appendBulkPage(fileHandle, page, rids, firstRid) != 0) {
+                    rc = -1; // append fail
+                    break;
+                }
+                firstRid = rids.size();
+                thisPage->numOfSlots = 0;
+                thisPage->freeSpace = PAGE_SIZE - sizeof(PageDir);
+            }
+
+            formatRecord(recordDescriptor, tuple, offsetAndVarLen, record, nullFieldsIndicator);
+
+            SlotDir newSlot;
+            newSlot.ds_length = recordLength;
+            newSlot.ds_offset = PAGE_SIZE - sizeof(PageDir) - (thisPage->numOfSlots) * sizeof(SlotDir) - thisPage->freeSpace;
+            char16_t slot_offset = PAGE_SIZE - sizeof(PageDir) - (thisPage->numOfSlots + 1) * sizeof(SlotDir);
+            memcpy((char*) page + slot_offset, &newSlot, sizeof(SlotDir));
+            memcpy((char*) page + newSlot.ds_offset, record, recordLength);
+
+            RID rid;
+            rid.pageNum = 0;        // set once the page is appended
+            rid.slotNum = thisPage->numOfSlots;
+            rids.push_back(rid);
+            thisPage->numOfSlots++;
+            thisPage->freeSpace -= (recordLength + sizeof(SlotDir));
+        }
+
+        if (rc == 0 && thisPage->numOfSlots > 0 && appendBulkPage(fileHandle, page, rids, firstRid) != 0) {
+            rc = -1; // append fail
+        }
+        if (rc != 0) {
+            rids.resize(firstRid);
+        }
+        fileHandle.setExtentSize(extentPages);
+
+        free(page);
+        free(record);
+        free(offsetAndVarLen);
+        free(nullFieldsIndicator);
+        return rc;
+    }
+
+
+    RC RecordBasedFileManager::appendBulkPage(FileHandle &fileHandle, void *page,
+                                              std::vector<RID> &rids, unsigned firstRid) {
+        auto *thisPage = (PageDir*) ((char*) page + PAGE_SIZE - sizeof(PageDir));
+        PageNum pageNum;
+        if (FreeSpaceMap::appendDataPage(fileHandle, page, thisPage->freeSpace, pageNum) != 0) {
+            return -1;
+        }
+        for (unsigned ind = firstRid; ind < rids.size(); ind++) {
+            rids[ind].pageNum = pageNum;
+        }
+        return 0;
+    }
+
 /*
 
     RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
@@ -368,7 +473,8 @@ namespace PeterDB {
                 // move the left record forward
                 fillGap(recordLength, solidRid, page);
 
-                if (fileHandle.writePage(solidRid.pageNum, page) == -1) {
+                if (fileHandle.writePage(solidRid.pageNum, page) == -1
+                    || FreeSpaceMap::update(fileHandle, solidRid.pageNum, page_dir->freeSpace) != 0) {
                     free(page);
                     return -4; // write fails
                 } else {
@@ -402,7 +508,8 @@ namespace PeterDB {
                 // move the left record forward
                 fillGap(recordLength, old_rid, page);
 
-                if (fileHandle.writePage(old_rid.pageNum, page) == -1) {
+                if (fileHandle.writePage(old_rid.pageNum, page) == -1
+                    || FreeSpaceMap::update(fileHandle, old_rid.pageNum, page_dir->freeSpace) != 0) {
                     free(page);
                     return -4; // write fails
                 }
@@ -627,6 +734,10 @@ namespace PeterDB {
 //        std::cout <<  "==================================END updateRecord()===============================" << std::endl;
 
         RC rc = fileHandle.writePage(solidRid.pageNum, page); // solidRid or rid ????
+        if (rc == 0) {
+            auto *pageDir = (PageDir *) ((char *) page + PAGE_SIZE - sizeof(PageDir));
+            rc = FreeSpaceMap::update(fileHandle, solidRid.pageNum, pageDir->freeSpace);
+        }
 
         if (rc != 0) {
             free(page);
@@ -742,124 +853,32 @@ namespace PeterDB {
 
     RC RecordBasedFileManager::getAttributefromOrgFormat(const std::vector<Attribute> &recordDescriptor, const std::string & attributeName, void * deformattedRecord, void *data) {
         // only one attribute here
-
-        int varCharLen;
-        int fieldLength = recordDescriptor.size();
-        int offsetData = 0;
-
-
-        int nullFieldsIndicatorActualSize = ceil((double(fieldLength)/CHAR_BIT));
-        auto *nullFieldsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
-        memcpy((char *) nullFieldsIndicator, deformattedRecord, nullFieldsIndicatorActualSize);
-
-        int oneByteReserved4nullIndicator = 1;
-        auto *nullsIndicatorForAttr = (unsigned char *) malloc(oneByteReserved4nullIndicator);
-        memset(nullsIndicatorForAttr, 0, oneByteReserved4nullIndicator); // all bits set to 0
-
-        offsetData += nullFieldsIndicatorActualSize;
-
-
-        // int lengthBeforeVarChar = ceil((double(recordDescriptor.size())/CHAR_BIT));
-
-
-        for (int ind = 0; ind < recordDescriptor.size(); ind++) {
-            Attribute info = recordDescriptor[ind];
-
-            if (info.length != 0) {
-                // not delete
-                if (nullFieldsIndicator[ind / 8] & ((unsigned)1 << (unsigned) (7 - (ind % 8))) && info.name == attributeName) {
-                    // desired attribute is null
-                    //nullsIndicatorForAttr[0] |= ((unsigned char)1); // 0000 0001 if null
-
-                    *((unsigned char *) nullsIndicatorForAttr) = 128u; // update 12/2
-
-                    memcpy(data, nullsIndicatorForAttr, oneByteReserved4nullIndicator);
-                    return 0;
-                }
-
-                // update 12/2
-                if (nullFieldsIndicator[ind / 8] & ((unsigned)1 << (unsigned) (7 - (ind % 8)))){
-                    continue;
-                }
-                // update 12/2
-
-                switch (info.type) {
-                    case TypeInt: {
-
-                        if(info.name == attributeName){
-                            memcpy((char* )data + oneByteReserved4nullIndicator, (char *) deformattedRecord + offsetData, INT_FIELD_LEN);
-                            memcpy(data, nullsIndicatorForAttr, oneByteReserved4nullIndicator);
-                            free(nullsIndicatorForAttr);
-                            free(nullFieldsIndicator);
-                            return 0 ;
-                        }
-                        offsetData += 4;
-                        break;
-
-                    }
-                    case TypeReal: {
-                        if(info.name == attributeName){
-                            memcpy((char* )data + oneByteReserved4nullIndicator, (char *) deformattedRecord + offsetData, REAL_FIELD_LEN);
-                            memcpy(data, nullsIndicatorForAttr, oneByteReserved4nullIndicator);
-                            free(nullsIndicatorForAttr);
-                            free(nullFieldsIndicator);
-                            return 0 ;
-                        }
-                        offsetData += 4;
-                        break;
-                    }
-                    case TypeVarChar: {
-                        memcpy(&varCharLen, (char *) deformattedRecord + offsetData, sizeof(int));
-                        offsetData += 4;
-                        offsetData += varCharLen;
-                        if(info.name == attributeName){
-
-                            memcpy((char* )data + oneByteReserved4nullIndicator, &varCharLen, sizeof(int));
-                            memcpy((char* )data + oneByteReserved4nullIndicator + sizeof(int), (char* )deformattedRecord + offsetData - varCharLen, varCharLen);
-
-                            // nullsIndicatorForAttr[ind/8] &= (~((unsigned) 1 << (unsigned) ( 7- (ind % 8) )));
-                            memcpy((char* )data, nullsIndicatorForAttr, oneByteReserved4nullIndicator);
-                            free(nullsIndicatorForAttr);
-                            free(nullFieldsIndicator);
-                            return 0 ;
-
-                        }
-
-                        break;
-                    }
-                    default: {
-                        break;
-                    }
-                }
-            }
+        RecordLayout layout(recordDescriptor);
+        std::vector<int> fieldIndexes(1, layout.getFieldIndex(attributeName));
+        if (fieldIndexes[0] == -1) {
+            return -1; // unknown attribute
         }
+        return layout.project(deformattedRecord, fieldIndexes, data);
     }
 
 
     RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                              const RID &rid, const std::string &attributeName, void *data) {
+        RecordLayout layout(recordDescriptor);
+        std::vector<int> fieldIndexes(1, layout.getFieldIndex(attributeName));
+        if (fieldIndexes[0] == -1) {
+            return -1; // unknown attribute
+        }
 
-        void* wantedRecord = malloc(PAGE_SIZE);
-        // RC rc1 = getFormattedRecord(fileHandle, rid, formattedRecord);
-        RC rc1 = readRecord(fileHandle, recordDescriptor, rid, wantedRecord);
-
-        if(rc1 == 0){
-
-            RC rc3 = getAttributefromOrgFormat(recordDescriptor, attributeName, wantedRecord, data);
-
-            if(rc3 != 0){
-                //std::cout << "[ERROE]: getAttribute() fail" << std::endl;
-                return -1;
-            }
-            free(wantedRecord);
-            // free(deformattedRecord);
-            //std::cout << "[SUCCESS]: readAttribute() succeed ! " << std::endl;
-            return 0 ;
-
-        }else{
-            free(wantedRecord);
+        // read the field straight from the stored format, no need to deformat the whole record
+        void *formattedRecord = malloc(PAGE_SIZE);
+        if (getFormattedRecord(fileHandle, rid, formattedRecord) != 0) {
+            free(formattedRecord);
             return -1;
         }
+        RC rc = layout.projectStored(formattedRecord, fieldIndexes, data);
+        free(formattedRecord);
+        return rc;
     }
 
     RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
@@ -1144,7 +1163,28 @@ namespace PeterDB {
             return -2;
         }
 
-        if (fileHandle.getNumberOfPages() > 0) {
+        if (FreeSpaceMap::hasMap(fileHandle)) {
+            PageNum pageNum;
+            if (FreeSpaceMap::findPage(fileHandle, recordLength + sizeof(SlotDir), pageNum) == 0
+                && fileHandle.readPage(pageNum, page) == 0) {
+                char* PD_ptr = (char*) page + PAGE_SIZE - sizeof(PageDir);
+                auto* pageDir = (PageDir*) PD_ptr;
+
+                // reuse a deleted slot if there is one, otherwise create a new slot
+                rid.slotNum = pageDir->numOfSlots;
+                rid.pageNum = pageNum;
+                for (short int slot_ind = 0; slot_ind < pageDir->numOfSlots; slot_ind++) {
+                    auto *thisSlot = (SlotDir *) (PD_ptr - (slot_ind + 1) * sizeof(SlotDir));
+                    if (thisSlot->ds_length == 0) {
+                        rid.slotNum = slot_ind;
+                        break;
+                    }
+                }
+                return HAS_AVAILABLE_PAGE;
+            }
+        }
+        else if (fileHandle.getNumberOfPages() > 0) {
+            // file written before the free-space map, fall back to trying every page
             for (int page_ind = (int)(fileHandle.getNumberOfPages()); page_ind > 0; page_ind--) {
                 if (fileHandle.readPage(page_ind-1, page) == 0) {
                     char* PD_ptr = (char*) page + PAGE_SIZE - sizeof(PageDir);
@@ -1160,7 +1200,7 @@ namespace PeterDB {
                             // find the deleted record, reuse it
                             if (thisSlot->ds_length == 0) {
                                 rid.slotNum = slot_ind;
-                                rid.pageNum = page_ind;
+                                rid.pageNum = page_ind-1;
 
                                 return HAS_AVAILABLE_PAGE;
                             }
@@ -1218,460 +1258,478 @@ namespace PeterDB {
 
     RC RecordBasedFileManager::getAttributeSfromOrgFormat(const std::vector<Attribute> &recordDescriptor, const vector<string> &attributeNames,
                                                           void* deformattedRecord, void* data){
-        //void* data;  // substitute of 'data'
         // the attributes in attributeNames do not have to be in original order in recordDescriptor
-        // so need three for loops
-
-        int recordDescriptor_size = recordDescriptor.size();
-        int attributeNames_size = attributeNames.size();
-        int offset_record = 0;
-        int offset_returned_data = 0;
-        int idx_attributeNames ;
-
-        // nulls indicator of returned data
-        int nullIndicator_attributes_siz = ceil((double(attributeNames_size)/CHAR_BIT));
-        auto* nullIndicator_attributes = (char* )malloc(nullIndicator_attributes_siz);
-        memset(nullIndicator_attributes, 0, nullIndicator_attributes_siz); // all set to 0
-        offset_returned_data += nullIndicator_attributes_siz; // save space for storing nulls indicator later
-
-        // deformattedRecord
-        int nullFieldsIndicatorActualSize = ceil((double(recordDescriptor_size)/CHAR_BIT));
-        auto *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
-        memcpy(nullsIndicator, (char* )deformattedRecord + offset_record, nullFieldsIndicatorActualSize);
-        offset_record += nullFieldsIndicatorActualSize;
-
-        int idx_field, temp_varvhar_len;
-        for(idx_attributeNames = 0; idx_attributeNames < attributeNames_size; idx_attributeNames++) {
-
-            std::string wantedAttrName = attributeNames[idx_attributeNames];
-            offset_record = nullFieldsIndicatorActualSize;
-
-            // for each wanted attribute name, loop over recordDescriptor
-            for (int idx_byte = 0; idx_byte < nullFieldsIndicatorActualSize; idx_byte++) {
-                for (int idx_bit = 0; idx_bit < CHAR_BIT; idx_bit++) {
-                    idx_field = idx_byte * CHAR_BIT + idx_bit;
-                    if (idx_field == recordDescriptor_size)
-                        // end search
-                        break;
-
-                    Attribute thisattribute = recordDescriptor[idx_field];
-
-
-                    if (nullsIndicator[idx_byte] & (unsigned) 1 << (unsigned) (7 - idx_bit)) {
-                        //if null
-                        if (thisattribute.name == wantedAttrName) {
-                            // if null, set corresponding bit to 1 !
-                            nullIndicator_attributes[idx_attributeNames / CHAR_BIT] |= ((unsigned char) 1
-                                    << (unsigned) (7 - idx_attributeNames % CHAR_BIT));
-                            //idx_attributeNames++;
-                            continue;
-                        } else {
-                            continue;
-                        }
-                    }
+        RecordLayout layout(recordDescriptor);
+        std::vector<int> fieldIndexes;
+        if (layout.getFieldIndexes(attributeNames, fieldIndexes) != 0) {
+            return -1; // unknown attribute
+        }
+        return layout.project(deformattedRecord, fieldIndexes, data);
+    }
 
-                    switch (thisattribute.type) {
-                        case TypeInt: {
-                            if (thisattribute.name == wantedAttrName) {
-                                memcpy((char *) data + offset_returned_data, (char *) deformattedRecord + offset_record,
-                                       INT_FIELD_LEN);
+    RC RecordBasedFileManager::readAttributesGivenByRidAndAttributeNames(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                                                 const RID &rid, const vector<string> &attributeNames,
+                                                                 void* data) {
+        RecordLayout layout(recordDescriptor);
+        std::vector<int> fieldIndexes;
+        if (layout.getFieldIndexes(attributeNames, fieldIndexes) != 0) {
+            return -1; // unknown attribute
+        }
 
+        void *formattedRecord = malloc(PAGE_SIZE);
+        if (getFormattedRecord(fileHandle, rid, formattedRecord) != 0) {
+            free(formattedRecord);
+            return -1;
+        }
+        RC rc = layout.projectStored(formattedRecord, fieldIndexes, data);
+        free(formattedRecord);
+        return rc;
+    }
 
-                                offset_returned_data += 4;
-                                //idx_attributeNames++;
-                            }
-                            offset_record += INT_FIELD_LEN;
-                            break;
-                        }
-                        case TypeReal: {
-                            if (thisattribute.name == wantedAttrName) {
-                                memcpy((char *) data + offset_returned_data, (char *) deformattedRecord + offset_record,
-                                       REAL_FIELD_LEN);
-                                offset_returned_data += 4;
-                                //idx_attributeNames++;
-                            }
-                            offset_record += REAL_FIELD_LEN;
-                            break;
-                        }
-                        case TypeVarChar: {
-                            memcpy(&temp_varvhar_len, (char *) deformattedRecord + offset_record, 4);
-                            offset_record += 4;
-                            if (thisattribute.name == wantedAttrName) {
-                                memcpy((char *) data + offset_returned_data, &temp_varvhar_len, sizeof(int));
-                                offset_returned_data += 4;
-                                memcpy((char *) data + offset_returned_data, (char *) deformattedRecord + offset_record,
-                                       temp_varvhar_len);
-                                offset_returned_data += temp_varvhar_len;
-                                //idx_attributeNames++;
-                            }
-                            offset_record += temp_varvhar_len;
-                            break;
 
-                        }
-                    }
-                }
-            }
+    /*RBFM_ScanIterator*/
 
-        }
+    Predicate Predicate::compare(const std::string &attributeName, CompOp compOp, const void *value) {
+        Predicate predicate;
+        predicate.kind = PRED_COMPARE;
+        predicate.attributeName = attributeName;
+        predicate.compOp = compOp;
+        predicate.values.push_back(value);
+        return predicate;
+    }
 
+    Predicate Predicate::between(const std::string &attributeName, const void *low, const void *high) {
+        Predicate predicate;
+        predicate.kind = PRED_BETWEEN;
+        predicate.attributeName = attributeName;
+        predicate.compOp = NO_OP;
+        predicate.values.push_back(low);
+        predicate.values.push_back(high);
+        return predicate;
+    }
 
-        memcpy(data, nullIndicator_attributes, nullIndicator_attributes_siz);
-        free(nullsIndicator);
-        free(nullIndicator_attributes);
-        return 0;
+    Predicate Predicate::in(const std::string &attributeName, const std::vector<const void *> &values) {
+        Predicate predicate;
+        predicate.kind = PRED_IN;
+        predicate.attributeName = attributeName;
+        predicate.compOp = EQ_OP;
+        predicate.values = values;
+        return predicate;
+    }
 
+    Predicate Predicate::conjunction(const std::vector<Predicate> &children) {
+        Predicate predicate;
+        predicate.kind = PRED_AND;
+        predicate.compOp = NO_OP;
+        predicate.children = children;
+        return predicate;
+    }
 
+    Predicate Predicate::disjunction(const std::vector<Predicate> &children) {
+        Predicate predicate;
+        predicate.kind = PRED_OR;
+        predicate.compOp = NO_OP;
+        predicate.children = children;
+        return predicate;
     }
 
-    RC RecordBasedFileManager::readAttributesGivenByRidAndAttributeNames(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                                                 const RID &rid, const vector<string> &attributeNames,
-                                                                 void* data) {
-        void *wantedRecord = malloc(PAGE_SIZE);
-        // read formatted record by rid
-        RC rc1 = readRecord(fileHandle, recordDescriptor, rid, wantedRecord);
-
-        if(rc1 == 0){
-
-//            void* deformattedRecord = nullptr;
-//            // recover to original data
-//            RC rc2 = deFormatRecord(recordDescriptor, deformattedRecord, formattedRecord);
-//
-//            if(rc2 != 0){
-//                std::cout << "[ERROE]: deFormatRecord() fail [readAttributesGivenAttributeNames]" << std::endl;
-//                return -1;
-//            }
-            // read contents given attributeNames in the record, returned data should have null-indicators
-
-            RC rc3 = getAttributeSfromOrgFormat(recordDescriptor, attributeNames, wantedRecord, data);
-
-            if(rc3 != 0){
-                std::cout << "[ERROE]: getAttributeSfromOrgFormat() fail [readAttributesGivenAttributeNames]" << std::endl;
-                return -1;
-            }
-            free(wantedRecord);
-            //free(deformattedRecord);
-            // std::cout << "[SUCCESS]: readAttribute() succeed ! [readAttributesGivenAttributeNames]" << std::endl;
-            return 0 ;
-
-        }else{
-            // std::cout << "[ERROE]: getFormattedRecord() fail [readAttributesGivenAttributeNames]" << std::endl;
-            free(wantedRecord);
-            return -1;
-        }
 
+    RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                    const Predicate &predicate, const std::vector<std::string> &attributeNames,
+                                    RBFM_ScanIterator &rbfm_ScanIterator) {
+        return rbfm_ScanIterator.initScanIterator(fileHandle, recordDescriptor, predicate, attributeNames);
     }
 
 
     /*RBFM_ScanIterator*/
 
     RBFM_ScanIterator::RBFM_ScanIterator(){
-        maxAttrLen = -1;
-        maxRecordLen = -1;
-        cur_num_slots_of_curPage = -1;
+        predicate.kind = PRED_AND;
+        predicate.fieldIndex = -1;
+        predicate.compOp = NO_OP;
+        cur_num_slots_of_curPage = 0;
+        num_of_pages = 0;
+        hasFreeSpaceMap = false;
+        pageAtATime = false;
+        nextSelected = 0;
+        page = nullptr;
+    }
+
+
+    RBFM_ScanIterator::~RBFM_ScanIterator() {
+        releasePage();
     }
 
 
     RC RBFM_ScanIterator::initScanIterator(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttribute,
                                            const CompOp compOp, const void *value, const vector<string> &attributeNames){
+        if (conditionAttribute.empty()) {
+            return initScanIterator(fileHandle, recordDescriptor, Predicate::conjunction({}), attributeNames);
+        }
+        return initScanIterator(fileHandle, recordDescriptor, Predicate::compare(conditionAttribute, compOp, value), attributeNames);
+    }
+
 
+    RC RBFM_ScanIterator::initScanIterator(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                                           const Predicate &predicate, const vector<string> &attributeNames){
+
+        releasePage();
         this->fileHandle = fileHandle;
         this->recordDescriptor = recordDescriptor;
-        this->conditionAttribute = conditionAttribute;
-        this->compOp = compOp;
-        this->value = (char*)value;
         this->attributeNames = attributeNames;
 
+        // resolve attribute names to field positions once, records are then read by position
+        layout = RecordLayout(recordDescriptor);
+        if (bindPredicate(predicate, this->predicate) != 0) {
+            return -1; // unknown condition attribute
+        }
+        if (layout.getFieldIndexes(attributeNames, projectedIndex) != 0) {
+            return -1; // unknown projected attribute
+        }
+        projectedAttrs.clear();
+        for (int fieldIndex : projectedIndex) {
+            projectedAttrs.push_back(recordDescriptor[fieldIndex]);
+        }
+        pageAtATime = this->predicate.kind == PRED_COMPARE && this->predicate.compOp != NO_OP
+                      && layout.getAttribute(this->predicate.fieldIndex).type != TypeVarChar;
+        selectedSlots.clear();
+        nextSelected = 0;
 
-        this->cur_rid.pageNum = 0;
-        this->cur_rid.slotNum = -1;
+        // page 0 is a map page when the file has a free-space map, updateCurRid() moves to the first data page
+        hasFreeSpaceMap = FreeSpaceMap::hasMap(fileHandle);
+        num_of_pages = fileHandle.getNumberOfPages();
+        cur_rid.pageNum = hasFreeSpaceMap ? 0 : -1;
+        cur_rid.slotNum = 0;
+        cur_num_slots_of_curPage = 0;
 
+        return 0;
 
-        void *page = malloc(PAGE_SIZE);
-        fileHandle.readPage(cur_rid.pageNum, page);
-        auto *pageDir_ptr = (PageDir *)((char *)page + PAGE_SIZE - sizeof(PageDir));
-        cur_num_slots_of_curPage = pageDir_ptr->numOfSlots;
-        free(page);
+    }
 
-        num_of_pages = fileHandle.getNumberOfPages();
 
-        for(auto & it : recordDescriptor) {
-            if(it.name == conditionAttribute){
-                conditionAttributeType = it.type;
-            }
-        }
+    RC RBFM_ScanIterator::bindPredicate(const Predicate &source, BoundPredicate &bound) const {
+        bound.kind = source.kind;
+        bound.compOp = source.compOp;
+        bound.values = source.values;
+        bound.fieldIndex = -1;
+        bound.children.clear();
 
-        int idx = 0;  // index for looping through attributeNames
-        while(idx < attributeNames.size()){
-            for(auto & attr_i : recordDescriptor){
-                if(attr_i.name == attributeNames[idx]){
-                    attributesVector.push_back(attr_i);
-                    idx++;
-                    break;
+        if (source.kind == PRED_AND || source.kind == PRED_OR) {
+            bound.children.resize(source.children.size());
+            for (unsigned ind = 0; ind < source.children.size(); ind++) {
+                if (bindPredicate(source.children[ind], bound.children[ind]) != 0) {
+                    return -1;
                 }
             }
+            return 0;
         }
 
-        for(auto & it : this->recordDescriptor){
-            maxRecordLen += it.length;
-            if(it.length > maxAttrLen)
-                maxAttrLen = it.length;
+        bound.fieldIndex = layout.getFieldIndex(source.attributeName);
+        if (bound.fieldIndex == -1) {
+            return -1; // unknown attribute
         }
+        if ((source.kind == PRED_COMPARE && source.values.size() != 1)
+            || (source.kind == PRED_BETWEEN && source.values.size() != 2)) {
+            return -2; // wrong number of values
+        }
+        return 0;
+    }
 
 
+    RC RBFM_ScanIterator::nextQualifyingRecord(const char *&record) {
+        while (true) {
+            RC rc = updateCurRid();
+            if (rc != 0) {
+                return rc;
+            }
 
-        return 0;
-
+            const char *PD_ptr = page + PAGE_SIZE - sizeof(PageDir);
+            auto *thisSlot = (const SlotDir *) (PD_ptr - (cur_rid.slotNum + 1) * sizeof(SlotDir));
+            if (thisSlot->ds_length == 0) {
+                // deleted
+                continue;
+            }
+            record = page + thisSlot->ds_offset;
+            if (*record != SOLID_RECORD_FLAG) {
+                // tombstone, the record itself is returned when the scan reaches the page it moved to
+                continue;
+            }
+            if (isSatisfied(predicate, record)) {
+                return 0;
+            }
+        }
     }
 
 
     RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data){
+        const char *record;
+        RC rc = nextQualifyingRecord(record);
+        if (rc != 0) {
+            return rc;
+        }
+        rid = cur_rid;
+        return layout.projectStored(record, projectedIndex, data);
+    }
 
-        bool is_found = false;
-        RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
-
-        auto* attribute_with_nullIndicator = (char* )malloc(maxAttrLen); // or PAGE_SIZE ?? this caused the failure of conditional scan test case
-
-        //find rid
-        while(!is_found){
-            // std::cout << "[Warning] " << std::endl;
-            RC rc1 = updateCurRid();
 
-            if(rc1 != 0){
-                // std::cout << "[Warning] updateCurRid() [RBFM_ScanIterator::getNextRecord()]" << std::endl;
-                free(attribute_with_nullIndicator);
-                return rc1;
-            }
-            else{
-                RC rc_check = rbfm.checkRecordFlag(fileHandle, cur_rid);
-                if(rc_check != 0){
-                    // this record was deleted or updated(moved to other page)
-                    // continue to check next rid
-                    continue;
-                }
-                else{
-                    if(conditionAttribute.empty()){
-                        rid.pageNum = cur_rid.pageNum;
-                        rid.slotNum = cur_rid.slotNum;
-                        free(attribute_with_nullIndicator); // update 12/7
-                        // if condition attribute is "", then there is no need to do Comporation.
+    RC RBFM_ScanIterator::getNextBatch(RecordBatch &batch) {
+        batch.reset(projectedAttrs);
+        RC rc = 0;
+        while (!batch.isFull()) {
+            const char *record;
+            if (pageAtATime) {
+                if (nextSelected == selectedSlots.size()) {
+                    rc = selectNextPage();
+                    if (rc != 0) {
                         break;
                     }
+                }
+                cur_rid.slotNum = selectedSlots[nextSelected++];
+                const char *PD_ptr = page + PAGE_SIZE - sizeof(PageDir);
+                auto *thisSlot = (const SlotDir *) (PD_ptr - (cur_rid.slotNum + 1) * sizeof(SlotDir));
+                record = page + thisSlot->ds_offset;
+                if (thisSlot->ds_length == 0 || *record != SOLID_RECORD_FLAG || !isSatisfied(predicate, record)) {
+                    // the page is pinned, not copied: the record was deleted, moved or changed since the selection
+                    continue;
+                }
+            } else {
+                rc = nextQualifyingRecord(record);
+                if (rc != 0) {
+                    break;
+                }
+            }
+            batch.beginRow(cur_rid);
+            appendRecord(batch, record);
+        }
+        return batch.getNumberOfRows() > 0 ? 0 : rc;
+    }
 
 
-                    RC rc2 = rbfm.readAttribute(fileHandle, recordDescriptor, cur_rid, conditionAttribute, attribute_with_nullIndicator);
-                    // returned is attribute_with_nullIndicator: 1 Byte + data
-
-                    if(rc2 == -1){
-                        std::cout << "[ERROR] rbfm.readAttribute() [RBFM_ScanIterator::getNextRecord()]" << std::endl;
-                        // free(attribute_with_nullIndicator);
-                        continue;
-                    }
-                    else {
-
-                        RC rc3 = helperCompOp(attribute_with_nullIndicator);
-                        if(rc3 > 0){
-                            // condition satisfied
-                            rid.slotNum = cur_rid.slotNum;
-                            rid.pageNum = cur_rid.pageNum;
-                            free(attribute_with_nullIndicator);
-                            is_found = true;
-                            //break;
-                        }
-                        else{
-                            // condition not satisfied
-                            // continue to next rid
-                            continue;
-                        }
+    RC RBFM_ScanIterator::selectNextPage() {
+        const Attribute &attr = layout.getAttribute(predicate.fieldIndex);
+        selectedSlots.clear();
+        nextSelected = 0;
+        while (selectedSlots.empty()) {
+            // past the last slot, updateCurRid() reads the next data page
+            cur_rid.slotNum = cur_num_slots_of_curPage;
+            RC rc = updateCurRid();
+            if (rc != 0) {
+                return rc;
+            }
 
-                    }
+            // gather the condition field of the live records into one column
+            candidateSlots.clear();
+            pageInts.clear();
+            pageReals.clear();
+            const char *PD_ptr = page + PAGE_SIZE - sizeof(PageDir);
+            for (char16_t slot = 0; slot < cur_num_slots_of_curPage; slot++) {
+                auto *thisSlot = (const SlotDir *) (PD_ptr - (slot + 1) * sizeof(SlotDir));
+                const char *record = page + thisSlot->ds_offset;
+                if (thisSlot->ds_length == 0 || *record != SOLID_RECORD_FLAG) {
+                    continue;
+                }
+                char16_t varCharLen;
+                const char *field = layout.getStoredField(record, predicate.fieldIndex, varCharLen);
+                if (field == nullptr) {
+                    continue;
+                }
+                candidateSlots.push_back(slot);
+                if (attr.type == TypeInt) {
+                    int value;
+                    memcpy(&value, field, sizeof(int));
+                    pageInts.push_back(value);
+                } else {
+                    float value;
+                    memcpy(&value, field, sizeof(float));
+                    pageReals.push_back(value);
+                }
+            }
 
+            unsigned count = candidateSlots.size();
+            pageMask.resize((count + CHAR_BIT - 1) / CHAR_BIT);
+            if (attr.type == TypeInt) {
+                int value;
+                memcpy(&value, predicate.values[0], sizeof(int));
+                CompareKernel::selectInts(pageInts.data(), count, predicate.compOp, value, pageMask.data());
+            } else {
+                float value;
+                memcpy(&value, predicate.values[0], sizeof(float));
+                CompareKernel::selectReals(pageReals.data(), count, predicate.compOp, value, pageMask.data());
+            }
+            for (unsigned ind = 0; ind < count; ind++) {
+                if (pageMask[ind / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - ind % CHAR_BIT))) {
+                    selectedSlots.push_back(candidateSlots[ind]);
                 }
             }
         }
-
-        // here we find next rid satisfying the condition successfully
-
-        RC rc4 = rbfm.readAttributesGivenByRidAndAttributeNames(fileHandle, recordDescriptor, rid, attributeNames, data);
-        // free(attribute_with_nullIndicator);
         return 0;
+    }
+
 
+    void RBFM_ScanIterator::appendRecord(RecordBatch &batch, const char *record) const {
+        // straight from the stored record into the columns
+        for (unsigned column = 0; column < projectedIndex.size(); column++) {
+            char16_t varCharLen;
+            const char *field = layout.getStoredField(record, projectedIndex[column], varCharLen);
+            if (field == nullptr) {
+                batch.appendNull(column);
+                continue;
+            }
+            switch (projectedAttrs[column].type) {
+                case TypeInt: {
+                    int value;
+                    memcpy(&value, field, sizeof(int));
+                    batch.appendInt(column, value);
+                    break;
+                }
+                case TypeReal: {
+                    float value;
+                    memcpy(&value, field, sizeof(float));
+                    batch.appendReal(column, value);
+                    break;
+                }
+                case TypeVarChar:
+                    batch.appendVarChar(column, field, varCharLen);
+                    break;
+            }
+        }
     }
 
 
     RC RBFM_ScanIterator::updateCurRid() {
         cur_rid.slotNum++;
-        if(num_of_pages == 0){
-            return RBFM_EOF;
-        }
-
-        if (cur_rid.slotNum >= cur_num_slots_of_curPage) {
+        while (cur_rid.slotNum >= cur_num_slots_of_curPage) {
+            releasePage();
             cur_rid.slotNum = 0;
             cur_rid.pageNum++;
+            if (hasFreeSpaceMap && FreeSpaceMap::isMapPage(cur_rid.pageNum)) {
+                cur_rid.pageNum++;
+            }
 
             if (cur_rid.pageNum >= num_of_pages) {
                 cur_num_slots_of_curPage = 0;
-                // std::cout << "[Warning] get the last page of file [RBFM_ScanIterator::findNext_cur_rid()]" << std::endl;
                 return RBFM_EOF;
-            } else {
-                void *page = malloc(PAGE_SIZE);
-                if (fileHandle.readPage(cur_rid.pageNum, page) != 0) {
-                    free(page);
-                    //std::cout << "[Warning] can not read the next page [RBFM_ScanIterator::findNext_cur_rid()]" << std::endl;
-                    return -2;
-                } else {
-                    auto *_page_dir = ((char *) page + PAGE_SIZE - sizeof(PageDir));
-                    cur_num_slots_of_curPage = ((PageDir *) _page_dir)->numOfSlots;
-                    free(page);
-                    return 0;
-                }
-
             }
+            // the only read of this page: it stays pinned while its slots are walked, no copy is made
+            const void *pageRef;
+            if (fileHandle.readPageRef(cur_rid.pageNum, pageRef) != 0) {
+                cur_num_slots_of_curPage = 0;
+                return -2;
+            }
+            page = (const char *) pageRef;
+            auto *_page_dir = (PageDir *) (page + PAGE_SIZE - sizeof(PageDir));
+            cur_num_slots_of_curPage = _page_dir->numOfSlots;
         }
 
         return 0;
     }
 
 
-    RC RBFM_ScanIterator::helperCompOp(void * attributeWithFlag){
-        // update 12/2
-        if( *((unsigned char *) attributeWithFlag) == 128u){
-            //null here, continue to check next rid
-            return -1;
+    void RBFM_ScanIterator::releasePage() {
+        if (page != nullptr) {
+            fileHandle.releasePageRef(cur_rid.pageNum);
+            page = nullptr;
         }
-        // update 12/2
+    }
 
-        int nullIndicatorSize = 1;
-        // private: conditionAttributeType
-        switch(conditionAttributeType){
-            case TypeInt:{
-                int attr_value, condition_value;
-                memcpy(&attr_value, (char*)attributeWithFlag + nullIndicatorSize, sizeof(int) );
-                memcpy(&condition_value, (char*)value, sizeof(int));
-                switch (compOp){
-                    case EQ_OP:{
-                        return attr_value == condition_value;
-                    }
-                    case LT_OP:{
-                        return attr_value < condition_value;
-                    }
-                    case LE_OP:{
-                        return attr_value <= condition_value;
-                    }
-                    case GT_OP:{
-                        return attr_value > condition_value;
-                    }
-                    case GE_OP:{
-                        return attr_value >= condition_value;
-                    };
-                    case NE_OP:{
-                        return attr_value != condition_value;
+
+    bool RBFM_ScanIterator::isSatisfied(const BoundPredicate &bound, const char *record) const {
+        switch (bound.kind) {
+            case PRED_AND: {
+                for (auto &child : bound.children) {
+                    if (!isSatisfied(child, record)) {
+                        return false;
                     }
-                    case NO_OP:{
-                        return 1;
+                }
+                return true;
+            }
+            case PRED_OR: {
+                for (auto &child : bound.children) {
+                    if (isSatisfied(child, record)) {
+                        return true;
                     }
                 }
+                return false;
+            }
+            default:
+                break;
+        }
 
+        char16_t varCharLen;
+        const char *field = layout.getStoredField(record, bound.fieldIndex, varCharLen);
+        if (field == nullptr) {
+            return false;
+        }
+
+        switch (bound.kind) {
+            case PRED_COMPARE: {
+                if (bound.compOp == NO_OP) {
+                    return true;
+                }
+                int cmp = compareField(bound.fieldIndex, field, varCharLen, bound.values[0]);
+                switch (bound.compOp) {
+                    case EQ_OP: return cmp == 0;
+                    case LT_OP: return cmp < 0;
+                    case LE_OP: return cmp <= 0;
+                    case GT_OP: return cmp > 0;
+                    case GE_OP: return cmp >= 0;
+                    case NE_OP: return cmp != 0;
+                    default: return true;
+                }
             }
-            case TypeReal:{
-                float attr_value, condition_value;
-                memcpy(&attr_value, (char*)attributeWithFlag + nullIndicatorSize, sizeof(float) );
-                memcpy(&condition_value, (char*)value, sizeof(float));
-                switch (compOp){
-                    case EQ_OP:{
-                        return attr_value == condition_value;
-                    }
-                    case LT_OP:{
-                        return attr_value < condition_value;
-                    }
-                    case LE_OP:{
-                        return attr_value <= condition_value;
-                    }
-                    case GT_OP:{
-                        return attr_value > condition_value;
-                    }
-                    case GE_OP:{
-                        return attr_value >= condition_value;
-                    };
-                    case NE_OP:{
-                        return attr_value != condition_value;
-                    }
-                    case NO_OP:{
-                        return 1;
+            case PRED_BETWEEN:
+                return compareField(bound.fieldIndex, field, varCharLen, bound.values[0]) >= 0
+                       && compareField(bound.fieldIndex, field, varCharLen, bound.values[1]) <= 0;
+            case PRED_IN: {
+                for (auto value : bound.values) {
+                    if (compareField(bound.fieldIndex, field, varCharLen, value) == 0) {
+                        return true;
                     }
                 }
-
+                return false;
             }
-            case TypeVarChar:{
-                // update 11/30
-                int varchar_attr_length;
-                memcpy(&varchar_attr_length, (char*)attributeWithFlag + nullIndicatorSize, sizeof(int));
-                auto* varcharAttr = (char* )malloc(varchar_attr_length + 1);
-                memcpy(varcharAttr, (char* )attributeWithFlag + nullIndicatorSize + sizeof(int), varchar_attr_length);
-                varcharAttr[varchar_attr_length] = '\0';
+            default:
+                return false;
+        }
+    }
 
 
+    int RBFM_ScanIterator::compareField(int fieldIndex, const char *field, char16_t varCharLen, const void *value) const {
+        switch (layout.getAttribute(fieldIndex).type) {
+            case TypeInt: {
+                int attr_value, condition_value;
+                memcpy(&attr_value, field, sizeof(int));
+                memcpy(&condition_value, value, sizeof(int));
+                return attr_value < condition_value ? -1 : attr_value > condition_value ? 1 : 0;
+            }
+            case TypeReal: {
+                float attr_value, condition_value;
+                memcpy(&attr_value, field, sizeof(float));
+                memcpy(&condition_value, value, sizeof(float));
+                return attr_value < condition_value ? -1 : attr_value > condition_value ? 1 : 0;
+            }
+            case TypeVarChar: {
+                // compared in place, a shorter string orders first when it is a prefix of the other
                 int varchar_condition_length;
-                memcpy(&varchar_condition_length, (char*)value, sizeof(int));
-                auto* varcharCond = (char* )malloc(varchar_condition_length + 1);
-                memcpy(varcharCond, (char*)value + sizeof(int), varchar_condition_length);
-                varcharCond[varchar_condition_length] = '\0';
-
-                int CompOpVarchar;
-                switch (compOp){
-                    case EQ_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) == 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    }
-                    case LT_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) < 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    }
-                    case LE_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) <= 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    }
-                    case GT_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) > 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    }
-                    case GE_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) >= 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    };
-                    case NE_OP:{
-                        CompOpVarchar = strcmp(varcharAttr, varcharCond) != 0;
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return CompOpVarchar;
-                    }
-                    case NO_OP:{
-                        free(varcharAttr);
-                        free(varcharCond);
-                        return 1;
-                    }
+                memcpy(&varchar_condition_length, value, sizeof(int));
+                int common = varCharLen < varchar_condition_length ? varCharLen : varchar_condition_length;
+                int cmp = memcmp(field, (const char *) value + sizeof(int), common);
+                if (cmp == 0) {
+                    cmp = varCharLen < varchar_condition_length ? -1 : varCharLen > varchar_condition_length ? 1 : 0;
                 }
+                return cmp;
             }
-
+            default:
+                return -1;
         }
-
     }
 
 
     RC RBFM_ScanIterator::close() {
+        releasePage();
         RecordBasedFileManager::instance().closeFile(fileHandle);
         return 0;
     };
 
 
 } // namespace PeterDB
-
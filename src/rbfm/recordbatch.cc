@@ -0,0 +1,277 @@
+#include "src/include/rbfm.h"
+
+#include <string.h>
+
+namespace PeterDB {
+
+    RecordBatch::RecordBatch(unsigned capacity) : capacity(capacity), numRows(0) {
+    }
+
+    void RecordBatch::reset(const std::vector<Attribute> &attrs) {
+        this->attrs = attrs;
+        columns.resize(attrs.size());
+        for (unsigned column = 0; column < attrs.size(); column++) {
+            columns[column].type = attrs[column].type;
+        }
+        clear();
+    }
+
+    void RecordBatch::clear() {
+        // the vectors keep their storage, refilling a batch does not allocate
+        for (auto &column : columns) {
+            column.ints.clear();
+            column.reals.clear();
+            column.offsets.assign(1, 0);
+            column.heap.clear();
+            column.validity.clear();
+        }
+        rids.clear();
+        numRows = 0;
+    }
+
+    bool RecordBatch::isNull(unsigned column, unsigned row) const {
+        return !(columns[column].validity[row / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT)));
+    }
+
+    const char *RecordBatch::getVarChar(unsigned column, unsigned row, unsigned &length) const {
+        const ColumnVector &vector = columns[column];
+        length = vector.offsets[row + 1] - vector.offsets[row];
+        return vector.heap.data() + vector.offsets[row];
+    }
+
+    void RecordBatch::beginRow(const RID &rid) {
+        rids.push_back(rid);
+        numRows++;
+    }
+
+    void RecordBatch::setValid(unsigned column, bool valid) {
+        ColumnVector &vector = columns[column];
+        unsigned row = numRows - 1;
+        if (row % CHAR_BIT == 0) {
+            vector.validity.push_back(0);
+        }
+        if (valid) {
+            vector.validity[row / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT));
+        }
+    }
+
+    void RecordBatch::appendNull(unsigned column) {
+        ColumnVector &vector = columns[column];
+        switch (vector.type) {
+            case TypeInt:
+                vector.ints.push_back(0);
+                break;
+            case TypeReal:
+                vector.reals.push_back(0);
+                break;
+            case TypeVarChar:
+                vector.offsets.push_back(vector.heap.size());
+                break;
+        }
+        setValid(column, false);
+    }
+
+    void RecordBatch::appendInt(unsigned column, int value) {
+        columns[column].ints.push_back(value);
+        setValid(column, true);
+    }
+
+    void RecordBatch::appendReal(unsigned column, float value) {
+        columns[column].reals.push_back(value);
+        setValid(column, true);
+    }
+
+    void RecordBatch::appendVarChar(unsigned column, const char *value, unsigned length) {
+        ColumnVector &vector = columns[column];
+        vector.heap.insert(vector.heap.end(), value, value + length);
+        vector.offsets.push_back(vector.heap.size());
+        setValid(column, true);
+    }
+
+    RC RecordBatch::appendTuple(const RID &rid, const void *data) {
+        if (isFull()) {
+            return -1;
+        }
+        auto *nullsIndicator = (const unsigned char *) data;
+        const char *field = (const char *) data + (attrs.size() + CHAR_BIT - 1) / CHAR_BIT;
+
+        beginRow(rid);
+        for (unsigned column = 0; column < attrs.size(); column++) {
+            if (RecordLayout::isNull(nullsIndicator, column)) {
+                appendNull(column);
+                continue;
+            }
+            switch (attrs[column].type) {
+                case TypeInt: {
+                    int value;
+                    memcpy(&value, field, sizeof(int));
+                    appendInt(column, value);
+                    field += sizeof(int);
+                    break;
+                }
+                case TypeReal: {
+                    float value;
+                    memcpy(&value, field, sizeof(float));
+                    appendReal(column, value);
+                    field += sizeof(float);
+                    break;
+                }
+                case TypeVarChar: {
+                    int length;
+                    memcpy(&length, field, sizeof(int));
+                    appendVarChar(column, field + sizeof(int), length);
+                    field += sizeof(int) + length;
+                    break;
+                }
+            }
+        }
+        return 0;
+    }
+
+    RC RecordBatch::getTuple(unsigned row, void *data) const {
+        if (row >= numRows) {
+            return -1;
+        }
+        int nullIndicatorSize = (attrs.size() + CHAR_BIT - 1) / CHAR_BIT;
+        auto *nullsIndicator = (unsigned char *) data;
+        memset(nullsIndicator, 0, nullIndicatorSize);
+        char *field = (char *) data + nullIndicatorSize;
+
+        for (unsigned column = 0; column < attrs.size(); column++) {
+            if (isNull(column, row)) {
+                nullsIndicator[column / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - column % CHAR_BIT));
+                continue;
+            }
+            switch (attrs[column].type) {
+                case TypeInt:
+                    memcpy(field, &columns[column].ints[row], sizeof(int));
+                    field += sizeof(int);
+                    break;
+                case TypeReal:
+                    memcpy(field, &columns[column].reals[row], sizeof(float));
+                    field += sizeof(float);
+                    break;
+                case TypeVarChar: {
+                    unsigned length;
+                    const char *value = getVarChar(column, row, length);
+                    int len = length;
+                    memcpy(field, &len, sizeof(int));
+                    memcpy(field + sizeof(int), value, length);
+                    field += sizeof(int) + length;
+                    break;
+                }
+            }
+        }
+        return 0;
+    }
+
+    RC RecordBatch::keepRows(const std::vector<bool> &keep) {
+        if (keep.size() != numRows) {
+            return -1;
+        }
+        selection.assign((numRows + CHAR_BIT - 1) / CHAR_BIT, 0);
+        for (unsigned row = 0; row < numRows; row++) {
+            if (keep[row]) {
+                selection[row / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT));
+            }
+        }
+        compact(selection.data());
+        return 0;
+    }
+
+    RC RecordBatch::select(unsigned column, CompOp compOp, const void *value) {
+        if (column >= columns.size()) {
+            return -1;
+        }
+        const ColumnVector &vector = columns[column];
+        selection.resize((numRows + CHAR_BIT - 1) / CHAR_BIT);
+        if (vector.type == TypeInt) {
+            int constant;
+            memcpy(&constant, value, sizeof(int));
+            CompareKernel::selectInts(vector.ints.data(), numRows, compOp, constant, selection.data());
+        } else if (vector.type == TypeReal) {
+            float constant;
+            memcpy(&constant, value, sizeof(float));
+            CompareKernel::selectReals(vector.reals.data(), numRows, compOp, constant, selection.data());
+        } else {
+            return -2; // VarChar is compared row by row
+        }
+        // a null satisfies no comparison
+        for (unsigned byte = 0; byte < selection.size(); byte++) {
+            selection[byte] &= vector.validity[byte];
+        }
+        compact(selection.data());
+        return 0;
+    }
+
+    void RecordBatch::compact(const unsigned char *mask) {
+        // compact in place, kept rows only move towards the front
+        unsigned kept = 0;
+        for (unsigned row = 0; row < numRows; row++) {
+            if (!(mask[row / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT)))) {
+                continue;
+            }
+            rids[kept] = rids[row];
+            for (unsigned column = 0; column < columns.size(); column++) {
+                ColumnVector &vector = columns[column];
+                bool valid = !isNull(column, row);
+                switch (vector.type) {
+                    case TypeInt:
+                        vector.ints[kept] = vector.ints[row];
+                        break;
+                    case TypeReal:
+                        vector.reals[kept] = vector.reals[row];
+                        break;
+                    case TypeVarChar: {
+                        unsigned begin = vector.offsets[row];
+                        unsigned length = vector.offsets[row + 1] - begin;
+                        memmove(vector.heap.data() + vector.offsets[kept], vector.heap.data() + begin, length);
+                        vector.offsets[kept + 1] = vector.offsets[kept] + length;
+                        break;
+                    }
+                }
+                unsigned char bit = (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - kept % CHAR_BIT));
+                if (valid) {
+                    vector.validity[kept / CHAR_BIT] |= bit;
+                } else {
+                    vector.validity[kept / CHAR_BIT] &= (unsigned char) ~bit;
+                }
+            }
+            kept++;
+        }
+
+        rids.resize(kept);
+        for (auto &vector : columns) {
+            switch (vector.type) {
+                case TypeInt:
+                    vector.ints.resize(kept);
+                    break;
+                case TypeReal:
+                    vector.reals.resize(kept);
+                    break;
+                case TypeVarChar:
+                    vector.offsets.resize(kept + 1);
+                    vector.heap.resize(vector.offsets[kept]);
+                    break;
+            }
+            vector.validity.resize((kept + CHAR_BIT - 1) / CHAR_BIT);
+        }
+        numRows = kept;
+    }
+
+    RC RecordBatch::keepColumns(const std::vector<int> &columnIndexes) {
+        std::vector<Attribute> keptAttrs;
+        std::vector<ColumnVector> keptColumns;
+        for (int column : columnIndexes) {
+            if (column < 0 || (unsigned) column >= columns.size()) {
+                return -1;
+            }
+            keptAttrs.push_back(attrs[column]);
+            keptColumns.push_back(columns[column]);
+        }
+        attrs.swap(keptAttrs);
+        columns.swap(keptColumns);
+        return 0;
+    }
+
+} // namespace PeterDB
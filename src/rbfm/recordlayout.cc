@@ -0,0 +1,178 @@
+#include "src/include/rbfm.h"
+
+#include <string.h>
+
+namespace PeterDB {
+
+    RecordLayout::RecordLayout(const std::vector<Attribute> &recordDescriptor) : attributes(recordDescriptor) {
+        nullBitmapSize = (attributes.size() + CHAR_BIT - 1) / CHAR_BIT;
+        for (unsigned ind = 0; ind < attributes.size(); ind++) {
+            if (attributes[ind].type == TypeVarChar) {
+                firstVarChar = ind;
+                break;
+            }
+        }
+    }
+
+    int RecordLayout::getFieldIndex(const std::string &attributeName) const {
+        for (unsigned ind = 0; ind < attributes.size(); ind++) {
+            if (attributes[ind].name == attributeName) {
+                return ind;
+            }
+        }
+        return -1;
+    }
+
+    RC RecordLayout::getFieldIndexes(const std::vector<std::string> &attributeNames, std::vector<int> &fieldIndexes) const {
+        fieldIndexes.clear();
+        for (auto &name : attributeNames) {
+            int ind = getFieldIndex(name);
+            if (ind == -1) {
+                return -1; // unknown attribute
+            }
+            fieldIndexes.push_back(ind);
+        }
+        return 0;
+    }
+
+    bool RecordLayout::isNull(const void *nullBitmap, int fieldIndex) {
+        auto *bitmap = (const unsigned char *) nullBitmap;
+        return bitmap[fieldIndex / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - fieldIndex % CHAR_BIT));
+    }
+
+    unsigned RecordLayout::nullsBefore(const unsigned char *nullBitmap, int fieldIndex) {
+        unsigned count = 0;
+        int fullBytes = fieldIndex / CHAR_BIT;
+        for (int ind = 0; ind < fullBytes; ind++) {
+            count += __builtin_popcount(nullBitmap[ind]);
+        }
+        unsigned rest = fieldIndex % CHAR_BIT;
+        if (rest != 0) {
+            // the leading bits of the byte belong to the earlier fields
+            count += __builtin_popcount(nullBitmap[fullBytes] & (0xffu << (CHAR_BIT - rest)) & 0xffu);
+        }
+        return count;
+    }
+
+    const char *RecordLayout::getStoredField(const void *record, int fieldIndex, char16_t &varCharLen) const {
+        // stored format: flag, field count, null bitmap, one 4-byte slot per non-null field, VarChar bytes
+        auto *bytes = (const char *) record;
+        char16_t fieldLength;
+        memcpy(&fieldLength, bytes + FLAG_LEN, FIELD_SIZE_LEN);
+        if (fieldIndex >= fieldLength) {
+            // written before the attribute existed
+            return nullptr;
+        }
+        auto *nullBitmap = (const unsigned char *) bytes + FLAG_LEN + FIELD_SIZE_LEN;
+        if (isNull(nullBitmap, fieldIndex)) {
+            return nullptr;
+        }
+        unsigned storedBitmapSize = (fieldLength + CHAR_BIT - 1) / CHAR_BIT;
+        const char *slot = bytes + FLAG_LEN + FIELD_SIZE_LEN + storedBitmapSize
+                           + (fieldIndex - nullsBefore(nullBitmap, fieldIndex)) * INT_FIELD_LEN;
+
+        if (attributes[fieldIndex].type != TypeVarChar) {
+            varCharLen = 0;
+            return slot;
+        }
+        char16_t offsetVarChar;
+        memcpy(&varCharLen, slot, VARCHAR_FIELD_LENGTH_LEN);
+        memcpy(&offsetVarChar, slot + VARCHAR_FIELD_LENGTH_LEN, VARCHAR_FIELD_OFFSET_LEN);
+        return bytes + offsetVarChar;
+    }
+
+    RC RecordLayout::projectStored(const void *record, const std::vector<int> &fieldIndexes, void *data) const {
+        int selBitmapSize = (fieldIndexes.size() + CHAR_BIT - 1) / CHAR_BIT;
+        auto *selBitmap = (unsigned char *) data;
+        memset(selBitmap, 0, selBitmapSize);
+        char *out = (char *) data + selBitmapSize;
+
+        for (unsigned idx = 0; idx < fieldIndexes.size(); idx++) {
+            char16_t varCharLen;
+            const char *field = getStoredField(record, fieldIndexes[idx], varCharLen);
+            if (field == nullptr) {
+                selBitmap[idx / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - idx % CHAR_BIT));
+                continue;
+            }
+            if (attributes[fieldIndexes[idx]].type == TypeVarChar) {
+                int len = varCharLen;
+                memcpy(out, &len, sizeof(int));
+                memcpy(out + sizeof(int), field, len);
+                out += sizeof(int) + len;
+            } else {
+                memcpy(out, field, INT_FIELD_LEN);
+                out += INT_FIELD_LEN;
+            }
+        }
+        return 0;
+    }
+
+    const char *RecordLayout::getField(const void *data, int fieldIndex) const {
+        auto *nullBitmap = (const unsigned char *) data;
+        if (isNull(nullBitmap, fieldIndex)) {
+            return nullptr;
+        }
+        if (firstVarChar == -1 || fieldIndex <= firstVarChar) {
+            return (const char *) data + nullBitmapSize + (fieldIndex - nullsBefore(nullBitmap, fieldIndex)) * INT_FIELD_LEN;
+        }
+
+        const char *field = (const char *) data + nullBitmapSize
+                            + (firstVarChar - nullsBefore(nullBitmap, firstVarChar)) * INT_FIELD_LEN;
+        for (int ind = firstVarChar; ind < fieldIndex; ind++) {
+            if (isNull(nullBitmap, ind)) {
+                continue;
+            }
+            if (attributes[ind].type == TypeVarChar) {
+                int varCharLen;
+                memcpy(&varCharLen, field, sizeof(int));
+                field += sizeof(int) + varCharLen;
+            } else {
+                field += INT_FIELD_LEN;
+            }
+        }
+        return field;
+    }
+
+    unsigned RecordLayout::getLength(const void *data) const {
+        // the tuple ends with its last non-null field
+        for (int ind = (int) attributes.size() - 1; ind >= 0; ind--) {
+            const char *field = getField(data, ind);
+            if (field == nullptr) {
+                continue;
+            }
+            int length = INT_FIELD_LEN;
+            if (attributes[ind].type == TypeVarChar) {
+                int varCharLen;
+                memcpy(&varCharLen, field, sizeof(int));
+                length += varCharLen;
+            }
+            return field - (const char *) data + length;
+        }
+        return nullBitmapSize;
+    }
+
+    RC RecordLayout::project(const void *data, const std::vector<int> &fieldIndexes, void *selData) const {
+        int selBitmapSize = (fieldIndexes.size() + CHAR_BIT - 1) / CHAR_BIT;
+        auto *selBitmap = (unsigned char *) selData;
+        memset(selBitmap, 0, selBitmapSize);
+        char *out = (char *) selData + selBitmapSize;
+
+        for (unsigned idx = 0; idx < fieldIndexes.size(); idx++) {
+            const char *field = getField(data, fieldIndexes[idx]);
+            if (field == nullptr) {
+                selBitmap[idx / CHAR_BIT] |= (unsigned char) (1u << (unsigned) (CHAR_BIT - 1 - idx % CHAR_BIT));
+                continue;
+            }
+            int length = INT_FIELD_LEN;
+            if (attributes[fieldIndexes[idx]].type == TypeVarChar) {
+                int varCharLen;
+                memcpy(&varCharLen, field, sizeof(int));
+                length += varCharLen;
+            }
+            memcpy(out, field, length);
+            out += length;
+        }
+        return 0;
+    }
+
+} // namespace PeterDB
@@ -1,5 +1,8 @@
 #include "src/include/rm.h"
 
+#include <algorithm>
+#include <sstream>
+
 namespace PeterDB {
     RelationManager *RelationManager::_relation_manager = nullptr;
 
@@ -12,6 +15,7 @@ namespace PeterDB {
 
     RelationManager::RelationManager(){
         _rbfm = &RecordBasedFileManager::instance();
+        _indexManager = &IndexManager::instance();
         createTablesRecordDescriptor();
         createColumnsRecordDescriptor();
         createIndexesRecordDescriptor();
@@ -307,6 +311,7 @@ namespace PeterDB {
     RC RelationManager::createCatalog() {
 
         FileHandle fileHandle;
+        invalidateTableInfo("");
 
         if(_rbfm->createFile(TABLES_TABLE) != 0 || _rbfm->createFile(COLUMNS_TABLE) != 0 || _rbfm->createFile(INDEXES_TABLE) != 0){
             std::cout << "can not create two main CATALOG tables" << std::endl;
@@ -330,6 +335,7 @@ namespace PeterDB {
 
     RC RelationManager::deleteCatalog() {
         FileHandle fileHandle;
+        invalidateTableInfo("");
 
         // delete all tables registered in TABLES_TABLE
         RM_ScanIterator rm_ScanIterator_Tables;
@@ -466,6 +472,7 @@ namespace PeterDB {
         insertReocord2Columns(fileHandle, this_table_id, attrs);
         _rbfm->closeFile(fileHandle);
 
+        invalidateTableInfo(tableName);
         return 0;
     }
 
@@ -591,6 +598,7 @@ namespace PeterDB {
         _rbfm->closeFile(fileHandle);
         _rbfm->destroyFile(tableName);
         rm_ScanIterator_Columns.close();
+        invalidateTableInfo(tableName);
 
         free(data);
         return 0;
@@ -661,21 +669,100 @@ namespace PeterDB {
 
 
     RC RelationManager::getAttributes(const std::string &tableName, std::vector<Attribute> &attrs) {
-        int tableId = -1;
-        RID rid;
-
-        RC rc1 = getTableIdFromTableTable(tableName, tableId, rid);
-        if(rc1 != 0)
+        const TableInfo *tableInfo;
+        if(getTableInfo(tableName, tableInfo) != 0)
             return -1;
 
-        RC rc2 = getAttributesGivenTableId(tableId, attrs);
-        if(rc2 != 0)
-            return -1;
+        attrs = tableInfo->attrs;
+        return 0;
+    }
+
 
+    RC RelationManager::getTableInfo(const std::string &tableName, const TableInfo *&tableInfo) {
+        auto it = _catalogCache.find(tableName);
+        if(it == _catalogCache.end()){
+            TableInfo info;
+            RID rid;
+            if(getTableIdFromTableTable(tableName, info.tableId, rid) != 0)
+                return -1; // no such table
+            if(getAttributesGivenTableId(info.tableId, info.attrs) != 0)
+                return -1;
+            info.fileName = tableName;  // createTable names the file after the table
+
+            std::map<std::pair<std::string, std::string>, RID> attr2ridMap;
+            if(extractIndexFileInfoFromIndexesCatalog(tableName, attr2ridMap) == -1)
+                return -1;
+            RecordLayout layout(info.attrs);
+            for(auto &entry : attr2ridMap){
+                IndexInfo index;
+                index.attributeName = entry.first.first;
+                index.fileName = entry.first.second;
+                std::vector<std::string> columns;
+                std::string allColumns = index.attributeName;
+                unsigned includedCount = 0;
+                std::string::size_type includedStart = allColumns.find(';');
+                if(includedStart != std::string::npos){
+                    includedCount = std::count(allColumns.begin() + includedStart, allColumns.end(), ',') + 1;
+                    allColumns[includedStart] = ',';
+                }
+                std::stringstream columnList(allColumns);
+                for(std::string column; std::getline(columnList, column, ',');){
+                    columns.push_back(column);
+                }
+                if(layout.getFieldIndexes(columns, index.fieldIndexes) != 0)
+                    continue; // left behind by a createIndex on an unknown attribute, it has no entries
+                index.compositeKey = nullptr;
+                if(columns.size() > 1){
+                    std::vector<Attribute> keyAttrs;
+                    for(int fieldIndex : index.fieldIndexes){
+                        keyAttrs.push_back(info.attrs[fieldIndex]);
+                    }
+                    index.compositeKey = new IX_CompositeKey(keyAttrs, includedCount);
+                    index.keyAttribute = index.compositeKey->getKeyAttribute();
+                }
+                else{
+                    index.keyAttribute = info.attrs[index.fieldIndexes[0]];
+                }
+                index.ixFileHandle = new IXFileHandle;
+                if(_indexManager->acquireFile(index.fileName, *index.ixFileHandle) != 0){
+                    delete index.ixFileHandle;
+                    delete index.compositeKey;
+                    releaseTableInfo(info);
+                    return -1;
+                }
+                info.indexes.push_back(index);
+            }
+
+            it = _catalogCache.insert(std::make_pair(tableName, info)).first;
+        }
+        tableInfo = &it->second;
         return 0;
     }
 
 
+    void RelationManager::invalidateTableInfo(const std::string &tableName) {
+        for(auto it = _catalogCache.begin(); it != _catalogCache.end();){
+            if(tableName.empty() || it->first == tableName){
+                releaseTableInfo(it->second);
+                it = _catalogCache.erase(it);
+            }
+            else{
+                it++;
+            }
+        }
+    }
+
+
+    void RelationManager::releaseTableInfo(TableInfo &tableInfo) {
+        for(IndexInfo &index : tableInfo.indexes){
+            _indexManager->releaseFile(*index.ixFileHandle);
+            delete index.ixFileHandle;
+            delete index.compositeKey;
+        }
+        tableInfo.indexes.clear();
+    }
+
+
     RC RelationManager::insertTuple(const std::string &tableName, const void *data, RID &rid) {
         if(tableName == TABLES_TABLE || tableName == COLUMNS_TABLE || tableName == INDEXES_TABLE){
             return -1; // update 11/30
@@ -685,17 +772,17 @@ namespace PeterDB {
         std::vector<Attribute> table_attrs;
 
         getAttributes(tableName, table_attrs);
-        if(_rbfm->openFile(tableName, fileHandle)==0){
+        if(_rbfm->acquireFile(tableName, fileHandle)==0){
             if(_rbfm->insertRecord(fileHandle, table_attrs, data,rid) == 0){
                 //std::cout <<"[SUCCESS] insert tuple [RelationManager::insertTuple]" << std::endl;
-                _rbfm->closeFile(fileHandle);
+                _rbfm->releaseFile(fileHandle);
 
                 //todo: if you insert a tuple into a table using RelationManager::insertTuple(),
                 // the tuple should be inserted into thetable (via the RBFM layer) and
                 // each corresponding entry should be inserted into each associated index of the table (via the IX layer).
 
-                RC rc = insertEntriesToExistingIndexesFiles(tableName, table_attrs, rid);
-                if(rc == -1){
+                RC rc = insertEntriesInBatch(tableName, table_attrs, std::vector<const void *>(1, data), std::vector<RID>(1, rid));
+                if(rc < 0){
                     return -1;
                 }
 
@@ -703,7 +790,7 @@ namespace PeterDB {
                 return 0;
             }
             else{
-                _rbfm->closeFile(fileHandle);
+                _rbfm->releaseFile(fileHandle);
                 std::cout <<"[ERROR] insert tuple [RelationManager::insertTuple]" << std::endl;
                 return -1;
             }
@@ -713,53 +800,134 @@ namespace PeterDB {
     }
 
 
-    RC RelationManager::insertEntriesToExistingIndexesFiles(const std::string &tableName, std::vector<Attribute> &table_attrs, const RID &rid){
-        // std::cout << "insertEntriesToExistingIndexesFiles"<< std::endl;
-        std::map<std::pair<std::string, std::string>, RID> attr2ridMap;
-        RC rc1 = extractIndexFileInfoFromIndexesCatalog(tableName, attr2ridMap);
-        if(rc1 == -1){
+    RC RelationManager::insertTuples(const std::string &tableName, const std::vector<const void *> &data, std::vector<RID> &rids) {
+        if(tableName == TABLES_TABLE || tableName == COLUMNS_TABLE || tableName == INDEXES_TABLE){
+            return -1;
+        }
+
+        std::vector<Attribute> table_attrs;
+        if(getAttributes(tableName, table_attrs) != 0){
             return -1;
         }
-        if(rc1 == 1)
-            return 1;
 
         FileHandle fileHandle;
-        IXFileHandle ixFileHandle;
+        if(_rbfm->acquireFile(tableName, fileHandle) != 0){
+            return -1;
+        }
+        RC rc = _rbfm->insertRecords(fileHandle, table_attrs, data, rids);
+        _rbfm->releaseFile(fileHandle);
+        if(rc != 0){
+            return -1;
+        }
 
+        return insertEntriesInBatch(tableName, table_attrs, data, rids) < 0 ? -1 : 0;
+    }
 
-        void *returnedKey = malloc(PAGE_SIZE);
-        RC rc2 = _rbfm->openFile(tableName, fileHandle);
-        if(rc2 != 0){
-            return -2;
-        }
-        RC rc3;
-        for(auto it = attr2ridMap.begin(); it != attr2ridMap.end(); it++){
-            if( _rbfm->readAttribute(fileHandle, table_attrs, rid, it->first.first, returnedKey) !=0 )
-                return -1;
 
-            char nullIndicator;
-            memcpy(&nullIndicator, returnedKey, sizeof(char));
-            int nullIndicatorSize = ceil((double(table_attrs.size())/CHAR_BIT));
-            memmove(returnedKey, (char *)returnedKey+nullIndicatorSize, PAGE_SIZE-nullIndicatorSize);
+    // Keys come from the inserted data itself, the records are not read back. Each index gets its entries
+    // in key order, so consecutive inserts mostly land in the same leaf.
+    RC RelationManager::insertEntriesInBatch(const std::string &tableName, const std::vector<Attribute> &table_attrs,
+                                             const std::vector<const void *> &data, const std::vector<RID> &rids){
+        const TableInfo *tableInfo;
+        if(getTableInfo(tableName, tableInfo) != 0){
+            return -1;
+        }
+        if(tableInfo->indexes.empty()){
+            return 1;
+        }
 
-            if(_indexManager->openFile(it->first.second, ixFileHandle) != 0)
-                return -1;
+        RecordLayout layout(table_attrs);
+        for(const IndexInfo &index : tableInfo->indexes){
+            // composite keys are encoded side by side, a single-attribute key is read in place
+            unsigned keySize = sizeof(int) + index.keyAttribute.length + 1;
+            std::vector<char> encodedKeys(index.compositeKey != nullptr ? data.size() * keySize : 0);
+            std::vector<const void *> keys(data.size());
+
+            // a null has no key to index
+            std::vector<unsigned> rows;
+            for(unsigned row = 0; row < data.size(); row++){
+                keys[row] = getIndexKey(index.compositeKey, index.fieldIndexes, layout, data[row], rids[row],
+                                        encodedKeys.data() + (encodedKeys.empty() ? 0 : row * keySize));
+                if(keys[row] != nullptr){
+                    rows.push_back(row);
+                }
+            }
+            if(rows.size() > 1){
+                std::stable_sort(rows.begin(), rows.end(), [&](unsigned lhs, unsigned rhs){
+                    return IndexManager::compareKey(index.keyAttribute, keys[lhs], keys[rhs]) < 0;
+                });
+            }
 
-            for(auto &attribute : table_attrs){
-                if(attribute.name == it->first.first){
-                    rc3 = _indexManager->insertEntry(ixFileHandle, attribute, returnedKey, rid);
-                    if(rc3 != 0){
-                        return -3;
-                    }
+            for(unsigned row : rows){
+                if(_indexManager->insertEntry(*index.ixFileHandle, index.keyAttribute, keys[row], rids[row]) != 0){
+                    return -3;
                 }
             }
-            _indexManager->closeFile(ixFileHandle);
         }
+        return 0;
+    }
 
 
-        _rbfm->closeFile(fileHandle);
-        free(returnedKey);
-        return 0;
+    std::string RelationManager::getIndexColumnList(const std::vector<std::string> &attributeNames,
+                                                    const std::vector<std::string> &includedAttributeNames) {
+        std::string columnList;
+        for(const std::string &attributeName : attributeNames){
+            if(!columnList.empty())
+                columnList += ",";
+            columnList += attributeName;
+        }
+        for(unsigned i = 0; i < includedAttributeNames.size(); i++){
+            columnList += i == 0 ? ";" : ",";
+            columnList += includedAttributeNames[i];
+        }
+        return columnList;
+    }
+
+
+    std::string RelationManager::getIndexFilename(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                                  const std::vector<std::string> &includedAttributeNames) {
+        // a single attribute keeps the table_attr.idx name
+        return tableName + "_" + getIndexColumnList(attributeNames, includedAttributeNames) + ".idx";
+    }
+
+
+    const void *RelationManager::getIndexKey(const IX_CompositeKey *compositeKey, const std::vector<int> &fieldIndexes,
+                                             const RecordLayout &layout, const void *record, const RID &rid,
+                                             void *keyBuffer) {
+        if(compositeKey == nullptr)
+            return layout.getField(record, fieldIndexes[0]);
+
+        // a null column is part of a composite key, it sorts before the values of that column
+        std::vector<const void *> values;
+        for(int fieldIndex : fieldIndexes){
+            values.push_back(layout.getField(record, fieldIndex));
+        }
+        compositeKey->encode(values, keyBuffer, &rid);
+        return keyBuffer;
+    }
+
+
+    RC RelationManager::insertEntriesToExistingIndexesFiles(const std::string &tableName, std::vector<Attribute> &table_attrs, const RID &rid){
+        const TableInfo *tableInfo;
+        if(getTableInfo(tableName, tableInfo) != 0){
+            return -1;
+        }
+        if(tableInfo->indexes.empty())
+            return 1;
+
+        // the keys are taken from the stored tuple
+        FileHandle fileHandle;
+        if(_rbfm->acquireFile(tableName, fileHandle) != 0){
+            return -2;
+        }
+        void *record = malloc(PAGE_SIZE);
+        RC rc = _rbfm->readRecord(fileHandle, table_attrs, rid, record);
+        _rbfm->releaseFile(fileHandle);
+        if(rc == 0){
+            rc = insertEntriesInBatch(tableName, table_attrs, std::vector<const void *>(1, record), std::vector<RID>(1, rid));
+        }
+        free(record);
+        return rc < 0 ? -1 : 0;
     }
 
 
@@ -833,20 +1001,26 @@ namespace PeterDB {
         std::vector<Attribute> table_attrs;
 
         getAttributes(tableName, table_attrs);
-        if(_rbfm->openFile(tableName, fileHandle)==0){
+
+        // the keys are read from the tuple, so its entries go before it does; catalog tables have no indexes
+        bool isCatalog = tableName == TABLES_TABLE || tableName == COLUMNS_TABLE || tableName == INDEXES_TABLE;
+        if(!isCatalog && deleteEntriesFromExistingIndexesFiles(tableName, table_attrs, rid) == -1)
+            return -1;
+
+        if(_rbfm->acquireFile(tableName, fileHandle)==0){
             RC rc = _rbfm->deleteRecord(fileHandle, table_attrs,rid);
             if(rc == 0){
-                _rbfm->closeFile(fileHandle);
-
-                RC rc1 = deleteEntriesFromExistingIndexesFiles(tableName, table_attrs, rid);
-                if(rc1 == -1)
-                    return -1;
+                _rbfm->releaseFile(fileHandle);
 
                 // std::cout <<"[SUCCESS] delete tuple [RelationManager::deleteTuple]" << std::endl;
                 return 0;
             }
             else{
-                _rbfm->closeFile(fileHandle);
+                _rbfm->releaseFile(fileHandle);
+
+                // the tuple is still there, put its entries back
+                if(!isCatalog)
+                    insertEntriesToExistingIndexesFiles(tableName, table_attrs, rid);
                 return rc;
             }
 
@@ -858,50 +1032,39 @@ namespace PeterDB {
 
 
     RC RelationManager::deleteEntriesFromExistingIndexesFiles(const std::string &tableName, std::vector<Attribute> &table_attrs, const RID &rid){
-        std::map<std::pair<std::string, std::string>, RID> attr2ridMap;
-        RC rc1 = extractIndexFileInfoFromIndexesCatalog(tableName, attr2ridMap);
-        if(rc1 == -1){
+        const TableInfo *tableInfo;
+        if(getTableInfo(tableName, tableInfo) != 0){
             return -1;
         }
-        if(rc1 == 1)
+        if(tableInfo->indexes.empty())
             return 1;
 
+        // one read of the tuple gives the keys of every index
         FileHandle fileHandle;
-        IXFileHandle ixFileHandle;
-
-
-        void *returnedKey = malloc(PAGE_SIZE);
-        RC rc2 = _rbfm->openFile(tableName, fileHandle);
-        if(rc2 != 0){
+        if(_rbfm->acquireFile(tableName, fileHandle) != 0){
             return -2;
         }
-        RC rc3;
-        for(auto it = attr2ridMap.begin(); it != attr2ridMap.end(); it++){
-            if( _rbfm->readAttribute(fileHandle, table_attrs, rid, it->first.first, returnedKey) !=0 )
-                return -1;
-
-            char nullIndicator;
-            memcpy(&nullIndicator, returnedKey, sizeof(char));
-            int nullIndicatorSize = ceil((double(table_attrs.size())/CHAR_BIT));
-            memmove(returnedKey, (char *)returnedKey+nullIndicatorSize, PAGE_SIZE-nullIndicatorSize);
-
-            if(_indexManager->openFile(it->first.second, ixFileHandle) != 0)
-                return -1;
+        void *record = malloc(PAGE_SIZE);
+        RC rc = _rbfm->readRecord(fileHandle, table_attrs, rid, record);
+        _rbfm->releaseFile(fileHandle);
+        if(rc != 0){
+            free(record);
+            return -1;
+        }
 
-            for(auto &attribute : table_attrs){
-                if(attribute.name == it->first.first){
-                    rc3 = _indexManager->deleteEntry(ixFileHandle, attribute, returnedKey, rid);
-                    if(rc3 != 0){
-                        return -3;
-                    }
-                }
+        RecordLayout layout(table_attrs);
+        for(const IndexInfo &index : tableInfo->indexes){
+            std::vector<char> keyBuffer(sizeof(int) + index.keyAttribute.length + 1);
+            const void *key = getIndexKey(index.compositeKey, index.fieldIndexes, layout, record, rid, keyBuffer.data());
+            if(key == nullptr)
+                continue; // nulls are not indexed
+            if(_indexManager->deleteEntry(*index.ixFileHandle, index.keyAttribute, key, rid) != 0){
+                free(record);
+                return -3;
             }
-            _indexManager->closeFile(ixFileHandle);
         }
 
-
-        _rbfm->closeFile(fileHandle);
-        free(returnedKey);
+        free(record);
         return 0;
     }
 
@@ -920,22 +1083,20 @@ namespace PeterDB {
         }
 
 
-        if(_rbfm->openFile(tableName, fileHandle) == 0){
+        if(_rbfm->acquireFile(tableName, fileHandle) == 0){
 
             if(_rbfm->updateRecord(fileHandle, table_attrs, data, rid) == 0){
 
-                _rbfm->closeFile(fileHandle);
-                return 0;
-            }
-            _rbfm->closeFile(fileHandle);
-
-
-            RC rc2 = insertEntriesToExistingIndexesFiles(tableName, table_attrs, rid);
+                _rbfm->releaseFile(fileHandle);
 
-            if(rc2 == -1){
-                return -1;
+                // index the new values
+                RC rc2 = insertEntriesInBatch(tableName, table_attrs, std::vector<const void *>(1, data), std::vector<RID>(1, rid));
+                return rc2 < 0 ? -1 : 0;
             }
+            _rbfm->releaseFile(fileHandle);
 
+            // the tuple is unchanged, put its entries back
+            insertEntriesToExistingIndexesFiles(tableName, table_attrs, rid);
         }
         return -1;
     }
@@ -947,14 +1108,14 @@ namespace PeterDB {
 
         getAttributes(tableName, table_attrs);
 
-        if(_rbfm->openFile(tableName, fileHandle) == 0){
+        if(_rbfm->acquireFile(tableName, fileHandle) == 0){
 
             if(_rbfm->readRecord(fileHandle, table_attrs, rid, data) == 0){
 
-                _rbfm->closeFile(fileHandle);
+                _rbfm->releaseFile(fileHandle);
                 return 0;
             }
-            _rbfm->closeFile(fileHandle);
+            _rbfm->releaseFile(fileHandle);
         }
         // std::cout << "can not open file [RelationManager::readTuple]" << std::endl;
         return -1;
@@ -972,16 +1133,17 @@ namespace PeterDB {
 
         if(getAttributes(tableName, table_attrs)  == 0){
 
-            if(_rbfm->openFile(tableName, fileHandle) == 0){
+            if(_rbfm->acquireFile(tableName, fileHandle) == 0){
 
                 if(_rbfm->readAttribute(fileHandle, table_attrs, rid, attributeName, data) == 0){
 
                     // std::cout <<"[SUCCESS] read attribute [RelationManager::readAttribute]\n" << std::endl;
 
-                    _rbfm->closeFile(fileHandle);
+                    _rbfm->releaseFile(fileHandle);
                     return 0;
 
                 }
+                _rbfm->releaseFile(fileHandle);
             }
         }
         return -1;
@@ -1011,6 +1173,24 @@ namespace PeterDB {
     }
 
 
+    RC RelationManager::scan(const std::string &tableName, const Predicate &predicate,
+                             const std::vector<std::string> &attributeNames, RM_ScanIterator &rm_ScanIterator) {
+        std::vector<Attribute> attrs_table;
+        FileHandle fileHandle;
+        if (getAttributes(tableName, attrs_table) != 0) {
+            return -1;
+        }
+        if (_rbfm->openFile(tableName, fileHandle) != 0) {
+            return -1;
+        }
+        if (_rbfm->scan(fileHandle, attrs_table, predicate, attributeNames, rm_ScanIterator.getRBFMScanIterator()) != 0) {
+            _rbfm->closeFile(fileHandle);
+            return -1;
+        }
+        return 0;
+    }
+
+
     RC RelationManager::getTableIdFromTableTable(const std::string &tableName, int &tableId, RID &rid) {
         RBFM_ScanIterator rbfmScanIterator;
         FileHandle fileHandle;
@@ -1177,6 +1357,10 @@ namespace PeterDB {
         return _rbfmScanItearator.getNextRecord(rid, data);
     }
 
+    RC RM_ScanIterator::getNextBatch(RecordBatch &batch) {
+        return _rbfmScanItearator.getNextBatch(batch);
+    }
+
     RC RM_ScanIterator::close(){
         //_rbfmScanItearator.close();
         return 0;
@@ -1240,6 +1424,30 @@ namespace PeterDB {
 
 
     RC RelationManager::createIndex(const std::string &tableName, const std::string &attributeName) {
+        return createIndex(tableName, std::vector<std::string>(1, attributeName));
+    }
+
+    RC RelationManager::createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames) {
+        return createIndex(tableName, attributeNames, BTreeIndex);
+    }
+
+    RC RelationManager::createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                    IndexType indexType) {
+        return buildIndex(tableName, attributeNames, std::vector<std::string>(), indexType);
+    }
+
+    RC RelationManager::createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                    const std::vector<std::string> &includedAttributeNames) {
+        return createIndex(tableName, attributeNames, includedAttributeNames, BTreeIndex);
+    }
+
+    RC RelationManager::createIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                    const std::vector<std::string> &includedAttributeNames, IndexType indexType) {
+        return buildIndex(tableName, attributeNames, includedAttributeNames, indexType);
+    }
+
+    RC RelationManager::buildIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                   const std::vector<std::string> &includedAttributeNames, IndexType indexType) {
         FileHandle fileHandle;
         IXFileHandle ixFileHandle;
 
@@ -1248,15 +1456,43 @@ namespace PeterDB {
             return -1;
         _rbfm->closeFile(fileHandle);
 
+        // a hash probe needs the whole key, included columns would be part of it
+        if(indexType == HashIndex && !includedAttributeNames.empty())
+            return -1;
+
+        // check if every attributeName exist in attributes of tableName, once each; the included columns
+        // follow the key ones in every entry
+        std::vector<Attribute> attrs;
+        if(getAttributes(tableName, attrs) != 0)
+            return -1;
+        std::vector<std::string> columns(attributeNames);
+        columns.insert(columns.end(), includedAttributeNames.begin(), includedAttributeNames.end());
+        std::vector<int> fieldIndexes;
+        if(attributeNames.empty() || RecordLayout(attrs).getFieldIndexes(columns, fieldIndexes) != 0)
+            return -1;
+        std::vector<Attribute> keyAttrs;
+        for(unsigned i = 0; i < fieldIndexes.size(); i++){
+            if(std::count(fieldIndexes.begin(), fieldIndexes.begin() + i, fieldIndexes[i]) != 0)
+                return -1; // repeated column
+            if(columns[i].find_first_of(",;") != std::string::npos)
+                return -1; // would not split back out of the column list
+            keyAttrs.push_back(attrs[fieldIndexes[i]]);
+        }
+
         // check if index file exists
-        std::string indexFilename = tableName + "_" + attributeName + ".idx";
+        std::string indexFilename = getIndexFilename(tableName, attributeNames, includedAttributeNames);
         std::string atableName = tableName;
-        std::string aattributeName = attributeName;
+        std::string aattributeName = getIndexColumnList(attributeNames, includedAttributeNames);
 
-        if(_indexManager->openFile(indexFilename, ixFileHandle) == 0)
+        if(_indexManager->openFile(indexFilename, ixFileHandle) == 0) {
+            _indexManager->closeFile(ixFileHandle);
             return -1;
+        }
 
-        if(_indexManager->createFile(indexFilename) != 0)
+        // key compression is asked for, it changes the separators printBTree shows
+        unsigned options = indexType == HashIndex ? IX_HASH
+                           : indexType == CompressedBTreeIndex ? IX_KEY_COMPRESSION : 0;
+        if(_indexManager->createFile(indexFilename, options) != 0)
             return -1;
 
         // insert one record to INDEXES_TABLE
@@ -1264,91 +1500,78 @@ namespace PeterDB {
         int tableId;
         RID rid;
         RC rc1 = getTableIdFromTableTable(tableName, tableId, rid);
-        if(rc1 != 0)
+        if(rc1 != 0) {
+            free(record);
             return -1;
+        }
         _rbfm->openFile(INDEXES_TABLE, fileHandle);
         prepareRecord4IndexesCatalog(fileHandle, tableId, atableName, aattributeName, indexFilename, record);
         RC rc = _rbfm->insertRecord(fileHandle, _IndexesDescriptor, record, rid);
-        if(rc != 0)
-            return -1;
         free(record);
         _rbfm->closeFile(fileHandle);
-
-
-        // check if this attributeName exist in attributes of tableName
-        Attribute  thisattr;
-        bool isexist;
-        std::vector<Attribute> attrs;
-        getAttributes(tableName, attrs);
-        for(Attribute &attr: attrs){
-            if(attr.name == attributeName){
-                thisattr = attr;
-                isexist = true;
-                break;
-            }
-        }
-        if(isexist == false){
+        if(rc != 0)
             return -1;
+        invalidateTableInfo(tableName);
+
+        // sort the keys of the existing rows, then build the tree bottom-up from them
+        IX_CompositeKey compositeKey(keyAttrs, includedAttributeNames.size());
+        bool isComposite = keyAttrs.size() > 1;
+        const Attribute &keyAttribute = isComposite ? compositeKey.getKeyAttribute() : keyAttrs[0];
+        IX_KeySorter sorter(keyAttribute);
+        void *oneRecord = malloc(PAGE_SIZE);
+        std::vector<char> keyBuffer(sizeof(int) + keyAttribute.length + 1);
+        RecordLayout keyLayout(keyAttrs);
+        std::vector<int> keyFields;
+        for(unsigned i = 0; i < keyAttrs.size(); i++){
+            keyFields.push_back(i);
         }
-        else{
-            // if this attributeName exist in attributes of tableName,
-            // insert existing entries to index file
-            void *oneRecord = malloc(PAGE_SIZE);
-            std::vector<std::string> wantedAttrs;
-            wantedAttrs.push_back(attributeName);
-            RBFM_ScanIterator rbfmScanIterator;
-
-            _rbfm->openFile(tableName, fileHandle);
-            _indexManager->openFile(indexFilename, ixFileHandle);
-            if(_rbfm->scan(fileHandle, attrs, "", NO_OP, NULL, wantedAttrs, rbfmScanIterator) == 0){
-                int nullIndicatorSize = ceil((double)wantedAttrs.size()/CHAR_BIT);
-
-                while(rbfmScanIterator.getNextRecord(rid, oneRecord) != RM_EOF){
-                    auto* nullIndicator = (char* )malloc(nullIndicatorSize);
-                    memcpy(nullIndicator, oneRecord, nullIndicatorSize);
-
-                    if(nullIndicator[0] & (unsigned) 1 << (unsigned)7){
-                        free(nullIndicator);
-                        free(oneRecord);
-                        return -1; //todo ??
-                    }
-                    free(nullIndicator);
-                    memmove((char* )oneRecord, (char* )oneRecord + nullIndicatorSize, PAGE_SIZE - nullIndicatorSize);
-                    RC rc2 = _indexManager->insertEntry(ixFileHandle, thisattr, oneRecord, rid);
-                    if(rc2 != 0) {
-                        free(oneRecord);
-                        return -1;
-                    }
-
-                }
-
-
-            }
-            else{
-                free(oneRecord);
-                return -1;
-            }
+        RBFM_ScanIterator rbfmScanIterator;
 
-            rbfmScanIterator.close();
+        if(_rbfm->openFile(tableName, fileHandle) != 0){
             free(oneRecord);
-            if(_indexManager->closeFile(ixFileHandle) != 0)
-                return -1;
-            return 0;
+            return -1;
         }
+        if(_rbfm->scan(fileHandle, attrs, "", NO_OP, NULL, columns, rbfmScanIterator) != 0){
+            free(oneRecord);
+            _rbfm->closeFile(fileHandle);
+            return -1;
+        }
+        rc = 0;
+        while(rc == 0 && rbfmScanIterator.getNextRecord(rid, oneRecord) != RM_EOF){
+            const void *key = getIndexKey(isComposite ? &compositeKey : nullptr, keyFields, keyLayout, oneRecord, rid,
+                                          keyBuffer.data());
+            // a null key is not indexed
+            if(key == nullptr)
+                continue;
+            rc = sorter.addEntry(key, rid);
+        }
+        rbfmScanIterator.close();
+        _rbfm->closeFile(fileHandle);
+        free(oneRecord);
 
-
-
-
-
-
+        if(rc != 0 || sorter.finish() != 0)
+            return -1;
+        if(_indexManager->openFile(indexFilename, ixFileHandle) != 0)
+            return -1;
+        rc = _indexManager->bulkLoad(ixFileHandle, keyAttribute, sorter);
+        if(_indexManager->closeFile(ixFileHandle) != 0 || rc != 0)
+            return -1;
         return 0;
     }
 
-
     RC RelationManager::destroyIndex(const std::string &tableName, const std::string &attributeName) {
+        return destroyIndex(tableName, std::vector<std::string>(1, attributeName));
+    }
+
+    RC RelationManager::destroyIndex(const std::string &tableName, const std::vector<std::string> &attributeNames) {
+        return destroyIndex(tableName, attributeNames, std::vector<std::string>());
+    }
+
+    RC RelationManager::destroyIndex(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                     const std::vector<std::string> &includedAttributeNames) {
 
         // varchar for index filename
-        std::string indexFilename = tableName + "_" + attributeName + ".idx";
+        std::string indexFilename = getIndexFilename(tableName, attributeNames, includedAttributeNames);
         void* indexFilenameVarchar = malloc(PAGE_SIZE);
         int lenIndexFilename = strlen(indexFilename.c_str());
         memcpy(indexFilenameVarchar, &lenIndexFilename, sizeof(int));
@@ -1356,7 +1579,7 @@ namespace PeterDB {
 
         FileHandle fileHandle;
         RBFM_ScanIterator rbfmScanIterator;
-        std::vector<std::string> attrs;attrs.emplace_back("index-name");
+        std::vector<std::string> attrs;attrs.emplace_back("index-filename");
         _rbfm->openFile(INDEXES_TABLE, fileHandle);
         if(_rbfm->scan(fileHandle, _IndexesDescriptor, "index-filename", EQ_OP, indexFilenameVarchar, attrs, rbfmScanIterator) == 0){
             RID rid;
@@ -1368,13 +1591,18 @@ namespace PeterDB {
         }
         else{
             free(indexFilenameVarchar);
+            _rbfm->closeFile(fileHandle);
             return -1;
         }
 
         free(indexFilenameVarchar);
 
         rbfmScanIterator.close();
-        return 0;
+        _rbfm->closeFile(fileHandle);
+
+        // the cached handles go first, then the file, so the index can be created again
+        invalidateTableInfo(tableName);
+        return _indexManager->destroyFile(indexFilename) == 0 ? 0 : -1;
     }
 
 
@@ -1398,37 +1626,106 @@ namespace PeterDB {
             return -1;
         }
 
-        std::string indexFilename = tableName + "_" + attributeName + ".idx";
+        rm_IndexScanIterator.setCompositeKey(nullptr); // keys come back as they are
+        std::string indexFilename = getIndexFilename(tableName, std::vector<std::string>(1, attributeName));
         RC rc2 = _indexManager->openFile(indexFilename, rm_IndexScanIterator.getIXFileHandle());
         if(rc2 != 0)
             return -1;
         RC rc3 = _indexManager->scan(rm_IndexScanIterator.getIXFileHandle(), thisAttribute,
                                      lowKey, highKey, lowKeyInclusive, highKeyInclusive,
                                      rm_IndexScanIterator.getIX_ScanIterator());
-        if(rc3 != 0)
+        if(rc3 != 0) {
+            _indexManager->closeFile(rm_IndexScanIterator.getIXFileHandle());
             return -1;
+        }
 
-        // _indexManager->closeFile(rm_IndexScanIterator.getIXFileHandle());
+        return 0;
+    }
 
+    RC RelationManager::indexScan(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                  const std::vector<const void *> &lowKey, const std::vector<const void *> &highKey,
+                                  bool lowKeyInclusive, bool highKeyInclusive,
+                                  RM_IndexScanIterator &rm_IndexScanIterator) {
+        return indexScan(tableName, attributeNames, std::vector<std::string>(), lowKey, highKey, lowKeyInclusive,
+                         highKeyInclusive, rm_IndexScanIterator);
+    }
 
+    RC RelationManager::indexScan(const std::string &tableName, const std::vector<std::string> &attributeNames,
+                                  const std::vector<std::string> &includedAttributeNames,
+                                  const std::vector<const void *> &lowKey, const std::vector<const void *> &highKey,
+                                  bool lowKeyInclusive, bool highKeyInclusive,
+                                  RM_IndexScanIterator &rm_IndexScanIterator) {
+        if(attributeNames.size() == 1 && includedAttributeNames.empty()){
+            return indexScan(tableName, attributeNames[0], lowKey.empty() ? NULL : lowKey[0],
+                             highKey.empty() ? NULL : highKey[0], lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator);
+        }
+        if(attributeNames.empty() || lowKey.size() > attributeNames.size() || highKey.size() > attributeNames.size())
+            return -1;
 
+        std::vector<Attribute> attrs;
+        std::vector<std::string> columns(attributeNames);
+        columns.insert(columns.end(), includedAttributeNames.begin(), includedAttributeNames.end());
+        std::vector<int> fieldIndexes;
+        if(getAttributes(tableName, attrs) != 0 || RecordLayout(attrs).getFieldIndexes(columns, fieldIndexes) != 0)
+            return -1;
+        std::vector<Attribute> keyAttrs;
+        for(int fieldIndex : fieldIndexes){
+            keyAttrs.push_back(attrs[fieldIndex]);
+        }
+        auto *compositeKey = new IX_CompositeKey(keyAttrs, includedAttributeNames.size());
+        const Attribute &keyAttribute = compositeKey->getKeyAttribute();
+
+        // bounds on the leading columns cover every key that starts with them
+        std::vector<char> lowBuffer(sizeof(int) + keyAttribute.length + 1);
+        std::vector<char> highBuffer(sizeof(int) + keyAttribute.length + 1);
+        if(!lowKey.empty())
+            compositeKey->encodeBound(lowKey, true, lowKeyInclusive, lowBuffer.data());
+        if(!highKey.empty())
+            compositeKey->encodeBound(highKey, false, highKeyInclusive, highBuffer.data());
+
+        std::string indexFilename = getIndexFilename(tableName, attributeNames, includedAttributeNames);
+        if(_indexManager->openFile(indexFilename, rm_IndexScanIterator.getIXFileHandle()) != 0){
+            delete compositeKey;
+            return -1;
+        }
+        if(_indexManager->scan(rm_IndexScanIterator.getIXFileHandle(), keyAttribute,
+                               lowKey.empty() ? NULL : lowBuffer.data(), highKey.empty() ? NULL : highBuffer.data(),
+                               lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.getIX_ScanIterator()) != 0){
+            _indexManager->closeFile(rm_IndexScanIterator.getIXFileHandle());
+            delete compositeKey;
+            return -1;
+        }
+        rm_IndexScanIterator.setCompositeKey(compositeKey);
         return 0;
     }
 
-    RM_IndexScanIterator::RM_IndexScanIterator() {
+    RM_IndexScanIterator::RM_IndexScanIterator() : _compositeKey(nullptr) {
 
     }
 
     RM_IndexScanIterator::~RM_IndexScanIterator() {
+        delete _compositeKey;
+    }
 
+    void RM_IndexScanIterator::setCompositeKey(IX_CompositeKey *compositeKey) {
+        delete _compositeKey;
+        _compositeKey = compositeKey;
     }
 
     RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key) {
-        return _ix_ScanItearator.getNextEntry(rid, key);
+        if(_compositeKey == nullptr)
+            return _ix_ScanItearator.getNextEntry(rid, key);
+        RC rc = _ix_ScanItearator.getNextEntry(rid, _encodedKey);
+        if(rc != 0)
+            return rc;
+        return _compositeKey->decode(_encodedKey, key);
     }
 
     RC RM_IndexScanIterator::close() {
         _ix_ScanItearator.close();
+        setCompositeKey(nullptr);
+        // the handle indexScan opened, already closed if close is called twice
+        IndexManager::instance().closeFile(_ixFileHandle);
         return 0;
     }
 
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <climits>
+#include <numeric>
 #include <random>
+#include <set>
 
 #include "src/include/ix.h"
 #include "test/utils/ix_test_utils.h"
@@ -867,4 +871,1304 @@ namespace PeterDBTesting {
 
     }
 
+    typedef std::vector<std::pair<std::string, PeterDB::RID>> KeyedRIDs;
+
+    // key in the insertEntry format, as bytes
+    static std::string keyBytes(const PeterDB::Attribute &attribute, const void *key) {
+        unsigned length = sizeof(int);
+        if (attribute.type == PeterDB::TypeVarChar) {
+            length += *(const int *) key;
+        }
+        return std::string((const char *) key, length);
+    }
+
+    static std::string varCharBytes(const std::string &value) {
+        int length = (int) value.size();
+        return std::string((const char *) &length, sizeof(int)) + value;
+    }
+
+    // key order the index should follow, worked out apart from it
+    static int referenceCompare(const PeterDB::Attribute &attribute, const std::string &key,
+                                const std::string &otherKey) {
+        if (attribute.type == PeterDB::TypeVarChar) {
+            int cmp = key.substr(sizeof(int)).compare(otherKey.substr(sizeof(int)));
+            return cmp < 0 ? -1 : cmp > 0;
+        }
+        int value = *(const int *) key.data(), otherValue = *(const int *) otherKey.data();
+        return value < otherValue ? -1 : value > otherValue;
+    }
+
+    static bool lessKeyedRID(const std::pair<std::string, PeterDB::RID> &entry,
+                             const std::pair<std::string, PeterDB::RID> &other) {
+        if (entry.first != other.first) {
+            return entry.first < other.first;
+        }
+        return entry.second.pageNum != other.second.pageNum ? entry.second.pageNum < other.second.pageNum
+                                                             : entry.second.slotNum < other.second.slotNum;
+    }
+
+    // one scan of the index against a linear pass over entries: same entries, keys in order
+    static void checkScanAgainstLinear(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                                       const PeterDB::Attribute &attribute, const KeyedRIDs &entries,
+                                       const std::string *low, const std::string *high,
+                                       bool lowInclusive, bool highInclusive) {
+        KeyedRIDs expected;
+        for (const auto &entry : entries) {
+            int lowCmp = low == nullptr ? 1 : referenceCompare(attribute, entry.first, *low);
+            int highCmp = high == nullptr ? -1 : referenceCompare(attribute, entry.first, *high);
+            if ((lowCmp > 0 || (lowCmp == 0 && lowInclusive)) && (highCmp < 0 || (highCmp == 0 && highInclusive))) {
+                expected.push_back(entry);
+            }
+        }
+
+        KeyedRIDs found;
+        PeterDB::IX_ScanIterator iterator;
+        PeterDB::RID rid;
+        std::vector<char> key(PAGE_SIZE);
+        ASSERT_EQ(ix.scan(ixFileHandle, attribute, low == nullptr ? NULL : low->data(),
+                          high == nullptr ? NULL : high->data(), lowInclusive, highInclusive, iterator), success);
+        while (iterator.getNextEntry(rid, key.data()) == success) {
+            found.emplace_back(keyBytes(attribute, key.data()), rid);
+            ASSERT_TRUE(found.size() < 2 || referenceCompare(attribute, found[found.size() - 2].first,
+                                                             found.back().first) <= 0)
+                                        << "Keys should come back in order.";
+        }
+        ASSERT_EQ(iterator.close(), success);
+
+        std::sort(expected.begin(), expected.end(), lessKeyedRID);
+        std::sort(found.begin(), found.end(), lessKeyedRID);
+        ASSERT_EQ(found.size(), expected.size()) << "The scan should return what a linear pass finds.";
+        for (unsigned i = 0; i < found.size(); i++) {
+            ASSERT_FALSE(lessKeyedRID(found[i], expected[i]) || lessKeyedRID(expected[i], found[i]))
+                                        << "The scan should return what a linear pass finds.";
+        }
+    }
+
+    // exact lookups of every probe, and ranges bounded on one or both sides by them
+    static void checkLookupsAgainstLinear(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                                          const PeterDB::Attribute &attribute, const KeyedRIDs &entries,
+                                          const std::vector<std::string> &probes) {
+        for (unsigned i = 0; i < probes.size(); i++) {
+            const std::string *probe = &probes[i];
+            ASSERT_NO_FATAL_FAILURE(
+                    checkScanAgainstLinear(ix, ixFileHandle, attribute, entries, probe, probe, true, true));
+            bool inclusive = i % 2 == 0;
+            ASSERT_NO_FATAL_FAILURE(
+                    checkScanAgainstLinear(ix, ixFileHandle, attribute, entries, probe, nullptr, inclusive, true));
+            ASSERT_NO_FATAL_FAILURE(
+                    checkScanAgainstLinear(ix, ixFileHandle, attribute, entries, nullptr, probe, true, !inclusive));
+            const std::string *other = &probes[(i * 7 + 3) % probes.size()];
+            if (referenceCompare(attribute, *probe, *other) > 0) {
+                std::swap(probe, other);
+            }
+            ASSERT_NO_FATAL_FAILURE(checkScanAgainstLinear(ix, ixFileHandle, attribute, entries, probe, other,
+                                                           i % 3 != 0, i % 4 != 0));
+        }
+    }
+
+    static std::string intBytes(int value) {
+        return std::string((const char *) &value, sizeof(int));
+    }
+
+    TEST_F(IX_Test, binary_search_matches_a_linear_scan) {
+        // Functions tested
+        // 1. Even int keys fill the root leaf up to the entry that splits it; lookups of every key and of the
+        //    odd values between them are checked in the full leaf and right after the split
+        // 2. Int keys with up to several hundred RIDs each, so runs of equal keys straddle slots and nodes
+        // 3. VarChar keys that share a long prefix and contain NUL and 0xff bytes, some a prefix of others
+        // Exact and bounded scans are checked against a linear pass over what was inserted.
+
+        KeyedRIDs entries;
+        std::vector<std::string> probes(1, intBytes(-1));
+        int key = 0;
+        rid.pageNum = 0;
+        rid.slotNum = 0;
+        ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        unsigned oneLeafPages = ixFileHandle.getFileHandle().getNumberOfPages();
+        unsigned fullLeaf = 1;
+        for (;; fullLeaf++) {
+            key = 2 * (int) fullLeaf;
+            rid.pageNum = fullLeaf;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            if (ixFileHandle.getFileHandle().getNumberOfPages() != oneLeafPages) {
+                break;
+            }
+        }
+        for (unsigned i = 0; i <= fullLeaf; i++) {
+            entries.emplace_back(intBytes(2 * (int) i), PeterDB::RID{i, 0});
+            probes.push_back(intBytes(2 * (int) i));
+            probes.push_back(intBytes(2 * (int) i + 1));
+        }
+        ASSERT_NO_FATAL_FAILURE(checkLookupsAgainstLinear(ix, ixFileHandle, ageAttr, entries, probes));
+
+        // the same keys but the last, in a fresh file: one full leaf
+        ASSERT_EQ(ix.closeFile(ixFileHandle), success);
+        ASSERT_EQ(ix.destroyFile(indexFileName), success);
+        ASSERT_EQ(ix.createFile(indexFileName), success);
+        ixFileHandle = PeterDB::IXFileHandle();
+        ASSERT_EQ(ix.openFile(indexFileName, ixFileHandle), success);
+        entries.pop_back();
+        for (const auto &entry : entries) {
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, entry.first.data(), entry.second), success);
+        }
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), oneLeafPages) << "The keys should fit one leaf.";
+        ASSERT_NO_FATAL_FAILURE(checkLookupsAgainstLinear(ix, ixFileHandle, ageAttr, entries, probes));
+
+        // key k gets 1 + 37 * k RIDs, inserted in random order
+        std::string duplicateFileName = indexFileName + "_duplicates";
+        remove(duplicateFileName.c_str());
+        ASSERT_EQ(ix.createFile(duplicateFileName), success);
+        PeterDB::IXFileHandle duplicateHandle;
+        ASSERT_EQ(ix.openFile(duplicateFileName, duplicateHandle), success);
+        entries.clear();
+        probes.assign(1, intBytes(-1));
+        for (unsigned k = 0; k < 20; k++) {
+            for (unsigned j = 0; j <= 37 * k; j++) {
+                entries.emplace_back(intBytes((int) k * 10), PeterDB::RID{k, (unsigned short) j});
+            }
+            probes.push_back(intBytes((int) k * 10));
+            probes.push_back(intBytes((int) k * 10 + 5));
+        }
+        KeyedRIDs shuffled = entries;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(17));
+        for (const auto &entry : shuffled) {
+            ASSERT_EQ(ix.insertEntry(duplicateHandle, ageAttr, entry.first.data(), entry.second), success);
+        }
+        ASSERT_NO_FATAL_FAILURE(checkLookupsAgainstLinear(ix, duplicateHandle, ageAttr, entries, probes));
+        ASSERT_EQ(ix.closeFile(duplicateHandle), success);
+        ASSERT_EQ(ix.destroyFile(duplicateFileName), success);
+
+        // "shared/prefix/" followed by every string of up to 5 bytes out of NUL, 'a' and 0xff
+        std::vector<std::string> values(1, std::string());
+        for (unsigned i = 0; values[i].size() < 5; i++) {
+            for (char c : {'\0', 'a', '\xff'}) {
+                values.push_back(values[i] + c);
+            }
+        }
+        entries.clear();
+        probes.clear();
+        for (unsigned i = 0; i < values.size(); i++) {
+            std::string bytes = varCharBytes("shared/prefix/" + values[i]);
+            for (unsigned j = 0; j <= i % 3; j++) {
+                entries.emplace_back(bytes, PeterDB::RID{i, (unsigned short) j});
+            }
+            probes.push_back(bytes);
+        }
+        for (const std::string &missing : {std::string(), std::string("shared/prefix"), std::string("shared/prefiy"),
+                                           std::string("shared/prefix/b"), std::string("shared/prefix/\0\0\0\0\0\0", 20),
+                                           std::string("shared/prefix/a\xff\xff\xff\xff\xff")}) {
+            probes.push_back(varCharBytes(missing));
+        }
+        shuffled = entries;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(23));
+        std::string varCharFileName = indexFileName + "_varchar";
+        for (unsigned options : {0u, (unsigned) IX_KEY_COMPRESSION}) {
+            remove(varCharFileName.c_str());
+            ASSERT_EQ(ix.createFile(varCharFileName, options), success);
+            PeterDB::IXFileHandle varCharHandle;
+            ASSERT_EQ(ix.openFile(varCharFileName, varCharHandle), success);
+            for (const auto &entry : shuffled) {
+                ASSERT_EQ(ix.insertEntry(varCharHandle, empNameAttr, entry.first.data(), entry.second), success);
+            }
+            ASSERT_NO_FATAL_FAILURE(checkLookupsAgainstLinear(ix, varCharHandle, empNameAttr, entries, probes));
+            ASSERT_EQ(ix.closeFile(varCharHandle), success);
+            ASSERT_EQ(ix.destroyFile(varCharFileName), success);
+        }
+    }
+
+    TEST_F(IX_Test, key_sorter_orders_entries_in_memory_and_across_runs) {
+        // Functions tested
+        // 1. IX_KeySorter with room for every entry, and with a limit small enough to spill many runs
+        // 2. Int keys with duplicates come back in (key, RID) order, then IX_EOF
+        // 3. VarChar keys of different lengths come back in byte order, shorter first on a tie
+
+        const unsigned numOfEntries = 5000;
+        std::mt19937 random(7);
+        for (unsigned memoryLimit : {(unsigned) IX_SORT_MEMORY, 1024u}) {
+            PeterDB::IX_KeySorter sorter(ageAttr, memoryLimit);
+            std::vector<std::pair<int, std::pair<unsigned, unsigned>>> expected;
+            for (unsigned i = 0; i < numOfEntries; i++) {
+                int key = (int) (random() % 500) - 250;
+                rid.pageNum = random() % 100;
+                rid.slotNum = i;
+                expected.push_back({key, {rid.pageNum, rid.slotNum}});
+                ASSERT_EQ(sorter.addEntry(&key, rid), success) << "IX_KeySorter::addEntry() should succeed.";
+            }
+            std::sort(expected.begin(), expected.end());
+            ASSERT_EQ(sorter.finish(), success) << "IX_KeySorter::finish() should succeed.";
+            int key;
+            for (auto &entry : expected) {
+                ASSERT_EQ(sorter.getNextEntry(&key, rid), success) << "Every entry should come back.";
+                ASSERT_EQ(key, entry.first) << "Keys should come back sorted, limit " << memoryLimit;
+                ASSERT_EQ(rid.pageNum, entry.second.first) << "Equal keys should come back in RID order.";
+                ASSERT_EQ(rid.slotNum, entry.second.second);
+            }
+            ASSERT_EQ(sorter.getNextEntry(&key, rid), IX_EOF) << "Nothing should be left.";
+        }
+
+        PeterDB::IX_KeySorter sorter(empNameAttr, 1024);
+        std::vector<std::string> expected;
+        char key[PAGE_SIZE];
+        for (unsigned i = 0; i < numOfEntries; i++) {
+            std::string value = std::to_string(random() % 100000);
+            value.resize(random() % 3 + value.size(), 'x');
+            unsigned length = value.size();
+            memcpy(key, &length, sizeof(unsigned));
+            memcpy(key + sizeof(unsigned), value.data(), length);
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            expected.push_back(value);
+            ASSERT_EQ(sorter.addEntry(key, rid), success) << "IX_KeySorter::addEntry() should succeed.";
+        }
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(sorter.finish(), success) << "IX_KeySorter::finish() should succeed.";
+        for (auto &value : expected) {
+            ASSERT_EQ(sorter.getNextEntry(key, rid), success) << "Every entry should come back.";
+            ASSERT_EQ(std::string(key + sizeof(unsigned), *(unsigned *) key), value) << "Keys should come back sorted.";
+        }
+        ASSERT_EQ(sorter.getNextEntry(key, rid), IX_EOF) << "Nothing should be left.";
+    }
+
+    TEST_F(IX_Test, bulk_load_from_spilled_runs) {
+        // Functions tested
+        // 1. bulkLoad() refuses a bad fill factor, then builds the tree from a sorter that spilled its runs
+        // 2. A full scan returns every entry in (key, RID) order, a range scan only the keys in range
+        // 3. The tree takes inserts afterwards, a second bulkLoad() into it fails
+
+        const unsigned numOfEntries = 30000;
+        std::vector<unsigned> order(numOfEntries);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(11));
+        PeterDB::IX_KeySorter sorter(ageAttr, 4096);
+        for (unsigned i : order) {
+            int key = i / 3;
+            rid.pageNum = i;
+            rid.slotNum = i % 5;
+            ASSERT_EQ(sorter.addEntry(&key, rid), success) << "IX_KeySorter::addEntry() should succeed.";
+        }
+        ASSERT_EQ(sorter.finish(), success) << "IX_KeySorter::finish() should succeed.";
+        ASSERT_NE(ix.bulkLoad(ixFileHandle, ageAttr, sorter, 0), success) << "A fill factor of 0 should be refused.";
+        ASSERT_EQ(ix.bulkLoad(ixFileHandle, ageAttr, sorter, 0.7), success) << "indexManager::bulkLoad() should succeed.";
+
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        int key;
+        unsigned count = 0;
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_EQ(rid.pageNum, count) << "Entries should come back in (key, RID) order.";
+            ASSERT_EQ(key, (int) count / 3);
+            ASSERT_EQ(rid.slotNum, count % 5);
+            count++;
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        ASSERT_EQ(count, numOfEntries) << "Every entry should be in the tree.";
+
+        int low = 1000, high = 2000;
+        count = 0;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &low, &high, true, false, ix_ScanIterator), success);
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_TRUE(key >= low && key < high) << "Keys should be in range.";
+            count++;
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(count, 3 * (high - low));
+
+        key = numOfEntries;
+        rid.pageNum = numOfEntries;
+        rid.slotNum = 0;
+        ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success) << "The loaded tree should take inserts.";
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &key, &key, true, true, ix_ScanIterator), success);
+        ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &key), success) << "The inserted entry should be found.";
+        ASSERT_EQ(rid.pageNum, numOfEntries);
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+
+        PeterDB::IX_KeySorter other(ageAttr);
+        ASSERT_EQ(other.finish(), success);
+        ASSERT_NE(ix.bulkLoad(ixFileHandle, ageAttr, other), success) << "bulkLoad() only fills an empty index.";
+    }
+
+    static void prepareVarCharKey(const std::string &value, char *key) {
+        unsigned length = value.size();
+        memcpy(key, &length, sizeof(unsigned));
+        memcpy(key + sizeof(unsigned), value.data(), length);
+    }
+
+    // Every node of the tree, read from the file: page 0 for the root, then the children of each internal node
+    static std::vector<std::vector<char>> readNodes(PeterDB::IXFileHandle &ixFileHandle,
+                                                    const PeterDB::Attribute &attribute) {
+        std::vector<std::vector<char>> nodes;
+        std::vector<char> page(PAGE_SIZE);
+        PeterDB::FileHandle &fileHandle = ixFileHandle.getFileHandle();
+        if (fileHandle.readPage(0, page.data()) != success) {
+            ADD_FAILURE() << "The header page should be readable.";
+            return nodes;
+        }
+        PeterDB::IndexHeader header;
+        memcpy(&header, page.data(), sizeof(PeterDB::IndexHeader));
+        std::vector<PeterDB::PAGE_ID> pending;
+        if (header.rootPageID != 0) {
+            pending.push_back(header.rootPageID);
+        }
+        for (unsigned next = 0; next < pending.size(); next++) {
+            if (fileHandle.readPage(pending[next], page.data()) != success) {
+                ADD_FAILURE() << "Node " << pending[next] << " should be readable.";
+                break;
+            }
+            nodes.push_back(page);
+            auto *dir = (PeterDB::NodeDir *) page.data();
+            if (dir->flag != NONLEAF_FLAG) {
+                continue;
+            }
+            // internal entry: key | PAGE_ID of the child right of it
+            auto *slots = (PeterDB::KEY_SLOT *) (page.data() + sizeof(PeterDB::NodeDir));
+            pending.push_back(dir->firstChild);
+            for (int slot = 0; slot < dir->recordNum; slot++) {
+                const char *entry = page.data() + slots[slot];
+                unsigned keyLength = sizeof(int);
+                if (attribute.type == PeterDB::TypeVarChar) {
+                    keyLength += *(const unsigned *) entry;
+                }
+                PeterDB::PAGE_ID child;
+                memcpy(&child, entry + keyLength, sizeof(PeterDB::PAGE_ID));
+                pending.push_back(child);
+            }
+        }
+        return nodes;
+    }
+
+    // internal nodes of the tree that hold no key, so one child and no separator
+    static unsigned countKeylessInternalNodes(PeterDB::IXFileHandle &ixFileHandle, const PeterDB::Attribute &attribute) {
+        unsigned count = 0;
+        for (const std::vector<char> &node : readNodes(ixFileHandle, attribute)) {
+            auto *dir = (const PeterDB::NodeDir *) node.data();
+            if (dir->flag == NONLEAF_FLAG && dir->recordNum == 0) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // "000123" padded to length bytes; a share of the page size keeps node fanout the same at any page size
+    static std::string paddedKey(unsigned i, unsigned length) {
+        std::string digits = std::to_string(i);
+        return std::string(6 - digits.size(), '0') + digits + std::string(length - 6, 'k');
+    }
+
+    TEST_F(IX_Test, bulk_load_leaves_no_internal_node_without_a_key) {
+        // Functions tested
+        // 1. bulkLoad() of 83677 sequential keys, where a last internal node used to get one child and no key
+        // 2. bulkLoad() of 1 to 150 keys of a sixth of a page, across every way the last node of a level can
+        //    come out
+        // 3. Every internal node keeps a key, full scans return every entry
+
+        const unsigned numOfEntries = 83677;
+        PeterDB::IX_KeySorter sorter(ageAttr);
+        for (unsigned i = 0; i < numOfEntries; i++) {
+            int key = i;
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            ASSERT_EQ(sorter.addEntry(&key, rid), success);
+        }
+        ASSERT_EQ(sorter.finish(), success);
+        ASSERT_EQ(ix.bulkLoad(ixFileHandle, ageAttr, sorter), success) << "indexManager::bulkLoad() should succeed.";
+        ASSERT_EQ(countKeylessInternalNodes(ixFileHandle, ageAttr), 0) << "Every internal node should hold a key.";
+        int key;
+        unsigned count = 0;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_EQ(key, (int) count++) << "Keys should come back in order.";
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(count, numOfEntries) << "Every entry should be in the tree.";
+
+        PeterDB::Attribute longAttr{"emp_name", PeterDB::TypeVarChar, PAGE_SIZE};
+        std::string fileName = "bulk_load_sweep_idx";
+        std::vector<char> longKey(PAGE_SIZE);
+        for (unsigned entries = 1; entries <= 150; entries++) {
+            ASSERT_EQ(ix.createFile(fileName), success);
+            PeterDB::IXFileHandle handle;
+            ASSERT_EQ(ix.openFile(fileName, handle), success);
+            PeterDB::IX_KeySorter longSorter(longAttr);
+            for (unsigned i = 0; i < entries; i++) {
+                prepareVarCharKey(paddedKey(i, PAGE_SIZE / 6), longKey.data());
+                rid.pageNum = i;
+                ASSERT_EQ(longSorter.addEntry(longKey.data(), rid), success);
+            }
+            ASSERT_EQ(longSorter.finish(), success);
+            ASSERT_EQ(ix.bulkLoad(handle, longAttr, longSorter), success) << "bulkLoad() of " << entries << " keys.";
+            ASSERT_EQ(countKeylessInternalNodes(handle, longAttr), 0)
+                                        << "Every internal node should hold a key after loading " << entries << ".";
+            count = 0;
+            ASSERT_EQ(ix.scan(handle, longAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+            while (ix_ScanIterator.getNextEntry(rid, longKey.data()) == success) {
+                ASSERT_EQ(rid.pageNum, count++) << "Keys should come back in order.";
+            }
+            ASSERT_EQ(ix_ScanIterator.close(), success);
+            ASSERT_EQ(count, entries) << "Every entry should be in the tree.";
+            ASSERT_EQ(ix.closeFile(handle), success);
+            ASSERT_EQ(ix.destroyFile(fileName), success);
+        }
+    }
+
+    // "customer/region-eu/" and 100 bytes of padding shared by every key, the number in 6 digits, 100 bytes more
+    static std::string longPrefixKey(unsigned i) {
+        std::string digits = std::to_string(i);
+        return "customer/region-eu/" + std::string(100, 'p') + std::string(6 - digits.size(), '0') + digits
+               + std::string(100, 'z');
+    }
+
+    TEST_F(IX_Test, prefix_compression_and_truncated_separators) {
+        // Functions tested
+        // 1. The same VarChar keys with a long shared prefix go into a plain and an IX_KEY_COMPRESSION index
+        // 2. The compressed index takes far fewer pages, and its separators are cut short of the full keys
+        // 3. Scans return the full keys in order, also after deletes and a key that breaks the shared prefix
+
+        std::string compressedFileName = indexFileName + "_compressed";
+        remove(compressedFileName.c_str());
+        ASSERT_EQ(ix.createFile(compressedFileName, IX_KEY_COMPRESSION), success);
+        PeterDB::IXFileHandle compressedHandle;
+        ASSERT_EQ(ix.openFile(compressedFileName, compressedHandle), success);
+
+        const unsigned numOfEntries = 3000;
+        std::vector<unsigned> order(numOfEntries);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(19));
+        char key[PAGE_SIZE];
+        for (unsigned i : order) {
+            prepareVarCharKey(longPrefixKey(i), key);
+            rid.pageNum = i;
+            rid.slotNum = 1;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, empNameAttr, key, rid), success);
+            ASSERT_EQ(ix.insertEntry(compressedHandle, empNameAttr, key, rid), success);
+        }
+        unsigned plainPages = ixFileHandle.getFileHandle().getNumberOfPages();
+        unsigned compressedPages = compressedHandle.getFileHandle().getNumberOfPages();
+        ASSERT_LT(compressedPages, plainPages * 2 / 3) << "Leaves should keep the shared prefix once.";
+
+        // separators only need the bytes up to the first difference
+        std::stringstream stream;
+        ASSERT_EQ(ix.printBTree(compressedHandle, empNameAttr, stream), success);
+        nlohmann::ordered_json j;
+        stream >> j;
+        TreeNode root = buildTree(j);
+        ASSERT_GT(root.height(), 0) << "The keys should need more than one leaf.";
+        for (const KeyEntry &separator : root.keys) {
+            ASSERT_LE(separator.key.size(), longPrefixKey(0).size() - 100) << "Separators should be truncated.";
+        }
+        ASSERT_EQ(root.totalKeyCount(), numOfEntries);
+        std::string last;
+        for (const std::string &projected : root.projectKeys()) {
+            ASSERT_LE(last, projected) << "Separators should fall between the keys of their children.";
+            last = projected;
+        }
+
+        // every other key goes, then one without the shared prefix sorts first
+        for (unsigned i = 0; i < numOfEntries; i += 2) {
+            prepareVarCharKey(longPrefixKey(i), key);
+            rid.pageNum = i;
+            rid.slotNum = 1;
+            ASSERT_EQ(ix.deleteEntry(compressedHandle, empNameAttr, key, rid), success);
+        }
+        prepareVarCharKey("customer/region-as/", key);
+        rid.pageNum = numOfEntries;
+        ASSERT_EQ(ix.insertEntry(compressedHandle, empNameAttr, key, rid), success);
+
+        ASSERT_EQ(ix.scan(compressedHandle, empNameAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+        ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, key), success);
+        ASSERT_EQ(std::string(key + sizeof(unsigned), *(unsigned *) key), "customer/region-as/");
+        for (unsigned i = 1; i < numOfEntries; i += 2) {
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, key), success) << "Every remaining key should be found.";
+            ASSERT_EQ(std::string(key + sizeof(unsigned), *(unsigned *) key), longPrefixKey(i))
+                                        << "Keys should be rebuilt in full from the prefix.";
+            ASSERT_EQ(rid.pageNum, i);
+        }
+        ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, key), IX_EOF);
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+
+        ASSERT_EQ(ix.closeFile(compressedHandle), success);
+        ASSERT_EQ(ix.destroyFile(compressedFileName), success);
+    }
+
+    // RIDs the index holds for key, checked to come in RID order
+    static unsigned countRidsOfKey(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                                   const PeterDB::Attribute &attribute, int key) {
+        PeterDB::IX_ScanIterator iterator;
+        EXPECT_EQ(ix.scan(ixFileHandle, attribute, &key, &key, true, true, iterator), success);
+        PeterDB::RID rid, last{0, 0};
+        int found;
+        unsigned count = 0;
+        while (iterator.getNextEntry(rid, &found) == success) {
+            EXPECT_EQ(found, key);
+            EXPECT_TRUE(count == 0 || last.pageNum < rid.pageNum
+                        || (last.pageNum == rid.pageNum && last.slotNum < rid.slotNum)) << "RIDs should be in order.";
+            last = rid;
+            count++;
+        }
+        iterator.close();
+        return count;
+    }
+
+    TEST_F(IX_Test, posting_lists_grow_split_and_empty) {
+        // Functions tested
+        // 1. One key gets far more RIDs than IX_MAX_INLINE_RIDS, in random order, so its posting pages split
+        // 2. An equality scan returns them in RID order, the neighbouring keys are not disturbed
+        // 3. Deleting them in random order until the list is empty, then the key is gone
+        // 4. Filling the list again reuses the freed pages
+
+        const int hotKey = 7;
+        const unsigned numOfRids = 2000;
+        std::vector<PeterDB::RID> hotRids;
+        for (unsigned i = 0; i < numOfRids; i++) {
+            hotRids.push_back({i / 3, (unsigned short) (i % 3)});
+        }
+        std::mt19937 random(20);
+        std::shuffle(hotRids.begin(), hotRids.end(), random);
+        for (int key : {6, 8}) {
+            for (unsigned i = 0; i < 10; i++) {
+                rid.pageNum = i;
+                rid.slotNum = key;
+                ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            }
+        }
+        unsigned pagesBefore = ixFileHandle.getFileHandle().getNumberOfPages();
+        for (unsigned i = 0; i < numOfRids; i++) {
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &hotKey, hotRids[i]), success);
+            if (i == IX_MAX_INLINE_RIDS - 1) {
+                ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pagesBefore)
+                                            << "Up to IX_MAX_INLINE_RIDS RIDs stay in the leaf.";
+            }
+        }
+        unsigned pagesFull = ixFileHandle.getFileHandle().getNumberOfPages();
+        ASSERT_GE(pagesFull, pagesBefore + numOfRids * sizeof(PeterDB::RID) / PAGE_SIZE)
+                                    << "The RIDs should have moved to posting pages.";
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, hotKey), numOfRids);
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, 6), 10);
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, 8), 10);
+
+        std::shuffle(hotRids.begin(), hotRids.end(), random);
+        for (unsigned i = 0; i < numOfRids; i++) {
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &hotKey, hotRids[i]), success);
+            if (i % 500 == 499) {
+                ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, hotKey), numOfRids - i - 1);
+            }
+        }
+        ASSERT_NE(ix.deleteEntry(ixFileHandle, ageAttr, &hotKey, hotRids[0]), success)
+                                    << "The list is empty, there is nothing to delete.";
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, hotKey), 0) << "The key should be gone.";
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, 6), 10);
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, 8), 10);
+
+        for (auto &hotRid : hotRids) {
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &hotKey, hotRid), success);
+        }
+        ASSERT_EQ(countRidsOfKey(ix, ixFileHandle, ageAttr, hotKey), numOfRids);
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pagesFull)
+                                    << "The posting pages freed by the deletes should be reused.";
+    }
+
+    // nodes of a tree in its printBTree form
+    static unsigned countNodes(const TreeNode &node) {
+        unsigned count = 1;
+        for (const TreeNode &child : node.children) {
+            count += countNodes(child);
+        }
+        return count;
+    }
+
+    static TreeNode printTree(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                              const PeterDB::Attribute &attribute) {
+        std::stringstream stream;
+        EXPECT_EQ(ix.printBTree(ixFileHandle, attribute, stream), success);
+        nlohmann::ordered_json j;
+        stream >> j;
+        return buildTree(j);
+    }
+
+    // a full scan returns exactly the keys in expected, in order, each with the RID {key, key % 100}
+    static void checkFullScan(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                              const PeterDB::Attribute &attribute, const std::set<int> &expected) {
+        PeterDB::IX_ScanIterator iterator;
+        ASSERT_EQ(ix.scan(ixFileHandle, attribute, NULL, NULL, true, true, iterator), success);
+        PeterDB::RID rid;
+        int key;
+        auto next = expected.begin();
+        while (iterator.getNextEntry(rid, &key) == success) {
+            ASSERT_NE(next, expected.end()) << "The scan returned more entries than the tree holds.";
+            ASSERT_EQ(key, *next) << "Keys should come back in order, each once.";
+            ASSERT_EQ(rid.pageNum, (unsigned) key);
+            ASSERT_EQ(rid.slotNum, key % 100);
+            next++;
+        }
+        ASSERT_EQ(iterator.close(), success);
+        ASSERT_EQ(next, expected.end()) << "Every key should be returned.";
+    }
+
+    TEST_F(IX_Test, delete_churn_merges_and_collapses_the_root) {
+        // Functions tested
+        // 1. Insert 20000 keys, delete 90% of them in random order: underfull nodes merge or borrow
+        // 2. A full scan returns exactly the keys left, the tree is lower and no node but the root is underfull
+        // 3. Deleting all but a few keys collapses the tree into a root leaf
+
+        const int numOfEntries = 20000;
+        std::vector<int> keys(numOfEntries);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::mt19937 random(21);
+        std::shuffle(keys.begin(), keys.end(), random);
+        for (int key : keys) {
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        size_t heightBefore = printTree(ix, ixFileHandle, ageAttr).height();
+        ASSERT_GE(heightBefore, 1);
+
+        std::shuffle(keys.begin(), keys.end(), random);
+        std::set<int> left(keys.begin(), keys.end());
+        for (int i = 0; i < numOfEntries * 9 / 10; i++) {
+            rid.pageNum = keys[i];
+            rid.slotNum = keys[i] % 100;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &keys[i], rid), success);
+            left.erase(keys[i]);
+        }
+        checkFullScan(ix, ixFileHandle, ageAttr, left);
+        TreeNode root = printTree(ix, ixFileHandle, ageAttr);
+        ASSERT_EQ(root.totalKeyCount(), left.size());
+        ASSERT_LE(root.height(), heightBefore);
+        std::vector<std::vector<char>> nodes = readNodes(ixFileHandle, ageAttr);
+        const int capacity = PAGE_SIZE - sizeof(PeterDB::NodeDir);
+        for (unsigned i = 1; i < nodes.size(); i++) {
+            auto *dir = (const PeterDB::NodeDir *) nodes[i].data();
+            ASSERT_GE(capacity - dir->freeSpace, (int) (capacity * IX_MIN_FILL)) << "Only the root may be underfull.";
+        }
+
+        for (int i = numOfEntries * 9 / 10; i < numOfEntries - 3; i++) {
+            rid.pageNum = keys[i];
+            rid.slotNum = keys[i] % 100;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &keys[i], rid), success);
+            left.erase(keys[i]);
+        }
+        checkFullScan(ix, ixFileHandle, ageAttr, left);
+        root = printTree(ix, ixFileHandle, ageAttr);
+        ASSERT_EQ(root.height(), 0) << "With three keys left the root should have collapsed into a leaf.";
+        ASSERT_EQ(root.keyCount(), 3);
+    }
+
+    TEST_F(IX_Test, delete_all_then_reinsert_reuses_free_pages) {
+        // Functions tested
+        // 1. Insert 10000 keys and delete all of them, the index is empty
+        // 2. Inserting them again takes the pages from the free list, the file does not grow
+
+        const int numOfEntries = 10000;
+        std::vector<int> keys(numOfEntries);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::mt19937 random(22);
+        for (int round = 0; round < 2; round++) {
+            std::shuffle(keys.begin(), keys.end(), random);
+            for (int key : keys) {
+                rid.pageNum = key;
+                rid.slotNum = key % 100;
+                ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            }
+            unsigned pagesFull = ixFileHandle.getFileHandle().getNumberOfPages();
+            std::shuffle(keys.begin(), keys.end(), random);
+            for (int key : keys) {
+                rid.pageNum = key;
+                rid.slotNum = key % 100;
+                ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &key, rid), success);
+            }
+            checkFullScan(ix, ixFileHandle, ageAttr, std::set<int>());
+            ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pagesFull) << "Deletes do not shrink the file.";
+            if (round == 1) {
+                break;
+            }
+
+            std::shuffle(keys.begin(), keys.end(), random);
+            for (int key : keys) {
+                rid.pageNum = key;
+                rid.slotNum = key % 100;
+                ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            }
+            checkFullScan(ix, ixFileHandle, ageAttr, std::set<int>(keys.begin(), keys.end()));
+            ASSERT_LE(ixFileHandle.getFileHandle().getNumberOfPages(), pagesFull * 11 / 10)
+                                        << "The freed pages should be reused.";
+            std::shuffle(keys.begin(), keys.end(), random);
+            for (int key : keys) {
+                rid.pageNum = key;
+                rid.slotNum = key % 100;
+                ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &key, rid), success);
+            }
+        }
+    }
+
+    TEST_F(IX_Test, compact_rebuilds_in_place) {
+        // Functions tested
+        // 1. Insert 20000 keys in random order, delete two keys of every three
+        // 2. compact() rebuilds the tree into fewer nodes without growing the file
+        // 3. A full scan agrees, and reinserting keys takes the pages compact() freed
+
+        const int numOfEntries = 20000;
+        std::vector<int> keys(numOfEntries);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(23));
+        for (int key : keys) {
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        std::set<int> left;
+        for (int key = 0; key < numOfEntries; key++) {
+            if (key % 3 == 0) {
+                left.insert(key);
+                continue;
+            }
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        unsigned nodesBefore = countNodes(printTree(ix, ixFileHandle, ageAttr));
+        unsigned pagesBefore = ixFileHandle.getFileHandle().getNumberOfPages();
+
+        ASSERT_NE(ix.compact(ixFileHandle, ageAttr, 1.5), success) << "A fill factor over 1 should be refused.";
+        ASSERT_EQ(ix.compact(ixFileHandle, ageAttr), success) << "indexManager::compact() should succeed.";
+        TreeNode root = printTree(ix, ixFileHandle, ageAttr);
+        ASSERT_LT(countNodes(root), nodesBefore) << "Compacted nodes should be fuller.";
+        ASSERT_EQ(root.totalKeyCount(), left.size());
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pagesBefore) << "compact() works in place.";
+        checkFullScan(ix, ixFileHandle, ageAttr, left);
+
+        for (int key = 1; key < numOfEntries; key += 3) {
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            left.insert(key);
+        }
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pagesBefore)
+                                    << "Inserts should take the pages compact() freed first.";
+        checkFullScan(ix, ixFileHandle, ageAttr, left);
+    }
+
+    TEST_F(IX_Test, compact_leaves_no_internal_node_without_a_key) {
+        // Functions tested
+        // 1. compact() of 83677 sequential keys, the count at which a bulk build used to end a level with
+        //    a keyless node
+        // 2. compact() of 1 to 150 inserted keys of a sixth of a page
+        // 3. Every internal node keeps a key, full scans return every entry
+
+        const int numOfEntries = 83677;
+        std::set<int> keys;
+        for (int key = 0; key < numOfEntries; key++) {
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+            keys.insert(key);
+        }
+        ASSERT_EQ(ix.compact(ixFileHandle, ageAttr), success) << "indexManager::compact() should succeed.";
+        ASSERT_EQ(countKeylessInternalNodes(ixFileHandle, ageAttr), 0) << "Every internal node should hold a key.";
+        checkFullScan(ix, ixFileHandle, ageAttr, keys);
+
+        PeterDB::Attribute longAttr{"emp_name", PeterDB::TypeVarChar, PAGE_SIZE};
+        std::string fileName = "compact_sweep_idx";
+        std::vector<char> longKey(PAGE_SIZE);
+        for (unsigned entries = 1; entries <= 150; entries++) {
+            ASSERT_EQ(ix.createFile(fileName), success);
+            PeterDB::IXFileHandle handle;
+            ASSERT_EQ(ix.openFile(fileName, handle), success);
+            for (unsigned i = 0; i < entries; i++) {
+                prepareVarCharKey(paddedKey(i, PAGE_SIZE / 6), longKey.data());
+                rid.pageNum = i;
+                ASSERT_EQ(ix.insertEntry(handle, longAttr, longKey.data(), rid), success);
+            }
+            ASSERT_EQ(ix.compact(handle, longAttr), success) << "compact() of " << entries << " keys.";
+            ASSERT_EQ(countKeylessInternalNodes(handle, longAttr), 0)
+                                        << "Every internal node should hold a key after compacting " << entries << ".";
+            unsigned count = 0;
+            ASSERT_EQ(ix.scan(handle, longAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+            while (ix_ScanIterator.getNextEntry(rid, longKey.data()) == success) {
+                ASSERT_EQ(rid.pageNum, count++) << "Keys should come back in order.";
+            }
+            ASSERT_EQ(ix_ScanIterator.close(), success);
+            ASSERT_EQ(count, entries) << "Every entry should be in the tree.";
+            ASSERT_EQ(ix.closeFile(handle), success);
+            ASSERT_EQ(ix.destroyFile(fileName), success);
+        }
+    }
+
+    TEST_F(IX_Test, delete_while_scanning) {
+        // Functions tested
+        // 1. Open a full scan and read part of it
+        // 2. Delete keys behind and far ahead of the scan, enough for leaves to merge
+        // 3. The scan goes on after the last key it returned: every key it had not reached and that is still
+        //    there comes once, in order, and none of the deleted ones
+
+        const int numOfEntries = 10000;
+        for (int key = 0; key < numOfEntries; key++) {
+            rid.pageNum = key;
+            rid.slotNum = key % 100;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+        int key;
+        for (int expected = 0; expected < 3000; expected++) {
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &key), success);
+            ASSERT_EQ(key, expected);
+        }
+
+        std::set<int> ahead;
+        for (int k = 0; k < numOfEntries; k++) {
+            bool deleted = k < 2500 || (k >= 5000 && k % 4 != 0);
+            if (deleted) {
+                rid.pageNum = k;
+                rid.slotNum = k % 100;
+                ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &k, rid), success);
+            } else if (k >= 3000) {
+                ahead.insert(k);
+            }
+        }
+        auto next = ahead.begin();
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_NE(next, ahead.end()) << "The scan returned a key it should not have.";
+            ASSERT_EQ(key, *next) << "The scan should go on in order after its last key.";
+            ASSERT_EQ(rid.pageNum, (unsigned) key);
+            next++;
+        }
+        ASSERT_EQ(next, ahead.end()) << "Every key still ahead of the scan should be returned.";
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+    }
+
+    // internal nodes right above the leaves, in key order
+    static std::vector<std::vector<char>> leafParents(PeterDB::IXFileHandle &ixFileHandle,
+                                                      const PeterDB::Attribute &attribute) {
+        std::vector<std::vector<char>> parents;
+        std::vector<char> child(PAGE_SIZE);
+        for (std::vector<char> &node : readNodes(ixFileHandle, attribute)) {
+            auto *dir = (const PeterDB::NodeDir *) node.data();
+            if (dir->flag == NONLEAF_FLAG && ixFileHandle.getFileHandle().readPage(dir->firstChild, child.data()) == success
+                && ((const PeterDB::NodeDir *) child.data())->flag == LEAF_FLAG) {
+                parents.push_back(node);
+            }
+        }
+        return parents;
+    }
+
+    // separator slot of an internal node as a VarChar key, the first key of the child right of it
+    static void separatorOf(const std::vector<char> &node, int slot, char *key) {
+        auto *slots = (const PeterDB::KEY_SLOT *) (node.data() + sizeof(PeterDB::NodeDir));
+        const char *entry = node.data() + slots[slot];
+        memcpy(key, entry, sizeof(unsigned) + *(const unsigned *) entry);
+    }
+
+    // scan [low, high] of paddedKey keys with RID {i, 0}: keys come back in order, from first to last
+    static void checkPaddedRange(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                                 const PeterDB::Attribute &attribute, const void *low, const void *high,
+                                 unsigned first, unsigned last) {
+        PeterDB::IX_ScanIterator iterator;
+        PeterDB::RID rid;
+        std::vector<char> key(PAGE_SIZE);
+        ASSERT_EQ(ix.scan(ixFileHandle, attribute, low, high, true, true, iterator), success);
+        unsigned next = first;
+        while (iterator.getNextEntry(rid, key.data()) == success) {
+            ASSERT_EQ(rid.pageNum, next) << "Keys should come back in order, each once.";
+            next++;
+        }
+        ASSERT_EQ(iterator.close(), success);
+        ASSERT_EQ(next, last + 1) << "Every key in range should be returned.";
+    }
+
+    TEST_F(IX_Test, range_scan_reads_ahead_across_parents) {
+        // Functions tested
+        // 1. bulkLoad() 3000 keys of a twentieth of a page, so the leaves hang under several parents
+        // 2. A full scan and a range over several parents return every key in order; past each parent the
+        //    scan finds the next one again, every leaf but the first under each parent is read ahead once
+        // 3. A range ending in the third child of a parent reads ahead no leaf past the high key
+
+        PeterDB::Attribute longAttr{"emp_name", PeterDB::TypeVarChar, PAGE_SIZE};
+        const unsigned numOfEntries = 3000;
+        PeterDB::IX_KeySorter sorter(longAttr);
+        std::vector<char> key(PAGE_SIZE), low(PAGE_SIZE), high(PAGE_SIZE);
+        for (unsigned i = 0; i < numOfEntries; i++) {
+            prepareVarCharKey(paddedKey(i, PAGE_SIZE / 20), key.data());
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            ASSERT_EQ(sorter.addEntry(key.data(), rid), success);
+        }
+        ASSERT_EQ(sorter.finish(), success);
+        ASSERT_EQ(ix.bulkLoad(ixFileHandle, longAttr, sorter), success) << "indexManager::bulkLoad() should succeed.";
+
+        std::vector<std::vector<char>> parents = leafParents(ixFileHandle, longAttr);
+        ASSERT_GE(parents.size(), 3) << "The leaves should hang under several parents.";
+        unsigned leaves = 0;
+        for (const std::vector<char> &parent : parents) {
+            leaves += ((const PeterDB::NodeDir *) parent.data())->recordNum + 1;
+        }
+
+        ixFileHandle.ixPrefetchPageCounter = 0;
+        checkPaddedRange(ix, ixFileHandle, longAttr, NULL, NULL, 0, numOfEntries - 1);
+        ASSERT_EQ(ixFileHandle.ixPrefetchPageCounter, leaves - parents.size())
+                                    << "Every leaf but the first under each parent should be read ahead once.";
+
+        prepareVarCharKey(paddedKey(500, PAGE_SIZE / 20), low.data());
+        prepareVarCharKey(paddedKey(2500, PAGE_SIZE / 20), high.data());
+        checkPaddedRange(ix, ixFileHandle, longAttr, low.data(), high.data(), 500, 2500);
+
+        // children 1 to 3 of the second parent, the range ends on the first key of child 3
+        const std::vector<char> &parent = parents[1];
+        ASSERT_GE(((const PeterDB::NodeDir *) parent.data())->recordNum, 5);
+        separatorOf(parent, 0, low.data());
+        separatorOf(parent, 2, high.data());
+        unsigned first = std::stoul(std::string(low.data() + sizeof(unsigned), 6));
+        unsigned last = std::stoul(std::string(high.data() + sizeof(unsigned), 6));
+        ixFileHandle.ixPrefetchPageCounter = 0;
+        checkPaddedRange(ix, ixFileHandle, longAttr, low.data(), high.data(), first, last);
+        ASSERT_EQ(ixFileHandle.ixPrefetchPageCounter, 2) << "Only children 2 and 3 should be read ahead.";
+    }
+
+    // one (Int, Real, VarChar) row for IX_CompositeKey, a column is null when its flag is unset
+    struct CompositeRow {
+        bool hasInt, hasReal, hasString;
+        int intValue;
+        float realValue;
+        std::string stringValue;
+    };
+
+    static int compareRows(const CompositeRow &row, const CompositeRow &other) {
+        // nulls first, then the values of the column; -0.0 equals 0.0, a shorter string sorts first on a tie
+        if (row.hasInt != other.hasInt) return row.hasInt ? 1 : -1;
+        if (row.hasInt && row.intValue != other.intValue) return row.intValue < other.intValue ? -1 : 1;
+        if (row.hasReal != other.hasReal) return row.hasReal ? 1 : -1;
+        if (row.hasReal && row.realValue != other.realValue) return row.realValue < other.realValue ? -1 : 1;
+        if (row.hasString != other.hasString) return row.hasString ? 1 : -1;
+        if (row.hasString) return row.stringValue.compare(other.stringValue);
+        return 0;
+    }
+
+    static void encodeRow(const PeterDB::IX_CompositeKey &compositeKey, const CompositeRow &row, unsigned columns,
+                          char *key, bool isBound = false, bool isLowKey = true, bool *inclusive = nullptr) {
+        std::vector<char> varChar(sizeof(int) + row.stringValue.size());
+        int length = row.stringValue.size();
+        memcpy(varChar.data(), &length, sizeof(int));
+        memcpy(varChar.data() + sizeof(int), row.stringValue.data(), length);
+        std::vector<const void *> values = {row.hasInt ? &row.intValue : nullptr,
+                                            row.hasReal ? &row.realValue : nullptr,
+                                            row.hasString ? varChar.data() : nullptr};
+        values.resize(columns);
+        if (isBound) {
+            compositeKey.encodeBound(values, isLowKey, *inclusive, key);
+        } else {
+            compositeKey.encode(values, key);
+        }
+    }
+
+    static std::vector<CompositeRow> compositeRows() {
+        std::vector<std::pair<bool, int>> ints = {{false, 0}, {true, INT_MIN}, {true, -70000}, {true, -1}, {true, 0},
+                                                  {true, 1}, {true, 256}, {true, INT_MAX}};
+        std::vector<std::pair<bool, float>> reals = {{false, 0}, {true, -INFINITY}, {true, -1.5f}, {true, -0.0f},
+                                                     {true, 0.0f}, {true, 1e-30f}, {true, 2.5f}, {true, INFINITY}};
+        std::vector<std::pair<bool, std::string>> strings = {{false, ""}, {true, ""}, {true, std::string(1, '\0')},
+                                                             {true, std::string(2, '\0')}, {true, "a"},
+                                                             {true, std::string("a\0", 2)},
+                                                             {true, std::string("a\0b", 3)}, {true, "ab"},
+                                                             {true, "\xff"}};
+        std::vector<CompositeRow> rows;
+        for (auto &i : ints) {
+            for (auto &r : reals) {
+                for (auto &s : strings) {
+                    rows.push_back({i.first, r.first, s.first, i.second, r.second, s.second});
+                }
+            }
+        }
+        return rows;
+    }
+
+    TEST_F(IX_Test, composite_key_order_and_round_trip) {
+        // Functions tested
+        // 1. Encode every combination of negative and extreme ints, -0.0 and infinities, VarChars with
+        //    embedded 0x00 bytes, and nulls in each column
+        // 2. The encoded keys compare the way the rows compare column by column, nulls first
+        // 3. decode() gives the row back, -0.0 as 0.0
+
+        std::vector<PeterDB::Attribute> attributes = {ageAttr, heightAttr, empNameAttr};
+        attributes[2].length = 10;
+        PeterDB::IX_CompositeKey compositeKey(attributes);
+        const PeterDB::Attribute &keyAttribute = compositeKey.getKeyAttribute();
+        std::vector<CompositeRow> rows = compositeRows();
+        std::vector<std::vector<char>> keys(rows.size(), std::vector<char>(sizeof(int) + keyAttribute.length));
+        for (unsigned i = 0; i < rows.size(); i++) {
+            encodeRow(compositeKey, rows[i], attributes.size(), keys[i].data());
+            ASSERT_LE(PeterDB::IndexManager::getKeyLength(keyAttribute, keys[i].data()),
+                      sizeof(int) + keyAttribute.length) << "The key should fit the declared length.";
+        }
+        for (unsigned i = 0; i < rows.size(); i++) {
+            for (unsigned j = 0; j < rows.size(); j++) {
+                int expected = compareRows(rows[i], rows[j]);
+                int actual = PeterDB::IndexManager::compareKey(keyAttribute, keys[i].data(), keys[j].data());
+                ASSERT_EQ(expected < 0, actual < 0) << "Rows " << i << " and " << j << " should keep their order.";
+                ASSERT_EQ(expected == 0, actual == 0) << "Rows " << i << " and " << j << " should compare equal.";
+            }
+        }
+
+        char data[PAGE_SIZE];
+        for (unsigned i = 0; i < rows.size(); i++) {
+            const CompositeRow &row = rows[i];
+            ASSERT_EQ(compositeKey.decode(keys[i].data(), data), success) << "decode() should succeed.";
+            unsigned char nulls = (row.hasInt ? 0 : 0x80) | (row.hasReal ? 0 : 0x40) | (row.hasString ? 0 : 0x20);
+            ASSERT_EQ((unsigned char) data[0], nulls) << "The null bitmap should come back.";
+            char *field = data + 1;
+            if (row.hasInt) {
+                ASSERT_EQ(*(int *) field, row.intValue);
+                field += sizeof(int);
+            }
+            if (row.hasReal) {
+                float expected = row.realValue == 0 ? 0.0f : row.realValue;
+                ASSERT_EQ(memcmp(field, &expected, sizeof(float)), 0) << "Reals should come back bit for bit.";
+                field += sizeof(float);
+            }
+            if (row.hasString) {
+                ASSERT_EQ(std::string(field + sizeof(int), *(int *) field), row.stringValue)
+                                            << "Strings with 0x00 bytes should come back whole.";
+            }
+        }
+        int truncated = 2;
+        memcpy(keys[1].data(), &truncated, sizeof(int));
+        ASSERT_NE(compositeKey.decode(keys[1].data(), data), success) << "A truncated key should not decode.";
+    }
+
+    TEST_F(IX_Test, composite_key_prefix_bounds) {
+        // Functions tested
+        // 1. encodeBound() on the first one and two columns, low and high, inclusive and not
+        // 2. A key falls inside the bound exactly when its leading columns compare that way to the prefix
+        // 3. A bound on every column is the key itself, and a tree scan with prefix bounds finds the rows
+
+        std::vector<PeterDB::Attribute> attributes = {ageAttr, heightAttr, empNameAttr};
+        attributes[2].length = 10;
+        PeterDB::IX_CompositeKey compositeKey(attributes);
+        const PeterDB::Attribute &keyAttribute = compositeKey.getKeyAttribute();
+        std::vector<CompositeRow> rows = compositeRows();
+        std::vector<std::vector<char>> keys(rows.size(), std::vector<char>(sizeof(int) + keyAttribute.length));
+        for (unsigned i = 0; i < rows.size(); i++) {
+            encodeRow(compositeKey, rows[i], attributes.size(), keys[i].data());
+        }
+
+        char bound[PAGE_SIZE];
+        for (unsigned columns = 1; columns <= attributes.size(); columns++) {
+            for (const CompositeRow &prefix : rows) {
+                for (bool isLowKey : {true, false}) {
+                    for (bool inclusive : {true, false}) {
+                        bool boundInclusive = inclusive;
+                        encodeRow(compositeKey, prefix, columns, bound, true, isLowKey, &boundInclusive);
+                        for (unsigned i = 0; i < rows.size(); i++) {
+                            // the leading columns of the row against the prefix
+                            CompositeRow lead = rows[i], prefixLead = prefix;
+                            if (columns < 3) lead.hasString = prefixLead.hasString = false;
+                            if (columns < 2) lead.hasReal = prefixLead.hasReal = false;
+                            int cmp = compareRows(lead, prefixLead);
+                            bool expected = isLowKey ? (cmp > 0 || (cmp == 0 && inclusive))
+                                                     : (cmp < 0 || (cmp == 0 && inclusive));
+                            int keyCmp = PeterDB::IndexManager::compareKey(keyAttribute, keys[i].data(), bound);
+                            bool actual = isLowKey ? (keyCmp > 0 || (keyCmp == 0 && boundInclusive))
+                                                   : (keyCmp < 0 || (keyCmp == 0 && boundInclusive));
+                            ASSERT_EQ(actual, expected) << "Row " << i << " against a bound on " << columns
+                                                        << " columns, low " << isLowKey << " inclusive " << inclusive;
+                        }
+                        if (columns == attributes.size()) {
+                            ASSERT_EQ(boundInclusive, inclusive) << "A bound on every column is the key itself.";
+                        }
+                    }
+                }
+            }
+        }
+
+        // a range scan on the first column: every row with int -1
+        for (unsigned i = 0; i < rows.size(); i++) {
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, keyAttribute, keys[i].data(), rid), success);
+        }
+        CompositeRow prefix = {true, false, false, -1, 0, ""};
+        char highBound[PAGE_SIZE];
+        bool lowInclusive = true, highInclusive = true;
+        encodeRow(compositeKey, prefix, 1, bound, true, true, &lowInclusive);
+        encodeRow(compositeKey, prefix, 1, highBound, true, false, &highInclusive);
+        ASSERT_EQ(ix.scan(ixFileHandle, keyAttribute, bound, highBound, lowInclusive, highInclusive, ix_ScanIterator),
+                  success);
+        unsigned count = 0;
+        char key[PAGE_SIZE];
+        while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+            ASSERT_TRUE(rows[rid.pageNum].hasInt && rows[rid.pageNum].intValue == -1) << "Only the prefix should match.";
+            count++;
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(count, rows.size() / 8) << "Every row with the prefix should be found.";
+    }
+
+    // the fixture's index file again, as an empty hash index
+    static void recreateAsHashIndex(PeterDB::IndexManager &ix, const std::string &indexFileName,
+                                    PeterDB::IXFileHandle &ixFileHandle) {
+        ASSERT_EQ(ix.closeFile(ixFileHandle), success);
+        ASSERT_EQ(ix.destroyFile(indexFileName), success);
+        ASSERT_EQ(ix.createFile(indexFileName, IX_HASH), success) << "Creating a hash index should succeed.";
+        ixFileHandle = PeterDB::IXFileHandle();
+        ASSERT_EQ(ix.openFile(indexFileName, ixFileHandle), success);
+    }
+
+    static unsigned hashGlobalDepth(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                                    const PeterDB::Attribute &attribute) {
+        std::stringstream stream;
+        EXPECT_EQ(ix.printBTree(ixFileHandle, attribute, stream), success);
+        nlohmann::ordered_json j;
+        stream >> j;
+        return j["globalDepth"];
+    }
+
+    // RIDs an equality probe returns for key
+    static unsigned probeCount(PeterDB::IndexManager &ix, PeterDB::IXFileHandle &ixFileHandle,
+                               const PeterDB::Attribute &attribute, const void *key) {
+        PeterDB::IX_ScanIterator iterator;
+        EXPECT_EQ(ix.scan(ixFileHandle, attribute, key, key, true, true, iterator), success);
+        PeterDB::RID rid;
+        char found[PAGE_SIZE];
+        unsigned count = 0;
+        while (iterator.getNextEntry(rid, found) == success) {
+            EXPECT_EQ(PeterDB::IndexManager::compareKey(attribute, found, key), 0) << "A probe returns its key only.";
+            count++;
+        }
+        iterator.close();
+        return count;
+    }
+
+    TEST_F(IX_Test, hash_directory_grows_out_of_the_head_page) {
+        // Functions tested
+        // 1. More Int keys than a bucket holds whose hashes share more low bits than page 0 has directory slots
+        //    for, so their bucket splits until the directory moves out to directory pages; plain keys go in after
+        // 2. Every key is found by its probe, a full scan returns each entry once
+
+        recreateAsHashIndex(ix, indexFileName, ixFileHandle);
+        const unsigned slotsPerPage = PAGE_SIZE / sizeof(PeterDB::PAGE_ID), mask = 2 * slotsPerPage - 1;
+        std::vector<int> keys;
+        for (int key = 0; keys.size() < PAGE_SIZE / 8; key++) {
+            if ((PeterDB::IndexManager::hashKey(ageAttr, &key) & mask) == 0) {
+                keys.push_back(key);
+            }
+        }
+        const int numOfPlainKeys = 1000;
+        for (int key = -numOfPlainKeys; key < 0; key++) {
+            keys.push_back(key);
+        }
+        for (unsigned i = 0; i < keys.size(); i++) {
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &keys[i], rid), success);
+        }
+        ASSERT_GT(1u << hashGlobalDepth(ix, ixFileHandle, ageAttr), slotsPerPage)
+                                    << "The directory should have moved to directory pages.";
+        ASSERT_LT(ixFileHandle.getFileHandle().getNumberOfPages(), keys.size() / 8)
+                                    << "Only the directory should have grown that far, not the buckets.";
+
+        for (int key : keys) {
+            ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 1) << "Key " << key << " should be found.";
+        }
+        std::vector<bool> seen(keys.size(), false);
+        int key;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_LT(rid.pageNum, keys.size());
+            ASSERT_EQ(key, keys[rid.pageNum]);
+            ASSERT_FALSE(seen[rid.pageNum]) << "Each entry should be returned once.";
+            seen[rid.pageNum] = true;
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(std::count(seen.begin(), seen.end(), true), keys.size()) << "Every entry should be returned.";
+    }
+
+    TEST_F(IX_Test, hash_overflow_delete_and_compact) {
+        // Functions tested
+        // 1. One hot key with 3000 RIDs overflows its bucket instead of growing the directory, so do the keys
+        //    inserted after it into that chain
+        // 2. hashDelete removes single entries, an entry that is not there cannot be deleted
+        // 3. compact rebuilds the buckets, the probes agree and new entries take the pages it freed
+
+        recreateAsHashIndex(ix, indexFileName, ixFileHandle);
+        const int hotKey = 42;
+        const unsigned numOfRids = 3000;
+        for (unsigned i = 0; i < numOfRids; i++) {
+            rid.pageNum = i;
+            rid.slotNum = 1;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &hotKey, rid), success);
+        }
+        ASSERT_EQ(hashGlobalDepth(ix, ixFileHandle, ageAttr), 0) << "A chain of one key should overflow, not split.";
+        ASSERT_GT(ixFileHandle.getFileHandle().getNumberOfPages(), numOfRids * sizeof(PeterDB::RID) / PAGE_SIZE)
+                                    << "The bucket should have overflow pages.";
+        for (int key = 0; key < 1000; key++) {
+            rid.pageNum = key;
+            rid.slotNum = 2;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &hotKey), numOfRids + 1);
+        int key = 500;
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 1);
+
+        for (unsigned i = 0; i < numOfRids; i++) {
+            rid.pageNum = i;
+            rid.slotNum = 1;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &hotKey, rid), success);
+        }
+        ASSERT_NE(ix.deleteEntry(ixFileHandle, ageAttr, &hotKey, rid), success) << "The entry is gone already.";
+        rid.pageNum = 500;
+        rid.slotNum = 2;
+        ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &key, rid), success);
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &hotKey), 1) << "Only the entry of the second round is left.";
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 0);
+
+        unsigned pages = ixFileHandle.getFileHandle().getNumberOfPages();
+        ASSERT_EQ(ix.compact(ixFileHandle, ageAttr), success) << "indexManager::compact() should succeed.";
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pages) << "compact() works in place.";
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &hotKey), 1);
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 0);
+        key = 499;
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 1);
+        for (key = 1000; key < 1200; key++) {
+            rid.pageNum = key;
+            rid.slotNum = 2;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        ASSERT_EQ(ixFileHandle.getFileHandle().getNumberOfPages(), pages) << "The freed pages should be reused.";
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 0);
+        key = 1100;
+        ASSERT_EQ(probeCount(ix, ixFileHandle, ageAttr, &key), 1);
+    }
+
+    TEST_F(IX_Test, hash_range_scan_reads_every_bucket) {
+        // Functions tested
+        // 1. A range scan over a hash index returns the keys in range, each once, in no particular order
+        // 2. Exclusive bounds leave their keys out, a full scan returns everything
+
+        recreateAsHashIndex(ix, indexFileName, ixFileHandle);
+        const int numOfEntries = PAGE_SIZE * 5 / 4;
+        for (int key = 0; key < numOfEntries; key++) {
+            rid.pageNum = key;
+            rid.slotNum = 3;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success);
+        }
+        int low = 100, high = 200, key;
+        std::set<int> found;
+        bool ordered = true;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &low, &high, false, true, ix_ScanIterator), success);
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            ASSERT_TRUE(key > low && key <= high) << "Keys should be in range.";
+            ASSERT_EQ(rid.pageNum, (unsigned) key);
+            ordered = ordered && (found.empty() || key > *found.rbegin());
+            ASSERT_TRUE(found.insert(key).second) << "Each key should be returned once.";
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(found.size(), high - low);
+        ASSERT_FALSE(ordered) << "A hash index returns keys in bucket order.";
+
+        unsigned count = 0;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success);
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+            count++;
+        }
+        ASSERT_EQ(ix_ScanIterator.close(), success);
+        ASSERT_EQ(count, numOfEntries);
+    }
+
 } // namespace PeterDBTesting
\ No newline at end of file
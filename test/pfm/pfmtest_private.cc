@@ -1,4 +1,6 @@
 #include "src/include/pfm.h"
+#include "src/include/bufferpool.h"
+#include "src/include/pageio.h"
 #include "test/utils/pfm_test_utils.h"
 
 namespace PeterDBTesting {
@@ -130,4 +132,485 @@ namespace PeterDBTesting {
         ASSERT_GT(getFileSize(fileName), 0) << "File Size should not be zero at this moment.";
     }
 
+    TEST(PFM_Buffer_Pool_Test, clock_gives_referenced_frames_a_second_chance) {
+        // Test case procedure:
+        // 1. Reference three evictable frames
+        // 2. The first sweep only clears reference bits, so the frame under the hand goes first
+        // 3. A frame referenced again is skipped once, pinned frames are never picked
+
+        PeterDB::ClockReplacer replacer(3);
+        PeterDB::FrameId frameId;
+        ASSERT_NE(replacer.victim(frameId), success) << "No frame is evictable yet.";
+        for (PeterDB::FrameId i = 0; i < 3; i++) {
+            replacer.recordAccess(i);
+            replacer.setEvictable(i, true);
+        }
+        ASSERT_EQ(replacer.victim(frameId), success);
+        ASSERT_EQ(frameId, 0) << "Every frame was referenced, the hand comes back to frame 0.";
+
+        replacer.recordAccess(1);
+        ASSERT_EQ(replacer.victim(frameId), success);
+        ASSERT_EQ(frameId, 2) << "Frame 1 was referenced again and gets a second chance.";
+
+        replacer.setEvictable(1, false);
+        ASSERT_NE(replacer.victim(frameId), success) << "The only frame left is pinned.";
+    }
+
+    TEST(PFM_Buffer_Pool_Test, lru_k_evicts_the_oldest_kth_access) {
+        // Test case procedure:
+        // 1. Frames 0 and 1 are accessed twice, frame 2 once
+        // 2. Frame 2 has fewer than K accesses and goes first
+        // 3. Then frame 0, whose second most recent access is the oldest
+
+        PeterDB::LRUKReplacer replacer(3, 2);
+        replacer.recordAccess(0);
+        replacer.recordAccess(1);
+        replacer.recordAccess(0);
+        replacer.recordAccess(2);
+        replacer.recordAccess(1);
+        for (PeterDB::FrameId i = 0; i < 3; i++) {
+            replacer.setEvictable(i, true);
+        }
+        PeterDB::FrameId frameId;
+        ASSERT_EQ(replacer.victim(frameId), success);
+        ASSERT_EQ(frameId, 2) << "A frame with fewer than K accesses should be evicted first.";
+        ASSERT_EQ(replacer.victim(frameId), success);
+        ASSERT_EQ(frameId, 0) << "Frame 0 has the oldest K-th most recent access.";
+        ASSERT_EQ(replacer.victim(frameId), success);
+        ASSERT_EQ(frameId, 1);
+        ASSERT_NE(replacer.victim(frameId), success) << "Nothing is left to evict.";
+    }
+
+    TEST_F (PFM_File_Test, buffer_pool_pins_writes_back_and_discards) {
+        // Test case procedure:
+        // 1. Create a file of 3 pages and attach it to a pool of 2 frames
+        // 2. Pinned pages cannot be evicted; with every frame pinned a fetch fails
+        // 3. A dirty page reaches the disk on flush and on eviction, not before
+        // 4. discardFile drops nothing while a page is pinned; once none is it drops them all, so the next fetch
+        //    reads the disk again
+
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        std::vector<char> page(PAGE_SIZE), disk(PAGE_SIZE);
+        for (int i = 0; i < 3; i++) {
+            generateData(page.data(), PAGE_SIZE, 20 + i, 40 + i);
+            ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+
+        PeterDB::PageIO *io = PeterDB::PageIO::create(PeterDB::POSIX_IO);
+        ASSERT_EQ(io->open(fileName), success);
+        PeterDB::BufferPool pool(2, PeterDB::CLOCK_POLICY);
+        const PeterDB::FileId fileId = 1000;
+        ASSERT_EQ(pool.attachFile(fileId, io), success);
+
+        // pins
+        char *frame0, *frame1, *frame2;
+        ASSERT_EQ(pool.fetchPage(fileId, 0, frame0), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 1, frame1), success);
+        ASSERT_NE(pool.fetchPage(fileId, 2, frame2), success) << "Every frame is pinned.";
+        ASSERT_EQ(pool.unpinPage(fileId, 1, false), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 2, frame2), success) << "Page 1 is unpinned and can make room.";
+        generateData(page.data(), PAGE_SIZE, 22, 42);
+        ASSERT_EQ(memcmp(frame2, page.data(), PAGE_SIZE), 0) << "Page 2 should be read from the disk.";
+        ASSERT_NE(pool.unpinPage(fileId, 1, false), success) << "Page 1 was evicted, there is nothing to unpin.";
+
+        // dirty write-back on flush
+        memset(frame0, 'x', PAGE_SIZE);
+        ASSERT_EQ(pool.unpinPage(fileId, 0, true), success);
+        ASSERT_EQ(pool.unpinPage(fileId, 2, false), success);
+        ASSERT_EQ(io->readAt(PAGE_SIZE, disk.data(), PAGE_SIZE), success);
+        ASSERT_NE(disk[0], 'x') << "A dirty page should stay in the pool until it is written back.";
+        ASSERT_EQ(pool.flushFile(fileId), success);
+        ASSERT_EQ(io->readAt(PAGE_SIZE, disk.data(), PAGE_SIZE), success);
+        ASSERT_EQ(disk[0], 'x') << "Flushing should write the dirty page back.";
+
+        // dirty write-back on eviction: pages 1 and 2 take both frames
+        ASSERT_EQ(pool.fetchPage(fileId, 0, frame0), success);
+        memset(frame0, 'y', PAGE_SIZE);
+        ASSERT_EQ(pool.unpinPage(fileId, 0, true), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 1, frame1), success);
+        ASSERT_EQ(pool.unpinPage(fileId, 1, false), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 2, frame2), success);
+        ASSERT_EQ(pool.unpinPage(fileId, 2, false), success);
+        ASSERT_EQ(io->readAt(PAGE_SIZE, disk.data(), PAGE_SIZE), success);
+        ASSERT_EQ(disk[0], 'y') << "Evicting a dirty page should write it back.";
+
+        // discard
+        unsigned hits, misses, evictions, hits1, misses1;
+        ASSERT_EQ(pool.fetchPage(fileId, 2, frame2), success);
+        ASSERT_NE(pool.discardFile(fileId), success) << "A pinned page cannot be discarded.";
+        ASSERT_EQ(pool.unpinPage(fileId, 2, false), success);
+        ASSERT_EQ(pool.collectStats(hits, misses, evictions), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 1, frame1), success);
+        ASSERT_EQ(pool.unpinPage(fileId, 1, false), success);
+        ASSERT_EQ(pool.collectStats(hits1, misses1, evictions), success);
+        ASSERT_EQ(hits1, hits + 1) << "A refused discard should leave the unpinned pages cached too.";
+        memset(page.data(), 'z', PAGE_SIZE);
+        ASSERT_EQ(io->writeAt(3 * PAGE_SIZE, page.data(), PAGE_SIZE), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 2, frame2), success);
+        ASSERT_NE(frame2[0], 'z') << "The cached copy is served until it is discarded.";
+        ASSERT_EQ(pool.unpinPage(fileId, 2, false), success);
+        ASSERT_EQ(pool.collectStats(hits, misses, evictions), success);
+        ASSERT_EQ(pool.discardFile(fileId), success);
+        ASSERT_EQ(pool.fetchPage(fileId, 2, frame2), success);
+        ASSERT_EQ(frame2[0], 'z') << "After a discard the page should be read from the disk again.";
+        ASSERT_EQ(pool.unpinPage(fileId, 2, false), success);
+        ASSERT_EQ(pool.collectStats(hits, misses1, evictions), success);
+        ASSERT_EQ(misses1, misses + 1) << "The fetch after a discard is a miss.";
+
+        ASSERT_EQ(pool.detachFile(fileId), success);
+        io->close();
+        delete io;
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
+    TEST_F (PFM_File_Test, destroyed_file_keeps_referenced_pages_until_released) {
+        // Test case procedure:
+        // 1. Destroy a file while it is open and one of its pages is referenced
+        // 2. Once the reference is released, closing drops its pages
+        // 3. Closing with the reference still held cannot drop them and fails
+        // 4. Either way a new file by the same name starts without the old pages
+
+        for (bool release : {true, false}) {
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+            PeterDB::FileHandle fileHandle;
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed.";
+            std::vector<char> page(PAGE_SIZE);
+            generateData(page.data(), PAGE_SIZE, 70, 3);
+            ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+            const void *ref;
+            ASSERT_EQ(fileHandle.readPageRef(0, ref), success) << "Referencing a page should succeed.";
+            ASSERT_EQ(pfm.destroyFile(fileName), success) << "Destroying an open file should succeed.";
+            if (release) {
+                ASSERT_EQ(fileHandle.releasePageRef(0), success);
+                ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+            } else {
+                ASSERT_NE(pfm.closeFile(fileHandle), success) << "A referenced page should keep the close from "
+                                                                 "dropping the pages.";
+            }
+
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file again should succeed.";
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the new file should succeed.";
+            ASSERT_EQ(fileHandle.getNumberOfPages(), 0) << "The new file should not see the old pages.";
+            ASSERT_NE(fileHandle.readPage(0, page.data()), success) << "The new file should not see the old pages.";
+            ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+            ASSERT_EQ(pfm.destroyFile(fileName), success);
+        }
+    }
+
+    // read/write/append counters as stored in the last 12 bytes of the hidden header page
+    static void readStoredCounters(const std::string &fileName, unsigned counters[3]) {
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        in.seekg(PAGE_SIZE - 3 * sizeof(unsigned));
+        in.read((char *) counters, 3 * sizeof(unsigned));
+    }
+
+    TEST_F (PFM_File_Test, counters_persist_on_checkpoint_and_close) {
+        // Test case procedure:
+        // 1. Append, read and write pages: the counters change in memory only
+        // 2. checkpoint writes them to the header page
+        // 3. closeFile writes them again, reopening picks them up plus the read of the header page
+
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        std::vector<char> page(PAGE_SIZE);
+        generateData(page.data(), PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success);
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success);
+        ASSERT_EQ(fileHandle.readPage(1, page.data()), success);
+        ASSERT_EQ(fileHandle.writePage(0, page.data()), success);
+
+        unsigned readCount, writeCount, appendCount, stored[3];
+        ASSERT_EQ(fileHandle.collectCounterValues(readCount, writeCount, appendCount), success);
+        ASSERT_EQ(readCount, 1);
+        ASSERT_EQ(writeCount, 1);
+        ASSERT_EQ(appendCount, 2);
+        readStoredCounters(fileName, stored);
+        ASSERT_EQ(stored[0] + stored[1] + stored[2], 0) << "Counters should not be written on every page access.";
+
+        ASSERT_EQ(pfm.checkpoint(), success) << "Checkpoint should succeed.";
+        readStoredCounters(fileName, stored);
+        ASSERT_EQ(stored[0], readCount) << "Checkpoint should persist the read counter.";
+        ASSERT_EQ(stored[1], writeCount) << "Checkpoint should persist the write counter.";
+        ASSERT_EQ(stored[2], appendCount) << "Checkpoint should persist the append counter.";
+
+        ASSERT_EQ(fileHandle.readPage(0, page.data()), success);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        readStoredCounters(fileName, stored);
+        ASSERT_EQ(stored[0], readCount + 1) << "Closing should persist the read counter.";
+        ASSERT_EQ(stored[1], writeCount);
+        ASSERT_EQ(stored[2], appendCount);
+
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        ASSERT_EQ(fileHandle.collectCounterValues(readCount, writeCount, appendCount), success);
+        ASSERT_EQ(readCount, stored[0] + 1) << "Reading the header page on open counts as one read.";
+        ASSERT_EQ(writeCount, stored[1]);
+        ASSERT_EQ(appendCount, stored[2]);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
+    // append numPages pages through backend, overwrite page 1, then read everything back through readBackend
+    static void checkBackendRoundTrip(PeterDB::PagedFileManager &pfm, const std::string &fileName,
+                                      PeterDB::IOBackend backend, PeterDB::IOBackend readBackend) {
+        const unsigned numPages = 5;
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, backend), success) << "Opening the file should succeed.";
+        std::vector<char> page(PAGE_SIZE), expected(PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(page.data(), PAGE_SIZE, 31 + i, 17 + i);
+            ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        }
+        generateData(page.data(), PAGE_SIZE, 77, 5);
+        ASSERT_EQ(fileHandle.writePage(1, page.data()), success) << "Writing a page should succeed.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(getFileSize(fileName) % PAGE_SIZE, 0) << "File should be based on PAGE_SIZE.";
+
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, readBackend), success) << "Opening the file should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages);
+        for (unsigned i = 0; i < numPages; i++) {
+            if (i == 1) {
+                generateData(expected.data(), PAGE_SIZE, 77, 5);
+            } else {
+                generateData(expected.data(), PAGE_SIZE, 31 + i, 17 + i);
+            }
+            ASSERT_EQ(fileHandle.readPage(i, page.data()), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(page.data(), expected.data(), PAGE_SIZE), 0) << "Page " << i << " should read back.";
+        }
+        ASSERT_NE(fileHandle.readPage(numPages, page.data()), success) << "Reading past the last page should fail.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
+    TEST_F (PFM_File_Test, posix_and_fstream_backends) {
+        // Test case procedure:
+        // 1. Write pages with pread/pwrite and read them back with fstream
+        // 2. And the other way round
+
+        checkBackendRoundTrip(pfm, fileName, PeterDB::POSIX_IO, PeterDB::FSTREAM_IO);
+        checkBackendRoundTrip(pfm, fileName, PeterDB::FSTREAM_IO, PeterDB::POSIX_IO);
+    }
+
+    TEST_F (PFM_File_Test, second_open_shares_the_backend) {
+        // Test case procedure, for each backend:
+        // 1. Open a file with it
+        // 2. Opening it again with another backend fails, a plain open joins the open one
+        // 3. Once every handle is closed, the next open may pick any backend
+
+        const PeterDB::IOBackend backends[] = {PeterDB::FSTREAM_IO, PeterDB::POSIX_IO, PeterDB::MMAP_IO};
+        for (PeterDB::IOBackend backend : backends) {
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+            PeterDB::FileHandle fileHandle, otherHandle;
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle, backend), success);
+            for (PeterDB::IOBackend other : backends) {
+                if (other != backend) {
+                    ASSERT_EQ(pfm.openFile(fileName, otherHandle, other), -4)
+                                                << "A second open with another backend should fail.";
+                }
+            }
+            ASSERT_EQ(pfm.openFile(fileName, otherHandle), success) << "A plain open should join the open backend.";
+
+            std::vector<char> page(PAGE_SIZE), readBack(PAGE_SIZE);
+            generateData(page.data(), PAGE_SIZE, 40, 3);
+            ASSERT_EQ(fileHandle.appendPage(page.data()), success);
+            ASSERT_EQ(otherHandle.getNumberOfPages(), 1) << "Both handles should see the same file.";
+            ASSERT_EQ(otherHandle.readPage(0, readBack.data()), success);
+            ASSERT_EQ(memcmp(page.data(), readBack.data(), PAGE_SIZE), 0);
+            ASSERT_EQ(pfm.closeFile(otherHandle), success);
+            ASSERT_EQ(pfm.closeFile(fileHandle), success);
+
+            PeterDB::IOBackend next = backend == PeterDB::POSIX_IO ? PeterDB::MMAP_IO : PeterDB::POSIX_IO;
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle, next), success)
+                                        << "With no handle left open any backend can be picked.";
+            ASSERT_EQ(pfm.closeFile(fileHandle), success);
+            ASSERT_EQ(pfm.destroyFile(fileName), success);
+        }
+    }
+
+    TEST_F (PFM_File_Test, mmap_backend_and_page_refs) {
+        // Test case procedure:
+        // 1. Round trip between MMAP_IO and POSIX_IO
+        // 2. With either backend readPageRef hands out the same page memory to every reader, without a copy
+        // 3. A write to the page shows through a reference that is still held
+
+        checkBackendRoundTrip(pfm, fileName, PeterDB::MMAP_IO, PeterDB::POSIX_IO);
+        checkBackendRoundTrip(pfm, fileName, PeterDB::POSIX_IO, PeterDB::MMAP_IO);
+
+        for (PeterDB::IOBackend backend : {PeterDB::MMAP_IO, PeterDB::POSIX_IO}) {
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+            PeterDB::FileHandle fileHandle;
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle, backend), success) << "Opening the file should succeed.";
+            std::vector<char> page(PAGE_SIZE);
+            for (unsigned i = 0; i < 3; i++) {
+                generateData(page.data(), PAGE_SIZE, 50 + i, 9);
+                ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+            }
+
+            const void *first, *second;
+            ASSERT_EQ(fileHandle.readPageRef(2, first), success) << "Referencing a page should succeed.";
+            ASSERT_EQ(fileHandle.readPageRef(2, second), success) << "Referencing a page should succeed.";
+            ASSERT_EQ(first, second) << "Both readers should see the same page memory.";
+            generateData(page.data(), PAGE_SIZE, 52, 9);
+            ASSERT_EQ(memcmp(first, page.data(), PAGE_SIZE), 0) << "The reference should point at page 2.";
+
+            generateData(page.data(), PAGE_SIZE, 90, 4);
+            ASSERT_EQ(fileHandle.writePage(2, page.data()), success) << "Writing a page should succeed.";
+            ASSERT_EQ(memcmp(first, page.data(), PAGE_SIZE), 0) << "A held reference should see the write.";
+            ASSERT_EQ(fileHandle.releasePageRef(2), success);
+            ASSERT_EQ(fileHandle.releasePageRef(2), success);
+            ASSERT_NE(fileHandle.readPageRef(3, first), success) << "Referencing past the last page should fail.";
+
+            ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+            ASSERT_EQ(pfm.destroyFile(fileName), success);
+        }
+    }
+
+    TEST_F (PFM_File_Test, extents_and_high_water_mark) {
+        // Test case procedure:
+        // 1. With an extent of 8 pages the first append reserves 8 pages on disk
+        // 2. The page count is the high-water mark, it survives a reopen while the file keeps its size
+        // 3. Appends fill the extent before the next one is reserved
+        // 4. The manager's extent size is the default for the next open
+
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        ASSERT_EQ(fileHandle.getExtentSize(), DEFAULT_EXTENT_PAGES);
+        ASSERT_NE(fileHandle.setExtentSize(0), success) << "An empty extent should be rejected.";
+        ASSERT_EQ(fileHandle.setExtentSize(8), success);
+
+        std::vector<char> page(PAGE_SIZE), readBack(PAGE_SIZE);
+        generateData(page.data(), PAGE_SIZE, 12, 7);
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1);
+        ASSERT_EQ(getFileSize(fileName), (1 + 8) * PAGE_SIZE) << "The first append should reserve a whole extent.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1) << "Preallocated pages should not count after a reopen.";
+        ASSERT_EQ(fileHandle.getExtentSize(), DEFAULT_EXTENT_PAGES) << "The extent size is not kept in the file.";
+        ASSERT_NE(fileHandle.readPage(1, readBack.data()), success) << "A preallocated page cannot be read.";
+        ASSERT_EQ(fileHandle.setExtentSize(8), success);
+        for (unsigned i = 1; i < 8; i++) {
+            ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(getFileSize(fileName), (1 + 8) * PAGE_SIZE) << "Appends should fill the reserved extent first.";
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 9);
+        ASSERT_EQ(getFileSize(fileName), (1 + 16) * PAGE_SIZE) << "A full extent should make room for the next one.";
+        ASSERT_EQ(fileHandle.readPage(8, readBack.data()), success);
+        ASSERT_EQ(memcmp(page.data(), readBack.data(), PAGE_SIZE), 0);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+
+        ASSERT_EQ(pfm.setExtentSize(4), success);
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 9) << "The high-water mark should survive a reopen.";
+        ASSERT_EQ(fileHandle.getExtentSize(), 4) << "A new open should take the manager's extent size.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.setExtentSize(DEFAULT_EXTENT_PAGES), success);
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
+    TEST_F (PFM_File_Test, other_page_size_is_rejected) {
+        // Test case procedure:
+        // 1. Create a file with one page, its header records PAGE_SIZE
+        // 2. Change the page size stored in the header as another build would have written it
+        // 3. Opening the file fails with -3, with the original page size it opens again
+
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        std::vector<char> page(PAGE_SIZE);
+        generateData(page.data(), PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success) << "Appending a page should succeed.";
+        ASSERT_EQ(fileHandle.getPageSize(), PAGE_SIZE);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+
+        PeterDB::FileHeader header;
+        std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+        file.read((char *) &header, sizeof(header));
+        ASSERT_EQ(header.magic, FILE_HEADER_MAGIC);
+        ASSERT_EQ(header.pageSize, PAGE_SIZE);
+        unsigned otherPageSize = PAGE_SIZE * 2;
+        file.seekp(offsetof(PeterDB::FileHeader, pageSize));
+        file.write((const char *) &otherPageSize, sizeof(unsigned));
+        file.close();
+
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), -3) << "A file with another page size should not open.";
+        ASSERT_NE(fileHandle.readPage(0, page.data()), success) << "The handle should stay closed.";
+
+        file.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsetof(PeterDB::FileHeader, pageSize));
+        file.write((const char *) &header.pageSize, sizeof(unsigned));
+        file.close();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "With its own page size the file should open.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
+    TEST_F (PFM_File_Test, handle_cache_reuses_and_drops_handles) {
+        // Test case procedure:
+        // 1. Acquiring a file twice reuses the same open, a released handle keeps the file open
+        // 2. closeIdleHandles and a cache of one handle close idle files, which persists their counters
+        // 3. destroyFile drops the cached handle, a file created again under the name starts empty
+
+        std::string otherName = fileName + "_other";
+        remove(otherName.c_str());
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        ASSERT_EQ(pfm.createFile(otherName), success) << "Creating the file should succeed: " << otherName;
+
+        PeterDB::FileHandle fileHandle, notAcquired;
+        std::vector<char> page(PAGE_SIZE);
+        generateData(page.data(), PAGE_SIZE);
+        unsigned readCount, writeCount, appendCount, stored[3];
+        ASSERT_EQ(pfm.acquireFile(fileName, fileHandle), success);
+        ASSERT_EQ(fileHandle.appendPage(page.data()), success);
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+        ASSERT_NE(pfm.releaseFile(fileHandle), success) << "A handle is released only once.";
+        ASSERT_NE(pfm.releaseFile(notAcquired), success) << "Only acquired handles can be released.";
+
+        ASSERT_EQ(pfm.acquireFile(fileName, fileHandle), success);
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1);
+        ASSERT_EQ(fileHandle.collectCounterValues(readCount, writeCount, appendCount), success);
+        ASSERT_EQ(appendCount, 1) << "The second acquire should share the first open.";
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+        readStoredCounters(fileName, stored);
+        ASSERT_EQ(stored[2], 0) << "An idle cached handle keeps the file open.";
+        ASSERT_EQ(pfm.closeIdleHandles(), success);
+        readStoredCounters(fileName, stored);
+        ASSERT_EQ(stored[2], 1) << "Closing idle handles should close the file.";
+
+        // with room for one handle, acquiring another file closes the idle one
+        ASSERT_EQ(pfm.setHandleCacheSize(1), success);
+        ASSERT_EQ(pfm.acquireFile(fileName, fileHandle), success);
+        ASSERT_EQ(fileHandle.readPage(0, page.data()), success);
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+        readStoredCounters(fileName, stored);
+        unsigned readsBefore = stored[0];
+        ASSERT_EQ(pfm.acquireFile(otherName, fileHandle), success);
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+        readStoredCounters(fileName, stored);
+        ASSERT_GT(stored[0], readsBefore) << "The least recently used idle handle should have been closed.";
+
+        // destroying a file drops its handle even while acquired, the handle works until released
+        ASSERT_EQ(pfm.acquireFile(fileName, fileHandle), success);
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+        ASSERT_EQ(fileHandle.readPage(0, page.data()), success) << "An acquired handle stays usable.";
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should succeed: " << fileName;
+        ASSERT_EQ(pfm.acquireFile(fileName, fileHandle), success);
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 0) << "The new file should not see the old cached handle.";
+        ASSERT_EQ(pfm.releaseFile(fileHandle), success);
+
+        ASSERT_EQ(pfm.setHandleCacheSize(DEFAULT_HANDLE_CACHE), success);
+        ASSERT_EQ(pfm.closeIdleHandles(), success);
+        ASSERT_EQ(pfm.destroyFile(otherName), success);
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+    }
+
 }
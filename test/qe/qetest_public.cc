@@ -805,4 +805,182 @@ namespace PeterDBTesting {
 
     }
 
+    // Printed tuples of an iterator, read a tuple at a time or a batch at a time
+    static std::vector<std::string> drainIterator(PeterDB::RelationManager &rm, PeterDB::Iterator &iterator,
+                                                  bool batched) {
+        std::vector<PeterDB::Attribute> attrs;
+        iterator.getAttributes(attrs);
+        std::vector<char> tuple(PAGE_SIZE);
+        std::vector<std::string> printed;
+        auto print = [&]() {
+            std::stringstream stream;
+            rm.printTuple(attrs, tuple.data(), stream);
+            printed.emplace_back(stream.str());
+        };
+        if (batched) {
+            PeterDB::RecordBatch batch;
+            while (iterator.getNextBatch(batch) != QE_EOF) {
+                EXPECT_GT(batch.getNumberOfRows(), 0) << "A batch that is not the end should have rows.";
+                for (unsigned row = 0; row < batch.getNumberOfRows(); row++) {
+                    batch.getTuple(row, tuple.data());
+                    print();
+                }
+            }
+        } else {
+            while (iterator.getNextTuple(tuple.data()) != QE_EOF) {
+                print();
+            }
+        }
+        sort(printed.begin(), printed.end());
+        return printed;
+    }
+
+    TEST_F(QE_Test, filter_batches_match_tuples) {
+        // 1. Filter over Int and Real columns (compare kernels) and a VarChar column (row by row in the batch)
+        // 2. A condition between two attributes and one on an unknown attribute fall back to the row path
+        // 3. Project over Filter
+        // Every batch result is checked against getNextTuple over the same data
+        inBuffer = malloc(bufSize);
+        outBuffer = malloc(bufSize);
+
+        for (const std::string tableName : {"left", "leftvarchar"}) {
+            ASSERT_EQ(rm.createTable(tableName, attrsMap[tableName]), success)
+                                        << "Create table " << tableName << " should succeed.";
+            tableNames.emplace_back(tableName);
+            populateTable(tableName, 1000);
+        }
+
+        int intValue = 51;
+        float realValue = 100.5;
+        std::string text(12, 'l');
+        std::vector<char> varCharValue(sizeof(int) + text.length());
+        int textLength = text.length();
+        memcpy(varCharValue.data(), &textLength, sizeof(int));
+        memcpy(varCharValue.data() + sizeof(int), text.data(), textLength);
+
+        std::vector<std::pair<std::string, PeterDB::Condition>> cases = {
+                {"left",        {"left.B",        PeterDB::LE_OP, false, "",       {PeterDB::TypeInt,     &intValue}}},
+                {"left",        {"left.C",        PeterDB::GT_OP, false, "",       {PeterDB::TypeReal,    &realValue}}},
+                {"leftvarchar", {"leftvarchar.B", PeterDB::EQ_OP, false, "",       {PeterDB::TypeVarChar, varCharValue.data()}}},
+                {"left",        {"left.A",        PeterDB::LT_OP, true,  "left.B", {PeterDB::TypeInt,     nullptr}}},
+                {"left",        {"left.Z",        PeterDB::EQ_OP, false, "",       {PeterDB::TypeInt,     &intValue}}},
+        };
+        for (unsigned c = 0; c < cases.size(); c++) {
+            PeterDB::TableScan rowScan(rm, cases[c].first), batchScan(rm, cases[c].first);
+            PeterDB::Filter rowFilter(&rowScan, cases[c].second), batchFilter(&batchScan, cases[c].second);
+            std::vector<std::string> expected = drainIterator(rm, rowFilter, false);
+            ASSERT_EQ(drainIterator(rm, batchFilter, true), expected) << "Filter case " << c << " should match.";
+            if (c < 3) {
+                ASSERT_FALSE(expected.empty()) << "Filter case " << c << " should select some tuples.";
+            }
+        }
+
+        PeterDB::TableScan rowScan(rm, "left"), batchScan(rm, "left");
+        PeterDB::Filter rowFilter(&rowScan, cases[0].second), batchFilter(&batchScan, cases[0].second);
+        PeterDB::Project rowProject(&rowFilter, {"left.C", "left.A"}), batchProject(&batchFilter, {"left.C", "left.A"});
+        std::vector<std::string> expected = drainIterator(rm, rowProject, false);
+        ASSERT_FALSE(expected.empty()) << "B <= 51 should select some tuples.";
+        ASSERT_EQ(drainIterator(rm, batchProject, true), expected) << "Project over Filter should match.";
+    }
+
+    TEST_F(QE_Test, inljoin_on_a_hash_index) {
+        // 1. INLJoin -- on TypeReal Attribute, the right side probes a hash index
+        // SELECT * from left, right WHERE left.C = right.C
+
+        inBuffer = malloc(bufSize);
+        outBuffer = malloc(bufSize);
+
+        createAndPopulateTable("left", {}, 100);
+        createAndPopulateTable("right", {}, 300);
+        ASSERT_EQ(rm.createIndex("right", std::vector<std::string>(1, "C"), PeterDB::HashIndex), success)
+                                    << "RelationManager.createIndex() of a hash index should succeed.";
+        ASSERT_NE(rm.createIndex("right", "C"), success) << "The column already has an index.";
+
+        PeterDB::TableScan leftIn(rm, "left");
+        PeterDB::IndexScan rightIn(rm, "right", "C");
+        PeterDB::Condition cond{"left.C", PeterDB::EQ_OP, true, "right.C"};
+        PeterDB::INLJoin inlJoin(&leftIn, &rightIn, cond);
+
+        std::vector<std::string> printed;
+        ASSERT_EQ(inlJoin.getAttributes(attrs), success) << "INLJoin.getAttributes() should succeed.";
+        while (inlJoin.getNextTuple(outBuffer) != QE_EOF) {
+            std::stringstream stream;
+            ASSERT_EQ(rm.printTuple(attrs, outBuffer, stream), success)
+                                        << "RelationManager.printTuple() should succeed.";
+            printed.emplace_back(stream.str());
+            memset(outBuffer, 0, bufSize);
+        }
+
+        std::vector<std::string> expected;
+        for (int i = 0; i < 100; i++) {
+            unsigned a = i % 203;
+            unsigned b1 = (i + 10) % 197;
+            float c1 = (float) (i % 167) + 50.5f;
+            for (int j = 0; j < 300; j++) {
+                unsigned b2 = j % 251 + 20;
+                float c2 = (float) (j % 261) + 25.5f;
+                unsigned d = j % 179;
+                if (c1 == c2) {
+                    expected.emplace_back(
+                            "left.A: " + std::to_string(a) + ", left.B: " + std::to_string(b1) + ", left.C: " +
+                            std::to_string(c1) + ", right.B: " + std::to_string(b2) + ", right.C: " +
+                            std::to_string(c2) + ", right.D: " + std::to_string(d));
+                }
+            }
+        }
+        sort(expected.begin(), expected.end());
+        sort(printed.begin(), printed.end());
+
+        ASSERT_EQ(expected.size(), printed.size()) << "The number of returned tuple is not correct.";
+        for (int i = 0; i < expected.size(); ++i) {
+            checkPrintRecord(expected[i], printed[i], false, {}, i % 10 == 0);
+        }
+    }
+
+
+    TEST_F(QE_Test, index_only_scan_on_a_covering_index) {
+        // 1. Index-only IndexScan over an index on left.B including left.C
+        // SELECT B, C from left ORDER BY B, without reading the table
+        // 2. Unknown, repeated or unindexed included columns make the scan fail instead of coming back empty
+
+        inBuffer = malloc(bufSize);
+        outBuffer = malloc(bufSize);
+
+        createAndPopulateTable("left", {}, 100);
+        ASSERT_EQ(rm.createIndex("left", {"B"}, {"C"}), success) << "RelationManager.createIndex() should succeed.";
+
+        PeterDB::IndexScan indexScan(rm, "left", "B", std::vector<std::string>(1, "C"));
+        ASSERT_EQ(indexScan.getAttributes(attrs), success) << "IndexScan.getAttributes() should succeed.";
+        ASSERT_EQ(attrs.size(), 2) << "Only the indexed columns should be returned.";
+        ASSERT_EQ(attrs[0].name, "left.B");
+        ASSERT_EQ(attrs[1].name, "left.C");
+        unsigned count = 0;
+        int lastB = -1;
+        while (indexScan.getNextTuple(outBuffer) != QE_EOF) {
+            int b = *(int *) ((char *) outBuffer + 1);
+            float c = *(float *) ((char *) outBuffer + 1 + sizeof(int));
+            ASSERT_GT(b, lastB) << "Tuples should come in B order.";
+            ASSERT_EQ(c, (float) ((b - 10) % 167) + 50.5f) << "C should be the one of the tuple.";
+            lastB = b;
+            count++;
+        }
+        ASSERT_EQ(count, 100) << "Every tuple should be returned.";
+
+        PeterDB::IndexScan unknownColumn(rm, "left", "B", std::vector<std::string>(1, "X"));
+        PeterDB::RC rc = unknownColumn.getNextTuple(outBuffer);
+        ASSERT_TRUE(rc != success && rc != QE_EOF) << "An unknown included column should fail the scan.";
+        PeterDB::IndexScan repeatedColumn(rm, "left", "B", std::vector<std::string>(1, "B"));
+        rc = repeatedColumn.getNextTuple(outBuffer);
+        ASSERT_TRUE(rc != success && rc != QE_EOF) << "A repeated column should fail the scan.";
+        PeterDB::IndexScan noIndex(rm, "left", "B", std::vector<std::string>(1, "A"));
+        rc = noIndex.getNextTuple(outBuffer);
+        ASSERT_TRUE(rc != success && rc != QE_EOF) << "A scan of a missing index should fail.";
+
+        PeterDB::TableScan leftIn(rm, "left");
+        PeterDB::Condition cond{"left.B", PeterDB::EQ_OP, true, "left.B"};
+        PeterDB::INLJoin inlJoin(&leftIn, &noIndex, cond);
+        rc = inlJoin.getNextTuple(outBuffer);
+        ASSERT_TRUE(rc != success && rc != QE_EOF) << "INLJoin should pass on the failed index scan.";
+    }
+
 } // namespace PeterDBTesting
\ No newline at end of file
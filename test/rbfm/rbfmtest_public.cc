@@ -1,5 +1,7 @@
 #include "src/include/rbfm.h"
 #include "test/utils/rbfm_test_utils.h"
+#include <functional>
+#include <limits>
 
 namespace PeterDBTesting {
 
@@ -404,5 +406,541 @@ namespace PeterDBTesting {
                                     << "Read a deleted record should not success.";
     }
 
+    TEST_F(RBFM_Test, scan_pins_only_the_current_page) {
+        // Functions Tested:
+        // 1. Shrink the buffer pool to 4 frames and fill more pages than that
+        // 2. Two interleaved scans each hold one pinned page and read every record
+        // 3. The same scan over a file opened with MMAP_IO
+        // 4. Restore the buffer pool
+
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.configureBufferPool(4, PeterDB::CLOCK_POLICY), success);
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+
+        const unsigned numRecords = PAGE_SIZE / 4;
+        PeterDB::RID rid;
+        for (unsigned i = 0; i < numRecords; i++) {
+            insertRecord(recordDescriptor, rid, "Employee" + std::to_string(i));
+        }
+        ASSERT_GT(fileHandle.getNumberOfPages(), 8) << "The records should take more pages than the pool has frames.";
+
+        std::vector<std::string> attributeNames{"EmpName", "Age"};
+        PeterDB::RBFM_ScanIterator first, second;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, NULL, attributeNames, first), success);
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, NULL, attributeNames, second), success);
+        unsigned firstCount = 0, secondCount = 0;
+        while (true) {
+            bool firstDone = first.getNextRecord(rid, outBuffer) == RBFM_EOF;
+            firstCount += firstDone ? 0 : 1;
+            bool secondDone = second.getNextRecord(rid, outBuffer) == RBFM_EOF;
+            secondCount += secondDone ? 0 : 1;
+            if (firstDone && secondDone) {
+                break;
+            }
+        }
+        ASSERT_EQ(firstCount, numRecords) << "The first scan should return every record.";
+        ASSERT_EQ(secondCount, numRecords) << "The second scan should return every record.";
+        // closing a scan closes the file handle it was given
+        first.close();
+        second.close();
+
+        // a plain open joins the MMAP_IO backend, the scan then walks the mapping
+        PeterDB::FileHandle mappedHandle;
+        ASSERT_EQ(pfm.openFile(fileName, mappedHandle, PeterDB::MMAP_IO), success);
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+        int age = 25;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::EQ_OP, &age, attributeNames, first), success);
+        firstCount = 0;
+        while (first.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            firstCount++;
+        }
+        ASSERT_EQ(firstCount, numRecords) << "The scan over the mapping should return every record.";
+        first.close();
+        ASSERT_EQ(pfm.closeFile(mappedHandle), success);
+
+        ASSERT_EQ(pfm.configureBufferPool(DEFAULT_POOL_FRAMES, PeterDB::CLOCK_POLICY), success);
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed: " << fileName;
+    }
+
+    TEST_F(RBFM_Test, insert_records_grows_the_file_in_extents) {
+        // Functions Tested:
+        // 1. insertRecords() of a batch spanning many pages
+        // 2. The file was grown in extents, the handle's extent size is back to what it was
+        // 3. Every record reads back
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        outBuffer = malloc(100);
+
+        const unsigned numRecords = 2000;
+        std::vector<std::vector<char>> records(numRecords, std::vector<char>(100));
+        std::vector<const void *> data;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            std::string name = "Employee" + std::to_string(i);
+            prepareRecord(recordDescriptor.size(), nullsIndicator, name.length(), name, i, 170.5, 5000 + i,
+                          records[i].data(), recordSize);
+            data.push_back(records[i].data());
+        }
+
+        unsigned extentPages = fileHandle.getExtentSize();
+        std::vector<PeterDB::RID> rids;
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, data, rids), success)
+                                    << "Inserting a batch of records should succeed.";
+        ASSERT_EQ(rids.size(), numRecords);
+        ASSERT_EQ(fileHandle.getExtentSize(), extentPages) << "The extent size should be restored.";
+        unsigned numPages = fileHandle.getNumberOfPages();
+        ASSERT_GT(getFileSize(fileName), (numPages + 1) * PAGE_SIZE) << "The batch should have reserved extents.";
+        ASSERT_LT(getFileSize(fileName), (numPages + 1 + BULK_EXTENT_PAGES) * PAGE_SIZE);
+
+        for (unsigned i = 0; i < numRecords; i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success);
+            ASSERT_EQ(memcmp(outBuffer, records[i].data(), 20), 0) << "Record " << i << " should read back.";
+        }
+
+        reopenFile(fileName, fileHandle);
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "Reserved pages should not count after a reopen.";
+    }
+
+    TEST_F(RBFM_Test, free_space_map_picks_insert_pages) {
+        // Functions Tested:
+        // 1. The first data page brings map page 0 with it
+        // 2. findPage() only offers pages whose bucket covers the request, latest page first
+        // 3. Deleting records frees space that the next insert reuses instead of appending a page
+
+        ASSERT_FALSE(PeterDB::FreeSpaceMap::hasMap(fileHandle)) << "An empty file has no map yet.";
+        ASSERT_TRUE(PeterDB::FreeSpaceMap::isMapPage(0));
+        ASSERT_FALSE(PeterDB::FreeSpaceMap::isMapPage(1));
+        ASSERT_TRUE(PeterDB::FreeSpaceMap::isMapPage(PeterDB::FreeSpaceMap::FSM_ENTRIES + 1));
+
+        // free space between two bucket bounds, a small request and a page that is as good as full
+        unsigned width = PAGE_SIZE / FSM_BUCKETS;
+        const unsigned freeSpace = 3 * width + width * 3 / 4, small = width / 2, full = 10;
+
+        std::vector<char> page(PAGE_SIZE, 0);
+        PeterDB::PageNum pageNum;
+        ASSERT_EQ(PeterDB::FreeSpaceMap::appendDataPage(fileHandle, page.data(), freeSpace, pageNum), success);
+        ASSERT_EQ(pageNum, 1) << "The map page should come first.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 2);
+        ASSERT_TRUE(PeterDB::FreeSpaceMap::hasMap(fileHandle));
+
+        // buckets round down, the page only promises 3 buckets of PAGE_SIZE / FSM_BUCKETS
+        PeterDB::PageNum found;
+        ASSERT_EQ(PeterDB::FreeSpaceMap::findPage(fileHandle, freeSpace / width * width, found), success);
+        ASSERT_EQ(found, 1);
+        ASSERT_NE(PeterDB::FreeSpaceMap::findPage(fileHandle, freeSpace, found), success)
+                                    << "A request above the rounded down bucket should not be offered the page.";
+
+        ASSERT_EQ(PeterDB::FreeSpaceMap::appendDataPage(fileHandle, page.data(), PAGE_SIZE / 2, pageNum), success);
+        ASSERT_EQ(pageNum, 2);
+        ASSERT_EQ(PeterDB::FreeSpaceMap::findPage(fileHandle, small, found), success);
+        ASSERT_EQ(found, 2) << "The latest page with room should be picked.";
+        ASSERT_EQ(PeterDB::FreeSpaceMap::update(fileHandle, 2, full), success);
+        ASSERT_EQ(PeterDB::FreeSpaceMap::findPage(fileHandle, small, found), success);
+        ASSERT_EQ(found, 1) << "A full page should be passed over.";
+        ASSERT_EQ(PeterDB::FreeSpaceMap::update(fileHandle, 1, full), success);
+        ASSERT_NE(PeterDB::FreeSpaceMap::findPage(fileHandle, small, found), success) << "No page has room left.";
+    }
+
+    TEST_F(RBFM_Test, deleted_space_is_reused_through_the_free_space_map) {
+        // Functions Tested:
+        // 1. Insert records of 7/16 of a page, two to a page
+        // 2. Delete both records of the first data page
+        // 3. The next records go to that page and its deleted slots, the file does not grow
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        PeterDB::Attribute attr;
+        attr.name = "Text";
+        attr.type = PeterDB::TypeVarChar;
+        attr.length = PAGE_SIZE / 2;
+        recordDescriptor.push_back(attr);
+
+        const int textLength = PAGE_SIZE * 7 / 16;
+        inBuffer = calloc(1 + sizeof(int) + textLength, 1);
+        memcpy((char *) inBuffer + 1, &textLength, sizeof(int));
+        memset((char *) inBuffer + 1 + sizeof(int), 'f', textLength);
+
+        std::vector<PeterDB::RID> rids(6);
+        for (auto &rid : rids) {
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success);
+        }
+        ASSERT_EQ(rids[0].pageNum, 1) << "Page 0 is the map page.";
+        ASSERT_EQ(rids[1].pageNum, 1);
+        ASSERT_EQ(rids[5].pageNum, 3);
+        unsigned numPages = fileHandle.getNumberOfPages();
+        std::vector<char> page(PAGE_SIZE);
+        ASSERT_EQ(fileHandle.readPage(1, page.data()), success);
+        auto *pageDir = (PeterDB::PageDir *) (page.data() + PAGE_SIZE - sizeof(PeterDB::PageDir));
+        unsigned freeSpace = pageDir->freeSpace;
+
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[0]), success);
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[1]), success);
+        PeterDB::RID rid;
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success);
+        ASSERT_EQ(rid.pageNum, 1) << "The freed page should be reused.";
+        ASSERT_EQ(rid.slotNum, 0) << "The deleted slot should be reused.";
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success);
+        ASSERT_EQ(rid.pageNum, 1) << "The freed page should be reused.";
+        ASSERT_EQ(rid.slotNum, 1) << "The deleted slot should be reused.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "The file should not grow.";
+        ASSERT_EQ(fileHandle.readPage(1, page.data()), success);
+        ASSERT_EQ(pageDir->numOfSlots, 2) << "Reused slots should not add to the slot directory.";
+        ASSERT_EQ(pageDir->freeSpace, freeSpace) << "The page should be as full as before the deletes.";
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success);
+        ASSERT_EQ(rid.pageNum, numPages) << "With every page full the record goes to a new page.";
+    }
+
+    // Id and Text, the record format is the null byte, the Id and the Text with its length
+    static void prepareIdTextRecord(int id, int textLength, char fill, std::vector<char> &record) {
+        record.assign(1 + 2 * sizeof(int) + textLength, fill);
+        record[0] = 0;
+        memcpy(record.data() + 1, &id, sizeof(int));
+        memcpy(record.data() + 1 + sizeof(int), &textLength, sizeof(int));
+    }
+
+    static void createIdTextDescriptor(std::vector<PeterDB::Attribute> &recordDescriptor) {
+        PeterDB::Attribute attr;
+        attr.name = "Id";
+        attr.type = PeterDB::TypeInt;
+        attr.length = 4;
+        recordDescriptor.push_back(attr);
+        attr.name = "Text";
+        attr.type = PeterDB::TypeVarChar;
+        attr.length = PAGE_SIZE / 2;
+        recordDescriptor.push_back(attr);
+    }
+
+    TEST_F(RBFM_Test, scan_returns_forwarded_records_once) {
+        // Functions Tested:
+        // 1. Fill a page with small records, grow every fourth one so it moves to another page
+        // 2. A record scan and a batch scan each return every record once, the moved ones from their new page
+        // 3. The returned rids read back the same records
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createIdTextDescriptor(recordDescriptor);
+        const int numRecords = PAGE_SIZE / 100, grownLength = PAGE_SIZE * 3 / 8;
+        std::vector<char> record;
+        std::vector<PeterDB::RID> rids(numRecords);
+        for (int id = 0; id < numRecords; id++) {
+            prepareIdTextRecord(id, 80, 'a', record);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, record.data(), rids[id]), success);
+        }
+        for (int id = 0; id < numRecords; id += 4) {
+            prepareIdTextRecord(id, grownLength, 'b', record);
+            ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, record.data(), rids[id]), success);
+        }
+        ASSERT_GT(fileHandle.getNumberOfPages(), 2) << "The grown records should have moved to other pages.";
+
+        PeterDB::FileHandle scanHandle;
+        ASSERT_EQ(rbfm.openFile(fileName, scanHandle), success);
+        PeterDB::RBFM_ScanIterator iterator;
+        int zero = 0;
+        ASSERT_EQ(rbfm.scan(scanHandle, recordDescriptor, "Id", PeterDB::GE_OP, &zero, {"Id", "Text"}, iterator),
+                  success);
+        std::vector<int> seen(numRecords, 0);
+        std::vector<char> data(PAGE_SIZE), readBack(PAGE_SIZE);
+        PeterDB::RID rid;
+        while (iterator.getNextRecord(rid, data.data()) != RBFM_EOF) {
+            int id, textLength;
+            memcpy(&id, data.data() + 1, sizeof(int));
+            memcpy(&textLength, data.data() + 1 + sizeof(int), sizeof(int));
+            ASSERT_TRUE(id >= 0 && id < numRecords);
+            seen[id]++;
+            ASSERT_EQ(textLength, id % 4 == 0 ? grownLength : 80)
+                                        << "Record " << id << " should have its latest value.";
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rid, readBack.data()), success);
+            ASSERT_EQ(memcmp(readBack.data(), data.data(), 1 + 2 * sizeof(int) + textLength), 0);
+        }
+        iterator.close();
+        ASSERT_EQ(std::count(seen.begin(), seen.end(), 1), numRecords) << "Every record should be returned once.";
+
+        // the single Int comparison takes the page-at-a-time path of getNextBatch
+        ASSERT_EQ(rbfm.openFile(fileName, scanHandle), success);
+        ASSERT_EQ(rbfm.scan(scanHandle, recordDescriptor, "Id", PeterDB::GE_OP, &zero, {"Id"}, iterator), success);
+        std::fill(seen.begin(), seen.end(), 0);
+        PeterDB::RecordBatch batch;
+        while (iterator.getNextBatch(batch) != RBFM_EOF) {
+            for (unsigned row = 0; row < batch.getNumberOfRows(); row++) {
+                seen[batch.getInt(0, row)]++;
+            }
+        }
+        iterator.close();
+        ASSERT_EQ(std::count(seen.begin(), seen.end(), 1), numRecords) << "Every record should be returned once.";
+    }
+
+    TEST_F(RBFM_Test, scan_sees_deletes_and_updates_made_while_it_runs) {
+        // Functions Tested:
+        // 1. Fill a few pages with small records and scan them for Id >= 0, by record and by batches of 4 rows
+        // 2. After each record or batch, delete the next record and set the Id of the one after to -1 in place,
+        //    through another handle on the page the scan has pinned
+        // 3. The scan returns neither of them, and every record left alone exactly once with its value
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createIdTextDescriptor(recordDescriptor);
+        const int numRecords = PAGE_SIZE / 20;
+        std::vector<char> record;
+        for (bool batched : {false, true}) {
+            std::vector<PeterDB::RID> rids(numRecords);
+            for (int id = 0; id < numRecords; id++) {
+                prepareIdTextRecord(id, 40, 'a', record);
+                ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, record.data(), rids[id]), success);
+            }
+            std::vector<bool> changed(numRecords, false);
+            auto changeAfter = [&](int id) {
+                if (id + 1 < numRecords && !changed[id + 1]) {
+                    changed[id + 1] = true;
+                    ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[id + 1]), success);
+                }
+                if (id + 2 < numRecords && !changed[id + 2]) {
+                    changed[id + 2] = true;
+                    prepareIdTextRecord(-1, 40, 'a', record);
+                    ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, record.data(), rids[id + 2]), success);
+                }
+            };
+
+            PeterDB::FileHandle scanHandle;
+            ASSERT_EQ(rbfm.openFile(fileName, scanHandle), success);
+            PeterDB::RBFM_ScanIterator iterator;
+            int zero = 0;
+            ASSERT_EQ(rbfm.scan(scanHandle, recordDescriptor, "Id", PeterDB::GE_OP, &zero, {"Id", "Text"}, iterator),
+                      success);
+            std::vector<int> seen(numRecords, 0);
+            if (batched) {
+                PeterDB::RecordBatch batch(4);
+                while (iterator.getNextBatch(batch) != RBFM_EOF) {
+                    for (unsigned row = 0; row < batch.getNumberOfRows(); row++) {
+                        int id = batch.getInt(0, row);
+                        ASSERT_TRUE(id >= 0 && id < numRecords) << "A record changed to -1 should not match.";
+                        seen[id]++;
+                        ASSERT_EQ(batch.getRid(row).pageNum, rids[id].pageNum);
+                        ASSERT_EQ(batch.getRid(row).slotNum, rids[id].slotNum);
+                    }
+                    changeAfter(batch.getInt(0, batch.getNumberOfRows() - 1));
+                }
+            } else {
+                std::vector<char> data(PAGE_SIZE);
+                PeterDB::RID rid;
+                while (iterator.getNextRecord(rid, data.data()) != RBFM_EOF) {
+                    int id;
+                    memcpy(&id, data.data() + 1, sizeof(int));
+                    ASSERT_TRUE(id >= 0 && id < numRecords) << "A record changed to -1 should not match.";
+                    seen[id]++;
+                    ASSERT_EQ(rid.pageNum, rids[id].pageNum);
+                    ASSERT_EQ(rid.slotNum, rids[id].slotNum);
+                    changeAfter(id);
+                }
+            }
+            iterator.close();
+
+            unsigned kept = 0;
+            for (int id = 0; id < numRecords; id++) {
+                ASSERT_EQ(seen[id], changed[id] ? 0 : 1)
+                                            << "Record " << id << (changed[id] ? " was changed." : " was not.");
+                kept += !changed[id];
+            }
+            ASSERT_GT(kept, 0);
+            ASSERT_LT(kept, numRecords * 3 / 4) << "About a third of the records should have been changed.";
+
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+            ASSERT_EQ(rbfm.destroyFile(fileName), success);
+            ASSERT_EQ(rbfm.createFile(fileName), success);
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        }
+    }
+
+    // Salaries of the records a predicate scan returns, through getNextRecord or through getNextBatch
+    static std::vector<int> scanSalaries(PeterDB::RecordBasedFileManager &rbfm, const std::string &fileName,
+                                         const std::vector<PeterDB::Attribute> &recordDescriptor,
+                                         const PeterDB::Predicate &predicate, bool batched) {
+        std::vector<int> salaries;
+        PeterDB::FileHandle scanHandle;
+        PeterDB::RBFM_ScanIterator iterator;
+        EXPECT_EQ(rbfm.openFile(fileName, scanHandle), success);
+        EXPECT_EQ(rbfm.scan(scanHandle, recordDescriptor, predicate, {"Salary"}, iterator), success);
+        if (batched) {
+            PeterDB::RecordBatch batch;
+            while (iterator.getNextBatch(batch) != RBFM_EOF) {
+                for (unsigned row = 0; row < batch.getNumberOfRows(); row++) {
+                    salaries.push_back(batch.getInt(0, row));
+                }
+            }
+        } else {
+            PeterDB::RID rid;
+            char data[1 + sizeof(int)];
+            while (iterator.getNextRecord(rid, data) != RBFM_EOF) {
+                int salary;
+                memcpy(&salary, data + 1, sizeof(int));
+                salaries.push_back(salary);
+            }
+        }
+        iterator.close();
+        std::sort(salaries.begin(), salaries.end());
+        return salaries;
+    }
+
+    TEST_F(RBFM_Test, scan_with_predicate_trees) {
+        // Functions Tested:
+        // 1. Insert 300 records, every 13th has a null Age
+        // 2. Scan with AND/OR trees of comparisons, BETWEEN and IN over Int, Real and VarChar
+        // 3. Record and batch scans return exactly the records the predicate selects, nulls never match
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        inBuffer = malloc(100);
+
+        const int numRecords = 300;
+        auto nameOf = [](int i) { return "Emp" + std::to_string(i); };
+        auto ageOf = [](int i) { return i % 50; };
+        auto heightOf = [](int i) { return 150 + (float) (i % 40) * 0.5f; };
+        auto ageIsNull = [](int i) { return i % 13 == 0; };
+        PeterDB::RID rid;
+        for (int i = 0; i < numRecords; i++) {
+            nullsIndicator[0] = ageIsNull(i) ? 0x40 : 0;
+            size_t recordSize;
+            prepareRecord(recordDescriptor.size(), nullsIndicator, nameOf(i).length(), nameOf(i), ageOf(i), heightOf(i),
+                          5000 + i, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success);
+        }
+
+        int age20 = 20, age40 = 40, salaryA = 5003, salaryB = 5120, salaryC = 5299, salaryD = 9999;
+        float height155 = 155, height160 = 160;
+        std::string emp2 = "Emp2";
+        std::vector<char> name(sizeof(int) + emp2.length());
+        int nameLength = emp2.length();
+        memcpy(name.data(), &nameLength, sizeof(int));
+        memcpy(name.data() + sizeof(int), emp2.data(), nameLength);
+
+        typedef PeterDB::Predicate P;
+        std::vector<std::pair<P, std::function<bool(int)>>> cases = {
+                {P::between("Age", &age20, &age40),
+                        [&](int i) { return !ageIsNull(i) && ageOf(i) >= 20 && ageOf(i) <= 40; }},
+                {P::in("Salary", {&salaryA, &salaryB, &salaryC, &salaryD}),
+                        [&](int i) { return i == 3 || i == 120 || i == 299; }},
+                {P::conjunction({P::between("Height", &height155, &height160),
+                                 P::disjunction({P::compare("Age", PeterDB::LT_OP, &age20),
+                                                 P::compare("EmpName", PeterDB::GE_OP, name.data())})}),
+                        [&](int i) {
+                            return heightOf(i) >= 155 && heightOf(i) <= 160
+                                   && ((!ageIsNull(i) && ageOf(i) < 20) || nameOf(i) >= emp2);
+                        }},
+                {P::compare("Age", PeterDB::NE_OP, &age20),
+                        [&](int i) { return !ageIsNull(i) && ageOf(i) != 20; }},
+                {P::conjunction({}), [](int) { return true; }},
+                {P::disjunction({}), [](int) { return false; }},
+        };
+        for (unsigned c = 0; c < cases.size(); c++) {
+            std::vector<int> expected;
+            for (int i = 0; i < numRecords; i++) {
+                if (cases[c].second(i)) {
+                    expected.push_back(5000 + i);
+                }
+            }
+            ASSERT_EQ(scanSalaries(rbfm, fileName, recordDescriptor, cases[c].first, false), expected)
+                                        << "Record scan of case " << c << " should match.";
+            ASSERT_EQ(scanSalaries(rbfm, fileName, recordDescriptor, cases[c].first, true), expected)
+                                        << "Batch scan of case " << c << " should match.";
+        }
+
+        PeterDB::RBFM_ScanIterator iterator;
+        ASSERT_NE(rbfm.scan(fileHandle, recordDescriptor, P::compare("Bonus", PeterDB::EQ_OP, &age20), {"Salary"},
+                            iterator), success) << "An unknown attribute should be rejected.";
+    }
+
+    template<typename T>
+    static bool compareScalar(T lhs, PeterDB::CompOp compOp, T rhs) {
+        switch (compOp) {
+            case PeterDB::EQ_OP: return lhs == rhs;
+            case PeterDB::LT_OP: return lhs < rhs;
+            case PeterDB::LE_OP: return lhs <= rhs;
+            case PeterDB::GT_OP: return lhs > rhs;
+            case PeterDB::GE_OP: return lhs >= rhs;
+            case PeterDB::NE_OP: return lhs != rhs;
+            default: return true;
+        }
+    }
+
+    TEST(RBFM_Compare_Kernel_Test, masks_match_scalar_comparisons) {
+        // Functions Tested:
+        // 1. selectInts() and selectReals() for every operator
+        // 2. Counts around the vector widths, so the scalar tail is covered too
+        // 3. Extreme values and -0.0, which compares equal to 0.0
+
+        const PeterDB::CompOp ops[] = {PeterDB::EQ_OP, PeterDB::LT_OP, PeterDB::LE_OP, PeterDB::GT_OP,
+                                       PeterDB::GE_OP, PeterDB::NE_OP, PeterDB::NO_OP};
+        const unsigned counts[] = {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 1000};
+        std::vector<int> ints;
+        std::vector<float> reals;
+        for (unsigned i = 0; i < 1000; i++) {
+            ints.push_back((int) (i * 7919 % 41) - 20);
+            reals.push_back((float) ((int) (i * 104729 % 37) - 18) / 4);
+        }
+        ints[5] = INT_MIN;
+        ints[6] = INT_MAX;
+        reals[5] = -0.0f;
+        reals[6] = -std::numeric_limits<float>::max();
+
+        for (unsigned count : counts) {
+            std::vector<unsigned char> mask((count + CHAR_BIT - 1) / CHAR_BIT + 1);
+            for (PeterDB::CompOp compOp : ops) {
+                for (int value : {0, -20, 20, 7, INT_MIN, INT_MAX}) {
+                    std::fill(mask.begin(), mask.end(), 0xA5);
+                    PeterDB::CompareKernel::selectInts(ints.data(), count, compOp, value, mask.data());
+                    for (unsigned row = 0; row < count; row++) {
+                        bool selected = mask[row / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT));
+                        ASSERT_EQ(selected, compareScalar(ints[row], compOp, value))
+                                                    << "Int row " << row << " of " << count << ", op " << compOp
+                                                    << ", value " << value;
+                    }
+                    ASSERT_EQ(mask.back(), 0xA5) << "The mask should not be written past its bytes.";
+                }
+                for (float value : {0.0f, -0.0f, 2.25f, -4.5f, 100.0f}) {
+                    std::fill(mask.begin(), mask.end(), 0xA5);
+                    PeterDB::CompareKernel::selectReals(reals.data(), count, compOp, value, mask.data());
+                    for (unsigned row = 0; row < count; row++) {
+                        bool selected = mask[row / CHAR_BIT] & (1u << (unsigned) (CHAR_BIT - 1 - row % CHAR_BIT));
+                        ASSERT_EQ(selected, compareScalar(reals[row], compOp, value))
+                                                    << "Real row " << row << " of " << count << ", op " << compOp
+                                                    << ", value " << value;
+                    }
+                    ASSERT_EQ(mask.back(), 0xA5) << "The mask should not be written past its bytes.";
+                }
+            }
+        }
+    }
+
+    TEST_F(RBFM_Test, insert_records_stops_at_a_record_too_large) {
+        // Functions Tested:
+        // 1. insertRecords() with a record that cannot fit in any page
+        // 2. It fails, and only rids of records already on appended pages are returned
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createIdTextDescriptor(recordDescriptor);
+        recordDescriptor[1].length = 2 * PAGE_SIZE;
+        std::vector<char> small, huge;
+        prepareIdTextRecord(1, 10, 's', small);
+        prepareIdTextRecord(2, PAGE_SIZE, 'h', huge);
+
+        std::vector<PeterDB::RID> rids;
+        ASSERT_NE(rbfm.insertRecords(fileHandle, recordDescriptor, {small.data(), small.data(), huge.data()}, rids),
+                  success) << "A record larger than a page should fail the batch.";
+        ASSERT_TRUE(rids.empty()) << "The records before it were still on the unwritten page.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 0) << "Nothing should have been appended.";
+
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, {small.data(), small.data()}, rids), success);
+        ASSERT_EQ(rids.size(), 2);
+        ASSERT_EQ(rids[0].pageNum, rids[1].pageNum) << "A small batch fills one page.";
+        ASSERT_EQ(rids[1].slotNum, rids[0].slotNum + 1);
+    }
 
 }// namespace PeterDBTesting
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <dirent.h>
+
 #include "test/utils/rm_test_util.h"
 
 namespace PeterDBTesting {
@@ -695,4 +697,390 @@ namespace PeterDBTesting {
     }
     */
 
+    TEST_F(RM_Tuple_Test, insert_tuples_in_bulk) {
+        // Functions tested
+        // 1. insertTuples() of 2000 tuples into a table with an index on age, every 7th age is null
+        // 2. Every rid reads back its tuple
+        // 3. The index has exactly the non-null ages, a range scan agrees with the data
+        // 4. An empty batch inserts nothing, the catalog tables are refused
+
+        bufSize = 100;
+        outBuffer = malloc(bufSize);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+
+        const unsigned numTuples = 2000;
+        std::vector<std::vector<char>> tuples(numTuples, std::vector<char>(bufSize, 0));
+        std::vector<size_t> tupleSizes(numTuples);
+        std::vector<const void *> data;
+        unsigned expectedInRange = 0;
+        for (unsigned i = 0; i < numTuples; i++) {
+            nullsIndicator[0] = i % 7 == 0 ? 0x40 : 0;
+            std::string name = "Peter" + std::to_string(i);
+            unsigned age = i % 90;
+            prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age, 160 + (float) (i % 30), 1000 + i,
+                         tuples[i].data(), tupleSizes[i]);
+            data.push_back(tuples[i].data());
+            if (i % 7 != 0 && age >= 10 && age <= 20) {
+                expectedInRange++;
+            }
+        }
+
+        std::vector<PeterDB::RID> rids;
+        ASSERT_EQ(rm.insertTuples(tableName, data, rids), success) << "RelationManager::insertTuples() should succeed.";
+        ASSERT_EQ(rids.size(), numTuples) << "Every tuple should get a rid.";
+        for (unsigned i = 0; i < numTuples; i++) {
+            memset(outBuffer, 0, bufSize);
+            ASSERT_EQ(rm.readTuple(tableName, rids[i], outBuffer), success);
+            ASSERT_EQ(memcmp(outBuffer, tuples[i].data(), tupleSizes[i]), 0) << "Tuple " << i << " should read back.";
+        }
+
+        unsigned low = 10, high = 20, count = 0;
+        PeterDB::RM_IndexScanIterator indexIterator;
+        ASSERT_EQ(rm.indexScan(tableName, "age", &low, &high, true, true, indexIterator), success);
+        unsigned key;
+        while (indexIterator.getNextEntry(rid, &key) != RM_EOF) {
+            ASSERT_TRUE(key >= low && key <= high) << "The index should only return keys in range.";
+            count++;
+        }
+        ASSERT_EQ(indexIterator.close(), success);
+        ASSERT_EQ(count, expectedInRange) << "The index should have one entry per non-null age in range.";
+
+        ASSERT_EQ(rm.insertTuples(tableName, {}, rids), success) << "An empty batch should succeed.";
+        ASSERT_TRUE(rids.empty());
+        ASSERT_NE(rm.insertTuples("Tables", data, rids), success) << "The catalog should not take tuples.";
+        ASSERT_EQ(rm.destroyIndex(tableName, "age"), success);
+    }
+
+    TEST_F(RM_Tuple_Test, catalog_cache_follows_table_changes) {
+        // Functions tested
+        // 1. getAttributes() and a tuple insert fill the catalog cache for the table
+        // 2. deleteTable() and createTable() under the same name with another schema
+        // 3. The new schema is used right away, the old cached entry is gone
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        outBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        ASSERT_EQ(attrs.size(), 4);
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        size_t tupleSize;
+        prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", 24, 170.1, 5000, inBuffer, tupleSize);
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+
+        ASSERT_EQ(rm.deleteTable(tableName), success) << "RelationManager::deleteTable() should succeed.";
+        ASSERT_NE(rm.getAttributes(tableName, attrs), success) << "A deleted table should have no attributes.";
+        ASSERT_NE(rm.insertTuple(tableName, inBuffer, rid), success) << "A deleted table should take no tuples.";
+
+        ASSERT_EQ(rm.createTable(tableName, parseDDL("CREATE TABLE " + tableName + " (id INT, name VARCHAR(20))")),
+                  success) << "Create table " << tableName << " should succeed.";
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        ASSERT_EQ(attrs.size(), 2) << "The new schema should be returned, not the cached one.";
+        ASSERT_EQ(attrs[0].name, "id");
+        ASSERT_EQ(attrs[1].name, "name");
+
+        // id 7, name "Anteater"
+        char tuple[1 + 2 * sizeof(int) + 8] = {0};
+        int id = 7, nameLength = 8;
+        memcpy(tuple + 1, &id, sizeof(int));
+        memcpy(tuple + 1 + sizeof(int), &nameLength, sizeof(int));
+        memcpy(tuple + 1 + 2 * sizeof(int), "Anteater", nameLength);
+        ASSERT_EQ(rm.insertTuple(tableName, tuple, rid), success) << "RelationManager::insertTuple() should succeed.";
+        ASSERT_EQ(rm.readTuple(tableName, rid, outBuffer), success) << "RelationManager::readTuple() should succeed.";
+        ASSERT_EQ(memcmp(outBuffer, tuple, sizeof(tuple)), 0) << "The tuple should be stored with the new schema.";
+        ASSERT_EQ(rm.readAttribute(tableName, rid, "name", outBuffer), success);
+        ASSERT_EQ(memcmp((char *) outBuffer + 1 + sizeof(int), "Anteater", nameLength), 0);
+    }
+
+    TEST_F(RM_Tuple_Test, table_file_is_reopened_after_recreate) {
+        // Functions tested
+        // 1. Insert and scan a table, so its file handle is cached
+        // 2. deleteTable() and createTable() under the same name and schema
+        // 3. A scan of the new table returns only the tuple inserted after the recreate
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        outBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        size_t tupleSize;
+        PeterDB::RID firstRid;
+        for (unsigned i = 0; i < 200; i++) {
+            prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", 24, 170.1, 5000 + i, inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+            if (i == 0) {
+                firstRid = rid;
+            }
+        }
+        std::vector<std::string> attrNames = {"salary"};
+        PeterDB::RM_ScanIterator rmsi;
+        ASSERT_EQ(rm.scan(tableName, "", PeterDB::NO_OP, NULL, attrNames, rmsi), success);
+        ASSERT_NE(rmsi.getNextTuple(rid, outBuffer), RM_EOF);
+        ASSERT_EQ(rmsi.close(), success);
+
+        ASSERT_EQ(rm.deleteTable(tableName), success) << "RelationManager::deleteTable() should succeed.";
+        ASSERT_EQ(rm.createTable(tableName, attrs), success) << "Create table " << tableName << " should succeed.";
+        prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", 24, 170.1, 42, inBuffer, tupleSize);
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+        ASSERT_EQ(rid.pageNum, firstRid.pageNum) << "The new table should start with an empty file.";
+        ASSERT_EQ(rid.slotNum, firstRid.slotNum);
+
+        unsigned count = 0;
+        ASSERT_EQ(rm.scan(tableName, "", PeterDB::NO_OP, NULL, attrNames, rmsi), success);
+        while (rmsi.getNextTuple(rid, outBuffer) != RM_EOF) {
+            ASSERT_EQ(*(float *) ((char *) outBuffer + 1), 42) << "Only the new tuple should be returned.";
+            count++;
+        }
+        ASSERT_EQ(rmsi.close(), success);
+        ASSERT_EQ(count, 1) << "The old tuples should be gone with the old file.";
+    }
+
+    // number of entries an index on age returns for ages in [0, 100]
+    static unsigned countAgeEntries(PeterDB::RelationManager &rm, const std::string &tableName) {
+        unsigned low = 0, high = 100, count = 0, key;
+        PeterDB::RID rid;
+        PeterDB::RM_IndexScanIterator indexIterator;
+        if (rm.indexScan(tableName, "age", &low, &high, true, true, indexIterator) != success) {
+            return 0;
+        }
+        while (indexIterator.getNextEntry(rid, &key) != RM_EOF) {
+            count++;
+        }
+        indexIterator.close();
+        return count;
+    }
+
+    TEST_F(RM_Tuple_Test, index_cache_follows_index_changes) {
+        // Functions tested
+        // 1. Tuples inserted before createIndex() are loaded, later inserts and deletes reach the new index
+        // 2. After destroyIndex() inserts still succeed, the index file is not created again, indexScan() fails
+        // 3. deleteTable() drops the index with the table, a recreated table starts with no index
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        size_t tupleSize;
+        for (unsigned i = 0; i < 50; i++) {
+            prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", i, 170.1, 5000, inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+        }
+
+        std::string indexFileName = tableName + "_age.idx";
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+        ASSERT_TRUE(fileExists(indexFileName)) << "The index file should exist now.";
+        ASSERT_EQ(countAgeEntries(rm, tableName), 50) << "The existing tuples should be in the new index.";
+        prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", 60, 170.1, 5000, inBuffer, tupleSize);
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+        ASSERT_EQ(countAgeEntries(rm, tableName), 51) << "An insert after createIndex() should reach the index.";
+        ASSERT_EQ(rm.deleteTuple(tableName, rid), success) << "RelationManager::deleteTuple() should succeed.";
+        ASSERT_EQ(countAgeEntries(rm, tableName), 50) << "A delete after createIndex() should reach the index.";
+
+        ASSERT_EQ(rm.destroyIndex(tableName, "age"), success) << "RelationManager::destroyIndex() should succeed.";
+        ASSERT_FALSE(fileExists(indexFileName)) << "The index file should be gone.";
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "Inserts should not need the dropped index.";
+        ASSERT_FALSE(fileExists(indexFileName)) << "An insert should not recreate the dropped index.";
+        unsigned low = 0;
+        PeterDB::RM_IndexScanIterator indexIterator;
+        ASSERT_NE(rm.indexScan(tableName, "age", &low, NULL, true, true, indexIterator), success)
+                                    << "A dropped index should not be scanned.";
+
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "The index should be created again.";
+        ASSERT_EQ(countAgeEntries(rm, tableName), 51);
+        ASSERT_EQ(rm.deleteTable(tableName), success) << "RelationManager::deleteTable() should succeed.";
+        ASSERT_FALSE(fileExists(indexFileName)) << "Deleting the table should drop its index.";
+        ASSERT_EQ(rm.createTable(tableName, attrs), success) << "Create table " << tableName << " should succeed.";
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+        ASSERT_FALSE(fileExists(indexFileName)) << "The recreated table should have no index.";
+        ASSERT_NE(rm.indexScan(tableName, "age", &low, NULL, true, true, indexIterator), success);
+    }
+
+
+    static bool ridLess(const PeterDB::RID &lhs, const PeterDB::RID &rhs) {
+        return lhs.pageNum < rhs.pageNum || (lhs.pageNum == rhs.pageNum && lhs.slotNum < rhs.slotNum);
+    }
+
+    TEST_F(RM_Tuple_Test, covering_index_orders_rows_by_key_only) {
+        // Functions tested
+        // 1. createIndex() on age including salary, over existing tuples and with later inserts
+        // 2. Rows sharing an age come back in rid order, whatever their salaries
+        // 3. Every entry carries the salary of its tuple, also after an update of the salary
+        // 4. An equality scan on age returns every row with it, and none once they are deleted
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        outBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        size_t tupleSize;
+        const unsigned numTuples = 300;
+        std::map<std::pair<unsigned, unsigned>, float> salaries;
+        std::vector<PeterDB::RID> rids;
+        for (unsigned i = 0; i < numTuples; i++) {
+            if (i == 200) {
+                ASSERT_EQ(rm.createIndex(tableName, {"age"}, {"salary"}), success)
+                                            << "RelationManager::createIndex() should succeed.";
+            }
+            // salaries fall as rids grow, so ordering on them would reverse the rows of an age
+            float salary = 9000 - (float) i;
+            prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", i % 10, 170.1, salary, inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+            salaries[std::make_pair(rid.pageNum, rid.slotNum)] = salary;
+            rids.push_back(rid);
+        }
+
+        // age 3 gets a new salary on one row
+        prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", 3, 170.1, 20000, inBuffer, tupleSize);
+        ASSERT_EQ(rm.updateTuple(tableName, inBuffer, rids[3]), success) << "RelationManager::updateTuple() should succeed.";
+        salaries[std::make_pair(rids[3].pageNum, rids[3].slotNum)] = 20000;
+
+        char entry[1 + sizeof(int) + sizeof(float)];
+        PeterDB::RM_IndexScanIterator indexIterator;
+        ASSERT_EQ(rm.indexScan(tableName, {"age"}, {"salary"}, {}, {}, true, true, indexIterator), success);
+        unsigned count = 0;
+        int lastAge = -1;
+        PeterDB::RID lastRid = {0, 0};
+        while (indexIterator.getNextEntry(rid, entry) != RM_EOF) {
+            int age = *(int *) (entry + 1);
+            ASSERT_GE(age, lastAge) << "Entries should come in age order.";
+            if (age == lastAge) {
+                ASSERT_TRUE(ridLess(lastRid, rid)) << "Rows with the same age should come in rid order.";
+            }
+            ASSERT_EQ(*(float *) (entry + 1 + sizeof(int)), salaries[std::make_pair(rid.pageNum, rid.slotNum)])
+                                        << "The entry should carry the salary of its tuple.";
+            lastAge = age;
+            lastRid = rid;
+            count++;
+        }
+        ASSERT_EQ(indexIterator.close(), success);
+        ASSERT_EQ(count, numTuples) << "Every tuple should have one entry.";
+
+        int age = 3;
+        count = 0;
+        ASSERT_EQ(rm.indexScan(tableName, {"age"}, {"salary"}, {&age}, {&age}, true, true, indexIterator), success);
+        while (indexIterator.getNextEntry(rid, entry) != RM_EOF) {
+            ASSERT_EQ(*(int *) (entry + 1), age);
+            count++;
+        }
+        ASSERT_EQ(indexIterator.close(), success);
+        ASSERT_EQ(count, numTuples / 10) << "An equality scan should return every row of the age.";
+
+        for (unsigned i = 3; i < numTuples; i += 10) {
+            ASSERT_EQ(rm.deleteTuple(tableName, rids[i]), success) << "RelationManager::deleteTuple() should succeed.";
+        }
+        ASSERT_EQ(rm.indexScan(tableName, {"age"}, {"salary"}, {&age}, {&age}, true, true, indexIterator), success);
+        ASSERT_EQ(indexIterator.getNextEntry(rid, entry), RM_EOF) << "The deleted rows should leave the index.";
+        ASSERT_EQ(indexIterator.close(), success);
+        ASSERT_EQ(rm.destroyIndex(tableName, {"age"}, {"salary"}), success);
+    }
+
+
+    // descriptors the process has open, from /proc/self/fd
+    static unsigned countOpenFiles() {
+        unsigned count = 0;
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir == nullptr) {
+            return 0;
+        }
+        while (readdir(dir) != nullptr) {
+            count++;
+        }
+        closedir(dir);
+        return count;
+    }
+
+    TEST_F(RM_Tuple_Test, create_index_closes_the_table_file) {
+        // Functions tested
+        // 1. createIndex() and destroyIndex() over a table with tuples, 20 times
+        // 2. Once the cached handles are closed, no file is left open by the index builds
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        size_t tupleSize;
+        for (unsigned i = 0; i < 100; i++) {
+            prepareTuple(attrs.size(), nullsIndicator, 5, "Peter", i, 170.1, 5000, inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+        }
+
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        ASSERT_EQ(pfm.closeIdleHandles(), success);
+        unsigned openBefore = countOpenFiles();
+        for (unsigned round = 0; round < 20; round++) {
+            ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+            ASSERT_EQ(rm.destroyIndex(tableName, "age"), success) << "RelationManager::destroyIndex() should succeed.";
+        }
+        ASSERT_EQ(pfm.closeIdleHandles(), success);
+        ASSERT_EQ(countOpenFiles(), openBefore) << "Building an index should not leave the table file open.";
+    }
+
+
+    // printBTree of an index file, read through the IX layer
+    static std::string printIndex(const std::string &fileName, const PeterDB::Attribute &attribute) {
+        PeterDB::IndexManager &ix = PeterDB::IndexManager::instance();
+        PeterDB::IXFileHandle ixFileHandle;
+        std::stringstream stream;
+        EXPECT_EQ(ix.openFile(fileName, ixFileHandle), success);
+        EXPECT_EQ(ix.printBTree(ixFileHandle, attribute, stream), success);
+        EXPECT_EQ(ix.closeFile(ixFileHandle), success);
+        return stream.str();
+    }
+
+    TEST_F(RM_Tuple_Test, index_key_compression_is_opt_in) {
+        // Functions tested
+        // 1. createIndex() on emp_name, names sharing a 19 byte prefix, prints the same tree as a plain IX index
+        //    bulk-loaded with the same entries
+        // 2. createIndex() with CompressedBTreeIndex prints another tree, and finds the same entries
+
+        bufSize = 100;
+        inBuffer = calloc(bufSize, 1);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        nullsIndicator = initializeNullFieldsIndicator(attrs);
+        PeterDB::IndexManager &ix = PeterDB::IndexManager::instance();
+        PeterDB::IX_KeySorter sorter(attrs[0]);
+        const unsigned numTuples = PAGE_SIZE / 10;
+        size_t tupleSize;
+        for (unsigned i = 0; i < numTuples; i++) {
+            std::string digits = std::to_string(i);
+            std::string name = "customer/region-eu/" + std::string(6 - digits.size(), '0') + digits + std::string(25, 'x');
+            prepareTuple(attrs.size(), nullsIndicator, name.length(), name, i, 170.1, 5000, inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success) << "RelationManager::insertTuple() should succeed.";
+            ASSERT_EQ(sorter.addEntry((char *) inBuffer + 1, rid), success);
+        }
+
+        std::string indexFileName = tableName + "_emp_name.idx";
+        ASSERT_EQ(rm.createIndex(tableName, "emp_name"), success) << "RelationManager::createIndex() should succeed.";
+        std::string plainTree = printIndex(indexFileName, attrs[0]);
+
+        std::string referenceFileName = "reference_emp_name.idx";
+        PeterDB::IXFileHandle ixFileHandle;
+        ASSERT_EQ(ix.createFile(referenceFileName), success);
+        ASSERT_EQ(ix.openFile(referenceFileName, ixFileHandle), success);
+        ASSERT_EQ(sorter.finish(), success);
+        ASSERT_EQ(ix.bulkLoad(ixFileHandle, attrs[0], sorter), success);
+        ASSERT_EQ(ix.closeFile(ixFileHandle), success);
+        ASSERT_EQ(plainTree, printIndex(referenceFileName, attrs[0]))
+                                    << "An index created without the option should print as a plain IX index.";
+        ASSERT_EQ(ix.destroyFile(referenceFileName), success);
+
+        ASSERT_EQ(rm.destroyIndex(tableName, "emp_name"), success);
+        ASSERT_EQ(rm.createIndex(tableName, {"emp_name"}, PeterDB::CompressedBTreeIndex), success)
+                                    << "RelationManager::createIndex() of a compressed index should succeed.";
+        ASSERT_NE(printIndex(indexFileName, attrs[0]), plainTree) << "Compressed nodes should print another tree.";
+
+        char name[sizeof(unsigned) + 50];
+        std::string wanted = "customer/region-eu/000042" + std::string(25, 'x');
+        unsigned length = wanted.size();
+        memcpy(name, &length, sizeof(unsigned));
+        memcpy(name + sizeof(unsigned), wanted.data(), length);
+        PeterDB::RM_IndexScanIterator indexIterator;
+        ASSERT_EQ(rm.indexScan(tableName, "emp_name", name, name, true, true, indexIterator), success);
+        ASSERT_EQ(indexIterator.getNextEntry(rid, name), success) << "The compressed index should find the name.";
+        ASSERT_EQ(indexIterator.getNextEntry(rid, name), RM_EOF);
+        ASSERT_EQ(indexIterator.close(), success);
+        ASSERT_EQ(rm.destroyIndex(tableName, "emp_name"), success);
+    }
+
 }
\ No newline at end of file
@@ -214,7 +214,7 @@ namespace PeterDBTesting {
         }
 
         static void prepareKeyAndRid(const unsigned seed, char *key, PeterDB::RID &rid, unsigned fixedLength = NULL) {
-            unsigned length = (fixedLength == NULL ? seed : fixedLength) % 1000;
+            unsigned length = fixedLength == NULL ? seed % 1000 : fixedLength;
             *(unsigned *) key = length;
             for (int i = 0; i < length; i++) {
                 key[4 + i] = 'a' + seed % 26;